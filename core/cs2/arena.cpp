@@ -0,0 +1,78 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+void cs2::Arena::addChunk(size_t bytes)
+{
+	// The header sits at the start of the chunk, followed by the usable space.
+	size_t header = (sizeof(Chunk) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+	char* memory = static_cast<char*>(::operator new(header + bytes));
+
+	Chunk* chunk = reinterpret_cast<Chunk*>(memory);
+	chunk->next = head;
+	chunk->size = header + bytes;
+	head = chunk;
+
+	cursor = memory + header;
+	limit = cursor + bytes;
+	reserved += bytes;
+	chunks++;
+}
+
+void cs2::Arena::reserve(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (static_cast<size_t>(limit - cursor) < bytes)
+		addChunk(bytes);
+}
+
+void cs2::Arena::release()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	while (head)
+	{
+		Chunk* next = head->next;
+		::operator delete(head);
+		head = next;
+	}
+
+	cursor = nullptr;
+	limit = nullptr;
+	reserved = 0;
+	used = 0;
+	chunks = 0;
+}
+
+cs2::ArenaStats cs2::Arena::getStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	ArenaStats stats;
+	stats.reserved = reserved;
+	stats.used = used;
+	stats.chunks = chunks;
+	return stats;
+}
+
+void* cs2::Arena::do_allocate(size_t bytes, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto align = [&](char* p) {
+		return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+	};
+
+	char* start = align(cursor);
+	if (!cursor || start + bytes > limit)
+	{
+		// Grow geometrically so a long run of small allocations stays cheap.
+		addChunk(std::max({ bytes + alignment, chunk_size, reserved / 2 }));
+		start = align(cursor);
+	}
+
+	cursor = start + bytes;
+	used += bytes;
+	return start;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+
+namespace cs2
+{
+	class ArenaStats {
+	public:
+		// Bytes held in chunks, handed out, and left unused (alignment padding included).
+		size_t reserved = 0;
+		size_t used = 0;
+		size_t chunks = 0;
+
+		size_t getSlack() const { return reserved - used; }
+	};
+
+	/// <summary>
+	/// Thread-safe monotonic memory resource. Allocations bump a pointer through
+	/// large chunks and are never freed one by one; all chunks are released
+	/// together when the arena is destroyed. Reserving the total size up front
+	/// keeps everything in a single chunk.
+	/// </summary>
+	class Arena : public std::pmr::memory_resource {
+	public:
+		/// <param name="chunkSize">
+		/// The size of chunks allocated when the reserved space runs out.
+		/// </param>
+		explicit Arena(size_t chunkSize = 64 * 1024) : chunk_size(chunkSize) {}
+		~Arena() override { release(); }
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		/// <summary>
+		/// Make sure the next allocations totalling bytes fit without another chunk.
+		/// </summary>
+		void reserve(size_t bytes);
+
+		/// <summary>
+		/// Free every chunk. Memory handed out before becomes invalid.
+		/// </summary>
+		void release();
+
+		ArenaStats getStats() const;
+
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void*, size_t, size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	private:
+		struct Chunk {
+			Chunk* next;
+			size_t size;
+		};
+
+		void addChunk(size_t bytes);
+
+		mutable std::mutex mutex;
+		Chunk* head = nullptr;
+		char* cursor = nullptr;
+		char* limit = nullptr;
+		size_t chunk_size;
+		size_t reserved = 0;
+		size_t used = 0;
+		size_t chunks = 0;
+	};
+} // namespace cs2
@@ -0,0 +1,480 @@
+#include "bvh.h"
+
+namespace
+{
+	constexpr uint32_t kNone = 0xFFFFFFFF;
+	constexpr size_t kMaxBins = 64;
+	// Past this depth splits fall back to the median, which bounds the total depth.
+	constexpr size_t kMedianDepth = 64;
+	constexpr size_t kMaxLeafBlocks = 128;
+	constexpr uint32_t kMaxBlocks = 0x00FFFFFF;
+	constexpr float kTraversalCost = 1.0f;
+
+	float surfaceArea(const cs2::Aabb& box)
+	{
+		if (box.isEmpty())
+			return 0.0f;
+		float dx = box.max.x - box.min.x, dy = box.max.y - box.min.y, dz = box.max.z - box.min.z;
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	// Stored child bounds are padded outwards slightly, so rays lying in a face
+	// plane or grazing an edge still enter every leaf whose triangles they touch.
+	cs2::Aabb padBounds(const cs2::Aabb& box)
+	{
+		auto pad = [](float value) { return std::max(std::fabs(value), 1.0f) * 1e-6f; };
+		return cs2::Aabb(cs2::Vec3(box.min.x - pad(box.min.x), box.min.y - pad(box.min.y), box.min.z - pad(box.min.z)),
+			cs2::Vec3(box.max.x + pad(box.max.x), box.max.y + pad(box.max.y), box.max.z + pad(box.max.z)));
+	}
+
+	float axisOf(const cs2::Vec3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	cs2::Vec3 centerOf(const cs2::Aabb& box)
+	{
+		return cs2::Vec3((box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f);
+	}
+
+	size_t blocksFor(size_t count)
+	{
+		return (count + cs2::TriangleBlock::kLanes - 1) / cs2::TriangleBlock::kLanes;
+	}
+
+	// Binary tree node. A leaf covers refs [first, first + count); a placeholder
+	// stands for the root of a subtree built on another thread.
+	struct BuildNode {
+		cs2::Aabb bounds;
+		uint32_t left = kNone;
+		uint32_t right = kNone;
+		uint32_t first = 0;
+		uint32_t count = 0;
+		uint32_t subtree = kNone;
+
+		bool isLeaf() const { return left == kNone && subtree == kNone; }
+	};
+
+	struct BuildTask {
+		uint32_t first;
+		uint32_t count;
+		cs2::Aabb bounds;
+		size_t depth;
+	};
+
+	class Builder {
+	public:
+		Builder(const std::vector<cs2::Aabb>& triangleBounds, std::vector<uint32_t>& refs, const cs2::BvhOptions& options) :
+			triangle_bounds(triangleBounds), refs(refs),
+			bins(std::clamp<size_t>(options.bins, 2, kMaxBins)),
+			max_leaf(std::clamp<size_t>(options.max_leaf_triangles, 1, kMaxLeafBlocks * cs2::TriangleBlock::kLanes)) {}
+
+		// Build the subtree over refs [first, first + count) into nodes. Ranges
+		// larger than task_size become placeholders collected in tasks instead.
+		uint32_t build(std::vector<BuildNode>& nodes, uint32_t first, uint32_t count, const cs2::Aabb& nodeBounds, size_t depth,
+			size_t task_size = 0, std::vector<BuildTask>* tasks = nullptr)
+		{
+			uint32_t index = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+			nodes[index].bounds = nodeBounds;
+
+			if (tasks && count <= task_size)
+			{
+				nodes[index].subtree = static_cast<uint32_t>(tasks->size());
+				tasks->push_back({ first, count, nodeBounds, depth });
+				return index;
+			}
+
+			uint32_t middle;
+			cs2::Aabb left_bounds, right_bounds;
+			if (!split(first, count, nodeBounds, depth, middle, left_bounds, right_bounds))
+			{
+				nodes[index].first = first;
+				nodes[index].count = count;
+				return index;
+			}
+
+			uint32_t left = build(nodes, first, middle - first, left_bounds, depth + 1, task_size, tasks);
+			uint32_t right = build(nodes, middle, first + count - middle, right_bounds, depth + 1, task_size, tasks);
+			nodes[index].left = left;
+			nodes[index].right = right;
+			return index;
+		}
+
+	private:
+		struct Bin {
+			cs2::Aabb bounds;
+			uint32_t count = 0;
+		};
+
+		const std::vector<cs2::Aabb>& triangle_bounds;
+		std::vector<uint32_t>& refs;
+		size_t bins;
+		size_t max_leaf;
+
+		// Choose where to split a range and partition it, false to make a leaf.
+		bool split(uint32_t first, uint32_t count, const cs2::Aabb& nodeBounds, size_t depth, uint32_t& middle, cs2::Aabb& leftBounds, cs2::Aabb& rightBounds)
+		{
+			if (count <= 1)
+				return false;
+
+			cs2::Aabb centroid_bounds;
+			for (uint32_t i = first; i < first + count; i++)
+				centroid_bounds.extend(centerOf(triangle_bounds[refs[i]]));
+
+			float leaf_cost = static_cast<float>(blocksFor(count));
+			float best_cost = std::numeric_limits<float>::max();
+			int best_axis = -1;
+			size_t best_bin = 0;
+
+			if (depth < kMedianDepth)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					float low = axisOf(centroid_bounds.min, axis);
+					float extent = axisOf(centroid_bounds.max, axis) - low;
+					if (!(extent > 0.0f))
+						continue;
+
+					Bin bin_list[kMaxBins];
+					float scale = static_cast<float>(bins) / extent;
+					for (uint32_t i = first; i < first + count; i++)
+					{
+						const cs2::Aabb& box = triangle_bounds[refs[i]];
+						size_t b = std::min(bins - 1, static_cast<size_t>((axisOf(centerOf(box), axis) - low) * scale));
+						bin_list[b].bounds.extend(box);
+						bin_list[b].count++;
+					}
+
+					// Sweep from the right to get the cost of every right side, then from the left.
+					float right_area[kMaxBins];
+					uint32_t right_count[kMaxBins];
+					cs2::Aabb accumulated;
+					uint32_t accumulated_count = 0;
+					for (size_t b = bins - 1; b > 0; b--)
+					{
+						accumulated.extend(bin_list[b].bounds);
+						accumulated_count += bin_list[b].count;
+						right_area[b] = surfaceArea(accumulated);
+						right_count[b] = accumulated_count;
+					}
+
+					accumulated = cs2::Aabb();
+					accumulated_count = 0;
+					float parent_area = surfaceArea(nodeBounds);
+					for (size_t b = 1; b < bins; b++)
+					{
+						accumulated.extend(bin_list[b - 1].bounds);
+						accumulated_count += bin_list[b - 1].count;
+						if (accumulated_count == 0 || right_count[b] == 0)
+							continue;
+
+						float cost = kTraversalCost + (surfaceArea(accumulated) * blocksFor(accumulated_count) +
+							right_area[b] * blocksFor(right_count[b])) / std::max(parent_area, 1e-20f);
+						if (cost < best_cost)
+						{
+							best_cost = cost;
+							best_axis = axis;
+							best_bin = b;
+						}
+					}
+				}
+
+				if (count <= max_leaf && leaf_cost <= best_cost)
+					return false;
+			}
+
+			if (best_axis >= 0)
+			{
+				float low = axisOf(centroid_bounds.min, best_axis);
+				float scale = static_cast<float>(bins) / (axisOf(centroid_bounds.max, best_axis) - low);
+				auto it = std::partition(refs.begin() + first, refs.begin() + first + count, [&](uint32_t ref) {
+					size_t b = std::min(bins - 1, static_cast<size_t>((axisOf(centerOf(triangle_bounds[ref]), best_axis) - low) * scale));
+					return b < best_bin;
+				});
+				middle = static_cast<uint32_t>(it - refs.begin());
+			}
+			else
+			{
+				if (count <= max_leaf)
+					return false;
+
+				// No usable SAH split, or past the median depth: halve the range along the widest centroid axis.
+				int axis = 0;
+				cs2::Vec3 extent(centroid_bounds.max.x - centroid_bounds.min.x, centroid_bounds.max.y - centroid_bounds.min.y, centroid_bounds.max.z - centroid_bounds.min.z);
+				if (extent.y > extent.x && extent.y >= extent.z)
+					axis = 1;
+				else if (extent.z > extent.x && extent.z > extent.y)
+					axis = 2;
+
+				middle = first + count / 2;
+				std::nth_element(refs.begin() + first, refs.begin() + middle, refs.begin() + first + count, [&](uint32_t a, uint32_t b) {
+					return axisOf(centerOf(triangle_bounds[a]), axis) < axisOf(centerOf(triangle_bounds[b]), axis);
+				});
+			}
+
+			leftBounds = cs2::Aabb();
+			rightBounds = cs2::Aabb();
+			for (uint32_t i = first; i < middle; i++)
+				leftBounds.extend(triangle_bounds[refs[i]]);
+			for (uint32_t i = middle; i < first + count; i++)
+				rightBounds.extend(triangle_bounds[refs[i]]);
+
+			return true;
+		}
+	};
+
+	// A binary node somewhere in the top tree or one of the subtrees.
+	struct NodeRef {
+		uint32_t tree;
+		uint32_t index;
+	};
+
+	struct LeafRun {
+		uint32_t first_ref;
+		uint32_t count;
+		uint32_t first_block;
+	};
+
+	class Collapser {
+	public:
+		Collapser(const std::vector<std::vector<BuildNode>>& trees, std::vector<cs2::BvhNode>& nodes, cs2::BvhStats& stats) :
+			trees(trees), nodes(nodes), stats(stats) {}
+
+		std::vector<LeafRun> leaves;
+		uint32_t next_block = 0;
+		bool overflow = false;
+
+		const BuildNode& get(NodeRef ref) const { return trees[ref.tree][ref.index]; }
+
+		// Placeholders are replaced by the root of the subtree they stand for; tree 0 is the top tree.
+		NodeRef resolve(NodeRef ref) const
+		{
+			const BuildNode& node = get(ref);
+			if (node.subtree != kNone)
+				return NodeRef{ node.subtree + 1, 0 };
+			return ref;
+		}
+
+		uint32_t makeLeaf(const BuildNode& node)
+		{
+			uint32_t blocks = static_cast<uint32_t>(blocksFor(node.count));
+			if (next_block + blocks > kMaxBlocks)
+			{
+				overflow = true;
+				return cs2::BvhNode::kEmptyChild;
+			}
+
+			leaves.push_back({ node.first, node.count, next_block });
+			uint32_t child = cs2::BvhNode::kLeafFlag | ((blocks - 1) << 24) | next_block;
+			next_block += blocks;
+			stats.leaves++;
+			return child;
+		}
+
+		// Emit the four-wide node for a binary inner node by pulling up grandchildren,
+		// always opening the largest child, until four children are collected.
+		uint32_t collapse(NodeRef ref, size_t depth)
+		{
+			stats.max_depth = std::max(stats.max_depth, depth);
+
+			NodeRef children[4];
+			size_t count = 0;
+			const BuildNode& node = get(ref);
+			children[count++] = resolve(NodeRef{ ref.tree, node.left });
+			children[count++] = resolve(NodeRef{ ref.tree, node.right });
+
+			while (count < 4)
+			{
+				int best = -1;
+				float best_area = -1.0f;
+				for (size_t i = 0; i < count; i++)
+				{
+					const BuildNode& child = get(children[i]);
+					if (!child.isLeaf() && surfaceArea(child.bounds) > best_area)
+					{
+						best_area = surfaceArea(child.bounds);
+						best = static_cast<int>(i);
+					}
+				}
+				if (best < 0)
+					break;
+
+				const BuildNode& opened = get(children[best]);
+				NodeRef tree_ref = children[best];
+				children[best] = resolve(NodeRef{ tree_ref.tree, opened.left });
+				children[count++] = resolve(NodeRef{ tree_ref.tree, opened.right });
+			}
+
+			uint32_t index = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+
+			for (size_t i = 0; i < 4; i++)
+			{
+				if (i >= count)
+				{
+					nodes[index].setChild(i, cs2::BvhNode::kEmptyChild, cs2::Aabb());
+					continue;
+				}
+
+				const BuildNode& child = get(children[i]);
+				uint32_t code = child.isLeaf() ? makeLeaf(child) : collapse(children[i], depth + 1);
+				nodes[index].setChild(i, code, padBounds(child.bounds));
+			}
+
+			return index;
+		}
+
+	private:
+		const std::vector<std::vector<BuildNode>>& trees;
+		std::vector<cs2::BvhNode>& nodes;
+		cs2::BvhStats& stats;
+	};
+}
+
+bool cs2::Bvh::build(const PhysicsFile& physics, const BvhOptions& options)
+{
+	return build(TriangleSoup(physics, options.threads), options);
+}
+
+bool cs2::Bvh::build(const TriangleSoup& source, const BvhOptions& options)
+{
+	auto start_time = std::chrono::steady_clock::now();
+
+	nodes.clear();
+	soup = TriangleSoup();
+	source_index.clear();
+	bounds = Aabb();
+	stats = BvhStats();
+
+	std::vector<uint32_t> refs;
+	refs.reserve(source.size());
+	for (size_t i = 0; i < source.size(); i++)
+		if (source.getHull(i) != TriangleSoup::kPadding)
+			refs.push_back(static_cast<uint32_t>(i));
+
+	if (refs.empty())
+		return true;
+
+	std::vector<Aabb> triangle_bounds(source.size());
+	parallelFor(refs.size(), options.threads, [&](size_t i, unsigned) {
+		Triangle tri = source.get(refs[i]);
+		Aabb& box = triangle_bounds[refs[i]];
+		box.extend(tri.a);
+		box.extend(tri.b);
+		box.extend(tri.c);
+	});
+
+	for (uint32_t ref : refs)
+		bounds.extend(triangle_bounds[ref]);
+
+	// Split the top of the tree on this thread until the ranges are small enough
+	// to keep every thread busy, then build the subtrees below them in parallel.
+	Builder builder(triangle_bounds, refs, options);
+	unsigned threads = resolveThreadCount(options.threads);
+	size_t task_size = threads > 1 ? std::max<size_t>(refs.size() / (threads * 4), 4096) : refs.size();
+
+	std::vector<std::vector<BuildNode>> trees(1);
+	std::vector<BuildTask> tasks;
+	builder.build(trees[0], 0, static_cast<uint32_t>(refs.size()), bounds, 0, task_size, &tasks);
+
+	trees.resize(tasks.size() + 1);
+	parallelFor(tasks.size(), options.threads, [&](size_t t, unsigned) {
+		const BuildTask& task = tasks[t];
+		builder.build(trees[t + 1], task.first, task.count, task.bounds, task.depth);
+	});
+
+	// Collapse into four-wide nodes depth first, so siblings and their leaf blocks sit together.
+	Collapser collapser(trees, nodes, stats);
+	NodeRef root = collapser.resolve(NodeRef{ 0, 0 });
+	if (collapser.get(root).isLeaf())
+	{
+		nodes.emplace_back();
+		nodes[0].setChild(0, collapser.makeLeaf(collapser.get(root)), padBounds(bounds));
+		for (size_t i = 1; i < 4; i++)
+			nodes[0].setChild(i, BvhNode::kEmptyChild, Aabb());
+	}
+	else
+	{
+		collapser.collapse(root, 1);
+	}
+
+	if (collapser.overflow)
+	{
+		std::cerr << "Too many triangles for the BVH: " << refs.size() << std::endl;
+		nodes.clear();
+		return false;
+	}
+
+	// Lay the triangles out in leaf order; lanes past the end of a leaf stay padding.
+	soup.resize(static_cast<size_t>(collapser.next_block) * TriangleSoup::kLanes);
+	source_index.assign(soup.size(), TriangleSoup::kPadding);
+
+	parallelFor(collapser.leaves.size(), options.threads, [&](size_t l, unsigned) {
+		const LeafRun& leaf = collapser.leaves[l];
+		for (uint32_t k = 0; k < leaf.count; k++)
+		{
+			uint32_t ref = refs[leaf.first_ref + k];
+			size_t lane = static_cast<size_t>(leaf.first_block) * TriangleSoup::kLanes + k;
+			soup.set(lane, source.get(ref), source.getHull(ref), source.getSurfaceProp(ref));
+			source_index[lane] = ref;
+		}
+	});
+
+	// Expected cost of a ray through the root: every node hit costs a traversal step, every leaf its blocks.
+	float root_area = std::max(surfaceArea(bounds), 1e-20f);
+	double cost = 0.0;
+	for (auto& node : nodes)
+	{
+		for (size_t i = 0; i < 4; i++)
+		{
+			uint32_t child = node.children[i];
+			if (child == BvhNode::kEmptyChild)
+				continue;
+			float area = surfaceArea(node.getChildBounds(i)) / root_area;
+			cost += isLeaf(child) ? area * getLeafBlockCount(child) : area * kTraversalCost;
+		}
+	}
+
+	stats.triangles = refs.size();
+	stats.nodes = nodes.size();
+	stats.blocks = collapser.next_block;
+	stats.padding = stats.blocks * TriangleSoup::kLanes - stats.triangles;
+	stats.sah_cost = kTraversalCost + cost;
+	stats.bytes = nodes.capacity() * sizeof(BvhNode) + soup.getBytes() + source_index.capacity() * sizeof(uint32_t);
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+	return true;
+}
+
+void cs2::Bvh::queryOverlap(const Aabb& box, std::vector<uint32_t>& triangles) const
+{
+	const std::vector<TriangleBlock>& blocks = soup.getBlocks();
+
+	forEachLeaf(box, [&](uint32_t firstBlock, uint32_t blockCount) {
+		for (size_t lane = static_cast<size_t>(firstBlock) * TriangleSoup::kLanes; lane < static_cast<size_t>(firstBlock + blockCount) * TriangleSoup::kLanes; lane++)
+		{
+			if (source_index[lane] == TriangleSoup::kPadding)
+				continue;
+
+			Triangle tri = blocks[lane / TriangleSoup::kLanes].get(lane % TriangleSoup::kLanes);
+			Aabb tri_bounds;
+			tri_bounds.extend(tri.a);
+			tri_bounds.extend(tri.b);
+			tri_bounds.extend(tri.c);
+			if (tri_bounds.overlaps(box))
+				triangles.push_back(source_index[lane]);
+		}
+	});
+}
+
+void cs2::Bvh::displayStats() const
+{
+	std::cout << "BVH Triangles: " << stats.triangles << std::endl;
+	std::cout << "BVH Nodes: " << stats.nodes << " (" << stats.leaves << " leaves, depth " << stats.max_depth << ")" << std::endl;
+	std::cout << "BVH Blocks: " << stats.blocks << " (" << stats.padding << " padding lanes)" << std::endl;
+	std::cout << "BVH SAH Cost: " << stats.sah_cost << std::endl;
+	std::cout << "BVH Memory: " << stats.bytes / 1024 << " KB" << std::endl;
+	std::cout << "BVH Build Time: " << stats.seconds * 1000.0 << " ms" << std::endl;
+	std::cout << std::endl;
+}
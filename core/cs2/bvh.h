@@ -0,0 +1,154 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "parser.h"
+#include "soup.h"
+
+namespace cs2
+{
+	/// <summary>
+	/// Four-wide BVH node. Child bounds are stored per component so one SSE
+	/// slab test covers all four children. A child is an inner node index, a
+	/// leaf (kLeafFlag set, see Bvh::getLeafFirstBlock/getLeafBlockCount) or
+	/// kEmptyChild, whose inverted bounds never overlap anything.
+	/// </summary>
+	struct alignas(64) BvhNode {
+		static constexpr uint32_t kLeafFlag = 0x80000000;
+		static constexpr uint32_t kEmptyChild = 0xFFFFFFFF;
+
+		float min_x[4], min_y[4], min_z[4];
+		float max_x[4], max_y[4], max_z[4];
+		uint32_t children[4];
+
+		Aabb getChildBounds(size_t i) const { return Aabb(Vec3(min_x[i], min_y[i], min_z[i]), Vec3(max_x[i], max_y[i], max_z[i])); }
+
+		void setChild(size_t i, uint32_t child, const Aabb& bounds)
+		{
+			children[i] = child;
+			min_x[i] = bounds.min.x; min_y[i] = bounds.min.y; min_z[i] = bounds.min.z;
+			max_x[i] = bounds.max.x; max_y[i] = bounds.max.y; max_z[i] = bounds.max.z;
+		}
+	};
+
+	static_assert(sizeof(BvhNode) == 128, "BvhNode must span exactly two cache lines");
+
+	class BvhOptions {
+	public:
+		// Number of threads building subtrees, zero for one per hardware thread.
+		unsigned threads = 1;
+		// SAH bins per axis.
+		unsigned bins = 16;
+		// Largest leaf; leaves are padded to whole TriangleBlocks of eight.
+		unsigned max_leaf_triangles = 16;
+	};
+
+	class BvhStats {
+	public:
+		size_t triangles = 0;
+		size_t nodes = 0;
+		size_t leaves = 0;
+		size_t blocks = 0;
+		// Lanes of leaf blocks holding no triangle.
+		size_t padding = 0;
+		size_t max_depth = 0;
+		// Expected cost of a random ray relative to testing one block, lower is better.
+		double sah_cost = 0.0;
+		size_t bytes = 0;
+		double seconds = 0.0;
+	};
+
+	/// <summary>
+	/// Bounding volume hierarchy over the triangles of a map, built with a
+	/// binned SAH sweep and collapsed into four-wide nodes. Leaves reference
+	/// runs of TriangleBlocks in the BVH's own soup, which holds the triangles
+	/// in leaf order; getSourceIndex maps a lane back to the triangle's index
+	/// in hull order (the order of PhysicsFile::writeTriangles).
+	/// </summary>
+	class Bvh {
+	public:
+		// Deepest possible node, guaranteed by the build; traversal stacks hold kStackSize entries.
+		static constexpr size_t kMaxDepth = 96;
+		static constexpr size_t kStackSize = 3 * kMaxDepth + 1;
+
+		/// <summary>
+		/// Build the BVH over every hull of a physics file.
+		/// </summary>
+		/// <returns>
+		/// Returns false if the map is too large to index.
+		/// </returns>
+		bool build(const PhysicsFile& physics, const BvhOptions& options = BvhOptions());
+
+		/// <summary>
+		/// Build the BVH over a soup in hull order, e.g. TriangleSoup(physics).
+		/// Padding lanes of the source are skipped.
+		/// </summary>
+		bool build(const TriangleSoup& source, const BvhOptions& options = BvhOptions());
+
+		const std::vector<BvhNode>& getNodes() const { return nodes; }
+		const TriangleSoup& getSoup() const { return soup; }
+		const BvhStats& getStats() const { return stats; }
+		const Aabb& getBounds() const { return bounds; }
+		bool empty() const { return nodes.empty(); }
+
+		uint32_t getSourceIndex(size_t lane) const { return source_index[lane]; }
+
+		static bool isLeaf(uint32_t child) { return child != BvhNode::kEmptyChild && (child & BvhNode::kLeafFlag); }
+		static uint32_t getLeafFirstBlock(uint32_t child) { return child & 0x00FFFFFF; }
+		static uint32_t getLeafBlockCount(uint32_t child) { return ((child >> 24) & 0x7F) + 1; }
+
+		/// <summary>
+		/// Call fn(firstBlock, blockCount) for every leaf whose bounds overlap box.
+		/// </summary>
+		template<typename Fn>
+		void forEachLeaf(const Aabb& box, Fn&& fn) const
+		{
+			if (nodes.empty())
+				return;
+
+			uint32_t stack[kStackSize];
+			size_t depth = 0;
+			stack[depth++] = 0;
+
+			while (depth > 0)
+			{
+				const BvhNode& node = nodes[stack[--depth]];
+				for (size_t i = 0; i < 4; i++)
+				{
+					uint32_t child = node.children[i];
+					if (child == BvhNode::kEmptyChild || !node.getChildBounds(i).overlaps(box))
+						continue;
+
+					if (isLeaf(child))
+						fn(getLeafFirstBlock(child), getLeafBlockCount(child));
+					else
+						stack[depth++] = child;
+				}
+			}
+		}
+
+		/// <summary>
+		/// Collect the triangles whose bounds overlap box.
+		/// </summary>
+		/// <param name="box">
+		/// The box to test.
+		/// </param>
+		/// <param name="triangles">
+		/// Receives the source indices of the triangles, unordered.
+		/// </param>
+		void queryOverlap(const Aabb& box, std::vector<uint32_t>& triangles) const;
+
+		/// <summary>
+		/// Display the build statistics.
+		/// </summary>
+		void displayStats() const;
+
+	private:
+		std::vector<BvhNode> nodes;
+		TriangleSoup soup;
+		std::vector<uint32_t> source_index;
+		Aabb bounds;
+		BvhStats stats;
+	};
+} // namespace cs2
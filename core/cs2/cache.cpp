@@ -0,0 +1,743 @@
+#include "cache.h"
+
+static_assert(sizeof(cs2::Triangle) == 3 * sizeof(cs2::Vec3), "Triangle must be three packed Vec3s");
+
+namespace
+{
+	uint64_t alignUp(uint64_t offset, uint64_t alignment = cs2::kCacheAlignment)
+	{
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	constexpr uint32_t kNoTile = 0xFFFFFFFF;
+	// Tiles along each axis before the tile size is doubled.
+	constexpr float kMaxTilesPerAxis = 256.0f;
+
+	// Interleave the low sixteen bits of x and y.
+	uint32_t morton2(uint32_t x, uint32_t y)
+	{
+		auto spread = [](uint32_t v) {
+			v &= 0xFFFF;
+			v = (v | (v << 8)) & 0x00FF00FF;
+			v = (v | (v << 4)) & 0x0F0F0F0F;
+			v = (v | (v << 2)) & 0x33333333;
+			v = (v | (v << 1)) & 0x55555555;
+			return v;
+		};
+		return spread(x) | (spread(y) << 1);
+	}
+
+	float dot(const cs2::Vec3& a, const cs2::Vec3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	cs2::Vec3 cross(const cs2::Vec3& a, const cs2::Vec3& b)
+	{
+		return cs2::Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	cs2::Vec3 normalize(const cs2::Vec3& v)
+	{
+		float length = std::sqrt(dot(v, v));
+		return length > 0.0f ? cs2::Vec3(v.x / length, v.y / length, v.z / length) : v;
+	}
+
+	// a + b * scale
+	cs2::Vec3 addScaled(const cs2::Vec3& a, const cs2::Vec3& b, float scale)
+	{
+		return cs2::Vec3(a.x + b.x * scale, a.y + b.y * scale, a.z + b.z * scale);
+	}
+
+	cs2::Aabb getSectionBounds(const cs2::CacheSection& section)
+	{
+		return cs2::Aabb(
+			cs2::Vec3(section.bounds_min[0], section.bounds_min[1], section.bounds_min[2]),
+			cs2::Vec3(section.bounds_max[0], section.bounds_max[1], section.bounds_max[2]));
+	}
+
+	uint64_t getVertexBytes(const cs2::CacheSection& section)
+	{
+		bool quantized = (section.flags & cs2::kCacheSectionQuantized) != 0;
+		return static_cast<uint64_t>(section.vertex_count) * (quantized ? 3 * sizeof(uint16_t) : sizeof(cs2::Vec3));
+	}
+
+	// Vertex and index counts of a hull as it is laid out in the cache.
+	void getPayloadCounts(const cs2::HullFile& hull, uint32_t& vertex_count, uint32_t& index_count, uint32_t& index_size)
+	{
+		if (hull.isQuantized())
+		{
+			vertex_count = static_cast<uint32_t>(hull.quantized.positions.size() / 3);
+			index_count = hull.quantized.index_count;
+			index_size = 0;
+			return;
+		}
+
+		if (hull.isIndexed())
+		{
+			vertex_count = static_cast<uint32_t>(hull.vertices.size());
+			index_count = static_cast<uint32_t>(hull.indices32.empty() ? hull.indices16.size() : hull.indices32.size());
+			index_size = hull.indices32.empty() ? 2 : 4;
+			return;
+		}
+
+		vertex_count = static_cast<uint32_t>(hull.triangles.size() * 3);
+		index_count = vertex_count;
+		index_size = vertex_count <= 0x10000 ? 2 : 4;
+	}
+
+	template<typename T>
+	std::vector<T> makeSequentialIndices(uint32_t count)
+	{
+		std::vector<T> indices(count);
+		for (uint32_t i = 0; i < count; i++)
+			indices[i] = static_cast<T>(i);
+		return indices;
+	}
+
+	bool inRange(uint64_t offset, uint64_t size, uint64_t file_size)
+	{
+		return offset <= file_size && size <= file_size - offset;
+	}
+}
+
+bool cs2::writeGeometryCache(const std::string& filename, std::string_view mapname, std::span<const HullFile> hulls, float tile_size)
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to open file: " << filename << std::endl;
+		return false;
+	}
+
+	std::string strings;
+	strings.append(mapname);
+
+	CacheHeader header = {};
+	std::memcpy(header.magic, kCacheMagic, 4);
+	header.version = kCacheVersion;
+	header.endian_marker = kCacheEndianMarker;
+	header.hull_count = static_cast<uint32_t>(hulls.size());
+	header.section_size = sizeof(CacheSection);
+	header.sections_offset = alignUp(sizeof(CacheHeader));
+	header.mapname_offset = 0;
+	header.mapname_length = static_cast<uint32_t>(mapname.size());
+	header.tile_size = sizeof(CacheTile);
+
+	Aabb map_bounds;
+	std::vector<CacheSection> sections(hulls.size());
+	for (size_t i = 0; i < hulls.size(); i++)
+	{
+		CacheSection& section = sections[i];
+		section.name_offset = static_cast<uint32_t>(strings.size());
+		section.name_length = static_cast<uint32_t>(hulls[i].name.size());
+		strings.append(hulls[i].name);
+		section.surface_prop_offset = static_cast<uint32_t>(strings.size());
+		section.surface_prop_length = static_cast<uint32_t>(hulls[i].surface_prop.size());
+		strings.append(hulls[i].surface_prop);
+
+		Aabb bounds = hulls[i].getBounds();
+		if (bounds.isEmpty())
+			bounds = Aabb(Vec3(0, 0, 0), Vec3(0, 0, 0));
+		section.bounds_min[0] = bounds.min.x; section.bounds_min[1] = bounds.min.y; section.bounds_min[2] = bounds.min.z;
+		section.bounds_max[0] = bounds.max.x; section.bounds_max[1] = bounds.max.y; section.bounds_max[2] = bounds.max.z;
+		map_bounds.extend(bounds);
+	}
+
+	// Each hull goes to the tile under the centre of its bounds; the tile size
+	// doubles until neither axis has more than kMaxTilesPerAxis tiles.
+	float tile_length = tile_size;
+	uint32_t tiles_x = 1, tiles_y = 1;
+	if (tile_length > 0.0f && !map_bounds.isEmpty())
+	{
+		float extent = std::max(map_bounds.max.x - map_bounds.min.x, map_bounds.max.y - map_bounds.min.y);
+		while (extent / tile_length > kMaxTilesPerAxis)
+			tile_length *= 2.0f;
+		tiles_x = std::max(1u, static_cast<uint32_t>(std::ceil((map_bounds.max.x - map_bounds.min.x) / tile_length)));
+		tiles_y = std::max(1u, static_cast<uint32_t>(std::ceil((map_bounds.max.y - map_bounds.min.y) / tile_length)));
+	}
+	else
+		tile_length = 0.0f;
+	header.tile_length = tile_length;
+
+	auto getTile = [&](const CacheSection& section, uint32_t& x, uint32_t& y) {
+		x = y = 0;
+		if (tile_length <= 0.0f)
+			return;
+		float center_x = 0.5f * (section.bounds_min[0] + section.bounds_max[0]);
+		float center_y = 0.5f * (section.bounds_min[1] + section.bounds_max[1]);
+		x = std::min(tiles_x - 1, static_cast<uint32_t>(std::max(0.0f, (center_x - map_bounds.min.x) / tile_length)));
+		y = std::min(tiles_y - 1, static_cast<uint32_t>(std::max(0.0f, (center_y - map_bounds.min.y) / tile_length)));
+	};
+
+	// Sorted by Morton code of the tile, then by hull, so a tile's hulls are one run.
+	std::vector<std::pair<uint32_t, uint32_t>> order(hulls.size());
+	for (size_t i = 0; i < hulls.size(); i++)
+	{
+		uint32_t x, y;
+		getTile(sections[i], x, y);
+		order[i] = { morton2(x, y), static_cast<uint32_t>(i) };
+	}
+	std::sort(order.begin(), order.end());
+
+	std::vector<CacheTile> tiles;
+	std::vector<uint32_t> tile_hulls(hulls.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		if (i == 0 || order[i].first != order[i - 1].first)
+		{
+			CacheTile tile = {};
+			getTile(sections[order[i].second], tile.x, tile.y);
+			tile.first_hull = static_cast<uint32_t>(i);
+			tiles.push_back(tile);
+		}
+		tiles.back().hull_count++;
+		tile_hulls[i] = order[i].second;
+	}
+
+	header.tile_count = static_cast<uint32_t>(tiles.size());
+	header.tiles_offset = alignUp(header.sections_offset + sections.size() * sizeof(CacheSection));
+	header.tile_hulls_offset = alignUp(header.tiles_offset + tiles.size() * sizeof(CacheTile));
+	header.strings_offset = header.tile_hulls_offset + tile_hulls.size() * sizeof(uint32_t);
+	header.strings_size = strings.size();
+	header.payloads_offset = header.strings_offset + header.strings_size;
+
+	// Payload offsets depend only on the counts, so the whole layout is known up front.
+	uint64_t offset = header.payloads_offset;
+
+	for (size_t t = 0; t < tiles.size(); t++)
+	{
+		CacheTile& tile = tiles[t];
+		// The first tile may share a page with the tables, which every reader maps anyway.
+		offset = t == 0 ? alignUp(offset) : alignUp(offset, kCacheTilePage);
+		tile.payload_offset = offset;
+
+		Aabb tile_bounds;
+		for (uint32_t h = 0; h < tile.hull_count; h++)
+		{
+			size_t i = tile_hulls[tile.first_hull + h];
+			CacheSection& section = sections[i];
+			getPayloadCounts(hulls[i], section.vertex_count, section.index_count, section.index_size);
+
+			uint64_t vertex_bytes = static_cast<uint64_t>(section.vertex_count) * sizeof(Vec3);
+			section.index_bytes = section.index_count * section.index_size;
+
+			if (hulls[i].isQuantized())
+			{
+				section.flags |= kCacheSectionQuantized;
+				section.error = hulls[i].quantized.error;
+				vertex_bytes = static_cast<uint64_t>(section.vertex_count) * 3 * sizeof(uint16_t);
+				section.index_bytes = static_cast<uint32_t>(hulls[i].quantized.indices.size());
+			}
+
+			offset = alignUp(offset);
+			section.vertex_offset = offset;
+			offset += vertex_bytes;
+
+			offset = alignUp(offset);
+			section.index_offset = offset;
+			offset += section.index_bytes;
+
+			tile_bounds.extend(getSectionBounds(section));
+		}
+
+		tile.payload_size = offset - tile.payload_offset;
+		tile.bounds_min[0] = tile_bounds.min.x; tile.bounds_min[1] = tile_bounds.min.y; tile.bounds_min[2] = tile_bounds.min.z;
+		tile.bounds_max[0] = tile_bounds.max.x; tile.bounds_max[1] = tile_bounds.max.y; tile.bounds_max[2] = tile_bounds.max.z;
+	}
+
+	header.file_size = offset;
+
+	static const char padding[kCacheTilePage] = {};
+	uint64_t written = 0;
+
+	auto write = [&](const void* data, uint64_t size) {
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		written += size;
+	};
+
+	auto padTo = [&](uint64_t target) {
+		write(padding, target - written);
+	};
+
+	write(&header, sizeof(header));
+	padTo(header.sections_offset);
+	write(sections.data(), sections.size() * sizeof(CacheSection));
+	padTo(header.tiles_offset);
+	write(tiles.data(), tiles.size() * sizeof(CacheTile));
+	padTo(header.tile_hulls_offset);
+	write(tile_hulls.data(), tile_hulls.size() * sizeof(uint32_t));
+	write(strings.data(), strings.size());
+
+	for (uint32_t i : tile_hulls)
+	{
+		const HullFile& hull = hulls[i];
+		const CacheSection& section = sections[i];
+
+		padTo(section.vertex_offset);
+		if (hull.isQuantized())
+		{
+			write(hull.quantized.positions.data(), hull.quantized.positions.size() * sizeof(uint16_t));
+			padTo(section.index_offset);
+			write(hull.quantized.indices.data(), hull.quantized.indices.size());
+		}
+		else if (hull.isIndexed())
+		{
+			write(hull.vertices.data(), hull.vertices.size() * sizeof(Vec3));
+			padTo(section.index_offset);
+			if (section.index_size == 4)
+				write(hull.indices32.data(), hull.indices32.size() * sizeof(uint32_t));
+			else
+				write(hull.indices16.data(), hull.indices16.size() * sizeof(uint16_t));
+		}
+		else
+		{
+			// A Triangle is three consecutive Vec3s, so the soup is already the vertex buffer.
+			write(hull.triangles.data(), hull.triangles.size() * sizeof(Triangle));
+			padTo(section.index_offset);
+			if (section.index_size == 4)
+			{
+				auto indices = makeSequentialIndices<uint32_t>(section.index_count);
+				write(indices.data(), indices.size() * sizeof(uint32_t));
+			}
+			else
+			{
+				auto indices = makeSequentialIndices<uint16_t>(section.index_count);
+				write(indices.data(), indices.size() * sizeof(uint16_t));
+			}
+		}
+	}
+
+	file.close();
+	if (!file)
+	{
+		std::cerr << "Failed to write file: " << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool cs2::PhysicsFile::writeCache(const std::string& filename) const
+{
+	return writeGeometryCache(filename, mapname, hulls);
+}
+
+cs2::Frustum::Frustum(const Vec3& eye, const Vec3& forward, const Vec3& up, float fov, float aspect, float near_distance, float far_distance)
+{
+	Vec3 front = normalize(forward);
+	Vec3 right = normalize(cross(front, up));
+	Vec3 above = cross(right, front);
+	float tan_x = std::tan(fov * 0.5f * 3.14159265f / 180.0f);
+	float tan_y = tan_x / aspect;
+
+	// A side plane holds the eye and an edge of the view; its normal leans into the view.
+	normals[0] = addScaled(right, front, tan_x);
+	normals[1] = addScaled(Vec3(-right.x, -right.y, -right.z), front, tan_x);
+	normals[2] = addScaled(above, front, tan_y);
+	normals[3] = addScaled(Vec3(-above.x, -above.y, -above.z), front, tan_y);
+	for (int i = 0; i < 4; i++)
+		distances[i] = -dot(normals[i], eye);
+
+	normals[4] = front;
+	distances[4] = -dot(front, eye) - near_distance;
+	normals[5] = Vec3(-front.x, -front.y, -front.z);
+	distances[5] = dot(front, eye) + far_distance;
+}
+
+bool cs2::Frustum::overlaps(const Aabb& box) const
+{
+	if (box.isEmpty())
+		return false;
+
+	// The box is outside if even its corner furthest along a plane's normal is behind the plane.
+	for (int i = 0; i < 6; i++)
+	{
+		const Vec3& n = normals[i];
+		Vec3 corner(n.x >= 0.0f ? box.max.x : box.min.x, n.y >= 0.0f ? box.max.y : box.min.y, n.z >= 0.0f ? box.max.z : box.min.z);
+		if (dot(n, corner) + distances[i] < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+bool cs2::GeometryCache::open(const std::string& filename, std::string& error)
+{
+	header = nullptr;
+	tile_files.clear();
+
+	if (!file.open(filename))
+	{
+		error = "Failed to open file: " + filename;
+		return false;
+	}
+
+	this->filename = filename;
+	if (!validate(error))
+		return false;
+
+	for (size_t i = 0; i < tile_data.size(); i++)
+		tile_data[i] = file.data() + tiles[i].payload_offset;
+
+	for (size_t i = 0; i < tile_data.size(); i++)
+	{
+		if (!validateTile(i, error))
+		{
+			header = nullptr;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool cs2::GeometryCache::openRegion(const std::string& filename, const Aabb& region, std::string& error)
+{
+	return openTables(filename, error) && loadRegion(region, error);
+}
+
+bool cs2::GeometryCache::openRegion(const std::string& filename, const Frustum& frustum, std::string& error)
+{
+	return openTables(filename, error) && loadRegion(frustum, error);
+}
+
+bool cs2::GeometryCache::loadRegion(const Aabb& region, std::string& error)
+{
+	std::vector<bool> selected(getTileCount());
+	for (size_t i = 0; i < selected.size(); i++)
+		selected[i] = region.overlaps(getTileBounds(i));
+	return loadTiles(selected, error);
+}
+
+bool cs2::GeometryCache::loadRegion(const Frustum& frustum, std::string& error)
+{
+	std::vector<bool> selected(getTileCount());
+	for (size_t i = 0; i < selected.size(); i++)
+		selected[i] = frustum.overlaps(getTileBounds(i));
+	return loadTiles(selected, error);
+}
+
+bool cs2::GeometryCache::openTables(const std::string& filename, std::string& error)
+{
+	header = nullptr;
+	tile_files.clear();
+	file.close();
+
+	// Read the header on its own to learn how much of the file the tables take.
+	CacheHeader candidate = {};
+	std::ifstream stream(filename, std::ios::binary);
+	if (!stream.is_open())
+	{
+		error = "Failed to open file: " + filename;
+		return false;
+	}
+	stream.read(reinterpret_cast<char*>(&candidate), sizeof(candidate));
+	if (!stream || std::memcmp(candidate.magic, kCacheMagic, 4) != 0)
+	{
+		error = "Not a geometry cache: " + filename;
+		return false;
+	}
+	stream.close();
+
+	// Leave the version and byte order to validate, which reports them properly.
+	uint64_t tables_size = candidate.version == kCacheVersion && candidate.endian_marker == kCacheEndianMarker ? candidate.payloads_offset : sizeof(CacheHeader);
+	if (!file.open(filename, 0, static_cast<size_t>(tables_size)))
+	{
+		error = "Corrupt geometry cache header: " + filename;
+		return false;
+	}
+
+	this->filename = filename;
+	return validate(error);
+}
+
+bool cs2::GeometryCache::validate(std::string& error)
+{
+	const uint64_t file_size = file.getFileSize();
+	const uint64_t mapped_size = file.size();
+	const char* data = file.data();
+
+	if (mapped_size < sizeof(CacheHeader) || std::memcmp(data, kCacheMagic, 4) != 0)
+	{
+		error = "Not a geometry cache: " + filename;
+		return false;
+	}
+
+	auto candidate = reinterpret_cast<const CacheHeader*>(data);
+
+	if (candidate->version != kCacheVersion)
+	{
+		error = "Unsupported geometry cache version " + std::to_string(candidate->version) + ": " + filename;
+		return false;
+	}
+
+	if (candidate->endian_marker != kCacheEndianMarker)
+	{
+		error = "Geometry cache was written with a different byte order: " + filename;
+		return false;
+	}
+
+	// The tables must lie within payloads_offset, the part openRegion maps.
+	const uint64_t tables_size = candidate->payloads_offset;
+	if (candidate->section_size != sizeof(CacheSection) ||
+		candidate->tile_size != sizeof(CacheTile) ||
+		candidate->file_size != file_size ||
+		tables_size > mapped_size ||
+		candidate->sections_offset % alignof(CacheSection) != 0 ||
+		candidate->tiles_offset % alignof(CacheTile) != 0 ||
+		candidate->tile_hulls_offset % alignof(uint32_t) != 0 ||
+		!inRange(candidate->sections_offset, static_cast<uint64_t>(candidate->hull_count) * sizeof(CacheSection), tables_size) ||
+		!inRange(candidate->tiles_offset, static_cast<uint64_t>(candidate->tile_count) * sizeof(CacheTile), tables_size) ||
+		!inRange(candidate->tile_hulls_offset, static_cast<uint64_t>(candidate->hull_count) * sizeof(uint32_t), tables_size) ||
+		!inRange(candidate->strings_offset, candidate->strings_size, tables_size) ||
+		!inRange(candidate->mapname_offset, candidate->mapname_length, candidate->strings_size))
+	{
+		error = "Corrupt geometry cache header: " + filename;
+		return false;
+	}
+
+	auto candidate_sections = reinterpret_cast<const CacheSection*>(data + candidate->sections_offset);
+
+	for (uint32_t i = 0; i < candidate->hull_count; i++)
+	{
+		const CacheSection& section = candidate_sections[i];
+		bool quantized = (section.flags & kCacheSectionQuantized) != 0;
+
+		bool valid =
+			inRange(section.name_offset, section.name_length, candidate->strings_size) &&
+			inRange(section.surface_prop_offset, section.surface_prop_length, candidate->strings_size) &&
+			section.index_count % 3 == 0 &&
+			section.vertex_offset % (quantized ? alignof(uint16_t) : alignof(Vec3)) == 0 &&
+			inRange(section.vertex_offset, getVertexBytes(section), file_size) &&
+			inRange(section.index_offset, section.index_bytes, file_size);
+
+		// Plain indices must fill their range; index values are checked by validateTile once the payloads are mapped.
+		if (!quantized)
+		{
+			valid = valid &&
+				(section.index_size == 2 || section.index_size == 4) &&
+				section.index_offset % section.index_size == 0 &&
+				section.index_bytes == static_cast<uint64_t>(section.index_count) * section.index_size;
+		}
+
+		if (!valid)
+		{
+			error = "Corrupt geometry cache section " + std::to_string(i) + ": " + filename;
+			return false;
+		}
+	}
+
+	// Every hull belongs to exactly one tile, and its payloads lie within the tile's range.
+	auto candidate_tiles = reinterpret_cast<const CacheTile*>(data + candidate->tiles_offset);
+	auto candidate_tile_hulls = reinterpret_cast<const uint32_t*>(data + candidate->tile_hulls_offset);
+	hull_tiles.assign(candidate->hull_count, kNoTile);
+
+	for (uint32_t t = 0; t < candidate->tile_count; t++)
+	{
+		const CacheTile& tile = candidate_tiles[t];
+		bool valid =
+			static_cast<uint64_t>(tile.first_hull) + tile.hull_count <= candidate->hull_count &&
+			tile.payload_offset >= tables_size &&
+			inRange(tile.payload_offset, tile.payload_size, file_size);
+
+		for (uint32_t h = 0; valid && h < tile.hull_count; h++)
+		{
+			uint32_t i = candidate_tile_hulls[tile.first_hull + h];
+			if (i >= candidate->hull_count || hull_tiles[i] != kNoTile)
+			{
+				valid = false;
+				break;
+			}
+			hull_tiles[i] = t;
+
+			const CacheSection& section = candidate_sections[i];
+			uint64_t tile_end = tile.payload_offset + tile.payload_size;
+			valid =
+				section.vertex_offset >= tile.payload_offset && getVertexBytes(section) <= tile_end - section.vertex_offset &&
+				section.index_offset >= tile.payload_offset && section.index_bytes <= tile_end - section.index_offset;
+		}
+
+		if (!valid)
+		{
+			error = "Corrupt geometry cache tile " + std::to_string(t) + ": " + filename;
+			return false;
+		}
+	}
+
+	if (std::find(hull_tiles.begin(), hull_tiles.end(), kNoTile) != hull_tiles.end())
+	{
+		error = "Corrupt geometry cache header: " + filename;
+		return false;
+	}
+
+	header = candidate;
+	sections = candidate_sections;
+	tiles = candidate_tiles;
+	tile_hulls = candidate_tile_hulls;
+	tile_data.assign(header->tile_count, nullptr);
+	strings = std::string_view(data + header->strings_offset, header->strings_size);
+	mapname = strings.substr(header->mapname_offset, header->mapname_length);
+
+	return true;
+}
+
+bool cs2::GeometryCache::loadTiles(const std::vector<bool>& selected, std::string& error)
+{
+	if (!header)
+	{
+		error = "No geometry cache open";
+		return false;
+	}
+
+	// Tiles next to each other in the file are mapped together.
+	size_t first = 0;
+	while (first < selected.size())
+	{
+		if (!selected[first] || isTileLoaded(first))
+		{
+			first++;
+			continue;
+		}
+
+		size_t last = first + 1;
+		while (last < selected.size() && selected[last] && !isTileLoaded(last))
+			last++;
+
+		uint64_t start = tiles[first].payload_offset;
+		uint64_t end = tiles[last - 1].payload_offset + tiles[last - 1].payload_size;
+
+		if (end == start)
+		{
+			// Nothing to map; any pointer marks the tiles loaded, their hulls have no payloads.
+			for (size_t t = first; t < last; t++)
+				tile_data[t] = file.data();
+		}
+		else
+		{
+			MappedFile run;
+			if (!run.open(filename, start, static_cast<size_t>(end - start)))
+			{
+				error = "Failed to map geometry cache tiles: " + filename;
+				return false;
+			}
+
+			for (size_t t = first; t < last; t++)
+				tile_data[t] = run.data() + (tiles[t].payload_offset - start);
+			tile_files.push_back(std::move(run));
+		}
+
+		for (size_t t = first; t < last; t++)
+		{
+			if (!validateTile(t, error))
+			{
+				// Leave none of the run loaded, so no hull of a corrupt tile can be fetched.
+				for (size_t u = first; u < last; u++)
+					tile_data[u] = nullptr;
+				if (end != start)
+					tile_files.pop_back();
+				return false;
+			}
+		}
+
+		first = last;
+	}
+
+	return true;
+}
+
+bool cs2::GeometryCache::validateTile(size_t index, std::string& error) const
+{
+	std::vector<uint32_t> decoded;
+
+	for (uint32_t i : getTileHulls(index))
+	{
+		CachedHull hull = getHull(i);
+		bool valid = true;
+
+		if (hull.isQuantized())
+		{
+			// Decoding the deltas is the only way to learn the indices; it fails on any out of range.
+			decoded.resize(hull.quantized.index_count);
+			valid = hull.quantized.decodeIndices(decoded.data());
+		}
+		else
+		{
+			auto inRange = [&](uint32_t v) { return v < hull.vertices.size(); };
+			valid = std::all_of(hull.indices16.begin(), hull.indices16.end(), inRange) &&
+				std::all_of(hull.indices32.begin(), hull.indices32.end(), inRange);
+		}
+
+		if (!valid)
+		{
+			error = "Corrupt geometry cache section " + std::to_string(i) + ": index out of range: " + filename;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+cs2::Aabb cs2::GeometryCache::getTileBounds(size_t index) const
+{
+	const CacheTile& tile = tiles[index];
+	return Aabb(
+		Vec3(tile.bounds_min[0], tile.bounds_min[1], tile.bounds_min[2]),
+		Vec3(tile.bounds_max[0], tile.bounds_max[1], tile.bounds_max[2]));
+}
+
+size_t cs2::GeometryCache::getLoadedTileCount() const
+{
+	return tile_data.size() - std::count(tile_data.begin(), tile_data.end(), nullptr);
+}
+
+uint64_t cs2::GeometryCache::getMappedBytes() const
+{
+	uint64_t bytes = file.size();
+	for (const MappedFile& run : tile_files)
+		bytes += run.size();
+	return bytes;
+}
+
+cs2::CachedHull cs2::GeometryCache::getHull(size_t index) const
+{
+	const CacheSection& section = sections[index];
+	const CacheTile& tile = tiles[hull_tiles[index]];
+	const char* data = tile_data[hull_tiles[index]];
+
+	// Payload offsets are file offsets; the tile's mapping starts at its first payload.
+	auto at = [&](uint64_t offset) {
+		return data + (offset - tile.payload_offset);
+	};
+
+	CachedHull hull;
+	hull.name = strings.substr(section.name_offset, section.name_length);
+	hull.surface_prop = strings.substr(section.surface_prop_offset, section.surface_prop_length);
+	hull.bounds = getSectionBounds(section);
+
+	if (section.flags & kCacheSectionQuantized)
+	{
+		hull.quantized.bounds = hull.bounds;
+		hull.quantized.positions = std::span<const uint16_t>(reinterpret_cast<const uint16_t*>(at(section.vertex_offset)), section.vertex_count * 3);
+		hull.quantized.indices = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(at(section.index_offset)), section.index_bytes);
+		hull.quantized.index_count = section.index_count;
+		hull.quantized.error = section.error;
+		return hull;
+	}
+
+	hull.vertices = std::span<const Vec3>(reinterpret_cast<const Vec3*>(at(section.vertex_offset)), section.vertex_count);
+
+	if (section.index_size == 2)
+		hull.indices16 = std::span<const uint16_t>(reinterpret_cast<const uint16_t*>(at(section.index_offset)), section.index_count);
+	else
+		hull.indices32 = std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(at(section.index_offset)), section.index_count);
+
+	return hull;
+}
+
+size_t cs2::GeometryCache::getTriangleCount() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < getHullCount(); i++)
+		count += sections[i].index_count / 3;
+	return count;
+}
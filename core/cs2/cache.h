@@ -0,0 +1,296 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+#include "mapped_file.h"
+
+namespace cs2
+{
+	// Geometry cache file layout, in the byte order recorded by the endian marker:
+	//
+	//   CacheHeader                       128 bytes
+	//   CacheSection[hull_count]          section_size bytes each
+	//   CacheTile[tile_count]             tile_size bytes each, on a 64-byte boundary
+	//   tile hulls                        uint32 hull indices, tile by tile
+	//   string table                      names and surface props, not terminated
+	//   payloads                          tile by tile, from payloads_offset; per hull
+	//                                     Vec3 vertices, then 16 or 32-bit indices,
+	//                                     each starting on a 64-byte boundary
+	//
+	// Hulls are grouped into square tiles over the map's x and y by the centre of
+	// their bounds. A tile's payloads are one byte range starting on a page
+	// boundary (kCacheTilePage), so it can be mapped without touching its
+	// neighbours; its bounds are the union of its hulls' bounds. Tiles are stored
+	// along a Morton curve, so tiles near each other are near in the file.
+	//
+	// Quantized sections (kCacheSectionQuantized) store 16-bit positions relative
+	// to the section bounds instead of Vec3s, and index_bytes of varint deltas
+	// (see QuantizedMesh) with an index_size of zero.
+	//
+	// Readers reject files whose version or endian marker differ from their own.
+	constexpr char kCacheMagic[4] = { 'C', 'S', '2', 'C' };
+	constexpr uint32_t kCacheVersion = 3;
+	constexpr uint32_t kCacheEndianMarker = 0x01020304;
+	constexpr uint64_t kCacheAlignment = 64;
+	constexpr uint64_t kCacheTilePage = 4096;
+	constexpr uint32_t kCacheSectionQuantized = 1;
+	// Default edge length of a tile in map units.
+	constexpr float kCacheTileSize = 1024.0f;
+
+	struct CacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t endian_marker;
+		uint32_t flags;
+		uint32_t hull_count;
+		uint32_t section_size;
+		uint64_t sections_offset;
+		uint64_t strings_offset;
+		uint64_t strings_size;
+		uint64_t file_size;
+		uint32_t mapname_offset;
+		uint32_t mapname_length;
+		uint32_t tile_count;
+		uint32_t tile_size;
+		uint64_t tiles_offset;
+		uint64_t tile_hulls_offset;
+		// End of the tables, which every reader maps.
+		uint64_t payloads_offset;
+		// Edge length of a tile in map units.
+		float tile_length;
+	};
+
+	struct CacheSection {
+		uint32_t name_offset;
+		uint32_t name_length;
+		uint32_t surface_prop_offset;
+		uint32_t surface_prop_length;
+		uint64_t vertex_offset;
+		uint64_t index_offset;
+		uint32_t vertex_count;
+		uint32_t index_count;
+		uint32_t index_size;
+		uint32_t flags;
+		float bounds_min[3];
+		float bounds_max[3];
+		uint32_t index_bytes;
+		float error;
+	};
+
+	struct CacheTile {
+		uint32_t x;
+		uint32_t y;
+		// Range of the tile's hulls in the tile hull list.
+		uint32_t first_hull;
+		uint32_t hull_count;
+		uint64_t payload_offset;
+		uint64_t payload_size;
+		float bounds_min[3];
+		float bounds_max[3];
+	};
+
+	static_assert(sizeof(CacheHeader) <= 128, "CacheHeader must fit its 128-byte slot");
+	static_assert(sizeof(CacheSection) == 80, "CacheSection layout changed, bump kCacheVersion");
+	static_assert(sizeof(CacheTile) == 56, "CacheTile layout changed, bump kCacheVersion");
+
+	/// <summary>
+	/// A view volume bounded by six planes facing inwards: a point p is inside
+	/// when dot(normals[i], p) + distances[i] >= 0 for every plane.
+	/// </summary>
+	class Frustum {
+	public:
+		Vec3 normals[6];
+		float distances[6];
+
+		Frustum() = default;
+
+		/// <summary>
+		/// Build the frustum of a perspective camera.
+		/// </summary>
+		/// <param name="forward">
+		/// The view direction, which need not be normalized.
+		/// </param>
+		/// <param name="up">
+		/// Any direction above the view direction; the camera has no roll about it.
+		/// </param>
+		/// <param name="fov">
+		/// The horizontal field of view in degrees, 90 for the CS2 default.
+		/// </param>
+		/// <param name="aspect">
+		/// Width over height of the view.
+		/// </param>
+		Frustum(const Vec3& eye, const Vec3& forward, const Vec3& up, float fov, float aspect, float near_distance, float far_distance);
+
+		/// <summary>
+		/// Check whether a box may be inside. Boxes near a corner of the frustum
+		/// can pass without being inside, never the other way around.
+		/// </summary>
+		bool overlaps(const Aabb& box) const;
+	};
+
+	/// <summary>
+	/// A hull inside a mapped geometry cache. All views point into the mapping.
+	/// </summary>
+	class CachedHull {
+	public:
+		std::string_view name;
+		std::string_view surface_prop;
+		std::span<const Vec3> vertices;
+		std::span<const uint16_t> indices16;
+		std::span<const uint32_t> indices32;
+		// Set instead of the spans above for quantized sections.
+		QuantizedView quantized;
+		Aabb bounds;
+
+		bool isQuantized() const { return !quantized.empty(); }
+
+		size_t getTriangleCount() const
+		{
+			if (isQuantized())
+				return quantized.getTriangleCount();
+			return (indices16.size() + indices32.size()) / 3;
+		}
+
+		/// <summary>
+		/// Get the triangles of the hull, empty for quantized hulls.
+		/// </summary>
+		TriangleView getTriangles() const
+		{
+			if (!indices16.empty())
+				return TriangleView(vertices.data(), indices16.data(), indices16.size() / 3);
+			return TriangleView(vertices.data(), indices32.data(), indices32.size() / 3);
+		}
+
+		/// <summary>
+		/// Call fn with every triangle of the hull, decoding quantized hulls first.
+		/// </summary>
+		template<typename Fn>
+		void forEachTriangle(Fn&& fn) const
+		{
+			if (isQuantized())
+			{
+				quantized.forEachTriangle(fn);
+				return;
+			}
+			for (auto tri : getTriangles())
+				fn(tri);
+		}
+	};
+
+	/// <summary>
+	/// Read-only geometry cache written by PhysicsFile::writeCache. The file is
+	/// memory-mapped and validated once when opened, including every index of
+	/// a tile when the tile is mapped; after that hulls are handed out as views
+	/// into the mapping with no parsing or copying.
+	///
+	/// open maps the whole file. openRegion maps only the tables and the tiles
+	/// overlapping a box or frustum, so the payloads of every other tile are
+	/// never read and take no memory; loadRegion maps more tiles as the area of
+	/// interest moves. Only hulls of loaded tiles may be fetched.
+	/// </summary>
+	class GeometryCache {
+	public:
+		/// <summary>
+		/// Map and validate a geometry cache file.
+		/// </summary>
+		/// <param name="filename">
+		/// The filename of the cache.
+		/// </param>
+		/// <param name="error">
+		/// Receives a description of the failure, if any.
+		/// </param>
+		/// <returns>
+		/// Returns true if the cache was opened successfully, false otherwise.
+		/// </returns>
+		bool open(const std::string& filename, std::string& error);
+
+		/// <summary>
+		/// Map and validate the tables of a geometry cache, then the tiles
+		/// overlapping a region. An empty box maps no tiles.
+		/// </summary>
+		bool openRegion(const std::string& filename, const Aabb& region, std::string& error);
+		bool openRegion(const std::string& filename, const Frustum& frustum, std::string& error);
+
+		/// <summary>
+		/// Map the tiles overlapping a region that are not loaded yet. Tiles
+		/// already loaded stay loaded.
+		/// </summary>
+		bool loadRegion(const Aabb& region, std::string& error);
+		bool loadRegion(const Frustum& frustum, std::string& error);
+
+		size_t getHullCount() const { return header ? header->hull_count : 0; }
+		std::string_view getMapname() const { return mapname; }
+
+		size_t getTileCount() const { return header ? header->tile_count : 0; }
+		const CacheTile& getTile(size_t index) const { return tiles[index]; }
+		std::span<const uint32_t> getTileHulls(size_t index) const { return std::span<const uint32_t>(tile_hulls + tiles[index].first_hull, tiles[index].hull_count); }
+		Aabb getTileBounds(size_t index) const;
+
+		bool isTileLoaded(size_t index) const { return tile_data[index] != nullptr; }
+		bool isHullLoaded(size_t index) const { return isTileLoaded(hull_tiles[index]); }
+		size_t getLoadedTileCount() const;
+
+		// Bytes of the file mapped, out of getFileSize().
+		uint64_t getMappedBytes() const;
+		uint64_t getFileSize() const { return file.getFileSize(); }
+
+		/// <summary>
+		/// Get a hull of the cache.
+		/// </summary>
+		/// <param name="index">
+		/// The index of the hull, less than getHullCount(), whose tile is loaded.
+		/// </param>
+		CachedHull getHull(size_t index) const;
+
+		size_t getTriangleCount() const;
+
+	private:
+		// The whole file after open, the tables up to payloads_offset after openRegion.
+		MappedFile file;
+		// Mappings of runs of tiles loaded together.
+		std::vector<MappedFile> tile_files;
+		std::string filename;
+		const CacheHeader* header = nullptr;
+		const CacheSection* sections = nullptr;
+		const CacheTile* tiles = nullptr;
+		const uint32_t* tile_hulls = nullptr;
+		// Start of each tile's payloads in memory, null until the tile is loaded.
+		std::vector<const char*> tile_data;
+		std::vector<uint32_t> hull_tiles;
+		std::string_view strings;
+		std::string_view mapname;
+
+		bool openTables(const std::string& filename, std::string& error);
+		bool validate(std::string& error);
+		bool loadTiles(const std::vector<bool>& selected, std::string& error);
+		// Check that every index of a loaded tile's hulls names one of the hull's vertices.
+		bool validateTile(size_t index, std::string& error) const;
+	};
+
+	/// <summary>
+	/// Write hulls to a geometry cache file. Expanded hulls are stored as
+	/// indexed meshes with three vertices per triangle, quantized hulls stay
+	/// quantized.
+	/// </summary>
+	/// <param name="filename">
+	/// The filename to write the cache to.
+	/// </param>
+	/// <param name="mapname">
+	/// The map name stored in the header.
+	/// </param>
+	/// <param name="hulls">
+	/// The hulls to write.
+	/// </param>
+	/// <param name="tile_size">
+	/// Edge length of a tile in map units, zero to put every hull in one tile.
+	/// Larger maps get larger tiles so no axis has more than 256.
+	/// </param>
+	/// <returns>
+	/// Returns true if the cache was written successfully, false otherwise.
+	/// </returns>
+	bool writeGeometryCache(const std::string& filename, std::string_view mapname, std::span<const HullFile> hulls, float tile_size = kCacheTileSize);
+} // namespace cs2
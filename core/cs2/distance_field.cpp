@@ -0,0 +1,644 @@
+#include "distance_field.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+#include "geometry.h"
+#include "parallel.h"
+#include "penetration.h"
+
+namespace
+{
+	using cs2::Vec3;
+	using namespace cs2::detail;
+
+	constexpr uint32_t kNoTriangle = 0xFFFFFFFF;
+	// Largest grid; keeps sample indices in 32-bit gather offsets and the bake, at 36 bytes per sample, under a few GB.
+	constexpr size_t kMaxSamples = size_t(1) << 26;
+	// Offsets of the vertical sign lines from the sample columns, in cells, so they miss grid-aligned edges.
+	constexpr float kJitterX = 1.3e-3f;
+	constexpr float kJitterY = 2.9e-3f;
+
+	// A triangle with its bounds, for the seeding to find the samples near it.
+	struct BoundedTriangle {
+		cs2::Triangle triangle;
+		Vec3 min;
+		Vec3 max;
+	};
+
+	size_t getValueSize(cs2::DistanceFormat format)
+	{
+		switch (format)
+		{
+		case cs2::DistanceFormat::Float32: return 4;
+		case cs2::DistanceFormat::Snorm16: return 2;
+		default: return 1;
+		}
+	}
+
+	float getQuantizedScale(cs2::DistanceFormat format)
+	{
+		switch (format)
+		{
+		case cs2::DistanceFormat::Snorm16: return 32767.0f;
+		case cs2::DistanceFormat::Snorm8: return 127.0f;
+		default: return 1.0f;
+		}
+	}
+
+	const char* getFormatName(cs2::DistanceFormat format)
+	{
+		switch (format)
+		{
+		case cs2::DistanceFormat::Float32: return "float32";
+		case cs2::DistanceFormat::Snorm16: return "snorm16";
+		default: return "snorm8";
+		}
+	}
+
+	uint64_t alignUp(uint64_t offset)
+	{
+		return (offset + 63) & ~uint64_t(63);
+	}
+
+	bool inRange(uint64_t offset, uint64_t size, uint64_t file_size)
+	{
+		return offset <= file_size && size <= file_size - offset;
+	}
+
+	// What the samplers need of a field; stored values are multiplied by decode_scale at the end.
+	struct FieldView {
+		const uint8_t* values;
+		int32_t size[3];
+		float origin[3];
+		float inverse_cell;
+		float decode_scale;
+	};
+
+	template<typename T>
+	float sampleScalar(const FieldView& view, const Vec3& point)
+	{
+		const float p[3] = { point.x, point.y, point.z };
+		int32_t cell[3];
+		float t[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			// Clamping first puts outside points on the boundary; the last cell owns the far face.
+			float local = std::clamp((p[axis] - view.origin[axis]) * view.inverse_cell, 0.0f, static_cast<float>(view.size[axis] - 1));
+			cell[axis] = std::min(static_cast<int32_t>(local), view.size[axis] - 2);
+			t[axis] = local - static_cast<float>(cell[axis]);
+		}
+
+		const size_t stride_y = static_cast<size_t>(view.size[0]);
+		const size_t stride_z = stride_y * static_cast<size_t>(view.size[1]);
+		const T* values = reinterpret_cast<const T*>(view.values) + cell[0] + cell[1] * stride_y + cell[2] * stride_z;
+
+		auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+		float c00 = lerp(static_cast<float>(values[0]), static_cast<float>(values[1]), t[0]);
+		float c10 = lerp(static_cast<float>(values[stride_y]), static_cast<float>(values[stride_y + 1]), t[0]);
+		float c01 = lerp(static_cast<float>(values[stride_z]), static_cast<float>(values[stride_z + 1]), t[0]);
+		float c11 = lerp(static_cast<float>(values[stride_z + stride_y]), static_cast<float>(values[stride_z + stride_y + 1]), t[0]);
+		return lerp(lerp(c00, c10, t[1]), lerp(c01, c11, t[1]), t[2]) * view.decode_scale;
+	}
+
+	template<typename T>
+	void sampleBatchScalar(const FieldView& view, const Vec3* points, float* distances, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+			distances[i] = sampleScalar<T>(view, points[i]);
+	}
+
+#ifdef CS2_SIMD_X86
+	// Load eight samples at 32-bit offsets from base; narrower formats read a whole
+	// word and sign-extend its low bits, which the file's padding makes safe.
+	template<typename T>
+	CS2_TARGET_AVX2 __m256 gatherSamples(const uint8_t* base, __m256i index)
+	{
+		if constexpr (std::is_same_v<T, float>)
+		{
+			return _mm256_i32gather_ps(reinterpret_cast<const float*>(base), index, 4);
+		}
+		else
+		{
+			constexpr int kShift = 32 - 8 * static_cast<int>(sizeof(T));
+			__m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base), index, static_cast<int>(sizeof(T)));
+			return _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(words, kShift), kShift));
+		}
+	}
+
+	CS2_TARGET_AVX2 __m256 lerp(__m256 a, __m256 b, __m256 t)
+	{
+		return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+	}
+
+	template<typename T>
+	CS2_TARGET_AVX2 void sampleBatchAvx2(const FieldView& view, const Vec3* points, float* distances, size_t count)
+	{
+		// Vec3 is three packed floats, so coordinate k of point i is at float 3 * i + k.
+		const __m256i point_offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 inverse_cell = _mm256_set1_ps(view.inverse_cell);
+		const __m256i stride_y = _mm256_set1_epi32(view.size[0]);
+		const __m256i stride_z = _mm256_set1_epi32(view.size[0] * view.size[1]);
+		const __m256i one = _mm256_set1_epi32(1);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const float* coordinates = reinterpret_cast<const float*>(points + i);
+			__m256i cell[3];
+			__m256 t[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				__m256 p = _mm256_i32gather_ps(coordinates + axis, point_offsets, 4);
+				__m256 local = _mm256_mul_ps(_mm256_sub_ps(p, _mm256_set1_ps(view.origin[axis])), inverse_cell);
+				local = _mm256_min_ps(_mm256_max_ps(local, zero), _mm256_set1_ps(static_cast<float>(view.size[axis] - 1)));
+				cell[axis] = _mm256_min_epi32(_mm256_cvttps_epi32(local), _mm256_set1_epi32(view.size[axis] - 2));
+				t[axis] = _mm256_sub_ps(local, _mm256_cvtepi32_ps(cell[axis]));
+			}
+
+			__m256i index = _mm256_add_epi32(cell[0], _mm256_add_epi32(_mm256_mullo_epi32(cell[1], stride_y), _mm256_mullo_epi32(cell[2], stride_z)));
+			__m256i index_y = _mm256_add_epi32(index, stride_y);
+			__m256i index_z = _mm256_add_epi32(index, stride_z);
+			__m256i index_yz = _mm256_add_epi32(index_z, stride_y);
+
+			__m256 c00 = lerp(gatherSamples<T>(view.values, index), gatherSamples<T>(view.values, _mm256_add_epi32(index, one)), t[0]);
+			__m256 c10 = lerp(gatherSamples<T>(view.values, index_y), gatherSamples<T>(view.values, _mm256_add_epi32(index_y, one)), t[0]);
+			__m256 c01 = lerp(gatherSamples<T>(view.values, index_z), gatherSamples<T>(view.values, _mm256_add_epi32(index_z, one)), t[0]);
+			__m256 c11 = lerp(gatherSamples<T>(view.values, index_yz), gatherSamples<T>(view.values, _mm256_add_epi32(index_yz, one)), t[0]);
+			__m256 result = lerp(lerp(c00, c10, t[1]), lerp(c01, c11, t[1]), t[2]);
+			_mm256_storeu_ps(distances + i, _mm256_mul_ps(result, _mm256_set1_ps(view.decode_scale)));
+		}
+
+		sampleBatchScalar<T>(view, points + i, distances + i, count - i);
+	}
+#endif
+
+	template<typename T>
+	void sampleBatch(const FieldView& view, const Vec3* points, float* distances, size_t count, cs2::SimdLevel level)
+	{
+#ifdef CS2_SIMD_X86
+		if (level == cs2::SimdLevel::AVX2)
+		{
+			sampleBatchAvx2<T>(view, points, distances, count);
+			return;
+		}
+#endif
+		(void)level;
+		sampleBatchScalar<T>(view, points, distances, count);
+	}
+}
+
+void cs2::DistanceField::setLayout(DistanceFormat format, const size_t size[3], const Vec3& origin, float cellSize, float maxDistance)
+{
+	this->format = format;
+	for (int axis = 0; axis < 3; axis++)
+		this->size[axis] = size[axis];
+	this->origin = origin;
+	cell_size = cellSize;
+	max_distance = maxDistance;
+	decode_scale = format == DistanceFormat::Float32 ? 1.0f : maxDistance / getQuantizedScale(format);
+}
+
+bool cs2::DistanceField::bake(const PhysicsFile& physics, const Bvh& bvh, const DistanceFieldOptions& options)
+{
+	auto start_time = std::chrono::steady_clock::now();
+
+	values = nullptr;
+	storage.clear();
+	file.close();
+	size[0] = size[1] = size[2] = 0;
+	stats = DistanceFieldStats();
+
+	if (!(options.cell_size > 0.0f) || !(options.max_distance > 0.0f))
+	{
+		std::cerr << "Distance field cell size and max distance must be positive, got "
+			<< options.cell_size << " and " << options.max_distance << std::endl;
+		return false;
+	}
+	if (options.format != DistanceFormat::Float32 && options.format != DistanceFormat::Snorm16 && options.format != DistanceFormat::Snorm8)
+	{
+		std::cerr << "Unknown distance field format " << static_cast<uint32_t>(options.format) << std::endl;
+		return false;
+	}
+	if (bvh.empty())
+		return true;
+
+	// One cell of margin around the map, and at least two samples per axis for trilinear cells.
+	const float cell = options.cell_size;
+	const Aabb& bounds = bvh.getBounds();
+	Vec3 grid_origin(std::floor(bounds.min.x / cell) * cell - cell,
+		std::floor(bounds.min.y / cell) * cell - cell,
+		std::floor(bounds.min.z / cell) * cell - cell);
+	size_t grid_size[3];
+	const float extent[3] = { bounds.max.x - grid_origin.x, bounds.max.y - grid_origin.y, bounds.max.z - grid_origin.z };
+	double samples = 1.0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		double count = std::max(std::floor(extent[axis] / cell) + 2.0, 2.0);
+		samples *= count;
+		grid_size[axis] = samples > kMaxSamples ? 0 : static_cast<size_t>(count);
+	}
+	if (samples > kMaxSamples)
+	{
+		std::cerr << "Distance field of " << samples << " samples is too large, use a larger cell size" << std::endl;
+		return false;
+	}
+	setLayout(options.format, grid_size, grid_origin, cell, options.max_distance);
+
+	const size_t size_x = size[0], size_y = size[1], size_z = size[2];
+	const size_t stride_z = size_x * size_y;
+	const size_t count = stride_z * size_z;
+	stats.samples = count;
+	unsigned threads = resolveThreadCount(options.threads);
+
+	// Unpacked triangles, indexed by soup lane like the BVH leaves.
+	const TriangleSoup& soup = bvh.getSoup();
+	std::vector<BoundedTriangle> triangles(soup.size());
+	for (size_t i = 0; i < soup.size(); i++)
+	{
+		if (soup.getHull(i) == TriangleSoup::kPadding)
+			continue;
+		BoundedTriangle& entry = triangles[i];
+		const Triangle& tri = entry.triangle = soup.get(i);
+		entry.min = Vec3(std::min({ tri.a.x, tri.b.x, tri.c.x }), std::min({ tri.a.y, tri.b.y, tri.c.y }), std::min({ tri.a.z, tri.b.z, tri.c.z }));
+		entry.max = Vec3(std::max({ tri.a.x, tri.b.x, tri.c.x }), std::max({ tri.a.y, tri.b.y, tri.c.y }), std::max({ tri.a.z, tri.b.z, tri.c.z }));
+		stats.triangles++;
+	}
+
+	auto samplePoint = [&](size_t x, size_t y, size_t z) {
+		return Vec3(origin.x + x * cell, origin.y + y * cell, origin.z + z * cell);
+	};
+
+	// Seed every sample within a cell of a triangle's bounds with its exact nearest triangle, one z slice at a time.
+	std::vector<uint32_t> nearest(count, kNoTriangle);
+	std::vector<Vec3> closest(count);
+	std::vector<float> distances(count, std::numeric_limits<float>::infinity());
+	std::vector<size_t> seeded(threads, 0);
+	parallelFor(size_z, threads, [&](size_t z, unsigned worker) {
+		const float plane = origin.z + z * cell;
+		Aabb slice(Vec3(bounds.min.x - cell, bounds.min.y - cell, plane - cell), Vec3(bounds.max.x + cell, bounds.max.y + cell, plane + cell));
+		uint32_t* slice_nearest = nearest.data() + z * stride_z;
+		Vec3* slice_closest = closest.data() + z * stride_z;
+		float* slice_distances = distances.data() + z * stride_z;
+
+		bvh.forEachLeaf(slice, [&](uint32_t firstBlock, uint32_t blockCount) {
+			for (size_t lane = firstBlock * TriangleSoup::kLanes; lane < (firstBlock + blockCount) * TriangleSoup::kLanes; lane++)
+			{
+				if (soup.getHull(lane) == TriangleSoup::kPadding)
+					continue;
+
+				const BoundedTriangle& entry = triangles[lane];
+				if (plane < entry.min.z - cell || plane > entry.max.z + cell)
+					continue;
+
+				auto range = [&](float low, float high, float start, size_t limit, size_t& first, size_t& last) {
+					first = static_cast<size_t>(std::clamp(std::ceil((low - cell - start) / cell), 0.0f, static_cast<float>(limit - 1)));
+					last = static_cast<size_t>(std::clamp(std::floor((high + cell - start) / cell), 0.0f, static_cast<float>(limit - 1)));
+				};
+				size_t first_x, last_x, first_y, last_y;
+				range(entry.min.x, entry.max.x, origin.x, size_x, first_x, last_x);
+				range(entry.min.y, entry.max.y, origin.y, size_y, first_y, last_y);
+
+				for (size_t y = first_y; y <= last_y; y++)
+				{
+					for (size_t x = first_x; x <= last_x; x++)
+					{
+						size_t index = y * size_x + x;
+						Vec3 point = samplePoint(x, y, z);
+						Vec3 on_triangle = closestPointTriangle(point, entry.triangle.a, entry.triangle.b, entry.triangle.c);
+						float distance = dot(sub(point, on_triangle), sub(point, on_triangle));
+						if (distance < slice_distances[index])
+						{
+							slice_distances[index] = distance;
+							slice_nearest[index] = static_cast<uint32_t>(lane);
+							slice_closest[index] = on_triangle;
+						}
+					}
+				}
+			}
+		});
+
+		for (size_t i = 0; i < stride_z; i++)
+			seeded[worker] += slice_nearest[i] != kNoTriangle;
+	});
+	for (size_t count_seeded : seeded)
+		stats.seeded += count_seeded;
+
+	auto seed_time = std::chrono::steady_clock::now();
+	stats.seed_seconds = std::chrono::duration<double>(seed_time - start_time).count();
+
+	// Jump flood: each sample tries the nearest triangles of the 26 samples at a
+	// halving step, so a triangle spreads across the field in log2 passes. The
+	// first step reaches max_distance, beyond which distances are clamped, and a
+	// final step of one repairs most of the errors the larger steps leave.
+	//
+	// Samples pass on the closest point of their triangle as well. A candidate
+	// is only loaded when that point is nearer than the best so far, which makes
+	// it certainly nearer, so most candidates are rejected from the neighbours'
+	// rows without touching the triangles. Like any jump flood this can miss a
+	// triangle that is nearer than the point suggests, leaving a distance a
+	// little too large.
+	std::vector<size_t> steps;
+	size_t reach = static_cast<size_t>(std::ceil(options.max_distance / cell));
+	for (size_t step = std::bit_floor(std::max<size_t>(reach, 1)); step >= 1; step /= 2)
+		steps.push_back(step);
+	steps.push_back(1);
+
+	// A sample seeded within a cell of a triangle is exact: any nearer triangle
+	// is within a cell too, and the seeding tried all of those.
+	const float exact_distance = cell * cell;
+	std::vector<uint32_t> next(count);
+	std::vector<Vec3> next_closest(count);
+	for (size_t step : steps)
+	{
+		parallelFor(size_z, threads, [&](size_t z, unsigned) {
+			size_t rows[9];
+			for (size_t y = 0; y < size_y; y++)
+			{
+				// The rows of neighbours depend only on y and z.
+				size_t row_count = 0;
+				for (int64_t nz = static_cast<int64_t>(z) - step; nz <= static_cast<int64_t>(z + step); nz += step)
+				{
+					for (int64_t ny = static_cast<int64_t>(y) - step; ny <= static_cast<int64_t>(y + step); ny += step)
+					{
+						if (nz >= 0 && nz < static_cast<int64_t>(size_z) && ny >= 0 && ny < static_cast<int64_t>(size_y))
+							rows[row_count++] = nz * stride_z + ny * size_x;
+					}
+				}
+
+				for (size_t x = 0; x < size_x; x++)
+				{
+					size_t index = z * stride_z + y * size_x + x;
+					uint32_t best = nearest[index];
+					Vec3 best_point = closest[index];
+					float best_distance = distances[index];
+
+					if (best_distance > exact_distance)
+					{
+						Vec3 point = samplePoint(x, y, z);
+						size_t first_x = x >= step ? x - step : x, last_x = std::min(x + step, size_x - 1);
+						for (size_t row = 0; row < row_count; row++)
+						{
+							for (size_t nx = first_x; nx <= last_x; nx += step)
+							{
+								uint32_t candidate = nearest[rows[row] + nx];
+								if (candidate == kNoTriangle || candidate == best)
+									continue;
+
+								Vec3 offset = sub(point, closest[rows[row] + nx]);
+								if (dot(offset, offset) >= best_distance)
+									continue;
+
+								const Triangle& tri = triangles[candidate].triangle;
+								best_point = closestPointTriangle(point, tri.a, tri.b, tri.c);
+								best_distance = dot(sub(point, best_point), sub(point, best_point));
+								best = candidate;
+							}
+						}
+					}
+
+					// Each sample owns its distance, so it is updated in place.
+					next[index] = best;
+					next_closest[index] = best_point;
+					distances[index] = best_distance;
+				}
+			}
+		});
+		nearest.swap(next);
+		closest.swap(next_closest);
+		stats.passes++;
+	}
+
+	auto flood_time = std::chrono::steady_clock::now();
+	stats.flood_seconds = std::chrono::duration<double>(flood_time - seed_time).count();
+
+	for (float& distance : distances)
+		distance = std::min(std::sqrt(distance), options.max_distance);
+
+	// Negate samples inside hulls, along one vertical line per column of samples.
+	// Only intervals the tracer closed by facing count; unpaired crossings of open surfaces do not.
+	if (options.signed_distance)
+	{
+		Raycaster raycaster(bvh);
+		PenetrationTracer tracer(physics, raycaster);
+		std::vector<Penetration> penetrations(threads);
+		std::vector<size_t> inside(threads, 0);
+		const float bottom = origin.z - cell, top = origin.z + size_z * cell;
+
+		parallelFor(stride_z, threads, [&](size_t column, unsigned worker) {
+			size_t x = column % size_x, y = column / size_x;
+			float line_x = origin.x + (x + kJitterX) * cell, line_y = origin.y + (y + kJitterY) * cell;
+			Penetration& penetration = penetrations[worker];
+			if (!tracer.trace(Vec3(line_x, line_y, bottom), Vec3(line_x, line_y, top), penetration))
+				return;
+
+			for (const PenetrationInterval& interval : penetration.intervals)
+			{
+				float first = std::ceil((bottom + interval.enter - origin.z) / cell);
+				float last = std::floor((bottom + interval.exit - origin.z) / cell);
+				for (float z = std::max(first, 0.0f); z <= std::min(last, static_cast<float>(size_z - 1)); z++)
+				{
+					float& distance = distances[static_cast<size_t>(z) * stride_z + column];
+					if (distance > 0.0f)
+					{
+						distance = -distance;
+						inside[worker]++;
+					}
+				}
+			}
+		});
+		for (size_t count_inside : inside)
+			stats.inside += count_inside;
+	}
+
+	auto sign_time = std::chrono::steady_clock::now();
+	stats.sign_seconds = std::chrono::duration<double>(sign_time - flood_time).count();
+
+	const size_t value_size = getValueSize(format);
+	storage.assign(count * value_size + kDistanceFieldPadding, 0);
+	const float quantize = getQuantizedScale(format) / options.max_distance;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (format == DistanceFormat::Float32)
+		{
+			std::memcpy(storage.data() + i * 4, &distances[i], 4);
+		}
+		else if (format == DistanceFormat::Snorm16)
+		{
+			int16_t value = static_cast<int16_t>(std::lround(distances[i] * quantize));
+			std::memcpy(storage.data() + i * 2, &value, 2);
+		}
+		else
+		{
+			storage[i] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(distances[i] * quantize)));
+		}
+	}
+	values = storage.data();
+
+	stats.bytes = storage.size();
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	return true;
+}
+
+bool cs2::DistanceField::write(const std::string& filename) const
+{
+	std::ofstream output(filename, std::ios::binary);
+	if (!output.is_open())
+	{
+		std::cerr << "Failed to open file: " << filename << std::endl;
+		return false;
+	}
+
+	const uint64_t data_bytes = getSampleCount() * getValueSize(format);
+
+	DistanceFieldHeader header = {};
+	std::memcpy(header.magic, kDistanceFieldMagic, 4);
+	header.version = kDistanceFieldVersion;
+	header.endian_marker = kDistanceFieldEndianMarker;
+	header.format = format;
+	for (int axis = 0; axis < 3; axis++)
+		header.size[axis] = static_cast<uint32_t>(size[axis]);
+	header.origin[0] = origin.x; header.origin[1] = origin.y; header.origin[2] = origin.z;
+	header.cell_size = cell_size;
+	header.max_distance = max_distance;
+	header.data_offset = alignUp(sizeof(header));
+	header.file_size = header.data_offset + data_bytes + kDistanceFieldPadding;
+
+	char padding[kDistanceFieldPadding] = {};
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	output.write(padding, static_cast<std::streamsize>(header.data_offset - sizeof(header)));
+	if (data_bytes > 0)
+		output.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(data_bytes));
+	output.write(padding, kDistanceFieldPadding);
+
+	output.close();
+	if (!output)
+	{
+		std::cerr << "Failed to write file: " << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool cs2::DistanceField::open(const std::string& filename, std::string& error)
+{
+	values = nullptr;
+	storage.clear();
+	size[0] = size[1] = size[2] = 0;
+	stats = DistanceFieldStats();
+
+	if (!file.open(filename))
+	{
+		error = "Failed to open file: " + filename;
+		return false;
+	}
+
+	uint64_t file_size = file.size();
+	const char* data = file.data();
+
+	if (file_size < sizeof(DistanceFieldHeader) || std::memcmp(data, kDistanceFieldMagic, 4) != 0)
+	{
+		error = "Not a distance field: " + filename;
+		return false;
+	}
+
+	DistanceFieldHeader header;
+	std::memcpy(&header, data, sizeof(header));
+
+	if (header.version != kDistanceFieldVersion)
+	{
+		error = "Unsupported distance field version " + std::to_string(header.version) + ": " + filename;
+		return false;
+	}
+
+	if (header.endian_marker != kDistanceFieldEndianMarker)
+	{
+		error = "Distance field was written with a different byte order: " + filename;
+		return false;
+	}
+
+	bool valid =
+		(header.format == DistanceFormat::Float32 || header.format == DistanceFormat::Snorm16 || header.format == DistanceFormat::Snorm8) &&
+		header.cell_size > 0.0f && std::isfinite(header.cell_size) &&
+		header.max_distance > 0.0f && std::isfinite(header.max_distance) &&
+		header.size[0] >= 2 && header.size[1] >= 2 && header.size[2] >= 2 &&
+		header.file_size == file_size &&
+		header.data_offset % 64 == 0;
+
+	uint64_t samples = valid ? static_cast<uint64_t>(header.size[0]) * header.size[1] * header.size[2] : 0;
+	valid = valid && samples <= kMaxSamples &&
+		inRange(header.data_offset, samples * getValueSize(header.format) + kDistanceFieldPadding, file_size);
+
+	if (!valid)
+	{
+		error = "Corrupt distance field header: " + filename;
+		return false;
+	}
+
+	const size_t grid_size[3] = { header.size[0], header.size[1], header.size[2] };
+	setLayout(header.format, grid_size, Vec3(header.origin[0], header.origin[1], header.origin[2]), header.cell_size, header.max_distance);
+	values = reinterpret_cast<const uint8_t*>(data + header.data_offset);
+	stats.samples = samples;
+	stats.bytes = file_size;
+	return true;
+}
+
+float cs2::DistanceField::sample(const Vec3& point) const
+{
+	float distance = max_distance;
+	sample(std::span<const Vec3>(&point, 1), std::span<float>(&distance, 1), SimdLevel::Scalar);
+	return distance;
+}
+
+void cs2::DistanceField::sample(std::span<const Vec3> points, std::span<float> distances, SimdLevel level) const
+{
+	const size_t count = std::min(points.size(), distances.size());
+	if (!values)
+	{
+		std::fill(distances.begin(), distances.begin() + count, max_distance);
+		return;
+	}
+
+	FieldView view;
+	view.values = values;
+	for (int axis = 0; axis < 3; axis++)
+		view.size[axis] = static_cast<int32_t>(size[axis]);
+	view.origin[0] = origin.x; view.origin[1] = origin.y; view.origin[2] = origin.z;
+	view.inverse_cell = 1.0f / cell_size;
+	view.decode_scale = decode_scale;
+
+	level = getSupportedSimdLevel(level);
+	switch (format)
+	{
+	case DistanceFormat::Float32:
+		sampleBatch<float>(view, points.data(), distances.data(), count, level);
+		break;
+	case DistanceFormat::Snorm16:
+		sampleBatch<int16_t>(view, points.data(), distances.data(), count, level);
+		break;
+	case DistanceFormat::Snorm8:
+		sampleBatch<int8_t>(view, points.data(), distances.data(), count, level);
+		break;
+	}
+}
+
+void cs2::DistanceField::displayStats() const
+{
+	std::cout << "Distance Field: " << size[0] << "x" << size[1] << "x" << size[2] << " samples of " << cell_size
+		<< " units, " << getFormatName(format) << ", clamped to " << max_distance << std::endl;
+	std::cout << "Distance Field Samples: " << stats.seeded << " seeded, " << stats.inside << " inside of " << stats.samples
+		<< " (" << stats.passes << " flood passes)" << std::endl;
+	std::cout << "Distance Field Memory: " << stats.bytes / 1024 << " KB" << std::endl;
+	std::cout << "Distance Field Bake Time: " << stats.seconds * 1000.0 << " ms (seed " << stats.seed_seconds * 1000.0
+		<< ", flood " << stats.flood_seconds * 1000.0 << ", sign " << stats.sign_seconds * 1000.0 << ")" << std::endl;
+	std::cout << std::endl;
+}
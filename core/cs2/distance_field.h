@@ -0,0 +1,169 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "bvh.h"
+#include "mapped_file.h"
+#include "simd.h"
+
+namespace cs2
+{
+	// Distance field file layout, in the byte order recorded by the endian marker:
+	//
+	//   DistanceFieldHeader               64 bytes
+	//   samples                           size_x * size_y * size_z values in x, y, z
+	//                                     order, starting on a 64-byte boundary and
+	//                                     followed by at least kDistanceFieldPadding bytes
+	//
+	// Quantized formats store round(distance / max_distance * scale) with a scale
+	// of 32767 or 127.
+	constexpr char kDistanceFieldMagic[4] = { 'C', 'S', '2', 'D' };
+	constexpr uint32_t kDistanceFieldVersion = 1;
+	constexpr uint32_t kDistanceFieldEndianMarker = 0x01020304;
+	// Readable bytes after the last sample, so gathers may load a whole 32-bit word at any sample.
+	constexpr size_t kDistanceFieldPadding = 64;
+
+	enum class DistanceFormat : uint32_t {
+		Float32,
+		Snorm16,
+		Snorm8,
+	};
+
+	struct DistanceFieldHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t endian_marker;
+		DistanceFormat format;
+		uint32_t size[3];
+		float origin[3];
+		float cell_size;
+		float max_distance;
+		uint64_t data_offset;
+		uint64_t file_size;
+	};
+
+	static_assert(sizeof(DistanceFieldHeader) == 64, "DistanceFieldHeader must fill its 64-byte slot");
+
+	class DistanceFieldOptions {
+	public:
+		// Number of threads, zero for one per hardware thread.
+		unsigned threads = 1;
+		// Spacing of the samples in map units.
+		float cell_size = 16.0f;
+		// Distances are clamped to this, which also bounds the jump flood steps.
+		float max_distance = 256.0f;
+		// Negate distances inside hulls; otherwise every distance is positive.
+		bool signed_distance = true;
+		DistanceFormat format = DistanceFormat::Snorm16;
+	};
+
+	class DistanceFieldStats {
+	public:
+		size_t triangles = 0;
+		size_t samples = 0;
+		// Samples seeded with a nearby triangle before flooding.
+		size_t seeded = 0;
+		size_t passes = 0;
+		// Samples inside a hull.
+		size_t inside = 0;
+		size_t bytes = 0;
+		double seed_seconds = 0.0;
+		double flood_seconds = 0.0;
+		double sign_seconds = 0.0;
+		double seconds = 0.0;
+	};
+
+	/// <summary>
+	/// Distance from a regular grid of samples to the nearest triangle of a
+	/// map, for clearance queries that need no geometry. The bake seeds the
+	/// samples near each triangle with their exact distance, then spreads the
+	/// nearest triangle to the others with a jump flood, which stops at
+	/// max_distance. Samples are negative inside hulls, found by following the
+	/// crossings of vertical lines by their facing (see PenetrationTracer), so
+	/// the space between the surfaces of open or multi-shell meshes stays positive.
+	///
+	/// Between samples the field is interpolated trilinearly; points outside
+	/// the grid take the value of the nearest point on its boundary. A baked
+	/// field can be written to a file and mapped back without copying.
+	/// </summary>
+	class DistanceField {
+	public:
+		/// <summary>
+		/// Bake the distance field of the triangles of a BVH.
+		/// </summary>
+		/// <param name="physics">
+		/// The physics file the BVH was built from.
+		/// </param>
+		/// <param name="bvh">
+		/// The BVH of the map, used only during the bake.
+		/// </param>
+		/// <returns>
+		/// Returns false if the options are invalid or the grid would be too large.
+		/// </returns>
+		bool bake(const PhysicsFile& physics, const Bvh& bvh, const DistanceFieldOptions& options = DistanceFieldOptions());
+
+		/// <summary>
+		/// Write the field to a file that open can map.
+		/// </summary>
+		bool write(const std::string& filename) const;
+
+		/// <summary>
+		/// Map and validate a distance field file written by write.
+		/// </summary>
+		/// <param name="error">
+		/// Receives a description of the failure, if any.
+		/// </param>
+		bool open(const std::string& filename, std::string& error);
+
+		/// <summary>
+		/// Sample the field at a point.
+		/// </summary>
+		float sample(const Vec3& point) const;
+
+		/// <summary>
+		/// Sample the field at many points, eight at a time with AVX2.
+		/// </summary>
+		/// <param name="points">
+		/// The points to sample.
+		/// </param>
+		/// <param name="distances">
+		/// Receives one distance per point, at least as long as points.
+		/// </param>
+		void sample(std::span<const Vec3> points, std::span<float> distances, SimdLevel level = getSimdLevel()) const;
+
+		DistanceFormat getFormat() const { return format; }
+		float getCellSize() const { return cell_size; }
+		float getMaxDistance() const { return max_distance; }
+		const Vec3& getOrigin() const { return origin; }
+		size_t getSize(int axis) const { return size[axis]; }
+		size_t getSampleCount() const { return size[0] * size[1] * size[2]; }
+		bool empty() const { return values == nullptr; }
+
+		const DistanceFieldStats& getStats() const { return stats; }
+
+		/// <summary>
+		/// Display the bake statistics.
+		/// </summary>
+		void displayStats() const;
+
+	private:
+		// Samples, in storage or in the mapped file.
+		const uint8_t* values = nullptr;
+		std::vector<uint8_t> storage;
+		MappedFile file;
+
+		DistanceFormat format = DistanceFormat::Float32;
+		size_t size[3] = { 0, 0, 0 };
+		Vec3 origin = Vec3(0.0f, 0.0f, 0.0f);
+		float cell_size = 0.0f;
+		float max_distance = 0.0f;
+		// Multiplies a stored value into a distance.
+		float decode_scale = 0.0f;
+		DistanceFieldStats stats;
+
+		void setLayout(DistanceFormat format, const size_t size[3], const Vec3& origin, float cellSize, float maxDistance);
+	};
+} // namespace cs2
@@ -0,0 +1,58 @@
+#pragma once
+#include <cmath>
+
+#include "parser.h"
+
+namespace cs2
+{
+	// Small vector helpers and closest point queries shared by the geometry
+	// modules (sweep.cpp, distance_field.cpp). Internal, not part of the API.
+	namespace detail
+	{
+		inline Vec3 add(const Vec3& a, const Vec3& b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+		inline Vec3 sub(const Vec3& a, const Vec3& b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+		inline Vec3 scale(const Vec3& a, float s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+		inline float dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		inline Vec3 cross(const Vec3& a, const Vec3& b) { return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+
+		inline Vec3 normalize(const Vec3& a)
+		{
+			float length = std::sqrt(dot(a, a));
+			return length > 0.0f ? scale(a, 1.0f / length) : Vec3(0.0f, 0.0f, 0.0f);
+		}
+
+		// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5).
+		inline Vec3 closestPointTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c)
+		{
+			Vec3 ab = sub(b, a), ac = sub(c, a), ap = sub(p, a);
+			float d1 = dot(ab, ap), d2 = dot(ac, ap);
+			if (d1 <= 0.0f && d2 <= 0.0f)
+				return a;
+
+			Vec3 bp = sub(p, b);
+			float d3 = dot(ab, bp), d4 = dot(ac, bp);
+			if (d3 >= 0.0f && d4 <= d3)
+				return b;
+
+			float vc = d1 * d4 - d3 * d2;
+			if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+				return add(a, scale(ab, d1 / (d1 - d3)));
+
+			Vec3 cp = sub(p, c);
+			float d5 = dot(ab, cp), d6 = dot(ac, cp);
+			if (d6 >= 0.0f && d5 <= d6)
+				return c;
+
+			float vb = d5 * d2 - d1 * d6;
+			if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+				return add(a, scale(ac, d2 / (d2 - d6)));
+
+			float va = d3 * d6 - d5 * d4;
+			if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+				return add(b, scale(sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+
+			float denom = 1.0f / (va + vb + vc);
+			return add(a, add(scale(ab, vb * denom), scale(ac, vc * denom)));
+		}
+	} // namespace detail
+} // namespace cs2
@@ -0,0 +1,141 @@
+#include "grenade.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#include "hash.h"
+#include "parallel.h"
+
+namespace
+{
+	// Sweeps a single tick may take; each contact uses one and leaves the rest of the move.
+	constexpr int kMaxContactsPerTick = 4;
+	// Distance a grenade is pushed off a surface it hit, so the next sweep does not start touching it.
+	constexpr float kPushOff = cs2::Sweeper::kSkin * 0.25f;
+	// Floors are surfaces whose normal points up at least this much.
+	constexpr float kFloorNormal = 0.7f;
+}
+
+cs2::GrenadeSimulator::GrenadeSimulator(const PhysicsFile& physics, const Bvh& bvh, const GrenadeOptions& options) :
+	sweeper(bvh), options(options)
+{
+	// Props of compiled maps that are not stock names come through as their hash, so match those by hash too.
+	std::unordered_map<std::string, float> by_hash;
+	for (auto& [name, value] : options.restitution)
+	{
+		char text[16];
+		std::snprintf(text, sizeof(text), "0x%08X", hashToken(name));
+		by_hash.emplace(text, value);
+	}
+
+	const std::vector<std::string>& names = physics.getSurfaceProps();
+	restitution.resize(names.size(), options.default_restitution);
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (auto it = options.restitution.find(names[i]); it != options.restitution.end())
+			restitution[i] = it->second;
+		else if (auto hashed = by_hash.find(names[i]); hashed != by_hash.end())
+			restitution[i] = hashed->second;
+	}
+}
+
+size_t cs2::GrenadeSimulator::run(const GrenadeThrow& grenade, GrenadeResult& result) const
+{
+	const Vec3 extents(options.half_extent, options.half_extent, options.half_extent);
+	const float dt = options.tick_interval;
+	const size_t max_ticks = static_cast<size_t>(std::ceil(options.max_time / dt));
+
+	Vec3 position = grenade.position;
+	Vec3 velocity = grenade.velocity;
+	result = GrenadeResult();
+
+	size_t tick = 0;
+	while (tick < max_ticks && !result.at_rest && !result.stuck)
+	{
+		tick++;
+
+		// Half the gravity before the move and half after integrates the arc exactly.
+		velocity.z -= options.gravity * dt * 0.5f;
+		Vec3 move(velocity.x * dt, velocity.y * dt, velocity.z * dt);
+		velocity.z -= options.gravity * dt * 0.5f;
+
+		for (int contact = 0; contact < kMaxContactsPerTick; contact++)
+		{
+			Vec3 target(position.x + move.x, position.y + move.y, position.z + move.z);
+			SweepHit hit;
+			if (!sweeper.sweepBox(position, target, extents, hit))
+			{
+				position = target;
+				break;
+			}
+
+			if (hit.start_solid)
+			{
+				result.stuck = true;
+				break;
+			}
+
+			const Vec3& n = hit.normal;
+			position = Vec3(position.x + move.x * hit.fraction + n.x * kPushOff,
+				position.y + move.y * hit.fraction + n.y * kPushOff,
+				position.z + move.z * hit.fraction + n.z * kPushOff);
+
+			// Reflect, then lose energy according to the material.
+			float e = getRestitution(hit.surface_prop);
+			float into = velocity.x * n.x + velocity.y * n.y + velocity.z * n.z;
+			velocity = Vec3((velocity.x - 2.0f * into * n.x) * e, (velocity.y - 2.0f * into * n.y) * e, (velocity.z - 2.0f * into * n.z) * e);
+
+			float remaining = 1.0f - hit.fraction;
+			result.bounces.push_back(GrenadeBounce{ position, n, hit.surface_prop, (tick - 1 + hit.fraction) * dt });
+
+			float speed = std::sqrt(velocity.x * velocity.x + velocity.y * velocity.y + velocity.z * velocity.z);
+			if (n.z > kFloorNormal && speed < options.stop_speed)
+			{
+				result.at_rest = true;
+				break;
+			}
+
+			move = Vec3(velocity.x * dt * remaining, velocity.y * dt * remaining, velocity.z * dt * remaining);
+		}
+	}
+
+	result.position = position;
+	result.time = tick * dt;
+	return tick;
+}
+
+void cs2::GrenadeSimulator::simulate(const GrenadeThrow& grenade, GrenadeResult& result) const
+{
+	run(grenade, result);
+}
+
+cs2::GrenadeStats cs2::GrenadeSimulator::simulate(std::span<const GrenadeThrow> throws, std::vector<GrenadeResult>& results) const
+{
+	auto start_time = std::chrono::steady_clock::now();
+
+	GrenadeStats stats;
+	stats.trajectories = throws.size();
+	stats.threads = resolveThreadCount(options.threads);
+
+	results.resize(throws.size());
+	std::vector<size_t> worker_ticks(stats.threads);
+
+	// Trajectories differ a lot in length, so workers take small chunks.
+	constexpr size_t kChunk = 16;
+	parallelFor((throws.size() + kChunk - 1) / kChunk, stats.threads, [&](size_t chunk, unsigned worker) {
+		for (size_t i = chunk * kChunk; i < std::min(throws.size(), (chunk + 1) * kChunk); i++)
+			worker_ticks[worker] += run(throws[i], results[i]);
+	});
+
+	for (size_t ticks : worker_ticks)
+		stats.ticks += ticks;
+	for (auto& result : results)
+	{
+		stats.bounces += result.bounces.size();
+		stats.at_rest += result.at_rest;
+	}
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	return stats;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sweep.h"
+
+namespace cs2
+{
+	class GrenadeThrow {
+	public:
+		Vec3 position;
+		Vec3 velocity;
+
+		GrenadeThrow() = default;
+		GrenadeThrow(Vec3 position, Vec3 velocity) : position(position), velocity(velocity) {}
+	};
+
+	class GrenadeOptions {
+	public:
+		// sv_gravity of 800 scaled by the grenade gravity factor of 0.4.
+		float gravity = 320.0f;
+		float tick_interval = 1.0f / 64.0f;
+		// Simulation stops after this long even if the grenade is still moving.
+		float max_time = 10.0f;
+		// Half size of the grenade's collision box.
+		float half_extent = 2.0f;
+		// A grenade on a floor (normal z above 0.7) slower than this comes to rest.
+		float stop_speed = 20.0f;
+		// Fraction of the speed kept after a bounce, per surface prop name, and for all others.
+		// Names also match the hashed props of compiled maps.
+		std::unordered_map<std::string, float> restitution;
+		float default_restitution = 0.45f;
+		// Number of threads, zero for one per hardware thread.
+		unsigned threads = 0;
+	};
+
+	class GrenadeBounce {
+	public:
+		Vec3 position;
+		Vec3 normal;
+		// Index into PhysicsFile::getSurfaceProps.
+		uint32_t surface_prop;
+		float time;
+	};
+
+	class GrenadeResult {
+	public:
+		// Where the grenade came to rest, or where it was when the simulation stopped.
+		Vec3 position;
+		bool at_rest = false;
+		// The grenade started inside geometry or got wedged, and stopped there.
+		bool stuck = false;
+		float time = 0.0f;
+		// Every bounce in order; the path is the throw position, the bounces, then position.
+		std::vector<GrenadeBounce> bounces;
+	};
+
+	class GrenadeStats {
+	public:
+		size_t trajectories = 0;
+		size_t ticks = 0;
+		size_t bounces = 0;
+		size_t at_rest = 0;
+		unsigned threads = 0;
+		double seconds = 0.0;
+
+		double getTrajectoriesPerSecond() const { return seconds > 0.0 ? trajectories / seconds : 0.0; }
+	};
+
+	/// <summary>
+	/// Simulates thrown grenades through the map: gravity is integrated per
+	/// tick, each tick's move is swept as a small box, and on contact the
+	/// velocity is reflected about the contact normal and scaled by the
+	/// restitution of the surface prop that was hit (Source style). A grenade
+	/// slowing down on a floor comes to rest.
+	/// </summary>
+	class GrenadeSimulator {
+	public:
+		/// <param name="physics">
+		/// The physics file the BVH was built from, for its surface prop names.
+		/// </param>
+		/// <param name="bvh">
+		/// The BVH to collide against, which must outlive the simulator.
+		/// </param>
+		GrenadeSimulator(const PhysicsFile& physics, const Bvh& bvh, const GrenadeOptions& options = GrenadeOptions());
+
+		/// <summary>
+		/// Simulate a batch of throws in parallel.
+		/// </summary>
+		/// <param name="throws">
+		/// The initial position and velocity of every grenade.
+		/// </param>
+		/// <param name="results">
+		/// Receives one result per throw, in the same order.
+		/// </param>
+		GrenadeStats simulate(std::span<const GrenadeThrow> throws, std::vector<GrenadeResult>& results) const;
+
+		/// <summary>
+		/// Simulate a single throw.
+		/// </summary>
+		void simulate(const GrenadeThrow& grenade, GrenadeResult& result) const;
+
+		float getRestitution(uint32_t surfaceProp) const
+		{
+			return surfaceProp < restitution.size() ? restitution[surfaceProp] : options.default_restitution;
+		}
+
+	private:
+		Sweeper sweeper;
+		GrenadeOptions options;
+		// Restitution per surface prop id, resolved from the names once.
+		std::vector<float> restitution;
+
+		// Returns the number of ticks simulated.
+		size_t run(const GrenadeThrow& grenade, GrenadeResult& result) const;
+	};
+} // namespace cs2
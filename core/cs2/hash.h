@@ -0,0 +1,164 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace cs2
+{
+	namespace detail
+	{
+		constexpr uint64_t kHashPrime1 = 11400714785074694791ull;
+		constexpr uint64_t kHashPrime2 = 14029467366897019727ull;
+		constexpr uint64_t kHashPrime3 = 1609587929392839161ull;
+		constexpr uint64_t kHashPrime4 = 9650029242287828579ull;
+		constexpr uint64_t kHashPrime5 = 2870177450012600261ull;
+
+		inline uint64_t rotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+		inline uint64_t read64(const uint8_t* p)
+		{
+			uint64_t value;
+			std::memcpy(&value, p, 8);
+			return value;
+		}
+
+		inline uint32_t read32(const uint8_t* p)
+		{
+			uint32_t value;
+			std::memcpy(&value, p, 4);
+			return value;
+		}
+
+		inline uint64_t hashRound(uint64_t acc, uint64_t input)
+		{
+			acc += input * kHashPrime2;
+			return rotateLeft(acc, 31) * kHashPrime1;
+		}
+
+		inline uint64_t hashMerge(uint64_t acc, uint64_t value)
+		{
+			acc ^= hashRound(0, value);
+			return acc * kHashPrime1 + kHashPrime4;
+		}
+	}
+
+	/// <summary>
+	/// 64-bit content hash (the XXH64 algorithm). Four independent lanes of
+	/// eight bytes keep it well above the speed files can be read at.
+	/// </summary>
+	/// <param name="input">
+	/// The bytes to hash.
+	/// </param>
+	/// <param name="seed">
+	/// Seed mixed into the hash.
+	/// </param>
+	inline uint64_t hashBytes(std::string_view input, uint64_t seed = 0)
+	{
+		using namespace detail;
+
+		const uint8_t* p = reinterpret_cast<const uint8_t*>(input.data());
+		const uint8_t* end = p + input.size();
+		uint64_t h;
+
+		if (input.size() >= 32)
+		{
+			uint64_t v1 = seed + kHashPrime1 + kHashPrime2;
+			uint64_t v2 = seed + kHashPrime2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - kHashPrime1;
+
+			for (; p + 32 <= end; p += 32)
+			{
+				v1 = hashRound(v1, read64(p));
+				v2 = hashRound(v2, read64(p + 8));
+				v3 = hashRound(v3, read64(p + 16));
+				v4 = hashRound(v4, read64(p + 24));
+			}
+
+			h = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+			h = hashMerge(h, v1);
+			h = hashMerge(h, v2);
+			h = hashMerge(h, v3);
+			h = hashMerge(h, v4);
+		}
+		else
+		{
+			h = seed + kHashPrime5;
+		}
+
+		h += input.size();
+
+		for (; p + 8 <= end; p += 8)
+		{
+			h ^= hashRound(0, read64(p));
+			h = rotateLeft(h, 27) * kHashPrime1 + kHashPrime4;
+		}
+
+		if (p + 4 <= end)
+		{
+			h ^= static_cast<uint64_t>(read32(p)) * kHashPrime1;
+			h = rotateLeft(h, 23) * kHashPrime2 + kHashPrime3;
+			p += 4;
+		}
+
+		for (; p < end; p++)
+		{
+			h ^= *p * kHashPrime5;
+			h = rotateLeft(h, 11) * kHashPrime1;
+		}
+
+		h ^= h >> 33;
+		h *= kHashPrime2;
+		h ^= h >> 29;
+		h *= kHashPrime3;
+		h ^= h >> 32;
+
+		return h;
+	}
+
+	/// <summary>
+	/// 32-bit hash Source 2 uses for string tokens such as surface property names
+	/// (MurmurHash2 of the lowercased name). Compiled resources store these
+	/// hashes instead of the names.
+	/// </summary>
+	/// <param name="name">
+	/// The name to hash; ASCII letters are lowercased first.
+	/// </param>
+	inline uint32_t hashToken(std::string_view name)
+	{
+		constexpr uint32_t kSeed = 0x31415926;
+		constexpr uint32_t m = 0x5BD1E995;
+
+		auto lower = [&](size_t i) -> uint32_t {
+			unsigned char c = static_cast<unsigned char>(name[i]);
+			return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+		};
+
+		uint32_t h = kSeed ^ static_cast<uint32_t>(name.size());
+		size_t i = 0;
+
+		for (; i + 4 <= name.size(); i += 4)
+		{
+			uint32_t k = lower(i) | (lower(i + 1) << 8) | (lower(i + 2) << 16) | (lower(i + 3) << 24);
+			k *= m;
+			k ^= k >> 24;
+			k *= m;
+			h *= m;
+			h ^= k;
+		}
+
+		switch (name.size() - i)
+		{
+		case 3: h ^= lower(i + 2) << 16; [[fallthrough]];
+		case 2: h ^= lower(i + 1) << 8; [[fallthrough]];
+		case 1: h ^= lower(i); h *= m;
+		}
+
+		h ^= h >> 13;
+		h *= m;
+		h ^= h >> 15;
+
+		return h;
+	}
+} // namespace cs2
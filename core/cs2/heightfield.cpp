@@ -0,0 +1,595 @@
+#include "heightfield.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "parallel.h"
+
+namespace
+{
+	using cs2::Vec3;
+
+	constexpr size_t kTileSize = cs2::Heightfield::kTileSize;
+	// Largest grid; keeps the offset arrays and the file under a few hundred MB.
+	constexpr size_t kMaxCells = size_t(1) << 26;
+	// Triangles whose normal z is within this of zero are walls, neither floor nor ceiling.
+	constexpr float kWallNormal = 1e-3f;
+
+	struct Surface {
+		cs2::Triangle triangle;
+		bool floor;
+	};
+
+	// One layer height of a cell within a tile, before the tiles are merged.
+	struct Layer {
+		uint32_t cell;
+		float height;
+
+		bool operator<(const Layer& other) const { return cell < other.cell || (cell == other.cell && height < other.height); }
+	};
+
+	class TileBuilder {
+	public:
+		std::vector<Layer> floors;
+		std::vector<Layer> ceilings;
+
+		void build(const std::vector<Surface>& surfaces, const uint32_t* refs, size_t count, const cs2::HeightfieldOptions& options,
+			float originX, float originY, size_t tileX, size_t tileY, size_t sizeX, size_t sizeY)
+		{
+			floors.clear();
+			ceilings.clear();
+
+			const float cell = options.cell_size;
+			const size_t first_x = tileX * kTileSize, first_y = tileY * kTileSize;
+			const size_t last_x = std::min(first_x + kTileSize, sizeX) - 1, last_y = std::min(first_y + kTileSize, sizeY) - 1;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const Surface& surface = surfaces[refs[i]];
+				const cs2::Triangle& tri = surface.triangle;
+				size_t min_x, max_x, min_y, max_y;
+				if (!getCellRange(tri, originX, originY, cell, sizeX, sizeY, min_x, max_x, min_y, max_y))
+					continue;
+
+				for (size_t y = std::max(min_y, first_y); y <= std::min(max_y, last_y); y++)
+				{
+					for (size_t x = std::max(min_x, first_x); x <= std::min(max_x, last_x); x++)
+					{
+						float low, high;
+						float cell_x = originX + x * cell, cell_y = originY + y * cell;
+						if (!clipToCell(tri, cell_x, cell_y, cell_x + cell, cell_y + cell, low, high))
+							continue;
+
+						uint32_t local = static_cast<uint32_t>((y - first_y) * kTileSize + (x - first_x));
+						if (surface.floor)
+							floors.push_back(Layer{ local, high });
+						else
+							ceilings.push_back(Layer{ local, low });
+					}
+				}
+			}
+
+			// A floor layer keeps the highest of its surfaces and a ceiling the lowest.
+			mergeLayers(floors, options.merge_height, true);
+			mergeLayers(ceilings, options.merge_height, false);
+		}
+
+		static bool getCellRange(const cs2::Triangle& tri, float originX, float originY, float cell, size_t sizeX, size_t sizeY,
+			size_t& minX, size_t& maxX, size_t& minY, size_t& maxY)
+		{
+			auto range = [&](float low, float high, float origin, size_t size, size_t& first, size_t& last) {
+				float first_cell = std::floor((low - origin) / cell), last_cell = std::floor((high - origin) / cell);
+				if (!(last_cell >= 0.0f) || !(first_cell < static_cast<float>(size)))
+					return false;
+				first = static_cast<size_t>(std::max(first_cell, 0.0f));
+				last = std::min(static_cast<size_t>(last_cell), size - 1);
+				return true;
+			};
+			return range(std::min({ tri.a.x, tri.b.x, tri.c.x }), std::max({ tri.a.x, tri.b.x, tri.c.x }), originX, sizeX, minX, maxX) &&
+				range(std::min({ tri.a.y, tri.b.y, tri.c.y }), std::max({ tri.a.y, tri.b.y, tri.c.y }), originY, sizeY, minY, maxY);
+		}
+
+	private:
+		// Clip a triangle to the column over a cell (Sutherland-Hodgman) and get the height range of what is left.
+		static bool clipToCell(const cs2::Triangle& tri, float minX, float minY, float maxX, float maxY, float& low, float& high)
+		{
+			Vec3 polygon[2][9];
+			size_t count = 3;
+			polygon[0][0] = tri.a;
+			polygon[0][1] = tri.b;
+			polygon[0][2] = tri.c;
+
+			int current = 0;
+			for (int plane = 0; plane < 4 && count > 0; plane++)
+			{
+				// Signed distance inside each side: x >= minX, x <= maxX, y >= minY, y <= maxY.
+				auto inside = [&](const Vec3& p) {
+					switch (plane)
+					{
+					case 0: return p.x - minX;
+					case 1: return maxX - p.x;
+					case 2: return p.y - minY;
+					default: return maxY - p.y;
+					}
+				};
+
+				const Vec3* in = polygon[current];
+				Vec3* out = polygon[current ^ 1];
+				size_t out_count = 0;
+				for (size_t i = 0; i < count; i++)
+				{
+					const Vec3& p = in[i];
+					const Vec3& q = in[(i + 1) % count];
+					float dp = inside(p), dq = inside(q);
+					if (dp >= 0.0f)
+						out[out_count++] = p;
+					if ((dp >= 0.0f) != (dq >= 0.0f))
+					{
+						float t = dp / (dp - dq);
+						out[out_count++] = Vec3(p.x + (q.x - p.x) * t, p.y + (q.y - p.y) * t, p.z + (q.z - p.z) * t);
+					}
+				}
+				count = out_count;
+				current ^= 1;
+			}
+
+			if (count == 0)
+				return false;
+
+			low = std::numeric_limits<float>::max();
+			high = -low;
+			for (size_t i = 0; i < count; i++)
+			{
+				low = std::min(low, polygon[current][i].z);
+				high = std::max(high, polygon[current][i].z);
+			}
+			return true;
+		}
+
+		static void mergeLayers(std::vector<Layer>& layers, float mergeHeight, bool keepHighest)
+		{
+			std::sort(layers.begin(), layers.end());
+
+			size_t kept = 0;
+			for (size_t i = 0; i < layers.size(); kept++)
+			{
+				Layer layer = layers[i];
+				float last = layer.height;
+				for (i++; i < layers.size() && layers[i].cell == layer.cell && layers[i].height - last <= mergeHeight; i++)
+					last = layers[i].height;
+				if (keepHighest)
+					layer.height = last;
+				layers[kept] = layer;
+			}
+			layers.resize(kept);
+		}
+	};
+
+	uint64_t alignUp(uint64_t offset)
+	{
+		return (offset + 63) & ~uint64_t(63);
+	}
+
+	// Offsets of the sections after the header, which follow from the counts alone.
+	void getSectionOffsets(uint64_t cells, uint64_t floorCount, uint64_t ceilingCount, uint64_t offsets[5])
+	{
+		offsets[0] = alignUp(sizeof(cs2::HeightfieldHeader));
+		offsets[1] = alignUp(offsets[0] + (cells + 1) * sizeof(uint32_t));
+		offsets[2] = alignUp(offsets[1] + floorCount * sizeof(float));
+		offsets[3] = alignUp(offsets[2] + (cells + 1) * sizeof(uint32_t));
+		offsets[4] = offsets[3] + ceilingCount * sizeof(float);
+	}
+
+	bool isValidOffsets(const uint32_t* offsets, uint64_t cells, uint64_t count)
+	{
+		if (offsets[0] != 0 || offsets[cells] != count)
+			return false;
+		for (uint64_t i = 0; i < cells; i++)
+		{
+			if (offsets[i] > offsets[i + 1])
+				return false;
+		}
+		return true;
+	}
+}
+
+bool cs2::Heightfield::build(const PhysicsFile& physics, const HeightfieldOptions& options)
+{
+	auto start_time = std::chrono::steady_clock::now();
+
+	floor_offsets = nullptr;
+	floors = nullptr;
+	ceiling_offsets = nullptr;
+	ceilings = nullptr;
+	floor_offset_storage.clear();
+	floor_storage.clear();
+	ceiling_offset_storage.clear();
+	ceiling_storage.clear();
+	file.close();
+	size_x = size_y = 0;
+	stats = HeightfieldStats();
+
+	if (!(options.cell_size > 0.0f) || !(options.merge_height >= 0.0f))
+	{
+		std::cerr << "Heightfield cell size must be positive and merge height not negative, got "
+			<< options.cell_size << " and " << options.merge_height << std::endl;
+		return false;
+	}
+	cell_size = options.cell_size;
+	inverse_size = 1.0f / cell_size;
+	walkable_normal = options.walkable_normal;
+
+	// Keep the triangles that face up or down, hull by hull.
+	unsigned threads = resolveThreadCount(options.threads);
+	const auto& hulls = physics.getHulls();
+	std::vector<std::vector<Surface>> worker_surfaces(threads);
+	parallelFor(hulls.size(), threads, [&](size_t h, unsigned worker) {
+		hulls[h].forEachTriangle([&](const Triangle& tri) {
+			Vec3 u(tri.b.x - tri.a.x, tri.b.y - tri.a.y, tri.b.z - tri.a.z);
+			Vec3 v(tri.c.x - tri.a.x, tri.c.y - tri.a.y, tri.c.z - tri.a.z);
+			Vec3 n(u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x);
+			float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			if (!(length > 0.0f))
+				return;
+
+			float normal_z = n.z / length;
+			if (normal_z >= options.walkable_normal && normal_z > kWallNormal)
+				worker_surfaces[worker].push_back(Surface{ tri, true });
+			else if (normal_z < -kWallNormal)
+				worker_surfaces[worker].push_back(Surface{ tri, false });
+		});
+	});
+
+	std::vector<Surface> surfaces;
+	for (auto& list : worker_surfaces)
+	{
+		surfaces.insert(surfaces.end(), list.begin(), list.end());
+		list = std::vector<Surface>();
+	}
+
+	Aabb bounds;
+	for (const Surface& surface : surfaces)
+	{
+		bounds.extend(surface.triangle.a);
+		bounds.extend(surface.triangle.b);
+		bounds.extend(surface.triangle.c);
+		(surface.floor ? stats.floor_triangles : stats.ceiling_triangles)++;
+	}
+
+	if (surfaces.empty())
+	{
+		stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+		return true;
+	}
+
+	origin_x = std::floor(bounds.min.x * inverse_size) * cell_size;
+	origin_y = std::floor(bounds.min.y * inverse_size) * cell_size;
+	double cells_x = std::floor((bounds.max.x - origin_x) * inverse_size) + 1.0;
+	double cells_y = std::floor((bounds.max.y - origin_y) * inverse_size) + 1.0;
+	if (cells_x * cells_y > kMaxCells)
+	{
+		std::cerr << "Heightfield of " << cells_x << "x" << cells_y << " cells is too large, use a larger cell size" << std::endl;
+		return false;
+	}
+	size_x = static_cast<size_t>(cells_x);
+	size_y = static_cast<size_t>(cells_y);
+	stats.size_x = size_x;
+	stats.size_y = size_y;
+
+	// Bin the surfaces into the tiles their bounds touch, counting first so the bins are one array.
+	const size_t tiles_x = (size_x + kTileSize - 1) / kTileSize, tiles_y = (size_y + kTileSize - 1) / kTileSize;
+	const size_t tile_count = tiles_x * tiles_y;
+	stats.tiles = tile_count;
+
+	std::vector<uint32_t> tile_starts(tile_count + 1, 0);
+	auto forEachTile = [&](const Triangle& tri, auto&& fn) {
+		size_t min_x, max_x, min_y, max_y;
+		if (!TileBuilder::getCellRange(tri, origin_x, origin_y, cell_size, size_x, size_y, min_x, max_x, min_y, max_y))
+			return;
+		for (size_t y = min_y / kTileSize; y <= max_y / kTileSize; y++)
+			for (size_t x = min_x / kTileSize; x <= max_x / kTileSize; x++)
+				fn(y * tiles_x + x);
+	};
+	for (const Surface& surface : surfaces)
+		forEachTile(surface.triangle, [&](size_t tile) { tile_starts[tile + 1]++; });
+	for (size_t i = 0; i < tile_count; i++)
+		tile_starts[i + 1] += tile_starts[i];
+
+	std::vector<uint32_t> refs(tile_starts[tile_count]);
+	{
+		std::vector<uint32_t> cursor(tile_starts.begin(), tile_starts.end() - 1);
+		for (size_t i = 0; i < surfaces.size(); i++)
+			forEachTile(surfaces[i].triangle, [&](size_t tile) { refs[cursor[tile]++] = static_cast<uint32_t>(i); });
+	}
+
+	// Rasterize the tiles in parallel; each keeps its merged layers until the offsets are known.
+	std::vector<TileBuilder> builders(threads);
+	std::vector<std::vector<Layer>> tile_floors(tile_count), tile_ceilings(tile_count);
+	parallelFor(tile_count, threads, [&](size_t tile, unsigned worker) {
+		TileBuilder& builder = builders[worker];
+		builder.build(surfaces, refs.data() + tile_starts[tile], tile_starts[tile + 1] - tile_starts[tile], options,
+			origin_x, origin_y, tile % tiles_x, tile / tiles_x, size_x, size_y);
+		tile_floors[tile] = builder.floors;
+		tile_ceilings[tile] = builder.ceilings;
+	});
+
+	// Count the layers of every cell, then prefix sum them into offsets.
+	const size_t cells = size_x * size_y;
+	floor_offset_storage.assign(cells + 1, 0);
+	ceiling_offset_storage.assign(cells + 1, 0);
+	auto toGlobal = [&](size_t tile, uint32_t local) {
+		size_t x = (tile % tiles_x) * kTileSize + local % kTileSize;
+		size_t y = (tile / tiles_x) * kTileSize + local / kTileSize;
+		return y * size_x + x;
+	};
+	parallelFor(tile_count, threads, [&](size_t tile, unsigned) {
+		for (const Layer& layer : tile_floors[tile])
+			floor_offset_storage[toGlobal(tile, layer.cell) + 1]++;
+		for (const Layer& layer : tile_ceilings[tile])
+			ceiling_offset_storage[toGlobal(tile, layer.cell) + 1]++;
+	});
+	for (size_t i = 0; i < cells; i++)
+	{
+		stats.max_layers = std::max<size_t>(stats.max_layers, floor_offset_storage[i + 1]);
+		floor_offset_storage[i + 1] += floor_offset_storage[i];
+		ceiling_offset_storage[i + 1] += ceiling_offset_storage[i];
+	}
+
+	// Layers of one cell are consecutive and ascending within a tile, so they copy straight across.
+	floor_storage.resize(floor_offset_storage[cells]);
+	ceiling_storage.resize(ceiling_offset_storage[cells]);
+	parallelFor(tile_count, threads, [&](size_t tile, unsigned) {
+		auto copy = [&](const std::vector<Layer>& layers, const std::vector<uint32_t>& offsets, std::vector<float>& heights) {
+			for (size_t i = 0; i < layers.size();)
+			{
+				size_t position = offsets[toGlobal(tile, layers[i].cell)];
+				uint32_t cell = layers[i].cell;
+				for (; i < layers.size() && layers[i].cell == cell; i++)
+					heights[position++] = layers[i].height;
+			}
+		};
+		copy(tile_floors[tile], floor_offset_storage, floor_storage);
+		copy(tile_ceilings[tile], ceiling_offset_storage, ceiling_storage);
+	});
+
+	floor_offsets = floor_offset_storage.data();
+	floors = floor_storage.data();
+	ceiling_offsets = ceiling_offset_storage.data();
+	ceilings = ceiling_storage.data();
+
+	stats.floor_layers = floor_storage.size();
+	stats.ceiling_layers = ceiling_storage.size();
+	stats.bytes = (floor_offset_storage.size() + ceiling_offset_storage.size()) * sizeof(uint32_t) +
+		(floor_storage.size() + ceiling_storage.size()) * sizeof(float);
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	return true;
+}
+
+bool cs2::Heightfield::write(const std::string& filename) const
+{
+	std::ofstream output(filename, std::ios::binary);
+	if (!output.is_open())
+	{
+		std::cerr << "Failed to open file: " << filename << std::endl;
+		return false;
+	}
+
+	// An empty heightfield is written as a single cell without layers.
+	const uint64_t cells = empty() ? 1 : static_cast<uint64_t>(size_x) * size_y;
+	const uint32_t no_layers[2] = { 0, 0 };
+	const uint32_t* floor_offsets_data = empty() ? no_layers : floor_offsets;
+	const uint32_t* ceiling_offsets_data = empty() ? no_layers : ceiling_offsets;
+
+	HeightfieldHeader header = {};
+	std::memcpy(header.magic, kHeightfieldMagic, 4);
+	header.version = kHeightfieldVersion;
+	header.endian_marker = kHeightfieldEndianMarker;
+	header.size[0] = empty() ? 1 : static_cast<uint32_t>(size_x);
+	header.size[1] = empty() ? 1 : static_cast<uint32_t>(size_y);
+	header.origin[0] = origin_x;
+	header.origin[1] = origin_y;
+	header.cell_size = cell_size;
+	header.walkable_normal = walkable_normal;
+	header.floor_count = floor_offsets_data[cells];
+	header.ceiling_count = ceiling_offsets_data[cells];
+
+	uint64_t offsets[5];
+	getSectionOffsets(cells, header.floor_count, header.ceiling_count, offsets);
+	header.file_size = offsets[4];
+
+	char padding[64] = {};
+	uint64_t written = 0;
+
+	auto write = [&](const void* data, uint64_t size) {
+		output.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		written += size;
+	};
+
+	auto padTo = [&](uint64_t target) {
+		write(padding, target - written);
+	};
+
+	write(&header, sizeof(header));
+	padTo(offsets[0]);
+	write(floor_offsets_data, (cells + 1) * sizeof(uint32_t));
+	padTo(offsets[1]);
+	write(floors, header.floor_count * sizeof(float));
+	padTo(offsets[2]);
+	write(ceiling_offsets_data, (cells + 1) * sizeof(uint32_t));
+	padTo(offsets[3]);
+	write(ceilings, header.ceiling_count * sizeof(float));
+
+	output.close();
+	if (!output)
+	{
+		std::cerr << "Failed to write file: " << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool cs2::Heightfield::open(const std::string& filename, std::string& error)
+{
+	floor_offsets = nullptr;
+	floors = nullptr;
+	ceiling_offsets = nullptr;
+	ceilings = nullptr;
+	floor_offset_storage.clear();
+	floor_storage.clear();
+	ceiling_offset_storage.clear();
+	ceiling_storage.clear();
+	size_x = size_y = 0;
+	stats = HeightfieldStats();
+
+	if (!file.open(filename))
+	{
+		error = "Failed to open file: " + filename;
+		return false;
+	}
+
+	uint64_t file_size = file.size();
+	const char* data = file.data();
+
+	if (file_size < sizeof(HeightfieldHeader) || std::memcmp(data, kHeightfieldMagic, 4) != 0)
+	{
+		error = "Not a heightfield: " + filename;
+		return false;
+	}
+
+	auto header = reinterpret_cast<const HeightfieldHeader*>(data);
+
+	if (header->version != kHeightfieldVersion)
+	{
+		error = "Unsupported heightfield version " + std::to_string(header->version) + ": " + filename;
+		return false;
+	}
+
+	if (header->endian_marker != kHeightfieldEndianMarker)
+	{
+		error = "Heightfield was written with a different byte order: " + filename;
+		return false;
+	}
+
+	const uint64_t cells = static_cast<uint64_t>(header->size[0]) * header->size[1];
+	uint64_t offsets[5] = {};
+	bool valid =
+		header->cell_size > 0.0f && std::isfinite(header->cell_size) &&
+		cells > 0 && cells <= kMaxCells &&
+		header->floor_count <= std::numeric_limits<uint32_t>::max() &&
+		header->ceiling_count <= std::numeric_limits<uint32_t>::max() &&
+		header->file_size == file_size;
+	if (valid)
+	{
+		getSectionOffsets(cells, header->floor_count, header->ceiling_count, offsets);
+		valid = offsets[4] == file_size &&
+			isValidOffsets(reinterpret_cast<const uint32_t*>(data + offsets[0]), cells, header->floor_count) &&
+			isValidOffsets(reinterpret_cast<const uint32_t*>(data + offsets[2]), cells, header->ceiling_count);
+	}
+
+	if (!valid)
+	{
+		error = "Corrupt heightfield: " + filename;
+		return false;
+	}
+
+	size_x = header->size[0];
+	size_y = header->size[1];
+	origin_x = header->origin[0];
+	origin_y = header->origin[1];
+	cell_size = header->cell_size;
+	inverse_size = 1.0f / cell_size;
+	walkable_normal = header->walkable_normal;
+	floor_offsets = reinterpret_cast<const uint32_t*>(data + offsets[0]);
+	floors = reinterpret_cast<const float*>(data + offsets[1]);
+	ceiling_offsets = reinterpret_cast<const uint32_t*>(data + offsets[2]);
+	ceilings = reinterpret_cast<const float*>(data + offsets[3]);
+
+	stats.size_x = size_x;
+	stats.size_y = size_y;
+	stats.floor_layers = header->floor_count;
+	stats.ceiling_layers = header->ceiling_count;
+	stats.bytes = file_size;
+	return true;
+}
+
+bool cs2::Heightfield::toCell(float x, float y, size_t& cell) const
+{
+	float local_x = (x - origin_x) * inverse_size;
+	float local_y = (y - origin_y) * inverse_size;
+	// Written so NaN coordinates fail too.
+	if (!(local_x >= 0.0f && local_x < static_cast<float>(size_x) && local_y >= 0.0f && local_y < static_cast<float>(size_y)))
+		return false;
+
+	// Rounding can put a point just below the far edge into the cell past it.
+	size_t cell_x = std::min(static_cast<size_t>(local_x), size_x - 1);
+	size_t cell_y = std::min(static_cast<size_t>(local_y), size_y - 1);
+	cell = cell_y * size_x + cell_x;
+	return true;
+}
+
+bool cs2::Heightfield::getFloor(const Vec3& point, float& height, float tolerance) const
+{
+	size_t cell;
+	if (empty() || !toCell(point.x, point.y, cell))
+		return false;
+
+	for (uint32_t i = floor_offsets[cell + 1]; i > floor_offsets[cell]; i--)
+	{
+		if (floors[i - 1] <= point.z + tolerance)
+		{
+			height = floors[i - 1];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool cs2::Heightfield::getCeiling(const Vec3& point, float& height, float tolerance) const
+{
+	size_t cell;
+	if (empty() || !toCell(point.x, point.y, cell))
+		return false;
+
+	for (uint32_t i = ceiling_offsets[cell]; i < ceiling_offsets[cell + 1]; i++)
+	{
+		if (ceilings[i] >= point.z - tolerance)
+		{
+			height = ceilings[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+std::span<const float> cs2::Heightfield::getFloors(float x, float y) const
+{
+	size_t cell;
+	if (empty() || !toCell(x, y, cell))
+		return {};
+	return std::span<const float>(floors + floor_offsets[cell], floor_offsets[cell + 1] - floor_offsets[cell]);
+}
+
+std::span<const float> cs2::Heightfield::getCeilings(float x, float y) const
+{
+	size_t cell;
+	if (empty() || !toCell(x, y, cell))
+		return {};
+	return std::span<const float>(ceilings + ceiling_offsets[cell], ceiling_offsets[cell + 1] - ceiling_offsets[cell]);
+}
+
+void cs2::Heightfield::displayStats() const
+{
+	std::cout << "Heightfield: " << stats.size_x << "x" << stats.size_y << " cells of " << cell_size << " units (" << stats.tiles << " tiles)" << std::endl;
+	std::cout << "Heightfield Triangles: " << stats.floor_triangles << " floors, " << stats.ceiling_triangles << " ceilings" << std::endl;
+	std::cout << "Heightfield Layers: " << stats.floor_layers << " floors, " << stats.ceiling_layers << " ceilings, at most "
+		<< stats.max_layers << " floors per cell" << std::endl;
+	std::cout << "Heightfield Memory: " << stats.bytes / 1024 << " KB" << std::endl;
+	std::cout << "Heightfield Build Time: " << stats.seconds * 1000.0 << " ms" << std::endl;
+	std::cout << std::endl;
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "parser.h"
+
+namespace cs2
+{
+	// Heightfield file layout, in the byte order recorded by the endian marker.
+	// Every section starts on a 64-byte boundary, in this order:
+	//
+	//   HeightfieldHeader                 64 bytes
+	//   floor offsets                     uint32 per cell plus one, cells in x, y order
+	//   floors                            float per layer, ascending within a cell
+	//   ceiling offsets                   uint32 per cell plus one
+	//   ceilings                          float per layer, ascending within a cell
+	constexpr char kHeightfieldMagic[4] = { 'C', 'S', '2', 'H' };
+	constexpr uint32_t kHeightfieldVersion = 1;
+	constexpr uint32_t kHeightfieldEndianMarker = 0x01020304;
+
+	struct HeightfieldHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t endian_marker;
+		uint32_t reserved;
+		uint32_t size[2];
+		float origin[2];
+		float cell_size;
+		float walkable_normal;
+		uint64_t floor_count;
+		uint64_t ceiling_count;
+		uint64_t file_size;
+	};
+
+	static_assert(sizeof(HeightfieldHeader) == 64, "HeightfieldHeader must fill its 64-byte slot");
+
+	class HeightfieldOptions {
+	public:
+		// Number of threads rasterizing tiles, zero for one per hardware thread.
+		unsigned threads = 1;
+		// Edge length of a cell in map units.
+		float cell_size = 16.0f;
+		// Smallest normal z of a floor; 0.7 is the steepest slope a player can stand on.
+		float walkable_normal = 0.7f;
+		// Surfaces of one cell closer together than this are one layer.
+		float merge_height = 2.0f;
+	};
+
+	class HeightfieldStats {
+	public:
+		size_t floor_triangles = 0;
+		size_t ceiling_triangles = 0;
+		size_t size_x = 0, size_y = 0;
+		size_t tiles = 0;
+		size_t floor_layers = 0;
+		size_t ceiling_layers = 0;
+		// Most floor layers in one cell.
+		size_t max_layers = 0;
+		size_t bytes = 0;
+		double seconds = 0.0;
+	};
+
+	/// <summary>
+	/// Layered 2.5D heightfield of the floors and ceilings of a map, for the
+	/// height of the ground under a position without touching the geometry.
+	/// Each cell of a grid over the map's x and y holds the heights of every
+	/// floor and every ceiling crossing it, so multi-storey areas keep one
+	/// layer per storey.
+	///
+	/// Floors are triangles facing up at least walkable_normal, ceilings are
+	/// triangles facing down. A triangle is clipped to each cell it covers;
+	/// a floor layer is the highest point of its surfaces in the cell and a
+	/// ceiling layer the lowest, so a floor is never reported below the ground
+	/// or a ceiling above the roof. On slopes a point can therefore sit up to
+	/// a cell's rise below its floor, which the queries' tolerance absorbs.
+	///
+	/// The grid is rasterized in parallel over tiles of cells and can be
+	/// written next to the geometry cache and mapped back without copying.
+	/// </summary>
+	class Heightfield {
+	public:
+		// Cells along each side of a tile.
+		static constexpr size_t kTileSize = 64;
+
+		/// <summary>
+		/// Rasterize the floors and ceilings of every hull of a physics file.
+		/// </summary>
+		/// <returns>
+		/// Returns false if the options are invalid or the grid would be too large.
+		/// </returns>
+		bool build(const PhysicsFile& physics, const HeightfieldOptions& options = HeightfieldOptions());
+
+		/// <summary>
+		/// Write the heightfield to a file that open can map.
+		/// </summary>
+		bool write(const std::string& filename) const;
+
+		/// <summary>
+		/// Map and validate a heightfield file written by write.
+		/// </summary>
+		/// <param name="error">
+		/// Receives a description of the failure, if any.
+		/// </param>
+		bool open(const std::string& filename, std::string& error);
+
+		/// <summary>
+		/// Find the floor under a point: the highest floor layer of its cell at
+		/// most tolerance above it.
+		/// </summary>
+		/// <param name="height">
+		/// Receives the height of the floor.
+		/// </param>
+		/// <returns>
+		/// Returns false if the point is outside the grid or has no floor under it.
+		/// </returns>
+		bool getFloor(const Vec3& point, float& height, float tolerance = 0.0f) const;
+
+		/// <summary>
+		/// Find the ceiling above a point: the lowest ceiling layer of its cell
+		/// at most tolerance below it.
+		/// </summary>
+		/// <returns>
+		/// Returns false if the point is outside the grid or has no ceiling above it.
+		/// </returns>
+		bool getCeiling(const Vec3& point, float& height, float tolerance = 0.0f) const;
+
+		/// <summary>
+		/// Get every floor layer of the cell holding a point, lowest first.
+		/// </summary>
+		std::span<const float> getFloors(float x, float y) const;
+
+		/// <summary>
+		/// Get every ceiling layer of the cell holding a point, lowest first.
+		/// </summary>
+		std::span<const float> getCeilings(float x, float y) const;
+
+		float getCellSize() const { return cell_size; }
+		size_t getSizeX() const { return size_x; }
+		size_t getSizeY() const { return size_y; }
+		bool empty() const { return floor_offsets == nullptr; }
+
+		const HeightfieldStats& getStats() const { return stats; }
+
+		/// <summary>
+		/// Display the build statistics.
+		/// </summary>
+		void displayStats() const;
+
+	private:
+		// Layers of cell i are [offsets[i], offsets[i + 1]), in storage or in the mapped file.
+		const uint32_t* floor_offsets = nullptr;
+		const float* floors = nullptr;
+		const uint32_t* ceiling_offsets = nullptr;
+		const float* ceilings = nullptr;
+		std::vector<uint32_t> floor_offset_storage;
+		std::vector<float> floor_storage;
+		std::vector<uint32_t> ceiling_offset_storage;
+		std::vector<float> ceiling_storage;
+		MappedFile file;
+
+		size_t size_x = 0, size_y = 0;
+		float origin_x = 0.0f, origin_y = 0.0f;
+		float cell_size = 0.0f;
+		float inverse_size = 0.0f;
+		float walkable_normal = 0.0f;
+		HeightfieldStats stats;
+
+		// Index of the cell holding a point, or false if it is outside the grid.
+		bool toCell(float x, float y, size_t& cell) const;
+	};
+} // namespace cs2
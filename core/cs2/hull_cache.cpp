@@ -0,0 +1,208 @@
+#include "hull_cache.h"
+#include "cache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	const char* kIndexName = "index.txt";
+
+	// Temporary files carry a random token drawn once per process and a counter,
+	// so processes sharing a cache directory never write to the same file.
+	std::string getTempSuffix()
+	{
+		static const std::string token = [] {
+			std::random_device device;
+			char text[20];
+			std::snprintf(text, sizeof(text), "%08x%08x", device(), device());
+			return std::string(text);
+		}();
+		static std::atomic<uint32_t> counter = 0;
+		return "." + token + "." + std::to_string(counter++) + ".tmp";
+	}
+
+	// Entries differ per representation, so one directory can serve every load mode.
+	char getModeTag(const cs2::LoadOptions& options)
+	{
+		if (options.quantized)
+			return 'q';
+		return options.indexed ? 'i' : 't';
+	}
+}
+
+bool cs2::HullCache::open(const std::string& directory, std::string& error)
+{
+	this->directory = directory;
+	this->index.clear();
+	this->dirty = false;
+
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	if (!std::filesystem::is_directory(directory, ec))
+	{
+		error = "Failed to create cache directory: " + directory;
+		return false;
+	}
+
+	// A missing index is an empty cache.
+	std::ifstream file(directory + "/" + kIndexName);
+	if (!file.is_open())
+		return true;
+
+	// First line is the version, then "hash size mtime path" per source file.
+	uint32_t version = 0;
+	if (!(file >> version) || version != kHullCacheVersion)
+		return true;
+
+	std::string line;
+	std::getline(file, line);
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		HullCacheEntry entry;
+		std::string path;
+		if (!(stream >> std::hex >> entry.hash >> std::dec >> entry.size >> entry.mtime))
+			continue;
+		stream >> std::ws;
+		std::getline(stream, path);
+		if (!path.empty())
+			index[path] = entry;
+	}
+
+	return true;
+}
+
+bool cs2::HullCache::findHash(const std::string& path, uint64_t size, int64_t mtime, uint64_t& hash) const
+{
+	std::shared_lock<std::shared_mutex> lock(index_mutex);
+
+	auto it = index.find(path);
+	if (it == index.end() || it->second.size != size || it->second.mtime != mtime)
+		return false;
+
+	hash = it->second.hash;
+	return true;
+}
+
+void cs2::HullCache::update(const std::string& path, const HullCacheEntry& entry)
+{
+	std::unique_lock<std::shared_mutex> lock(index_mutex);
+
+	auto it = index.find(path);
+	if (it != index.end() && it->second.size == entry.size && it->second.mtime == entry.mtime && it->second.hash == entry.hash)
+		return;
+
+	index[path] = entry;
+	dirty = true;
+}
+
+std::string cs2::HullCache::getEntryPath(uint64_t hash, const LoadOptions& options) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx%c%u.cs2c", static_cast<unsigned long long>(hash), getModeTag(options), kHullCacheVersion);
+	return directory + "/" + name;
+}
+
+bool cs2::HullCache::load(uint64_t hash, const LoadOptions& options, HullFile& hull, LoadStats& hullStats) const
+{
+	std::string path = getEntryPath(hash, options);
+
+	GeometryCache cache;
+	std::string error;
+	if (!cache.open(path, error) || cache.getHullCount() != 1)
+		return false;
+
+	CachedHull cached = cache.getHull(0);
+	if (cached.isQuantized() != options.quantized)
+		return false;
+
+	std::error_code ec;
+	hullStats.bytes_mapped += std::filesystem::file_size(path, ec);
+
+	if (cached.isQuantized())
+	{
+		hull.quantized.bounds = cached.quantized.bounds;
+		hull.quantized.positions.assign(cached.quantized.positions.begin(), cached.quantized.positions.end());
+		hull.quantized.indices.assign(cached.quantized.indices.begin(), cached.quantized.indices.end());
+		hull.quantized.index_count = cached.quantized.index_count;
+		hull.quantized.error = cached.quantized.error;
+		hullStats.bytes_copied += cached.quantized.positions.size_bytes() + cached.quantized.indices.size_bytes();
+	}
+	else if (options.indexed)
+	{
+		hull.vertices.assign(cached.vertices.begin(), cached.vertices.end());
+		hull.indices16.assign(cached.indices16.begin(), cached.indices16.end());
+		hull.indices32.assign(cached.indices32.begin(), cached.indices32.end());
+		hullStats.bytes_copied += cached.vertices.size_bytes() + cached.indices16.size_bytes() + cached.indices32.size_bytes();
+	}
+	else
+	{
+		TriangleView view = cached.getTriangles();
+		hull.triangles.assign(view.begin(), view.end());
+		hullStats.bytes_copied += hull.triangles.size() * sizeof(Triangle);
+	}
+
+	return true;
+}
+
+bool cs2::HullCache::store(uint64_t hash, const LoadOptions& options, const HullFile& hull) const
+{
+	// Write under a name no other writer uses, then rename it into place, so
+	// readers see a whole entry as far as the file system renames atomically.
+	std::string path = getEntryPath(hash, options);
+	std::string temp_path = path + getTempSuffix();
+
+	if (!writeGeometryCache(temp_path, "", std::span<const HullFile>(&hull, 1)))
+		return false;
+
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+
+	return true;
+}
+
+bool cs2::HullCache::writeIndex(std::string& error)
+{
+	if (!dirty)
+		return true;
+
+	std::string path = directory + "/" + kIndexName;
+	std::string temp_path = path + getTempSuffix();
+
+	std::ofstream file(temp_path);
+	if (!file.is_open())
+	{
+		error = "Failed to open file: " + temp_path;
+		return false;
+	}
+
+	file << kHullCacheVersion << "\n";
+	for (auto& [source, entry] : index)
+		file << std::hex << entry.hash << std::dec << " " << entry.size << " " << entry.mtime << " " << source << "\n";
+
+	file.close();
+	if (!file)
+	{
+		error = "Failed to write file: " + temp_path;
+		return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		error = "Failed to replace file: " + path;
+		return false;
+	}
+
+	dirty = false;
+	return true;
+}
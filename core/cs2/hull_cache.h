@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "parser.h"
+
+namespace cs2
+{
+	// Bump when parsing changes the geometry it produces, so stale entries are ignored.
+	constexpr uint32_t kHullCacheVersion = 1;
+
+	class HullCacheEntry {
+	public:
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		uint64_t hash = 0;
+	};
+
+	/// <summary>
+	/// Persistent parse cache for hull files. Parsed geometry is stored per hull
+	/// in a geometry cache file named after the content hash of the source file,
+	/// so a changed hull only invalidates itself and identical hulls share an
+	/// entry. An index of size, mtime and hash per source path records which
+	/// entry each file last produced, so a file whose size and mtime are
+	/// unchanged is not hashed again. A file rewritten to the same size within
+	/// the mtime resolution of the file system is therefore not noticed.
+	/// </summary>
+	class HullCache {
+	public:
+		/// <summary>
+		/// Open a cache directory, creating it if needed, and read its index.
+		/// </summary>
+		/// <param name="directory">
+		/// The directory holding the index and the entries.
+		/// </param>
+		/// <param name="error">
+		/// Receives a description of the failure, if any.
+		/// </param>
+		/// <returns>
+		/// Returns true if the directory is usable, false otherwise.
+		/// </returns>
+		bool open(const std::string& directory, std::string& error);
+
+		/// <summary>
+		/// Get the indexed hash of a source file if its size and mtime are unchanged.
+		/// Thread-safe.
+		/// </summary>
+		bool findHash(const std::string& path, uint64_t size, int64_t mtime, uint64_t& hash) const;
+
+		/// <summary>
+		/// Record the hash of a source file for the next run. Thread-safe.
+		/// </summary>
+		void update(const std::string& path, const HullCacheEntry& entry);
+
+		/// <summary>
+		/// Load cached geometry for a content hash into hull, in the representation
+		/// requested by options. The name and surface_prop of hull are kept.
+		/// </summary>
+		/// <returns>
+		/// Returns false if there is no usable entry.
+		/// </returns>
+		bool load(uint64_t hash, const LoadOptions& options, HullFile& hull, LoadStats& hullStats) const;
+
+		/// <summary>
+		/// Store the geometry of hull under a content hash. Thread-safe.
+		/// </summary>
+		bool store(uint64_t hash, const LoadOptions& options, const HullFile& hull) const;
+
+		/// <summary>
+		/// Write the index back to the cache directory if it changed.
+		/// </summary>
+		bool writeIndex(std::string& error);
+
+	private:
+		std::string directory;
+		std::unordered_map<std::string, HullCacheEntry> index;
+		// Shared by findHash, exclusive for update.
+		mutable std::shared_mutex index_mutex;
+		bool dirty = false;
+
+		std::string getEntryPath(uint64_t hash, const LoadOptions& options) const;
+	};
+} // namespace cs2
@@ -0,0 +1,353 @@
+#include "kv3.h"
+
+namespace
+{
+	bool isWordEnd(char c)
+	{
+		switch (c)
+		{
+		case ' ': case '\t': case '\r': case '\n':
+		case '{': case '}': case '[': case ']':
+		case '=': case ',': case '"':
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	class Kv3Parser {
+	public:
+		Kv3Parser(std::string_view input, cs2::Kv3Handler& handler) : lexer(input), handler(handler) {}
+
+		bool parseDocument();
+
+		std::string error;
+
+	private:
+		cs2::Kv3Lexer lexer;
+		cs2::Kv3Handler& handler;
+
+		bool fail(const char* message);
+
+		bool parseValue(cs2::Kv3Token token, std::string_view text, std::string_view type);
+		bool parseMember(std::string_view name);
+		bool parseObjectBody();
+		bool parseArrayBody();
+	};
+}
+
+cs2::Kv3Token cs2::Kv3Lexer::next(std::string_view& text)
+{
+	if (peeked)
+	{
+		peeked = false;
+		text = peeked_text;
+		return peeked_token;
+	}
+
+	return lex(text);
+}
+
+cs2::Kv3Token cs2::Kv3Lexer::peek(std::string_view& text)
+{
+	if (!peeked)
+	{
+		peeked_token = lex(peeked_text);
+		peeked = true;
+	}
+
+	text = peeked_text;
+	return peeked_token;
+}
+
+bool cs2::Kv3Lexer::skipWhitespaceAndComments()
+{
+	while (position < input.size())
+	{
+		char c = input[position];
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+		{
+			position++;
+			continue;
+		}
+
+		std::string_view rest = input.substr(position);
+		size_t end;
+
+		if (rest.starts_with("//"))
+		{
+			end = rest.find('\n');
+			position = end == std::string_view::npos ? input.size() : position + end + 1;
+		}
+		else if (rest.starts_with("/*"))
+		{
+			end = rest.find("*/", 2);
+			if (end == std::string_view::npos)
+				return false;
+			position += end + 2;
+		}
+		else if (rest.starts_with("<!--"))
+		{
+			end = rest.find("-->", 4);
+			if (end == std::string_view::npos)
+				return false;
+			position += end + 3;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return true;
+}
+
+cs2::Kv3Token cs2::Kv3Lexer::lex(std::string_view& text)
+{
+	text = {};
+
+	if (!skipWhitespaceAndComments())
+		return Kv3Token::Error;
+
+	if (position >= input.size())
+		return Kv3Token::End;
+
+	size_t start = position;
+
+	switch (input[position])
+	{
+	case '{': position++; return Kv3Token::BeginObject;
+	case '}': position++; return Kv3Token::EndObject;
+	case '[': position++; return Kv3Token::BeginArray;
+	case ']': position++; return Kv3Token::EndArray;
+	case '=': position++; return Kv3Token::Equals;
+	case ',': position++; return Kv3Token::Comma;
+
+	case '"':
+	{
+		// Multi-line strings are wrapped in triple quotes and have no escapes.
+		if (input.substr(position).starts_with("\"\"\""))
+		{
+			size_t end = input.find("\"\"\"", position + 3);
+			if (end == std::string_view::npos)
+				return Kv3Token::Error;
+			text = input.substr(position + 3, end - position - 3);
+			position = end + 3;
+			return Kv3Token::String;
+		}
+
+		size_t i = position + 1;
+		while (i < input.size() && input[i] != '"')
+			i += input[i] == '\\' ? 2 : 1;
+
+		if (i >= input.size())
+			return Kv3Token::Error;
+
+		text = input.substr(position + 1, i - position - 1);
+		position = i + 1;
+		return Kv3Token::String;
+	}
+
+	case '#':
+		if (position + 1 < input.size() && input[position + 1] == '[')
+		{
+			size_t end = input.find(']', position + 2);
+			if (end == std::string_view::npos)
+				return Kv3Token::Error;
+			text = input.substr(position + 2, end - position - 2);
+			position = end + 1;
+			return Kv3Token::Blob;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	while (position < input.size() && !isWordEnd(input[position]))
+		position++;
+
+	text = input.substr(start, position - start);
+	return Kv3Token::Word;
+}
+
+bool Kv3Parser::fail(const char* message)
+{
+	if (error.empty())
+		error = std::string(message) + " at offset " + std::to_string(lexer.offset());
+	return false;
+}
+
+bool Kv3Parser::parseDocument()
+{
+	for (;;)
+	{
+		std::string_view text;
+		cs2::Kv3Token token = lexer.next(text);
+
+		if (token == cs2::Kv3Token::End)
+			return true;
+		if (token == cs2::Kv3Token::Comma)
+			continue;
+		if (!parseValue(token, text, {}))
+			return false;
+	}
+}
+
+bool Kv3Parser::parseValue(cs2::Kv3Token token, std::string_view text, std::string_view type)
+{
+	switch (token)
+	{
+	case cs2::Kv3Token::BeginObject:
+		handler.beginObject(type);
+		return parseObjectBody();
+
+	case cs2::Kv3Token::BeginArray:
+		handler.beginArray(type);
+		return parseArrayBody();
+
+	case cs2::Kv3Token::String:
+	{
+		// KV2 elements are written as "DmeType" { ... }, with the type in front.
+		if (type.empty())
+		{
+			std::string_view next_text;
+			cs2::Kv3Token next = lexer.peek(next_text);
+			if (next == cs2::Kv3Token::BeginObject || next == cs2::Kv3Token::BeginArray)
+			{
+				lexer.next(next_text);
+				return parseValue(next, next_text, text);
+			}
+		}
+
+		handler.value(text, type);
+		return true;
+	}
+
+	case cs2::Kv3Token::Word:
+	{
+		// KV3 flags such as resource_name:"..." prefix the value they apply to.
+		if (text.size() > 1 && text.back() == ':')
+		{
+			std::string_view value_text;
+			cs2::Kv3Token value_token = lexer.next(value_text);
+			return parseValue(value_token, value_text, text.substr(0, text.size() - 1));
+		}
+
+		handler.value(text, type);
+		return true;
+	}
+
+	case cs2::Kv3Token::Blob:
+		handler.value(text, "binary");
+		return true;
+
+	case cs2::Kv3Token::Error:
+		return fail("Unterminated string or comment");
+
+	case cs2::Kv3Token::End:
+		return fail("Unexpected end of input");
+
+	default:
+		return fail("Unexpected token");
+	}
+}
+
+bool Kv3Parser::parseMember(std::string_view name)
+{
+	handler.key(name);
+
+	std::string_view text;
+	cs2::Kv3Token token = lexer.next(text);
+
+	// KV3: key = value
+	if (token == cs2::Kv3Token::Equals)
+	{
+		token = lexer.next(text);
+		return parseValue(token, text, {});
+	}
+
+	// KV2: "key" "type" value
+	if (token == cs2::Kv3Token::String)
+	{
+		std::string_view type = text;
+		token = lexer.next(text);
+		if (token == cs2::Kv3Token::String)
+		{
+			handler.value(text, type);
+			return true;
+		}
+		return parseValue(token, text, type);
+	}
+
+	return fail("Expected '=' or a type after key");
+}
+
+bool Kv3Parser::parseObjectBody()
+{
+	for (;;)
+	{
+		std::string_view text;
+		cs2::Kv3Token token = lexer.next(text);
+
+		switch (token)
+		{
+		case cs2::Kv3Token::EndObject:
+			handler.endObject();
+			return true;
+
+		case cs2::Kv3Token::Comma:
+			continue;
+
+		case cs2::Kv3Token::String:
+		case cs2::Kv3Token::Word:
+			if (!parseMember(text))
+				return false;
+			continue;
+
+		case cs2::Kv3Token::End:
+			return fail("Unterminated object");
+
+		case cs2::Kv3Token::Error:
+			return fail("Unterminated string or comment");
+
+		default:
+			return fail("Expected a key");
+		}
+	}
+}
+
+bool Kv3Parser::parseArrayBody()
+{
+	for (;;)
+	{
+		std::string_view text;
+		cs2::Kv3Token token = lexer.next(text);
+
+		if (token == cs2::Kv3Token::EndArray)
+		{
+			handler.endArray();
+			return true;
+		}
+
+		if (token == cs2::Kv3Token::Comma)
+			continue;
+
+		if (token == cs2::Kv3Token::End)
+			return fail("Unterminated array");
+
+		if (!parseValue(token, text, {}))
+			return false;
+	}
+}
+
+bool cs2::parseKv3(std::string_view input, Kv3Handler& handler, std::string* error)
+{
+	Kv3Parser parser(input, handler);
+	bool result = parser.parseDocument();
+
+	if (!result && error)
+		*error = parser.error;
+
+	return result;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace cs2
+{
+	enum class Kv3Token {
+		End,
+		Error,
+		String,
+		Word,
+		Blob,
+		Equals,
+		Comma,
+		BeginObject,
+		EndObject,
+		BeginArray,
+		EndArray,
+	};
+
+	/// <summary>
+	/// Tokenizer for KeyValues text, covering both the KV3 syntax used by .vmdl
+	/// files (key = value) and the KeyValues2 syntax used by .dmx files
+	/// ("key" "type" value). Every byte is looked at once and token text is a
+	/// view into the input.
+	/// </summary>
+	class Kv3Lexer {
+	public:
+		explicit Kv3Lexer(std::string_view input) : input(input) {}
+
+		/// <summary>
+		/// Read the next token.
+		/// </summary>
+		/// <param name="text">
+		/// Receives the token text. Strings are returned without their quotes and
+		/// blobs without the surrounding #[ ].
+		/// </param>
+		/// <returns>
+		/// Returns the kind of the token.
+		/// </returns>
+		Kv3Token next(std::string_view& text);
+
+		/// <summary>
+		/// Look at the next token without consuming it.
+		/// </summary>
+		Kv3Token peek(std::string_view& text);
+
+		size_t offset() const { return position; }
+
+	private:
+		std::string_view input;
+		size_t position = 0;
+
+		bool peeked = false;
+		Kv3Token peeked_token = Kv3Token::End;
+		std::string_view peeked_text;
+
+		Kv3Token lex(std::string_view& text);
+		bool skipWhitespaceAndComments();
+	};
+
+	/// <summary>
+	/// Receives the events of a streaming KeyValues parse. Views passed to the
+	/// handler point into the parsed text.
+	/// </summary>
+	class Kv3Handler {
+	public:
+		virtual ~Kv3Handler() = default;
+
+		// Called before the value of an object member.
+		virtual void key(std::string_view /*name*/) {}
+
+		// A scalar. type is the KV2 attribute type or the KV3 flag, empty otherwise.
+		virtual void value(std::string_view /*text*/, std::string_view /*type*/) {}
+
+		// type is the KV2 element type (e.g. "DmeMesh") or the KV3 flag, empty otherwise.
+		virtual void beginObject(std::string_view /*type*/) {}
+		virtual void endObject() {}
+
+		// type is the KV2 array type (e.g. "vector3_array"), empty for KV3 arrays.
+		virtual void beginArray(std::string_view /*type*/) {}
+		virtual void endArray() {}
+	};
+
+	/// <summary>
+	/// Parse KeyValues text in a single pass, emitting events to a handler.
+	/// </summary>
+	/// <param name="input">
+	/// The text to parse.
+	/// </param>
+	/// <param name="handler">
+	/// The handler receiving the events.
+	/// </param>
+	/// <param name="error">
+	/// Receives a description of the first syntax error, if any.
+	/// </param>
+	/// <returns>
+	/// Returns true if the whole input was parsed, false otherwise.
+	/// </returns>
+	bool parseKv3(std::string_view input, Kv3Handler& handler, std::string* error = nullptr);
+} // namespace cs2
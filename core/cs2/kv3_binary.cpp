@@ -0,0 +1,905 @@
+#include "kv3_binary.h"
+
+#include <cstring>
+
+namespace
+{
+	constexpr uint32_t kMagicLegacy = 0x03564B56; // "VKV\x03"
+	constexpr uint32_t kMagicVersioned = 0x4B563300; // "\x0?3VK", low byte is the version
+	constexpr uint32_t kBlobTrailer = 0xFFEEDD00;
+
+	constexpr uint8_t kEncodingBlockCompressed[16] = { 0x46, 0x1A, 0x79, 0x95, 0xBC, 0x95, 0x6C, 0x4F, 0xA7, 0x0B, 0x05, 0xBC, 0xA1, 0xB7, 0xDF, 0xD2 };
+	constexpr uint8_t kEncodingUncompressed[16] = { 0x00, 0x05, 0x86, 0x1B, 0xD8, 0xF7, 0xC1, 0x40, 0xAD, 0x82, 0x75, 0xA4, 0x82, 0x67, 0xE7, 0x14 };
+	constexpr uint8_t kEncodingLz4[16] = { 0x8A, 0x34, 0x47, 0x68, 0xA1, 0x63, 0x5C, 0x4F, 0xA1, 0x97, 0x53, 0x80, 0x6F, 0xD9, 0xB1, 0x19 };
+
+	enum WireType : uint8_t {
+		WireStringMulti = 0,
+		WireNull = 1,
+		WireBoolean = 2,
+		WireInt64 = 3,
+		WireUInt64 = 4,
+		WireDouble = 5,
+		WireString = 6,
+		WireBlob = 7,
+		WireArray = 8,
+		WireObject = 9,
+		WireArrayTyped = 10,
+		WireInt32 = 11,
+		WireUInt32 = 12,
+		WireTrue = 13,
+		WireFalse = 14,
+		WireInt64Zero = 15,
+		WireInt64One = 16,
+		WireDoubleZero = 17,
+		WireDoubleOne = 18,
+		WireFloat = 19,
+		WireInt16 = 20,
+		WireUInt16 = 21,
+		WireInt32AsByte = 23,
+		WireArrayTypedByteLength = 24,
+	};
+
+	// Bounds checked little-endian reader over a byte range.
+	class Cursor {
+	public:
+		Cursor() = default;
+		Cursor(const uint8_t* begin, const uint8_t* end) : p(begin), end(end) {}
+
+		const uint8_t* p = nullptr;
+		const uint8_t* end = nullptr;
+
+		size_t remaining() const { return static_cast<size_t>(end - p); }
+
+		template <typename T>
+		bool read(T& value)
+		{
+			if (remaining() < sizeof(T))
+				return false;
+			std::memcpy(&value, p, sizeof(T));
+			p += sizeof(T);
+			return true;
+		}
+
+		bool bytes(size_t count, const uint8_t*& out)
+		{
+			if (remaining() < count)
+				return false;
+			out = p;
+			p += count;
+			return true;
+		}
+	};
+
+	// The streams a value is decoded from. The legacy encoding interleaves
+	// everything in one stream; the versioned encodings split types, bytes,
+	// 4-byte and 8-byte values into separate regions of the buffer.
+	class ValueReader {
+	public:
+		Cursor* types = nullptr;
+		Cursor* bytes = nullptr;
+		Cursor* ints = nullptr;
+		Cursor* eights = nullptr;
+		Cursor* two_bytes = nullptr;
+		Cursor* blob_data = nullptr;
+
+		// Versioned encodings keep blob lengths in a table, the legacy one inline.
+		const uint8_t* blob_lengths = nullptr;
+		size_t blob_count = 0;
+		size_t blob_index = 0;
+
+		std::vector<std::string_view> strings;
+
+		int depth = 0;
+		std::string error;
+
+		bool readType(uint8_t& type)
+		{
+			uint8_t flags = 0;
+			if (!types->read(type))
+				return fail("Truncated type stream");
+			if (type & 0x80)
+			{
+				type &= 0x3F;
+				if (!types->read(flags))
+					return fail("Truncated type stream");
+			}
+			return true;
+		}
+
+		bool readValue(uint8_t type, cs2::Kv3Value& value)
+		{
+			switch (type)
+			{
+			case WireNull:
+				value.type = cs2::Kv3Type::Null;
+				return true;
+
+			case WireBoolean:
+			{
+				uint8_t b = 0;
+				if (!bytes->read(b))
+					return fail("Truncated byte stream");
+				value.type = cs2::Kv3Type::Bool;
+				value.boolean = b != 0;
+				return true;
+			}
+
+			case WireTrue:
+			case WireFalse:
+				value.type = cs2::Kv3Type::Bool;
+				value.boolean = type == WireTrue;
+				return true;
+
+			case WireInt64:
+			case WireUInt64:
+			case WireDouble:
+				value.type = type == WireInt64 ? cs2::Kv3Type::Int : type == WireUInt64 ? cs2::Kv3Type::UInt : cs2::Kv3Type::Double;
+				if (!eights->read(value.unsigned_integer))
+					return fail("Truncated 8-byte stream");
+				return true;
+
+			case WireInt64Zero:
+			case WireInt64One:
+				value.type = cs2::Kv3Type::Int;
+				value.integer = type == WireInt64One ? 1 : 0;
+				return true;
+
+			case WireDoubleZero:
+			case WireDoubleOne:
+				value.type = cs2::Kv3Type::Double;
+				value.floating = type == WireDoubleOne ? 1.0 : 0.0;
+				return true;
+
+			case WireInt32:
+			{
+				int32_t v = 0;
+				if (!ints->read(v))
+					return fail("Truncated 4-byte stream");
+				value.type = cs2::Kv3Type::Int;
+				value.integer = v;
+				return true;
+			}
+
+			case WireUInt32:
+			{
+				uint32_t v = 0;
+				if (!ints->read(v))
+					return fail("Truncated 4-byte stream");
+				value.type = cs2::Kv3Type::UInt;
+				value.unsigned_integer = v;
+				return true;
+			}
+
+			case WireFloat:
+			{
+				float v = 0.0f;
+				if (!ints->read(v))
+					return fail("Truncated 4-byte stream");
+				value.type = cs2::Kv3Type::Double;
+				value.floating = v;
+				return true;
+			}
+
+			case WireInt16:
+			case WireUInt16:
+			{
+				Cursor* stream = two_bytes ? two_bytes : ints;
+				uint16_t v = 0;
+				if (!stream->read(v))
+					return fail("Truncated 2-byte stream");
+				value.type = type == WireInt16 ? cs2::Kv3Type::Int : cs2::Kv3Type::UInt;
+				if (type == WireInt16)
+					value.integer = static_cast<int16_t>(v);
+				else
+					value.unsigned_integer = v;
+				return true;
+			}
+
+			case WireInt32AsByte:
+			{
+				uint8_t b = 0;
+				if (!bytes->read(b))
+					return fail("Truncated byte stream");
+				value.type = cs2::Kv3Type::Int;
+				value.integer = b;
+				return true;
+			}
+
+			case WireString:
+			case WireStringMulti:
+			{
+				int32_t id = 0;
+				if (!ints->read(id))
+					return fail("Truncated 4-byte stream");
+				if (id != -1 && (id < 0 || static_cast<size_t>(id) >= strings.size()))
+					return fail("String index out of range");
+				value.type = cs2::Kv3Type::String;
+				value.string = id == -1 ? std::string_view() : strings[id];
+				return true;
+			}
+
+			case WireBlob:
+				return readBlob(value);
+
+			case WireArray:
+			{
+				int32_t count = 0;
+				if (!ints->read(count) || count < 0)
+					return fail("Bad array length");
+				return readArray(value, static_cast<size_t>(count), false);
+			}
+
+			case WireArrayTyped:
+			{
+				int32_t count = 0;
+				if (!ints->read(count) || count < 0)
+					return fail("Bad array length");
+				return readArray(value, static_cast<size_t>(count), true);
+			}
+
+			case WireArrayTypedByteLength:
+			{
+				uint8_t count = 0;
+				if (!bytes->read(count))
+					return fail("Truncated byte stream");
+				return readArray(value, count, true);
+			}
+
+			case WireObject:
+			{
+				int32_t count = 0;
+				if (!ints->read(count) || count < 0)
+					return fail("Bad object size");
+				return readObject(value, static_cast<size_t>(count));
+			}
+
+			default:
+				return fail("Unsupported value type");
+			}
+		}
+
+	private:
+		bool fail(const char* message)
+		{
+			if (error.empty())
+				error = message;
+			return false;
+		}
+
+		bool readBlob(cs2::Kv3Value& value)
+		{
+			uint32_t length = 0;
+			if (blob_lengths)
+			{
+				if (blob_index >= blob_count)
+					return fail("Blob index out of range");
+				std::memcpy(&length, blob_lengths + blob_index * 4, 4);
+				blob_index++;
+			}
+			else if (!ints->read(length))
+			{
+				return fail("Truncated 4-byte stream");
+			}
+
+			const uint8_t* data = nullptr;
+			if (!blob_data->bytes(length, data))
+				return fail("Truncated blob data");
+
+			value.type = cs2::Kv3Type::Blob;
+			value.blob = std::span<const uint8_t>(data, length);
+			return true;
+		}
+
+		bool readArray(cs2::Kv3Value& value, size_t count, bool typed)
+		{
+			if (++depth > 256)
+				return fail("Nesting too deep");
+
+			uint8_t element_type = 0;
+			if (typed && !readType(element_type))
+				return false;
+
+			// Every element takes at least one byte of some stream, which bounds
+			// the reservation for corrupt counts.
+			if (count > types->remaining() + ints->remaining() + bytes->remaining() + eights->remaining() + 1)
+				return fail("Bad array length");
+
+			value.type = cs2::Kv3Type::Array;
+			value.items.resize(count);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				uint8_t type = element_type;
+				if (!typed && !readType(type))
+					return false;
+				if (!readValue(type, value.items[i]))
+					return false;
+			}
+
+			depth--;
+			return true;
+		}
+
+		bool readObject(cs2::Kv3Value& value, size_t count)
+		{
+			if (++depth > 256)
+				return fail("Nesting too deep");
+
+			if (count > ints->remaining())
+				return fail("Bad object size");
+
+			value.type = cs2::Kv3Type::Object;
+			value.items.resize(count);
+			value.keys.resize(count);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				int32_t id = 0;
+				if (!ints->read(id))
+					return fail("Truncated 4-byte stream");
+				if (id != -1 && (id < 0 || static_cast<size_t>(id) >= strings.size()))
+					return fail("Key index out of range");
+				value.keys[i] = id == -1 ? std::string_view() : strings[id];
+
+				uint8_t type = 0;
+				if (!readType(type) || !readValue(type, value.items[i]))
+					return false;
+			}
+
+			depth--;
+			return true;
+		}
+	};
+
+	// Read count null-terminated strings.
+	bool readStrings(Cursor& cursor, size_t count, std::vector<std::string_view>& strings)
+	{
+		if (count > cursor.remaining())
+			return false;
+
+		strings.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			const void* nul = std::memchr(cursor.p, 0, cursor.remaining());
+			if (!nul)
+				return false;
+			size_t length = static_cast<const uint8_t*>(nul) - cursor.p;
+			strings[i] = std::string_view(reinterpret_cast<const char*>(cursor.p), length);
+			cursor.p += length + 1;
+		}
+		return true;
+	}
+
+	void alignCursor(Cursor& cursor, const uint8_t* base, size_t alignment)
+	{
+		size_t offset = static_cast<size_t>(cursor.p - base);
+		size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+		cursor.p = base + aligned < cursor.end ? base + aligned : cursor.end;
+	}
+
+	// LZ4 block decoding into out[0, capacity), starting at position. Matches may
+	// reach back into earlier output, which lets chained frames share history.
+	bool decodeLz4(std::span<const uint8_t> input, uint8_t* out, size_t& position, size_t capacity)
+	{
+		const uint8_t* ip = input.data();
+		const uint8_t* iend = ip + input.size();
+
+		while (ip < iend)
+		{
+			uint8_t token = *ip++;
+
+			size_t literals = token >> 4;
+			if (literals == 15)
+			{
+				uint8_t b;
+				do {
+					if (ip >= iend)
+						return false;
+					b = *ip++;
+					literals += b;
+				} while (b == 255);
+			}
+
+			if (literals > static_cast<size_t>(iend - ip) || literals > capacity - position)
+				return false;
+
+			std::memcpy(out + position, ip, literals);
+			ip += literals;
+			position += literals;
+
+			// The last sequence has literals only.
+			if (ip >= iend)
+				break;
+
+			if (iend - ip < 2)
+				return false;
+			size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > position)
+				return false;
+
+			size_t match = token & 15;
+			if (match == 15)
+			{
+				uint8_t b;
+				do {
+					if (ip >= iend)
+						return false;
+					b = *ip++;
+					match += b;
+				} while (b == 255);
+			}
+			match += 4;
+
+			if (match > capacity - position)
+				return false;
+
+			const uint8_t* src = out + position - offset;
+			uint8_t* dst = out + position;
+			for (size_t i = 0; i < match; i++)
+				dst[i] = src[i];
+			position += match;
+		}
+
+		return true;
+	}
+
+	// Valve's LZ77-style block compression used by the legacy encoding.
+	bool decodeBlockCompressed(Cursor input, std::vector<uint8_t>& output)
+	{
+		uint8_t flags[4];
+		for (auto& flag : flags)
+			if (!input.read(flag))
+				return false;
+
+		if (flags[3] & 0x80)
+		{
+			output.assign(input.p, input.end);
+			return true;
+		}
+
+		size_t expected = flags[0] | (flags[1] << 8) | (flags[2] << 16);
+		output.clear();
+		output.reserve(expected);
+
+		while (input.remaining() > 0 && output.size() < expected)
+		{
+			uint16_t mask = 0;
+			if (!input.read(mask))
+				return false;
+
+			for (int i = 0; i < 16 && output.size() < expected; i++)
+			{
+				if (mask & (1 << i))
+				{
+					uint16_t offset_size = 0;
+					if (!input.read(offset_size))
+						return false;
+
+					size_t offset = ((offset_size & 0xFFF0) >> 4) + 1;
+					size_t size = (offset_size & 0x000F) + 3;
+					if (offset > output.size())
+						return false;
+
+					size_t from = output.size() - offset;
+					for (size_t j = 0; j < size; j++)
+						output.push_back(output[from + j]);
+				}
+				else
+				{
+					uint8_t b = 0;
+					if (!input.read(b))
+						return false;
+					output.push_back(b);
+				}
+			}
+		}
+
+		return output.size() == expected;
+	}
+}
+
+const cs2::Kv3Value* cs2::Kv3Value::find(std::string_view key) const
+{
+	if (type != Kv3Type::Object)
+		return nullptr;
+
+	for (size_t i = 0; i < keys.size(); i++)
+		if (keys[i] == key)
+			return &items[i];
+
+	return nullptr;
+}
+
+int64_t cs2::Kv3Value::asInt() const
+{
+	switch (type)
+	{
+	case Kv3Type::Bool: return boolean ? 1 : 0;
+	case Kv3Type::Int: return integer;
+	case Kv3Type::UInt: return static_cast<int64_t>(unsigned_integer);
+	case Kv3Type::Double: return static_cast<int64_t>(floating);
+	default: return 0;
+	}
+}
+
+double cs2::Kv3Value::asDouble() const
+{
+	switch (type)
+	{
+	case Kv3Type::Bool: return boolean ? 1.0 : 0.0;
+	case Kv3Type::Int: return static_cast<double>(integer);
+	case Kv3Type::UInt: return static_cast<double>(unsigned_integer);
+	case Kv3Type::Double: return floating;
+	default: return 0.0;
+	}
+}
+
+bool cs2::decompressLz4(std::span<const uint8_t> input, std::span<uint8_t> output)
+{
+	size_t position = 0;
+	return decodeLz4(input, output.data(), position, output.size()) && position == output.size();
+}
+
+bool cs2::Kv3Document::isKv3(std::span<const uint8_t> data)
+{
+	if (data.size() < 4)
+		return false;
+
+	uint32_t magic;
+	std::memcpy(&magic, data.data(), 4);
+	return magic == kMagicLegacy || (magic & 0xFFFFFF00) == kMagicVersioned;
+}
+
+bool cs2::Kv3Document::read(std::span<const uint8_t> data, std::string& error)
+{
+	buffer.clear();
+	blobs.clear();
+	root = Kv3Value();
+
+	if (data.size() < 4)
+	{
+		error = "Block too small for KV3";
+		return false;
+	}
+
+	uint32_t magic;
+	std::memcpy(&magic, data.data(), 4);
+
+	if (magic == kMagicLegacy)
+		return readLegacy(data, error);
+
+	if ((magic & 0xFFFFFF00) == kMagicVersioned)
+	{
+		uint32_t version = magic & 0xFF;
+		if (version >= 1 && version <= 3)
+			return readVersioned(data, version, error);
+
+		error = "Unsupported KV3 version " + std::to_string(version) + ", only versions 1 to 3 can be read";
+		return false;
+	}
+
+	error = "Not a binary KV3 block";
+	return false;
+}
+
+bool cs2::Kv3Document::readLegacy(std::span<const uint8_t> data, std::string& error)
+{
+	Cursor input(data.data() + 4, data.data() + data.size());
+
+	const uint8_t* encoding = nullptr;
+	const uint8_t* format = nullptr;
+	if (!input.bytes(16, encoding) || !input.bytes(16, format))
+	{
+		error = "Truncated KV3 header";
+		return false;
+	}
+
+	if (std::memcmp(encoding, kEncodingUncompressed, 16) == 0)
+	{
+		buffer.assign(input.p, input.end);
+	}
+	else if (std::memcmp(encoding, kEncodingBlockCompressed, 16) == 0)
+	{
+		if (!decodeBlockCompressed(input, buffer))
+		{
+			error = "Corrupt block compressed KV3 data";
+			return false;
+		}
+	}
+	else if (std::memcmp(encoding, kEncodingLz4, 16) == 0)
+	{
+		uint32_t size = 0;
+		if (!input.read(size))
+		{
+			error = "Truncated KV3 header";
+			return false;
+		}
+
+		buffer.resize(size);
+		if (!decompressLz4(std::span<const uint8_t>(input.p, input.remaining()), buffer))
+		{
+			error = "Corrupt LZ4 KV3 data";
+			return false;
+		}
+	}
+	else
+	{
+		error = "Unsupported KV3 encoding, only uncompressed, block compressed and LZ4 can be read";
+		return false;
+	}
+
+	Cursor stream(buffer.data(), buffer.data() + buffer.size());
+
+	ValueReader reader;
+	reader.types = reader.bytes = reader.ints = reader.eights = reader.blob_data = &stream;
+
+	uint32_t string_count = 0;
+	if (!stream.read(string_count) || !readStrings(stream, string_count, reader.strings))
+	{
+		error = "Corrupt KV3 string table";
+		return false;
+	}
+
+	uint8_t type = 0;
+	if (!reader.readType(type) || !reader.readValue(type, root))
+	{
+		error = reader.error;
+		return false;
+	}
+
+	return true;
+}
+
+bool cs2::Kv3Document::readVersioned(std::span<const uint8_t> data, uint32_t version, std::string& error)
+{
+	Cursor input(data.data() + 4, data.data() + data.size());
+
+	const uint8_t* format = nullptr;
+	uint32_t compression = 0;
+	uint16_t dictionary = 0;
+	uint16_t frame_size = 0;
+	uint32_t byte_count = 0;
+	uint32_t int_count = 0;
+	uint32_t eight_count = 0;
+	uint32_t strings_and_types_size = 0;
+	uint32_t uncompressed_size = 0;
+	uint32_t compressed_size = 0;
+	uint32_t blob_count = 0;
+	uint32_t blob_total_size = 0;
+	uint32_t two_byte_count = 0;
+
+	bool ok = input.bytes(16, format) && input.read(compression);
+	if (ok && version >= 2)
+		ok = input.read(dictionary) && input.read(frame_size);
+	ok = ok && input.read(byte_count) && input.read(int_count) && input.read(eight_count);
+
+	if (ok && version >= 2)
+	{
+		uint16_t object_count = 0;
+		uint16_t array_count = 0;
+		ok = input.read(strings_and_types_size) && input.read(object_count) && input.read(array_count) &&
+			input.read(uncompressed_size) && input.read(compressed_size) &&
+			input.read(blob_count) && input.read(blob_total_size);
+
+		if (ok && version >= 3)
+		{
+			uint32_t unknown = 0;
+			ok = input.read(two_byte_count) && input.read(unknown);
+		}
+	}
+
+	if (!ok)
+	{
+		error = "Truncated KV3 header";
+		return false;
+	}
+
+	// Version 1 stores the payload size in front of the payload.
+	if (version == 1)
+	{
+		if (compression == 0)
+		{
+			if (!input.read(uncompressed_size))
+			{
+				error = "Truncated KV3 header";
+				return false;
+			}
+			compressed_size = uncompressed_size;
+		}
+		else
+		{
+			if (!input.read(uncompressed_size))
+			{
+				error = "Truncated KV3 header";
+				return false;
+			}
+			compressed_size = static_cast<uint32_t>(input.remaining());
+		}
+	}
+
+	if (dictionary != 0)
+	{
+		error = "Unsupported KV3 compression dictionary " + std::to_string(dictionary) + ", only uncompressed and LZ4 without a dictionary can be read";
+		return false;
+	}
+
+	const uint8_t* payload = nullptr;
+	if (!input.bytes(compressed_size, payload))
+	{
+		error = "Truncated KV3 payload";
+		return false;
+	}
+
+	if (compression == 0)
+	{
+		buffer.assign(payload, payload + compressed_size);
+	}
+	else if (compression == 1)
+	{
+		buffer.resize(uncompressed_size);
+		if (!decompressLz4(std::span<const uint8_t>(payload, compressed_size), buffer))
+		{
+			error = "Corrupt LZ4 KV3 data";
+			return false;
+		}
+	}
+	else
+	{
+		error = std::string("Unsupported KV3 compression ") + (compression == 2 ? "Zstandard" : "method " + std::to_string(compression))
+			+ ", only uncompressed and LZ4 can be read";
+		return false;
+	}
+
+	// Region layout: bytes | 2-byte values | 4-byte values | 8-byte values | strings | types | blob table
+	const uint8_t* base = buffer.data();
+	const uint8_t* end = base + buffer.size();
+
+	if (byte_count > buffer.size())
+	{
+		error = "Corrupt KV3 layout";
+		return false;
+	}
+
+	Cursor bytes(base, base + byte_count);
+	Cursor cursor(base + byte_count, end);
+
+	Cursor two_bytes;
+	if (version >= 3)
+	{
+		alignCursor(cursor, base, 2);
+		if (cursor.remaining() < static_cast<size_t>(two_byte_count) * 2)
+		{
+			error = "Corrupt KV3 layout";
+			return false;
+		}
+		two_bytes = Cursor(cursor.p, cursor.p + two_byte_count * 2);
+		cursor.p += two_byte_count * 2;
+	}
+
+	alignCursor(cursor, base, 4);
+	if (int_count == 0 || cursor.remaining() < static_cast<size_t>(int_count) * 4)
+	{
+		error = "Corrupt KV3 layout";
+		return false;
+	}
+
+	// The first 4-byte value is the string count.
+	uint32_t string_count = 0;
+	cursor.read(string_count);
+	Cursor ints(cursor.p, cursor.p + (static_cast<size_t>(int_count) - 1) * 4);
+	cursor.p = ints.end;
+
+	alignCursor(cursor, base, 8);
+	if (cursor.remaining() < static_cast<size_t>(eight_count) * 8)
+	{
+		error = "Corrupt KV3 layout";
+		return false;
+	}
+	Cursor eights(cursor.p, cursor.p + static_cast<size_t>(eight_count) * 8);
+	cursor.p = eights.end;
+
+	const uint8_t* strings_start = cursor.p;
+
+	ValueReader reader;
+	if (!readStrings(cursor, string_count, reader.strings))
+	{
+		error = "Corrupt KV3 string table";
+		return false;
+	}
+
+	Cursor types;
+	if (version == 1)
+	{
+		// Types run to the end of the buffer, minus a 4 byte trailer.
+		if (cursor.remaining() < 4)
+		{
+			error = "Corrupt KV3 layout";
+			return false;
+		}
+		types = Cursor(cursor.p, end - 4);
+	}
+	else
+	{
+		size_t strings_size = static_cast<size_t>(cursor.p - strings_start);
+		if (strings_and_types_size < strings_size || cursor.remaining() < strings_and_types_size - strings_size)
+		{
+			error = "Corrupt KV3 layout";
+			return false;
+		}
+		types = Cursor(cursor.p, cursor.p + (strings_and_types_size - strings_size));
+		cursor.p = types.end;
+	}
+
+	Cursor blob_data = bytes;
+	if (version >= 2)
+	{
+		const uint8_t* lengths = nullptr;
+		uint32_t trailer = 0;
+		if (!cursor.bytes(static_cast<size_t>(blob_count) * 4, lengths) || !cursor.read(trailer) || trailer != kBlobTrailer)
+		{
+			error = "Corrupt KV3 blob table";
+			return false;
+		}
+
+		reader.blob_lengths = lengths;
+		reader.blob_count = blob_count;
+
+		if (blob_count > 0)
+		{
+			blobs.resize(blob_total_size);
+
+			if (compression == 0)
+			{
+				const uint8_t* raw = nullptr;
+				if (!input.bytes(blob_total_size, raw))
+				{
+					error = "Truncated KV3 blob data";
+					return false;
+				}
+				std::memcpy(blobs.data(), raw, blob_total_size);
+			}
+			else
+			{
+				// Blobs are LZ4 frames of at most frame_size bytes sharing one history.
+				// Their compressed sizes follow the blob table as 16-bit values.
+				size_t position = 0;
+				while (position < blobs.size())
+				{
+					uint16_t chunk = 0;
+					const uint8_t* chunk_data = nullptr;
+					if (!cursor.read(chunk) || !input.bytes(chunk, chunk_data))
+					{
+						error = "Truncated KV3 blob data";
+						return false;
+					}
+
+					size_t limit = frame_size ? std::min(blobs.size(), position + frame_size) : blobs.size();
+					if (!decodeLz4(std::span<const uint8_t>(chunk_data, chunk), blobs.data(), position, limit))
+					{
+						error = "Corrupt LZ4 KV3 blob data";
+						return false;
+					}
+				}
+			}
+
+			blob_data = Cursor(blobs.data(), blobs.data() + blobs.size());
+		}
+	}
+
+	reader.types = &types;
+	reader.bytes = &bytes;
+	reader.ints = &ints;
+	reader.eights = &eights;
+	reader.two_bytes = version >= 3 ? &two_bytes : nullptr;
+	reader.blob_data = &blob_data;
+
+	uint8_t type = 0;
+	if (!reader.readType(type) || !reader.readValue(type, root))
+	{
+		error = reader.error;
+		return false;
+	}
+
+	return true;
+}
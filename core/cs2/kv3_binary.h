@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cs2
+{
+	enum class Kv3Type : uint8_t {
+		Null,
+		Bool,
+		Int,
+		UInt,
+		Double,
+		String,
+		Blob,
+		Array,
+		Object,
+	};
+
+	/// <summary>
+	/// A value of a decoded binary KV3 document. Strings and blobs are views into
+	/// the buffers of the owning Kv3Document.
+	/// </summary>
+	class Kv3Value {
+	public:
+		Kv3Type type = Kv3Type::Null;
+
+		union {
+			bool boolean;
+			int64_t integer;
+			uint64_t unsigned_integer;
+			double floating;
+		};
+
+		std::string_view string;
+		std::span<const uint8_t> blob;
+
+		// Array items, or object member values in the same order as keys.
+		std::vector<Kv3Value> items;
+		std::vector<std::string_view> keys;
+
+		Kv3Value() : integer(0) {}
+
+		/// <summary>
+		/// Find an object member by name.
+		/// </summary>
+		/// <returns>
+		/// Returns the member, or nullptr if this is not an object or has no such member.
+		/// </returns>
+		const Kv3Value* find(std::string_view key) const;
+
+		bool isNumber() const { return type == Kv3Type::Int || type == Kv3Type::UInt || type == Kv3Type::Double || type == Kv3Type::Bool; }
+
+		int64_t asInt() const;
+		double asDouble() const;
+	};
+
+	/// <summary>
+	/// Decoder for the binary KV3 encodings found in compiled resource blocks:
+	/// the legacy VKV3 encoding (uncompressed, LZ4 or block compressed) and the
+	/// KV3 versions 1 to 3 (uncompressed or LZ4). Zstandard compression,
+	/// compression dictionaries and KV3 versions 4 and later are rejected with an
+	/// "Unsupported KV3 ..." error rather than decoded.
+	/// </summary>
+	class Kv3Document {
+	public:
+		/// <summary>
+		/// Decode a binary KV3 block.
+		/// </summary>
+		/// <param name="data">
+		/// The block contents, starting with the KV3 magic.
+		/// </param>
+		/// <param name="error">
+		/// Receives a description of the failure, if any.
+		/// </param>
+		/// <returns>
+		/// Returns true if the block was decoded successfully, false otherwise.
+		/// </returns>
+		bool read(std::span<const uint8_t> data, std::string& error);
+
+		const Kv3Value& getRoot() const { return root; }
+
+		/// <summary>
+		/// Check whether a block starts with a binary KV3 magic, including versions
+		/// that read() does not support, so those report why they cannot be decoded.
+		/// </summary>
+		static bool isKv3(std::span<const uint8_t> data);
+
+	private:
+		std::vector<uint8_t> buffer;
+		std::vector<uint8_t> blobs;
+		Kv3Value root;
+
+		bool readLegacy(std::span<const uint8_t> data, std::string& error);
+		bool readVersioned(std::span<const uint8_t> data, uint32_t version, std::string& error);
+	};
+
+	/// <summary>
+	/// Decompress a raw LZ4 block.
+	/// </summary>
+	/// <returns>
+	/// Returns true if exactly output.size() bytes were produced.
+	/// </returns>
+	bool decompressLz4(std::span<const uint8_t> input, std::span<uint8_t> output);
+} // namespace cs2
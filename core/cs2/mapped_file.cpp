@@ -0,0 +1,283 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+cs2::MappedFile& cs2::MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	close();
+
+	address = other.address;
+	length = other.length;
+	skipped = other.skipped;
+	total_size = other.total_size;
+	opened = other.opened;
+#ifdef _WIN32
+	file_handle = other.file_handle;
+	mapping_handle = other.mapping_handle;
+	other.file_handle = nullptr;
+	other.mapping_handle = nullptr;
+#endif
+
+	other.address = nullptr;
+	other.length = 0;
+	other.skipped = 0;
+	other.total_size = 0;
+	other.opened = false;
+
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool cs2::MappedFile::open(const std::string& filename)
+{
+	close();
+
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size = {};
+	if (!GetFileSizeEx(file, &file_size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	if (file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		opened = true;
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	address = static_cast<const char*>(view);
+	length = static_cast<size_t>(file_size.QuadPart);
+	total_size = static_cast<uint64_t>(file_size.QuadPart);
+	opened = true;
+
+	return true;
+}
+
+bool cs2::MappedFile::open(const std::string& filename, uint64_t offset, size_t size)
+{
+	close();
+
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size = {};
+	if (!GetFileSizeEx(file, &file_size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	uint64_t total = static_cast<uint64_t>(file_size.QuadPart);
+	if (offset > total || size > total - offset)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	if (size == 0)
+	{
+		CloseHandle(file);
+		total_size = total;
+		opened = true;
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// Views start on the allocation granularity, not just a page.
+	SYSTEM_INFO info = {};
+	GetSystemInfo(&info);
+	uint64_t start = offset - offset % info.dwAllocationGranularity;
+	size_t skip = static_cast<size_t>(offset - start);
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32), static_cast<DWORD>(start), size + skip);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	address = static_cast<const char*>(view) + skip;
+	length = size;
+	skipped = skip;
+	total_size = total;
+	opened = true;
+
+	return true;
+}
+
+void cs2::MappedFile::close()
+{
+	if (address)
+		UnmapViewOfFile(address - skipped);
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	if (file_handle)
+		CloseHandle(file_handle);
+
+	address = nullptr;
+	length = 0;
+	skipped = 0;
+	total_size = 0;
+	opened = false;
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+}
+
+#else
+
+bool cs2::MappedFile::open(const std::string& filename)
+{
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st = {};
+	if (fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	total_size = static_cast<uint64_t>(st.st_size);
+
+	if (st.st_size == 0)
+	{
+		::close(fd);
+		opened = true;
+		return true;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED)
+	{
+		total_size = 0;
+		return false;
+	}
+
+	madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+	address = static_cast<const char*>(view);
+	length = static_cast<size_t>(st.st_size);
+	opened = true;
+
+	return true;
+}
+
+bool cs2::MappedFile::open(const std::string& filename, uint64_t offset, size_t size)
+{
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st = {};
+	if (fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	uint64_t total = static_cast<uint64_t>(st.st_size);
+	if (offset > total || size > total - offset)
+	{
+		::close(fd);
+		return false;
+	}
+
+	if (size == 0)
+	{
+		::close(fd);
+		total_size = total;
+		opened = true;
+		return true;
+	}
+
+	uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+	uint64_t start = offset - offset % page;
+	size_t skip = static_cast<size_t>(offset - start);
+
+	void* view = mmap(nullptr, size + skip, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(start));
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	// The caller asked for this range to use it, so fetch it all now rather than page by page.
+	madvise(view, size + skip, MADV_WILLNEED);
+
+	address = static_cast<const char*>(view) + skip;
+	length = size;
+	skipped = skip;
+	total_size = total;
+	opened = true;
+
+	return true;
+}
+
+void cs2::MappedFile::close()
+{
+	if (address)
+		munmap(const_cast<char*>(address - skipped), length + skipped);
+
+	address = nullptr;
+	length = 0;
+	skipped = 0;
+	total_size = 0;
+	opened = false;
+}
+
+#endif
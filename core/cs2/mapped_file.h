@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace cs2
+{
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		~MappedFile() { close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		/// <summary>
+		/// Map a file read-only into memory.
+		/// </summary>
+		/// <param name="filename">
+		/// The filename of the file to map.
+		/// </param>
+		/// <returns>
+		/// Returns true if the file was mapped successfully, false otherwise.
+		/// An empty file maps successfully to an empty view.
+		/// </returns>
+		bool open(const std::string& filename);
+
+		/// <summary>
+		/// Map part of a file read-only into memory. Only the pages holding the
+		/// range are mapped, so the rest of the file is never read.
+		/// </summary>
+		/// <param name="offset">
+		/// The start of the range, which need not be page aligned.
+		/// </param>
+		/// <param name="size">
+		/// The size of the range.
+		/// </param>
+		/// <returns>
+		/// Returns false if the range runs past the end of the file.
+		/// </returns>
+		bool open(const std::string& filename, uint64_t offset, size_t size);
+
+		/// <summary>
+		/// Unmap the file. Any views handed out become invalid.
+		/// </summary>
+		void close();
+
+		bool isOpen() const { return opened; }
+		const char* data() const { return address; }
+		size_t size() const { return length; }
+		// Size of the whole file, which is more than size() for a partial mapping.
+		uint64_t getFileSize() const { return total_size; }
+
+		/// <summary>
+		/// Get a view over the mapped file or range.
+		/// </summary>
+		/// <returns>
+		/// Returns a view that stays valid until the file is closed.
+		/// </returns>
+		std::string_view view() const { return std::string_view(address, length); }
+
+	private:
+		const char* address = nullptr;
+		size_t length = 0;
+		// Distance from the start of the mapping to address, which a range rounds down.
+		size_t skipped = 0;
+		uint64_t total_size = 0;
+		bool opened = false;
+
+#ifdef _WIN32
+		void* file_handle = nullptr;
+		void* mapping_handle = nullptr;
+#endif
+	};
+} // namespace cs2
@@ -0,0 +1,1618 @@
+#include "navmesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+#include "parallel.h"
+
+namespace
+{
+	using cs2::Vec3;
+
+	// Directions between columns: -x, +y, +x, -y. Turning right is +1, left is +3.
+	constexpr int kDirX[4] = { -1, 0, 1, 0 };
+	constexpr int kDirY[4] = { 0, 1, 0, -1 };
+	constexpr uint32_t kNone = 0xFFFFFFFF;
+	// Heights are voxel counts above the mesh's origin.
+	constexpr int kMaxHeight = 0xFFFF;
+	constexpr size_t kMaxVertices = cs2::NavPolygon::kMaxVertices;
+	// Guards against a malformed outline looping forever.
+	constexpr size_t kMaxContourSteps = 1 << 16;
+	// A downward face this close above a floor is the underside of something resting on it.
+	constexpr float kCapDistance = 1.0f;
+	constexpr float kNoSurface = -std::numeric_limits<float>::max();
+
+	using Clock = std::chrono::steady_clock;
+
+	double secondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Options converted to voxels, shared by every tile of a build.
+	struct TileParams {
+		float cell;
+		float cell_height;
+		float origin_x, origin_y, origin_z;
+		int tile_size;
+		// Cells around the tile rasterized for context; erosion and ledges reach this far in.
+		int border;
+		int width;
+		int climb;
+		int height;
+		int radius;
+		float walkable_normal;
+		float max_error;
+		size_t min_region_cells;
+	};
+
+	struct SolidSpan {
+		uint16_t min;
+		uint16_t max;
+		// Highest walkable surface and highest downward face at the top, or kNoSurface.
+		float floor;
+		float cap;
+		// Decided by the filters from floor and cap.
+		bool walkable;
+		uint32_t next;
+	};
+
+	// Open space above a walkable solid span, up to the next solid span.
+	struct OpenSpan {
+		int floor;
+		int top;
+		uint32_t neighbors[4];
+		uint32_t region;
+		uint16_t distance;
+		bool walkable;
+	};
+
+	struct Column {
+		uint32_t first;
+		uint32_t count;
+	};
+
+	struct ContourVertex {
+		int x, y, z;
+		// Region across the edge ending at this vertex, zero for walls and the tile border.
+		uint32_t region;
+	};
+
+	// A convex polygon of one region, indexing that region's simplified outline.
+	struct RegionPolygon {
+		uint16_t vertices[kMaxVertices];
+		size_t count;
+	};
+
+	int cross2(const ContourVertex& a, const ContourVertex& b, const ContourVertex& c)
+	{
+		return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	}
+
+	float cross2(const Vec3& a, const Vec3& b, const Vec3& c)
+	{
+		return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	}
+
+	float distance(const Vec3& a, const Vec3& b)
+	{
+		float dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z;
+		return std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+	Vec3 lerp(const Vec3& a, const Vec3& b, float t)
+	{
+		return Vec3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+	}
+
+	class TileBuilder {
+	public:
+		// Stage times, accumulated over every tile this builder makes.
+		double seconds[5] = {};
+		size_t triangles = 0;
+		size_t regions = 0;
+
+		void build(const std::vector<cs2::Triangle>& input, const TileParams& params, size_t tileX, size_t tileY, cs2::NavTile& tile)
+		{
+			p = &params;
+			base_x = params.origin_x + (static_cast<float>(tileX * params.tile_size) - params.border) * params.cell;
+			base_y = params.origin_y + (static_cast<float>(tileY * params.tile_size) - params.border) * params.cell;
+			triangles += input.size();
+
+			tile.vertices.clear();
+			tile.polygons.clear();
+			tile.portals.clear();
+
+			auto start = Clock::now();
+			voxelize(input);
+			seconds[0] += secondsSince(start);
+
+			start = Clock::now();
+			filter();
+			compact();
+			erode();
+			seconds[1] += secondsSince(start);
+
+			start = Clock::now();
+			buildRegions();
+			seconds[2] += secondsSince(start);
+
+			start = Clock::now();
+			buildContours();
+			seconds[3] += secondsSince(start);
+
+			start = Clock::now();
+			buildPolygons(tile);
+			seconds[4] += secondsSince(start);
+		}
+
+	private:
+		const TileParams* p = nullptr;
+		float base_x = 0.0f, base_y = 0.0f;
+
+		std::vector<uint32_t> heads;
+		std::vector<SolidSpan> solids;
+		std::vector<Column> columns;
+		std::vector<OpenSpan> spans;
+		std::vector<uint32_t> region_cells;
+		// Simplified outline of each region, indexed by region.
+		std::vector<std::vector<ContourVertex>> contours;
+		std::vector<uint32_t> vertex_heads;
+		std::vector<uint32_t> vertex_next;
+
+		void voxelize(const std::vector<cs2::Triangle>& input)
+		{
+			const int width = p->width;
+			heads.assign(static_cast<size_t>(width) * width, kNone);
+			solids.clear();
+
+			for (const cs2::Triangle& tri : input)
+			{
+				Vec3 u(tri.b.x - tri.a.x, tri.b.y - tri.a.y, tri.b.z - tri.a.z);
+				Vec3 v(tri.c.x - tri.a.x, tri.c.y - tri.a.y, tri.c.z - tri.a.z);
+				Vec3 n(u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x);
+				float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+				if (!(length > 0.0f))
+					continue;
+				bool walkable = n.z / length >= p->walkable_normal;
+				bool downward = n.z < 0.0f;
+
+				int min_x = static_cast<int>(std::floor((std::min({ tri.a.x, tri.b.x, tri.c.x }) - base_x) / p->cell));
+				int max_x = static_cast<int>(std::floor((std::max({ tri.a.x, tri.b.x, tri.c.x }) - base_x) / p->cell));
+				int min_y = static_cast<int>(std::floor((std::min({ tri.a.y, tri.b.y, tri.c.y }) - base_y) / p->cell));
+				int max_y = static_cast<int>(std::floor((std::max({ tri.a.y, tri.b.y, tri.c.y }) - base_y) / p->cell));
+				if (max_x < 0 || max_y < 0 || min_x >= width || min_y >= width)
+					continue;
+
+				for (int y = std::max(min_y, 0); y <= std::min(max_y, width - 1); y++)
+				{
+					for (int x = std::max(min_x, 0); x <= std::min(max_x, width - 1); x++)
+					{
+						float low, high;
+						float cell_x = base_x + x * p->cell, cell_y = base_y + y * p->cell;
+						if (!clipToCell(tri, cell_x, cell_y, cell_x + p->cell, cell_y + p->cell, low, high))
+							continue;
+
+						int span_min = std::clamp(static_cast<int>(std::floor((low - p->origin_z) / p->cell_height)), 0, kMaxHeight - 1);
+						int span_max = std::clamp(static_cast<int>(std::ceil((high - p->origin_z) / p->cell_height)), span_min + 1, kMaxHeight);
+						addSpan(static_cast<size_t>(y) * width + x, span_min, span_max, walkable ? high : kNoSurface, downward ? high : kNoSurface);
+					}
+				}
+			}
+		}
+
+		// Clip a triangle to the column over a cell (Sutherland-Hodgman) and get the height range of what is left.
+		static bool clipToCell(const cs2::Triangle& tri, float minX, float minY, float maxX, float maxY, float& low, float& high)
+		{
+			Vec3 polygon[2][9];
+			size_t count = 3;
+			polygon[0][0] = tri.a;
+			polygon[0][1] = tri.b;
+			polygon[0][2] = tri.c;
+
+			int current = 0;
+			for (int plane = 0; plane < 4 && count > 0; plane++)
+			{
+				// Signed distance inside each side: x >= minX, x <= maxX, y >= minY, y <= maxY.
+				auto inside = [&](const Vec3& point) {
+					switch (plane)
+					{
+					case 0: return point.x - minX;
+					case 1: return maxX - point.x;
+					case 2: return point.y - minY;
+					default: return maxY - point.y;
+					}
+				};
+
+				const Vec3* in = polygon[current];
+				Vec3* out = polygon[current ^ 1];
+				size_t out_count = 0;
+				for (size_t i = 0; i < count; i++)
+				{
+					const Vec3& a = in[i];
+					const Vec3& b = in[(i + 1) % count];
+					float da = inside(a), db = inside(b);
+					if (da >= 0.0f)
+						out[out_count++] = a;
+					if ((da >= 0.0f) != (db >= 0.0f))
+						out[out_count++] = lerp(a, b, da / (da - db));
+				}
+				count = out_count;
+				current ^= 1;
+			}
+
+			if (count == 0)
+				return false;
+
+			low = std::numeric_limits<float>::max();
+			high = -low;
+			for (size_t i = 0; i < count; i++)
+			{
+				low = std::min(low, polygon[current][i].z);
+				high = std::max(high, polygon[current][i].z);
+			}
+			return true;
+		}
+
+		// Insert a span into a column, merging it with the spans it overlaps. The
+		// surfaces of whichever span has the higher top are kept, of both if the
+		// tops are within a voxel.
+		void addSpan(size_t column, int min, int max, float floor, float cap)
+		{
+			uint32_t previous = kNone, current = heads[column];
+			while (current != kNone)
+			{
+				SolidSpan& span = solids[current];
+				if (span.min > max)
+					break;
+				if (span.max < min)
+				{
+					previous = current;
+					current = span.next;
+					continue;
+				}
+
+				if (span.max > max + 1)
+				{
+					floor = span.floor;
+					cap = span.cap;
+				}
+				else if (span.max >= max - 1)
+				{
+					floor = std::max(floor, span.floor);
+					cap = std::max(cap, span.cap);
+				}
+				min = std::min(min, static_cast<int>(span.min));
+				max = std::max(max, static_cast<int>(span.max));
+
+				current = span.next;
+				if (previous == kNone)
+					heads[column] = current;
+				else
+					solids[previous].next = current;
+			}
+
+			SolidSpan span{ static_cast<uint16_t>(min), static_cast<uint16_t>(max), floor, cap, false, current };
+			uint32_t index = static_cast<uint32_t>(solids.size());
+			solids.push_back(span);
+			if (previous == kNone)
+				heads[column] = index;
+			else
+				solids[previous].next = index;
+		}
+
+		int getSpanTop(const SolidSpan& span) const
+		{
+			return span.next == kNone ? kMaxHeight : solids[span.next].min;
+		}
+
+		// A span is walkable if its top is a walkable surface not capped by a
+		// downward face, so the floor under a crate or inside a closed hull is not.
+		// Then Recast's three filters: step onto low obstacles, drop spans at ledges
+		// or on slopes steeper than a climb per cell, and drop spans without headroom.
+		void filter()
+		{
+			const int width = p->width;
+			for (uint32_t head : heads)
+			{
+				bool previous_walkable = false;
+				int previous_max = 0;
+				for (uint32_t i = head; i != kNone; i = solids[i].next)
+				{
+					SolidSpan& span = solids[i];
+					bool walkable = span.floor != kNoSurface && span.cap < span.floor - kCapDistance;
+					span.walkable = walkable;
+					if (!walkable && previous_walkable && span.max - previous_max <= p->climb)
+						span.walkable = true;
+					previous_walkable = walkable;
+					previous_max = span.max;
+				}
+			}
+
+			for (int y = 0; y < width; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					for (uint32_t i = heads[static_cast<size_t>(y) * width + x]; i != kNone; i = solids[i].next)
+					{
+						SolidSpan& span = solids[i];
+						if (!span.walkable)
+							continue;
+
+						const int bottom = span.max, top = getSpanTop(span);
+						if (top - bottom < p->height)
+						{
+							span.walkable = false;
+							continue;
+						}
+
+						// Lowest drop to a neighbour with headroom, and the range of neighbour floors within a climb.
+						int lowest = kMaxHeight, accessible_min = bottom, accessible_max = bottom;
+						for (int dir = 0; dir < 4; dir++)
+						{
+							int nx = x + kDirX[dir], ny = y + kDirY[dir];
+							if (nx < 0 || ny < 0 || nx >= width || ny >= width)
+							{
+								lowest = std::min(lowest, -p->climb - bottom);
+								continue;
+							}
+
+							uint32_t neighbor = heads[static_cast<size_t>(ny) * width + nx];
+							int neighbor_bottom = -p->climb;
+							int neighbor_top = neighbor == kNone ? kMaxHeight : solids[neighbor].min;
+							if (std::min(top, neighbor_top) - std::max(bottom, neighbor_bottom) > p->height)
+								lowest = std::min(lowest, neighbor_bottom - bottom);
+
+							for (; neighbor != kNone; neighbor = solids[neighbor].next)
+							{
+								neighbor_bottom = solids[neighbor].max;
+								neighbor_top = getSpanTop(solids[neighbor]);
+								if (std::min(top, neighbor_top) - std::max(bottom, neighbor_bottom) > p->height)
+								{
+									lowest = std::min(lowest, neighbor_bottom - bottom);
+									if (std::abs(neighbor_bottom - bottom) <= p->climb)
+									{
+										accessible_min = std::min(accessible_min, neighbor_bottom);
+										accessible_max = std::max(accessible_max, neighbor_bottom);
+									}
+								}
+							}
+						}
+
+						if (lowest < -p->climb || accessible_max - accessible_min > p->climb)
+							span.walkable = false;
+					}
+				}
+			}
+		}
+
+		// Keep the open space over walkable spans and connect it to the neighbouring
+		// columns' open space an agent can step to.
+		void compact()
+		{
+			const int width = p->width;
+			columns.assign(heads.size(), Column{ 0, 0 });
+			spans.clear();
+			for (size_t c = 0; c < heads.size(); c++)
+			{
+				columns[c].first = static_cast<uint32_t>(spans.size());
+				for (uint32_t i = heads[c]; i != kNone; i = solids[i].next)
+				{
+					if (solids[i].walkable)
+						spans.push_back(OpenSpan{ solids[i].max, getSpanTop(solids[i]), { kNone, kNone, kNone, kNone }, 0, 0, true });
+				}
+				columns[c].count = static_cast<uint32_t>(spans.size()) - columns[c].first;
+			}
+
+			for (int y = 0; y < width; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					const Column& column = columns[static_cast<size_t>(y) * width + x];
+					for (uint32_t i = column.first; i < column.first + column.count; i++)
+					{
+						OpenSpan& span = spans[i];
+						for (int dir = 0; dir < 4; dir++)
+						{
+							int nx = x + kDirX[dir], ny = y + kDirY[dir];
+							if (nx < 0 || ny < 0 || nx >= width || ny >= width)
+								continue;
+
+							const Column& neighbor = columns[static_cast<size_t>(ny) * width + nx];
+							for (uint32_t j = neighbor.first; j < neighbor.first + neighbor.count; j++)
+							{
+								const OpenSpan& other = spans[j];
+								if (std::min(span.top, other.top) - std::max(span.floor, other.floor) >= p->height &&
+									std::abs(other.floor - span.floor) <= p->climb)
+								{
+									span.neighbors[dir] = j;
+									break;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		// Chamfer distance to the nearest edge of the walkable area, in half cells
+		// (2 straight, 3 diagonal), then drop everything within the agent's radius.
+		void erode()
+		{
+			const int width = p->width;
+			for (OpenSpan& span : spans)
+			{
+				bool edge = false;
+				for (uint32_t neighbor : span.neighbors)
+					edge = edge || neighbor == kNone;
+				span.distance = edge ? 0 : 0xFFFF;
+			}
+
+			auto relax = [&](OpenSpan& span, int dir, int diagonal) {
+				uint32_t neighbor = span.neighbors[dir];
+				if (neighbor == kNone)
+					return;
+				span.distance = static_cast<uint16_t>(std::min<int>(span.distance, spans[neighbor].distance + 2));
+				uint32_t corner = spans[neighbor].neighbors[diagonal];
+				if (corner != kNone)
+					span.distance = static_cast<uint16_t>(std::min<int>(span.distance, spans[corner].distance + 3));
+			};
+
+			for (int y = 0; y < width; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					const Column& column = columns[static_cast<size_t>(y) * width + x];
+					for (uint32_t i = column.first; i < column.first + column.count; i++)
+					{
+						relax(spans[i], 0, 3);
+						relax(spans[i], 3, 2);
+					}
+				}
+			}
+			for (int y = width - 1; y >= 0; y--)
+			{
+				for (int x = width - 1; x >= 0; x--)
+				{
+					const Column& column = columns[static_cast<size_t>(y) * width + x];
+					for (uint32_t i = column.first; i < column.first + column.count; i++)
+					{
+						relax(spans[i], 2, 1);
+						relax(spans[i], 1, 0);
+					}
+				}
+			}
+
+			for (OpenSpan& span : spans)
+			{
+				if (span.distance < p->radius * 2)
+					span.walkable = false;
+			}
+		}
+
+		bool isCore(int x, int y) const
+		{
+			return x >= p->border && y >= p->border && x < p->border + p->tile_size && y < p->border + p->tile_size;
+		}
+
+		uint32_t getNeighborRegion(const OpenSpan& span, int dir) const
+		{
+			uint32_t neighbor = span.neighbors[dir];
+			return neighbor == kNone || !spans[neighbor].walkable ? 0 : spans[neighbor].region;
+		}
+
+		// Monotone partitioning (as in Recast): sweep the rows, start a run at every
+		// break along x, and continue the region below a run when every connection
+		// between the two is that run's. Regions are never holed, so each has one
+		// outline. Only the tile's core gets regions.
+		void buildRegions()
+		{
+			struct Sweep {
+				uint32_t id;
+				uint32_t below;
+				uint32_t connections;
+			};
+			constexpr uint32_t kMixed = kNone;
+
+			const int width = p->width;
+			uint32_t next_id = 1;
+			std::vector<Sweep> sweeps(1);
+			std::vector<uint32_t> below_connections(1, 0);
+
+			for (OpenSpan& span : spans)
+				span.region = 0;
+
+			for (int y = p->border; y < p->border + p->tile_size; y++)
+			{
+				sweeps.resize(1);
+				below_connections.assign(next_id, 0);
+				for (int x = p->border; x < p->border + p->tile_size; x++)
+				{
+					const Column& column = columns[static_cast<size_t>(y) * width + x];
+					for (uint32_t i = column.first; i < column.first + column.count; i++)
+					{
+						OpenSpan& span = spans[i];
+						if (!span.walkable)
+							continue;
+
+						// Runs stay row local until the row is done.
+						uint32_t run = x > p->border ? getNeighborRegion(span, 0) : 0;
+						if (run == 0)
+						{
+							run = static_cast<uint32_t>(sweeps.size());
+							sweeps.push_back(Sweep{ 0, 0, 0 });
+						}
+						span.region = run;
+
+						uint32_t below = y > p->border ? getNeighborRegion(span, 3) : 0;
+						if (below != 0)
+						{
+							Sweep& sweep = sweeps[run];
+							if (sweep.below == 0 || sweep.below == below)
+							{
+								sweep.below = below;
+								sweep.connections++;
+								below_connections[below]++;
+							}
+							else
+								sweep.below = kMixed;
+						}
+					}
+				}
+
+				for (size_t i = 1; i < sweeps.size(); i++)
+				{
+					Sweep& sweep = sweeps[i];
+					if (sweep.below != kMixed && sweep.below != 0 && below_connections[sweep.below] == sweep.connections)
+						sweep.id = sweep.below;
+					else
+						sweep.id = next_id++;
+				}
+
+				for (int x = p->border; x < p->border + p->tile_size; x++)
+				{
+					const Column& column = columns[static_cast<size_t>(y) * width + x];
+					for (uint32_t i = column.first; i < column.first + column.count; i++)
+					{
+						if (spans[i].walkable && spans[i].region != 0)
+							spans[i].region = sweeps[spans[i].region].id;
+					}
+				}
+			}
+
+			// Drop regions too small to stand on, like the tops of small props.
+			region_cells.assign(next_id, 0);
+			for (const OpenSpan& span : spans)
+				region_cells[span.region]++;
+			for (OpenSpan& span : spans)
+			{
+				if (span.region != 0 && region_cells[span.region] < p->min_region_cells)
+					span.region = 0;
+			}
+			for (uint32_t r = 1; r < next_id; r++)
+				regions += region_cells[r] >= p->min_region_cells;
+		}
+
+		uint32_t getRegion(const OpenSpan& span) const
+		{
+			return span.walkable ? span.region : 0;
+		}
+
+		// Height of a corner: the highest floor of the spans around it.
+		int getCornerHeight(uint32_t index, int dir) const
+		{
+			const OpenSpan& span = spans[index];
+			int height = span.floor;
+			int turned = (dir + 1) & 3;
+			uint32_t a = span.neighbors[dir];
+			if (a != kNone)
+			{
+				height = std::max(height, spans[a].floor);
+				if (spans[a].neighbors[turned] != kNone)
+					height = std::max(height, spans[spans[a].neighbors[turned]].floor);
+			}
+			uint32_t b = span.neighbors[turned];
+			if (b != kNone)
+			{
+				height = std::max(height, spans[b].floor);
+				if (spans[b].neighbors[dir] != kNone)
+					height = std::max(height, spans[spans[b].neighbors[dir]].floor);
+			}
+			return height;
+		}
+
+		void buildContours()
+		{
+			const int width = p->width;
+			uint32_t region_count = static_cast<uint32_t>(region_cells.size());
+			contours.assign(region_count, std::vector<ContourVertex>());
+			std::vector<int64_t> areas(region_count, 0);
+
+			// Edges of each span that border another region, consumed as the outlines are walked.
+			std::vector<uint8_t> edges(spans.size(), 0);
+			for (int y = p->border; y < p->border + p->tile_size; y++)
+			{
+				for (int x = p->border; x < p->border + p->tile_size; x++)
+				{
+					const Column& column = columns[static_cast<size_t>(y) * width + x];
+					for (uint32_t i = column.first; i < column.first + column.count; i++)
+					{
+						uint32_t region = getRegion(spans[i]);
+						if (region == 0)
+							continue;
+						for (int dir = 0; dir < 4; dir++)
+						{
+							if (getNeighborRegion(spans[i], dir) != region)
+								edges[i] |= 1 << dir;
+						}
+					}
+				}
+			}
+
+			std::vector<ContourVertex> raw;
+			for (int y = p->border; y < p->border + p->tile_size; y++)
+			{
+				for (int x = p->border; x < p->border + p->tile_size; x++)
+				{
+					const Column& column = columns[static_cast<size_t>(y) * width + x];
+					for (uint32_t i = column.first; i < column.first + column.count; i++)
+					{
+						if (edges[i] == 0)
+							continue;
+
+						raw.clear();
+						walkContour(x, y, i, edges, raw);
+						std::vector<ContourVertex> simplified;
+						simplifyContour(raw, simplified);
+						if (simplified.size() < 3)
+							continue;
+
+						// Monotone regions have one outline; keep the largest should a degenerate one turn up.
+						int64_t area = 0;
+						for (size_t v = 0, u = simplified.size() - 1; v < simplified.size(); u = v++)
+							area += static_cast<int64_t>(simplified[u].x) * simplified[v].y - static_cast<int64_t>(simplified[v].x) * simplified[u].y;
+						uint32_t region = getRegion(spans[i]);
+						if (std::abs(area) > areas[region])
+						{
+							areas[region] = std::abs(area);
+							contours[region] = std::move(simplified);
+						}
+					}
+				}
+			}
+		}
+
+		// Follow a region's outline, keeping the wall on the left, emitting the far
+		// corner of each boundary edge.
+		void walkContour(int x, int y, uint32_t index, std::vector<uint8_t>& edges, std::vector<ContourVertex>& vertices)
+		{
+			int dir = 0;
+			while (!(edges[index] & (1 << dir)))
+				dir++;
+
+			const uint32_t start_index = index;
+			const int start_dir = dir;
+			for (size_t step = 0; step < kMaxContourSteps; step++)
+			{
+				if (edges[index] & (1 << dir))
+				{
+					int px = x, py = y;
+					switch (dir)
+					{
+					case 0: py++; break;
+					case 1: px++; py++; break;
+					case 2: px++; break;
+					default: break;
+					}
+					vertices.push_back(ContourVertex{ px, py, getCornerHeight(index, dir), getNeighborRegion(spans[index], dir) });
+					edges[index] &= ~(1 << dir);
+					dir = (dir + 1) & 3;
+				}
+				else
+				{
+					index = spans[index].neighbors[dir];
+					x += kDirX[dir];
+					y += kDirY[dir];
+					dir = (dir + 3) & 3;
+				}
+
+				if (index == start_index && dir == start_dir)
+					break;
+			}
+		}
+
+		// Keep the corners where the neighbouring region changes, so the edges two
+		// regions share are straight and identical from both sides, then add back
+		// wall corners until the outline is within max_error of the voxels.
+		void simplifyContour(const std::vector<ContourVertex>& raw, std::vector<ContourVertex>& simplified) const
+		{
+			const size_t count = raw.size();
+			// Raw index of each simplified vertex.
+			std::vector<size_t> kept;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (raw[i].region != raw[(i + 1) % count].region)
+					kept.push_back(i);
+			}
+
+			if (kept.empty())
+			{
+				// One neighbour all round: start from the lower left and upper right corners.
+				size_t lower = 0, upper = 0;
+				for (size_t i = 1; i < count; i++)
+				{
+					if (raw[i].x < raw[lower].x || (raw[i].x == raw[lower].x && raw[i].y < raw[lower].y))
+						lower = i;
+					if (raw[i].x > raw[upper].x || (raw[i].x == raw[upper].x && raw[i].y > raw[upper].y))
+						upper = i;
+				}
+				kept.push_back(lower);
+				if (upper != lower)
+					kept.push_back(upper);
+				std::sort(kept.begin(), kept.end());
+			}
+
+			const float max_error = p->max_error * p->max_error;
+			for (size_t i = 0; i < kept.size();)
+			{
+				size_t a = kept[i], b = kept[(i + 1) % kept.size()];
+				size_t first = (a + 1) % count;
+				float max_distance = 0.0f;
+				size_t farthest = count;
+				if (raw[first].region == 0)
+				{
+					float ax = static_cast<float>(raw[a].x), ay = static_cast<float>(raw[a].y);
+					float dx = raw[b].x - ax, dy = raw[b].y - ay;
+					float length = dx * dx + dy * dy;
+					for (size_t c = first; c != b; c = (c + 1) % count)
+					{
+						float px = raw[c].x - ax, py = raw[c].y - ay;
+						float t = length > 0.0f ? std::clamp((px * dx + py * dy) / length, 0.0f, 1.0f) : 0.0f;
+						float ex = px - dx * t, ey = py - dy * t;
+						float d = ex * ex + ey * ey;
+						if (d > max_distance)
+						{
+							max_distance = d;
+							farthest = c;
+						}
+					}
+				}
+
+				if (farthest != count && max_distance > max_error)
+					kept.insert(kept.begin() + i + 1, farthest);
+				else
+					i++;
+			}
+
+			simplified.clear();
+			for (size_t i : kept)
+			{
+				if (simplified.empty() || simplified.back().x != raw[i].x || simplified.back().y != raw[i].y)
+					simplified.push_back(raw[i]);
+			}
+			while (simplified.size() > 1 && simplified.back().x == simplified.front().x && simplified.back().y == simplified.front().y)
+				simplified.pop_back();
+		}
+
+		// Ear clipping, cutting the ear with the shortest diagonal first for less
+		// sliver triangles.
+		static void triangulate(const std::vector<ContourVertex>& outline, std::vector<RegionPolygon>& polygons)
+		{
+			std::vector<uint16_t> remaining(outline.size());
+			for (size_t i = 0; i < remaining.size(); i++)
+				remaining[i] = static_cast<uint16_t>(i);
+
+			auto isEar = [&](size_t i) {
+				size_t n = remaining.size();
+				const ContourVertex& a = outline[remaining[(i + n - 1) % n]];
+				const ContourVertex& b = outline[remaining[i]];
+				const ContourVertex& c = outline[remaining[(i + 1) % n]];
+				if (cross2(a, b, c) <= 0)
+					return false;
+				for (size_t j = 0; j < n; j++)
+				{
+					const ContourVertex& q = outline[remaining[j]];
+					if ((q.x == a.x && q.y == a.y) || (q.x == b.x && q.y == b.y) || (q.x == c.x && q.y == c.y))
+						continue;
+					if (cross2(a, b, q) >= 0 && cross2(b, c, q) >= 0 && cross2(c, a, q) >= 0)
+						return false;
+				}
+				return true;
+			};
+
+			while (remaining.size() > 3)
+			{
+				size_t n = remaining.size(), best = n;
+				int best_length = std::numeric_limits<int>::max();
+				for (size_t i = 0; i < n; i++)
+				{
+					if (!isEar(i))
+						continue;
+					const ContourVertex& a = outline[remaining[(i + n - 1) % n]];
+					const ContourVertex& c = outline[remaining[(i + 1) % n]];
+					int length = (c.x - a.x) * (c.x - a.x) + (c.y - a.y) * (c.y - a.y);
+					if (length < best_length)
+					{
+						best_length = length;
+						best = i;
+					}
+				}
+				if (best == n)
+					return;
+
+				polygons.push_back(RegionPolygon{ { remaining[(best + n - 1) % n], remaining[best], remaining[(best + 1) % n] }, 3 });
+				remaining.erase(remaining.begin() + best);
+			}
+
+			if (remaining.size() == 3 && cross2(outline[remaining[0]], outline[remaining[1]], outline[remaining[2]]) > 0)
+				polygons.push_back(RegionPolygon{ { remaining[0], remaining[1], remaining[2] }, 3 });
+		}
+
+		// Merge triangles into convex polygons of up to six vertices, joining across
+		// the longest shared edge first.
+		static void mergePolygons(const std::vector<ContourVertex>& outline, std::vector<RegionPolygon>& polygons)
+		{
+			for (;;)
+			{
+				int best_length = -1;
+				size_t best_a = 0, best_b = 0, best_edge_a = 0, best_edge_b = 0;
+				for (size_t a = 0; a < polygons.size(); a++)
+				{
+					const RegionPolygon& pa = polygons[a];
+					for (size_t b = a + 1; b < polygons.size(); b++)
+					{
+						const RegionPolygon& pb = polygons[b];
+						if (pa.count + pb.count - 2 > kMaxVertices)
+							continue;
+
+						for (size_t ea = 0; ea < pa.count; ea++)
+						{
+							uint16_t va0 = pa.vertices[ea], va1 = pa.vertices[(ea + 1) % pa.count];
+							for (size_t eb = 0; eb < pb.count; eb++)
+							{
+								if (pb.vertices[eb] != va1 || pb.vertices[(eb + 1) % pb.count] != va0)
+									continue;
+
+								// The merged polygon must stay convex at both ends of the shared edge.
+								const ContourVertex& before_a = outline[pa.vertices[(ea + pa.count - 1) % pa.count]];
+								const ContourVertex& after_b = outline[pb.vertices[(eb + 2) % pb.count]];
+								const ContourVertex& before_b = outline[pb.vertices[(eb + pb.count - 1) % pb.count]];
+								const ContourVertex& after_a = outline[pa.vertices[(ea + 2) % pa.count]];
+								if (cross2(before_a, outline[va0], after_b) <= 0 || cross2(before_b, outline[va1], after_a) <= 0)
+									continue;
+
+								int dx = outline[va1].x - outline[va0].x, dy = outline[va1].y - outline[va0].y;
+								int length = dx * dx + dy * dy;
+								if (length > best_length)
+								{
+									best_length = length;
+									best_a = a;
+									best_b = b;
+									best_edge_a = ea;
+									best_edge_b = eb;
+								}
+							}
+						}
+					}
+				}
+
+				if (best_length < 0)
+					return;
+
+				const RegionPolygon pa = polygons[best_a], pb = polygons[best_b];
+				RegionPolygon merged{ {}, 0 };
+				for (size_t i = 0; i + 1 < pa.count; i++)
+					merged.vertices[merged.count++] = pa.vertices[(best_edge_a + 1 + i) % pa.count];
+				for (size_t i = 0; i + 1 < pb.count; i++)
+					merged.vertices[merged.count++] = pb.vertices[(best_edge_b + 1 + i) % pb.count];
+				polygons[best_a] = merged;
+				polygons.erase(polygons.begin() + best_b);
+			}
+		}
+
+		// Triangulate and merge every region's outline, weld the vertices regions
+		// share and link polygons across shared edges.
+		void buildPolygons(cs2::NavTile& tile)
+		{
+			const int grid = p->width + 1;
+			vertex_heads.assign(static_cast<size_t>(grid) * grid, kNone);
+			vertex_next.clear();
+			std::vector<ContourVertex> tile_vertices;
+
+			auto weld = [&](const ContourVertex& v) -> uint32_t {
+				uint32_t& head = vertex_heads[static_cast<size_t>(v.y) * grid + v.x];
+				for (uint32_t i = head; i != kNone; i = vertex_next[i])
+				{
+					if (std::abs(tile_vertices[i].z - v.z) <= 2)
+						return i;
+				}
+				uint32_t index = static_cast<uint32_t>(tile_vertices.size());
+				tile_vertices.push_back(v);
+				vertex_next.push_back(head);
+				head = index;
+				return index;
+			};
+
+			std::vector<RegionPolygon> polygons;
+			std::vector<ContourVertex> outline;
+			for (auto& contour : contours)
+			{
+				if (contour.size() < 3)
+					continue;
+
+				// Outlines are walked clockwise; polygons are counter-clockwise.
+				outline.assign(contour.rbegin(), contour.rend());
+				polygons.clear();
+				triangulate(outline, polygons);
+				mergePolygons(outline, polygons);
+
+				for (const RegionPolygon& polygon : polygons)
+				{
+					if (tile_vertices.size() + polygon.count > 0xFFFF)
+						break;
+					cs2::NavPolygon nav;
+					nav.vertex_count = static_cast<uint8_t>(polygon.count);
+					for (size_t i = 0; i < polygon.count; i++)
+					{
+						nav.vertices[i] = static_cast<uint16_t>(weld(outline[polygon.vertices[i]]));
+						nav.neighbors[i] = cs2::NavPolygon::kNoNeighbor;
+						nav.sides[i] = cs2::NavPolygon::kNoSide;
+					}
+					tile.polygons.push_back(nav);
+				}
+			}
+
+			// Link polygons sharing an edge; outer edges on the tile's border get its side.
+			std::unordered_map<uint64_t, uint32_t> open_edges;
+			const int low = p->border, high = p->border + p->tile_size;
+			for (uint32_t i = 0; i < tile.polygons.size(); i++)
+			{
+				cs2::NavPolygon& polygon = tile.polygons[i];
+				for (uint32_t e = 0; e < polygon.vertex_count; e++)
+				{
+					uint32_t a = polygon.vertices[e], b = polygon.vertices[(e + 1) % polygon.vertex_count];
+					auto found = open_edges.find(static_cast<uint64_t>(b) << 32 | a);
+					if (found != open_edges.end())
+					{
+						uint32_t other = found->second >> 3, other_edge = found->second & 7;
+						polygon.neighbors[e] = other;
+						tile.polygons[other].neighbors[other_edge] = i;
+						open_edges.erase(found);
+					}
+					else
+						open_edges.emplace(static_cast<uint64_t>(a) << 32 | b, i << 3 | e);
+				}
+			}
+			for (cs2::NavPolygon& polygon : tile.polygons)
+			{
+				for (size_t e = 0; e < polygon.vertex_count; e++)
+				{
+					if (polygon.neighbors[e] != cs2::NavPolygon::kNoNeighbor)
+						continue;
+					const ContourVertex& a = tile_vertices[polygon.vertices[e]];
+					const ContourVertex& b = tile_vertices[polygon.vertices[(e + 1) % polygon.vertex_count]];
+					if (a.x == low && b.x == low)
+						polygon.sides[e] = 0;
+					else if (a.y == high && b.y == high)
+						polygon.sides[e] = 1;
+					else if (a.x == high && b.x == high)
+						polygon.sides[e] = 2;
+					else if (a.y == low && b.y == low)
+						polygon.sides[e] = 3;
+				}
+			}
+
+			tile.vertices.reserve(tile_vertices.size());
+			for (const ContourVertex& v : tile_vertices)
+				tile.vertices.emplace_back(base_x + v.x * p->cell, base_y + v.y * p->cell, p->origin_z + v.z * p->cell_height);
+		}
+	};
+
+	// Where to cross an edge heading from a point to a goal: where the line between
+	// them meets the edge, or the edge's end nearest to that.
+	Vec3 getCrossing(const Vec3& from, const Vec3& goal, const Vec3& right, const Vec3& left)
+	{
+		float dx = goal.x - from.x, dy = goal.y - from.y;
+		float ex = left.x - right.x, ey = left.y - right.y;
+		float denominator = dx * ey - dy * ex;
+		float t;
+		if (std::abs(denominator) > 1e-6f)
+			t = ((right.x - from.x) * dy - (right.y - from.y) * dx) / denominator;
+		else
+		{
+			float length = ex * ex + ey * ey;
+			t = length > 0.0f ? ((goal.x - right.x) * ex + (goal.y - right.y) * ey) / length : 0.0f;
+		}
+		return lerp(right, left, std::clamp(t, 0.0f, 1.0f));
+	}
+
+	// Height of a convex polygon at a point over it, from the fan triangle holding the point.
+	float getPolygonHeight(const cs2::NavTile& tile, const cs2::NavPolygon& polygon, float x, float y)
+	{
+		const Vec3 point(x, y, 0.0f);
+		const Vec3& a = tile.vertices[polygon.vertices[0]];
+		float best = a.z, best_outside = std::numeric_limits<float>::max();
+		for (size_t i = 1; i + 1 < polygon.vertex_count; i++)
+		{
+			const Vec3& b = tile.vertices[polygon.vertices[i]];
+			const Vec3& c = tile.vertices[polygon.vertices[i + 1]];
+			float area = cross2(a, b, c);
+			if (std::abs(area) < 1e-6f)
+				continue;
+
+			// Barycentric weights; the triangle the point is least outside of wins.
+			float wa = cross2(b, c, point) / area, wb = cross2(c, a, point) / area, wc = 1.0f - wa - wb;
+			float outside = std::max({ -wa, -wb, -wc, 0.0f });
+			if (outside < best_outside)
+			{
+				best_outside = outside;
+				best = a.z * wa + b.z * wb + c.z * wc;
+			}
+		}
+		return best;
+	}
+}
+
+bool cs2::NavMesh::build(const PhysicsFile& physics, const NavMeshOptions& options)
+{
+	auto start = Clock::now();
+
+	tiles.clear();
+	hull_bounds.clear();
+	tiles_x = tiles_y = 0;
+	stats = NavMeshStats();
+
+	if (!(options.cell_size > 0.0f) || !(options.cell_height > 0.0f) || !(options.agent_radius >= 0.0f) ||
+		!(options.agent_height > 0.0f) || !(options.agent_climb >= 0.0f) || options.tile_size < 8 || options.tile_size > 1024)
+	{
+		std::cerr << "Navigation mesh cells and agent height must be positive, agent radius and climb not negative, "
+			"and tiles 8 to 1024 cells wide" << std::endl;
+		return false;
+	}
+	this->options = options;
+
+	const auto& hulls = physics.getHulls();
+	Aabb bounds;
+	hull_bounds.resize(hulls.size());
+	for (size_t h = 0; h < hulls.size(); h++)
+	{
+		hull_bounds[h] = hulls[h].getBounds();
+		bounds.extend(hull_bounds[h]);
+	}
+	if (bounds.isEmpty())
+	{
+		stats.seconds = secondsSince(start);
+		return true;
+	}
+
+	origin_x = std::floor(bounds.min.x / options.cell_size) * options.cell_size;
+	origin_y = std::floor(bounds.min.y / options.cell_size) * options.cell_size;
+	origin_z = std::floor(bounds.min.z / options.cell_height) * options.cell_height;
+	if ((bounds.max.z - origin_z) / options.cell_height + options.agent_height / options.cell_height >= kMaxHeight)
+	{
+		std::cerr << "Map is too tall for navigation voxels of " << options.cell_height << " units, use taller voxels" << std::endl;
+		return false;
+	}
+
+	const float tile_world = options.tile_size * options.cell_size;
+	tiles_x = static_cast<size_t>(std::floor((bounds.max.x - origin_x) / tile_world)) + 1;
+	tiles_y = static_cast<size_t>(std::floor((bounds.max.y - origin_y) / tile_world)) + 1;
+	tiles.resize(tiles_x * tiles_y);
+	std::vector<size_t> indices(tiles.size());
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		tiles[i].x = i % tiles_x;
+		tiles[i].y = i / tiles_x;
+		indices[i] = i;
+	}
+
+	buildTiles(physics, hull_bounds, indices);
+	linkTiles(indices);
+	updateCounts();
+	stats.seconds = secondsSince(start);
+	return true;
+}
+
+bool cs2::NavMesh::rebuildHulls(const PhysicsFile& physics, std::span<const uint32_t> hulls)
+{
+	if (tiles.empty())
+	{
+		std::cerr << "Navigation mesh must be built before its tiles can be rebuilt" << std::endl;
+		return false;
+	}
+
+	// A hull's old bounds find the tiles it leaves, its new ones those it enters.
+	const auto& current = physics.getHulls();
+	std::vector<bool> marked(tiles.size(), false);
+	for (uint32_t h : hulls)
+	{
+		if (h >= hull_bounds.size())
+			hull_bounds.resize(h + 1);
+		markTiles(hull_bounds[h], marked);
+		hull_bounds[h] = h < current.size() ? current[h].getBounds() : Aabb();
+		markTiles(hull_bounds[h], marked);
+	}
+	return rebuild(physics, marked);
+}
+
+bool cs2::NavMesh::rebuildTiles(const PhysicsFile& physics, const Aabb& box)
+{
+	if (tiles.empty())
+	{
+		std::cerr << "Navigation mesh must be built before its tiles can be rebuilt" << std::endl;
+		return false;
+	}
+
+	std::vector<bool> marked(tiles.size(), false);
+	markTiles(box, marked);
+	return rebuild(physics, marked);
+}
+
+void cs2::NavMesh::markTiles(const Aabb& box, std::vector<bool>& marked) const
+{
+	if (box.isEmpty())
+		return;
+
+	// Geometry reaches into the tiles whose border it lies in.
+	const float tile_world = options.tile_size * options.cell_size;
+	const float border = (std::ceil(options.agent_radius / options.cell_size) + 3.0f) * options.cell_size;
+	auto range = [&](float low, float high, float origin, size_t count, size_t& first, size_t& last) {
+		float first_tile = std::floor((low - border - origin) / tile_world), last_tile = std::floor((high + border - origin) / tile_world);
+		if (!(last_tile >= 0.0f) || !(first_tile < static_cast<float>(count)))
+			return false;
+		first = static_cast<size_t>(std::max(first_tile, 0.0f));
+		last = std::min(static_cast<size_t>(last_tile), count - 1);
+		return true;
+	};
+
+	size_t min_x, max_x, min_y, max_y;
+	if (!range(box.min.x, box.max.x, origin_x, tiles_x, min_x, max_x) || !range(box.min.y, box.max.y, origin_y, tiles_y, min_y, max_y))
+		return;
+	for (size_t y = min_y; y <= max_y; y++)
+		for (size_t x = min_x; x <= max_x; x++)
+			marked[y * tiles_x + x] = true;
+}
+
+bool cs2::NavMesh::rebuild(const PhysicsFile& physics, const std::vector<bool>& marked)
+{
+	auto start = Clock::now();
+	stats = NavMeshStats();
+
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		if (marked[i])
+			indices.push_back(i);
+	}
+
+	const auto& hulls = physics.getHulls();
+	std::vector<Aabb> bounds(hulls.size());
+	for (size_t h = 0; h < hulls.size(); h++)
+		bounds[h] = hulls[h].getBounds();
+
+	buildTiles(physics, bounds, indices);
+	linkTiles(indices);
+	updateCounts();
+	stats.seconds = secondsSince(start);
+	return true;
+}
+
+cs2::Aabb cs2::NavMesh::getTileBounds(size_t tileX, size_t tileY, float border) const
+{
+	const float tile_world = options.tile_size * options.cell_size;
+	const float infinity = std::numeric_limits<float>::max();
+	return Aabb(Vec3(origin_x + tileX * tile_world - border, origin_y + tileY * tile_world - border, -infinity),
+		Vec3(origin_x + (tileX + 1) * tile_world + border, origin_y + (tileY + 1) * tile_world + border, infinity));
+}
+
+void cs2::NavMesh::buildTiles(const PhysicsFile& physics, const std::vector<Aabb>& bounds, const std::vector<size_t>& indices)
+{
+	TileParams params;
+	params.cell = options.cell_size;
+	params.cell_height = options.cell_height;
+	params.origin_x = origin_x;
+	params.origin_y = origin_y;
+	params.origin_z = origin_z;
+	params.tile_size = static_cast<int>(options.tile_size);
+	params.radius = static_cast<int>(std::ceil(options.agent_radius / options.cell_size));
+	params.border = params.radius + 3;
+	params.width = params.tile_size + 2 * params.border;
+	params.climb = static_cast<int>(std::floor(options.agent_climb / options.cell_height));
+	params.height = static_cast<int>(std::ceil(options.agent_height / options.cell_height));
+	params.walkable_normal = options.walkable_normal;
+	params.max_error = options.max_edge_error / options.cell_size;
+	params.min_region_cells = options.min_region_cells;
+
+	unsigned threads = resolveThreadCount(options.threads);
+	std::vector<TileBuilder> builders(threads);
+	std::vector<std::vector<Triangle>> worker_triangles(threads);
+	const auto& hulls = physics.getHulls();
+	const float border = params.border * params.cell;
+
+	parallelFor(indices.size(), threads, [&](size_t i, unsigned worker) {
+		NavTile& tile = tiles[indices[i]];
+		const Aabb box = getTileBounds(tile.x, tile.y, border);
+		std::vector<Triangle>& triangles = worker_triangles[worker];
+		triangles.clear();
+		for (size_t h = 0; h < hulls.size(); h++)
+		{
+			if (!bounds[h].overlaps(box))
+				continue;
+			hulls[h].forEachTriangle([&](const Triangle& tri) {
+				Aabb triangle_bounds;
+				triangle_bounds.extend(tri.a);
+				triangle_bounds.extend(tri.b);
+				triangle_bounds.extend(tri.c);
+				if (triangle_bounds.overlaps(box))
+					triangles.push_back(tri);
+			});
+		}
+		builders[worker].build(triangles, params, tile.x, tile.y, tile);
+	});
+
+	stats.tiles_built = indices.size();
+	for (const TileBuilder& builder : builders)
+	{
+		stats.voxelize_seconds += builder.seconds[0];
+		stats.filter_seconds += builder.seconds[1];
+		stats.region_seconds += builder.seconds[2];
+		stats.contour_seconds += builder.seconds[3];
+		stats.polygon_seconds += builder.seconds[4];
+		stats.triangles += builder.triangles;
+		stats.regions += builder.regions;
+	}
+}
+
+void cs2::NavMesh::linkTiles(const std::vector<size_t>& indices)
+{
+	auto start = Clock::now();
+
+	// A rebuilt tile's neighbours lose their portals into it, so they are relinked too.
+	std::vector<bool> marked(tiles.size(), false);
+	for (size_t index : indices)
+	{
+		marked[index] = true;
+		for (int dir = 0; dir < 4; dir++)
+		{
+			int64_t x = static_cast<int64_t>(tiles[index].x) + kDirX[dir], y = static_cast<int64_t>(tiles[index].y) + kDirY[dir];
+			if (x >= 0 && y >= 0 && x < static_cast<int64_t>(tiles_x) && y < static_cast<int64_t>(tiles_y))
+				marked[static_cast<size_t>(y) * tiles_x + static_cast<size_t>(x)] = true;
+		}
+	}
+	std::vector<size_t> relink;
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		if (marked[i])
+			relink.push_back(i);
+	}
+
+	const float climb = options.agent_climb;
+	const float min_overlap = options.cell_size * 0.01f;
+	parallelFor(relink.size(), resolveThreadCount(options.threads), [&](size_t r, unsigned) {
+		const size_t index = relink[r];
+		NavTile& tile = tiles[index];
+		tile.portals.clear();
+
+		for (uint32_t i = 0; i < tile.polygons.size(); i++)
+		{
+			NavPolygon& polygon = tile.polygons[i];
+			polygon.first_portal = static_cast<uint32_t>(tile.portals.size());
+			for (uint8_t e = 0; e < polygon.vertex_count; e++)
+			{
+				const uint8_t side = polygon.sides[e];
+				if (side == NavPolygon::kNoSide)
+					continue;
+				int64_t nx = static_cast<int64_t>(tile.x) + kDirX[side], ny = static_cast<int64_t>(tile.y) + kDirY[side];
+				if (nx < 0 || ny < 0 || nx >= static_cast<int64_t>(tiles_x) || ny >= static_cast<int64_t>(tiles_y))
+					continue;
+
+				const size_t neighbor_index = static_cast<size_t>(ny) * tiles_x + static_cast<size_t>(nx);
+				const NavTile& neighbor = tiles[neighbor_index];
+				const uint8_t opposite = (side + 2) & 3;
+				// Coordinate along the shared border: y for the -x and +x sides, x otherwise.
+				auto along = [&](const Vec3& v) { return side == 0 || side == 2 ? v.y : v.x; };
+				const Vec3& a0 = tile.vertices[polygon.vertices[e]];
+				const Vec3& a1 = tile.vertices[polygon.vertices[(e + 1) % polygon.vertex_count]];
+				const float ta0 = along(a0), ta1 = along(a1);
+
+				for (uint32_t j = 0; j < neighbor.polygons.size(); j++)
+				{
+					const NavPolygon& other = neighbor.polygons[j];
+					for (uint8_t f = 0; f < other.vertex_count; f++)
+					{
+						if (other.sides[f] != opposite)
+							continue;
+						const Vec3& b0 = neighbor.vertices[other.vertices[f]];
+						const Vec3& b1 = neighbor.vertices[other.vertices[(f + 1) % other.vertex_count]];
+						const float tb0 = along(b0), tb1 = along(b1);
+						float low = std::max(std::min(ta0, ta1), std::min(tb0, tb1));
+						float high = std::min(std::max(ta0, ta1), std::max(tb0, tb1));
+						if (high - low < min_overlap)
+							continue;
+
+						Vec3 a_low = lerp(a0, a1, (low - ta0) / (ta1 - ta0)), a_high = lerp(a0, a1, (high - ta0) / (ta1 - ta0));
+						Vec3 b_low = lerp(b0, b1, (low - tb0) / (tb1 - tb0)), b_high = lerp(b0, b1, (high - tb0) / (tb1 - tb0));
+						if (std::abs(a_low.z - b_low.z) > climb || std::abs(a_high.z - b_high.z) > climb)
+							continue;
+
+						NavPortal portal;
+						portal.polygon = i;
+						portal.edge = e;
+						portal.target = static_cast<NavPolyRef>(neighbor_index) << 32 | j;
+						portal.start = ta0 < ta1 ? a_low : a_high;
+						portal.end = ta0 < ta1 ? a_high : a_low;
+						tile.portals.push_back(portal);
+					}
+				}
+			}
+			polygon.portal_count = static_cast<uint32_t>(tile.portals.size()) - polygon.first_portal;
+		}
+	});
+
+	stats.link_seconds = secondsSince(start);
+}
+
+void cs2::NavMesh::updateCounts()
+{
+	stats.tiles = tiles.size();
+	stats.polygons = stats.vertices = stats.portals = 0;
+	for (const NavTile& tile : tiles)
+	{
+		stats.polygons += tile.polygons.size();
+		stats.vertices += tile.vertices.size();
+		stats.portals += tile.portals.size();
+	}
+}
+
+cs2::NavPolyRef cs2::NavMesh::findPolygon(const Vec3& point, Vec3& nearest) const
+{
+	if (tiles.empty())
+		return kNoNavPoly;
+
+	const float tile_world = options.tile_size * options.cell_size;
+	const float radius = options.agent_radius + 2.0f * options.cell_size;
+	const int64_t cx = static_cast<int64_t>(std::floor((point.x - origin_x) / tile_world));
+	const int64_t cy = static_cast<int64_t>(std::floor((point.y - origin_y) / tile_world));
+
+	NavPolyRef best = kNoNavPoly;
+	float best_distance = std::numeric_limits<float>::max();
+	for (int64_t ty = cy - 1; ty <= cy + 1; ty++)
+	{
+		for (int64_t tx = cx - 1; tx <= cx + 1; tx++)
+		{
+			if (tx < 0 || ty < 0 || tx >= static_cast<int64_t>(tiles_x) || ty >= static_cast<int64_t>(tiles_y))
+				continue;
+			const size_t index = static_cast<size_t>(ty) * tiles_x + static_cast<size_t>(tx);
+			const Aabb box = getTileBounds(static_cast<size_t>(tx), static_cast<size_t>(ty), radius);
+			if (point.x < box.min.x || point.y < box.min.y || point.x > box.max.x || point.y > box.max.y)
+				continue;
+
+			const NavTile& tile = tiles[index];
+			for (uint32_t i = 0; i < tile.polygons.size(); i++)
+			{
+				const NavPolygon& polygon = tile.polygons[i];
+
+				// Closest point of the polygon in x and y: the point itself if inside, else on an edge.
+				bool inside = true;
+				float closest = std::numeric_limits<float>::max();
+				float qx = point.x, qy = point.y;
+				for (size_t e = 0; e < polygon.vertex_count; e++)
+				{
+					const Vec3& a = tile.vertices[polygon.vertices[e]];
+					const Vec3& b = tile.vertices[polygon.vertices[(e + 1) % polygon.vertex_count]];
+					float dx = b.x - a.x, dy = b.y - a.y;
+					float px = point.x - a.x, py = point.y - a.y;
+					if (dx * py - dy * px < 0.0f)
+						inside = false;
+					float length = dx * dx + dy * dy;
+					float t = length > 0.0f ? std::clamp((px * dx + py * dy) / length, 0.0f, 1.0f) : 0.0f;
+					float ex = px - dx * t, ey = py - dy * t;
+					float d = ex * ex + ey * ey;
+					if (d < closest)
+					{
+						closest = d;
+						qx = a.x + dx * t;
+						qy = a.y + dy * t;
+					}
+				}
+				if (inside)
+				{
+					closest = 0.0f;
+					qx = point.x;
+					qy = point.y;
+				}
+				if (closest > radius * radius)
+					continue;
+
+				float height = getPolygonHeight(tile, polygon, qx, qy);
+				if (height > point.z + options.agent_climb || height < point.z - options.agent_height)
+					continue;
+				float dz = point.z - height;
+				float d = closest + dz * dz;
+				if (d < best_distance)
+				{
+					best_distance = d;
+					best = static_cast<NavPolyRef>(index) << 32 | i;
+					nearest = Vec3(qx, qy, height);
+				}
+			}
+		}
+	}
+	return best;
+}
+
+bool cs2::NavMesh::findPath(const Vec3& start, const Vec3& end, NavPath& path) const
+{
+	path = NavPath();
+
+	Vec3 from, to;
+	const NavPolyRef start_ref = findPolygon(start, from);
+	const NavPolyRef end_ref = findPolygon(end, to);
+	if (start_ref == kNoNavPoly || end_ref == kNoNavPoly)
+		return false;
+
+	// A* over polygons; a node sits where the edge it was entered through is crossed
+	// heading for the goal, which keeps corridors over open ground straight.
+	struct Node {
+		NavPolyRef ref;
+		uint32_t parent;
+		float cost;
+		Vec3 position;
+		// The edge entered through, seen walking in: left and right end.
+		Vec3 left, right;
+		bool closed;
+	};
+	std::vector<Node> nodes;
+	std::unordered_map<NavPolyRef, uint32_t> lookup;
+	using Entry = std::pair<float, uint32_t>;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+	nodes.push_back(Node{ start_ref, kNone, 0.0f, from, from, from, false });
+	lookup.emplace(start_ref, 0);
+	open.emplace(distance(from, to), 0);
+
+	auto visit = [&](uint32_t current, NavPolyRef target, const Vec3& left, const Vec3& right) {
+		Vec3 crossing = getCrossing(nodes[current].position, to, right, left);
+		float cost = nodes[current].cost + distance(nodes[current].position, crossing);
+		auto found = lookup.find(target);
+		uint32_t index;
+		if (found == lookup.end())
+		{
+			index = static_cast<uint32_t>(nodes.size());
+			nodes.push_back(Node{ target, current, cost, crossing, left, right, false });
+			lookup.emplace(target, index);
+		}
+		else
+		{
+			index = found->second;
+			Node& node = nodes[index];
+			if (node.closed || node.cost <= cost)
+				return;
+			node = Node{ target, current, cost, crossing, left, right, false };
+		}
+		open.emplace(cost + distance(crossing, to), index);
+	};
+
+	uint32_t reached = kNone;
+	while (!open.empty())
+	{
+		uint32_t current = open.top().second;
+		open.pop();
+		if (nodes[current].closed)
+			continue;
+		nodes[current].closed = true;
+
+		const NavPolyRef ref = nodes[current].ref;
+		if (ref == end_ref)
+		{
+			reached = current;
+			break;
+		}
+
+		// The polygon's edge from vertex e to e + 1 has the polygon on its left, so
+		// walking out through it the edge's end is on the left.
+		const size_t tile_index = static_cast<size_t>(ref >> 32);
+		const NavTile& tile = tiles[tile_index];
+		const NavPolygon& polygon = tile.polygons[ref & 0xFFFFFFFF];
+		for (size_t e = 0; e < polygon.vertex_count; e++)
+		{
+			if (polygon.neighbors[e] == NavPolygon::kNoNeighbor)
+				continue;
+			const Vec3& a = tile.vertices[polygon.vertices[e]];
+			const Vec3& b = tile.vertices[polygon.vertices[(e + 1) % polygon.vertex_count]];
+			visit(current, static_cast<NavPolyRef>(tile_index) << 32 | polygon.neighbors[e], b, a);
+		}
+		for (uint32_t i = polygon.first_portal; i < polygon.first_portal + polygon.portal_count; i++)
+		{
+			const NavPortal& portal = tile.portals[i];
+			visit(current, portal.target, portal.end, portal.start);
+		}
+	}
+
+	if (reached == kNone)
+		return false;
+
+	// Walk back to the start, collecting the corridor and the edges crossed.
+	std::vector<Vec3> lefts, rights;
+	for (uint32_t i = reached; i != kNone; i = nodes[i].parent)
+	{
+		path.polygons.push_back(nodes[i].ref);
+		lefts.push_back(nodes[i].left);
+		rights.push_back(nodes[i].right);
+	}
+	std::reverse(path.polygons.begin(), path.polygons.end());
+	std::reverse(lefts.begin(), lefts.end());
+	std::reverse(rights.begin(), rights.end());
+	lefts.push_back(to);
+	rights.push_back(to);
+
+	// Funnel string pulling: narrow the wedge from the apex through each edge
+	// crossed; when one side crosses the other, that corner becomes the new apex.
+	auto same = [](const Vec3& a, const Vec3& b) { return std::abs(a.x - b.x) < 1e-3f && std::abs(a.y - b.y) < 1e-3f; };
+	path.points.push_back(from);
+	Vec3 apex = from, left = lefts[0], right = rights[0];
+	size_t left_index = 0, right_index = 0;
+	for (size_t i = 1; i < lefts.size(); i++)
+	{
+		if (cross2(apex, right, rights[i]) >= 0.0f)
+		{
+			if (same(apex, right) || cross2(apex, left, rights[i]) < 0.0f)
+			{
+				right = rights[i];
+				right_index = i;
+			}
+			else
+			{
+				apex = left;
+				path.points.push_back(apex);
+				right = left;
+				right_index = left_index;
+				i = left_index;
+				continue;
+			}
+		}
+
+		if (cross2(apex, left, lefts[i]) <= 0.0f)
+		{
+			if (same(apex, left) || cross2(apex, right, lefts[i]) > 0.0f)
+			{
+				left = lefts[i];
+				left_index = i;
+			}
+			else
+			{
+				apex = right;
+				path.points.push_back(apex);
+				left = right;
+				left_index = right_index;
+				i = right_index;
+				continue;
+			}
+		}
+	}
+	if (!same(path.points.back(), to) || path.points.size() == 1)
+		path.points.push_back(to);
+
+	for (size_t i = 1; i < path.points.size(); i++)
+		path.length += distance(path.points[i - 1], path.points[i]);
+	return true;
+}
+
+void cs2::NavMesh::displayStats() const
+{
+	std::cout << "NavMesh: " << stats.tiles << " tiles (" << stats.tiles_built << " built) of " << options.tile_size << "x" << options.tile_size
+		<< " cells of " << options.cell_size << "x" << options.cell_height << " units" << std::endl;
+	std::cout << "NavMesh Geometry: " << stats.triangles << " triangles, " << stats.regions << " regions, " << stats.polygons << " polygons, "
+		<< stats.vertices << " vertices, " << stats.portals << " portals" << std::endl;
+	std::cout << "NavMesh Stages: voxelize " << stats.voxelize_seconds * 1000.0 << " ms, filter " << stats.filter_seconds * 1000.0
+		<< " ms, regions " << stats.region_seconds * 1000.0 << " ms, contours " << stats.contour_seconds * 1000.0
+		<< " ms, polygons " << stats.polygon_seconds * 1000.0 << " ms, link " << stats.link_seconds * 1000.0 << " ms" << std::endl;
+	std::cout << "NavMesh Build Time: " << stats.seconds * 1000.0 << " ms" << std::endl;
+	std::cout << std::endl;
+}
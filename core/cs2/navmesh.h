@@ -0,0 +1,205 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "parser.h"
+
+namespace cs2
+{
+	class NavMeshOptions {
+	public:
+		// Number of threads building tiles, zero for one per hardware thread.
+		unsigned threads = 1;
+		// Horizontal and vertical size of a voxel in map units.
+		float cell_size = 8.0f;
+		float cell_height = 2.0f;
+		// Player hull: 32 units wide, 72 tall standing, climbing steps up to 18.
+		float agent_radius = 16.0f;
+		float agent_height = 72.0f;
+		float agent_climb = 18.0f;
+		// Smallest normal z of a walkable triangle; 0.7 is the steepest slope a player can stand on.
+		float walkable_normal = 0.7f;
+		// Cells along each side of a tile.
+		size_t tile_size = 64;
+		// Largest distance, in map units, a simplified wall may stray from the voxel outline.
+		float max_edge_error = 12.0f;
+		// Regions with fewer cells than this are dropped, e.g. the tops of small props.
+		size_t min_region_cells = 16;
+	};
+
+	class NavMeshStats {
+	public:
+		size_t tiles = 0;
+		// Tiles built by the last build or rebuild.
+		size_t tiles_built = 0;
+		size_t triangles = 0;
+		size_t regions = 0;
+		size_t polygons = 0;
+		size_t vertices = 0;
+		size_t portals = 0;
+		// Time spent in each stage, summed over tiles and threads.
+		double voxelize_seconds = 0.0;
+		double filter_seconds = 0.0;
+		double region_seconds = 0.0;
+		double contour_seconds = 0.0;
+		double polygon_seconds = 0.0;
+		// Wall time of connecting tiles, and of the whole build or rebuild.
+		double link_seconds = 0.0;
+		double seconds = 0.0;
+	};
+
+	// A polygon: tile index in the high 32 bits, polygon within the tile in the low 32 bits.
+	using NavPolyRef = uint64_t;
+	constexpr NavPolyRef kNoNavPoly = ~NavPolyRef(0);
+
+	class NavPolygon {
+	public:
+		static constexpr size_t kMaxVertices = 6;
+		static constexpr uint32_t kNoNeighbor = 0xFFFFFFFF;
+		static constexpr uint8_t kNoSide = 0xFF;
+
+		// Indices into the tile's vertices, counter-clockwise seen from above.
+		uint16_t vertices[kMaxVertices] = {};
+		// Polygon of the same tile across edge i (vertices i and i + 1), or kNoNeighbor.
+		uint32_t neighbors[kMaxVertices] = {};
+		// Tile side an outer edge lies on (0 -x, 1 +y, 2 +x, 3 -y), or kNoSide.
+		uint8_t sides[kMaxVertices] = {};
+		uint8_t vertex_count = 0;
+		// Links to polygons of neighbouring tiles, see NavTile::portals.
+		uint32_t first_portal = 0;
+		uint32_t portal_count = 0;
+	};
+
+	/// <summary>
+	/// Part of an outer edge shared with a polygon of a neighbouring tile.
+	/// </summary>
+	class NavPortal {
+	public:
+		uint32_t polygon = 0;
+		uint8_t edge = 0;
+		NavPolyRef target = kNoNavPoly;
+		// Ends of the shared part, in the direction of the edge.
+		Vec3 start = Vec3(0.0f, 0.0f, 0.0f);
+		Vec3 end = Vec3(0.0f, 0.0f, 0.0f);
+	};
+
+	class NavTile {
+	public:
+		size_t x = 0, y = 0;
+		std::vector<Vec3> vertices;
+		std::vector<NavPolygon> polygons;
+		// Sorted by polygon.
+		std::vector<NavPortal> portals;
+	};
+
+	class NavPath {
+	public:
+		// The polygons walked through, from the start's to the end's.
+		std::vector<NavPolyRef> polygons;
+		// The shortest route through them: start, the corners it turns at, end.
+		std::vector<Vec3> points;
+		float length = 0.0f;
+	};
+
+	/// <summary>
+	/// Navigation mesh of the walkable surfaces of a map, for bots. Tiles are
+	/// built independently and in parallel, each in five stages, from the
+	/// triangles of the hulls overlapping it plus a border:
+	///
+	///   voxelize   triangles become solid spans in columns of voxels
+	///   filter     spans too steep, too low, on a ledge or within the agent's
+	///              radius of an obstacle are made unwalkable
+	///   regions    walkable spans are swept into monotone regions, which have
+	///              no holes
+	///   contours   region outlines are traced and simplified; edges shared by
+	///              two regions stay straight so both sides agree
+	///   polygons   outlines are triangulated and merged into convex polygons
+	///
+	/// Polygons meeting on a tile border are then linked by portals. When some
+	/// hulls change, rebuildHulls rebuilds only the tiles their old and new
+	/// bounds touch.
+	///
+	/// findPath runs A* over polygons, crossing each edge where the line to the
+	/// goal meets it, and pulls the route taut through the edges crossed.
+	/// </summary>
+	class NavMesh {
+	public:
+		/// <summary>
+		/// Build the tiles covering every hull of a physics file.
+		/// </summary>
+		/// <returns>
+		/// Returns false if the options are invalid or the map is too tall for the voxel height.
+		/// </returns>
+		bool build(const PhysicsFile& physics, const NavMeshOptions& options = NavMeshOptions());
+
+		/// <summary>
+		/// Rebuild the tiles touched by some hulls, before or after they changed.
+		/// The tile grid keeps the extent of the first build.
+		/// </summary>
+		/// <param name="physics">
+		/// The changed physics file. Hulls added since the last build may be listed
+		/// too, and so may hulls past its end, which are taken as removed.
+		/// </param>
+		/// <param name="hulls">
+		/// Indices of the hulls that changed.
+		/// </param>
+		bool rebuildHulls(const PhysicsFile& physics, std::span<const uint32_t> hulls);
+
+		/// <summary>
+		/// Rebuild the tiles whose geometry a box can affect. Unlike rebuildHulls
+		/// this does not track where hulls were, so a box must cover both where a
+		/// changed hull was and where it is.
+		/// </summary>
+		bool rebuildTiles(const PhysicsFile& physics, const Aabb& box);
+
+		/// <summary>
+		/// Find the polygon under a point, or the nearest one within the agent's
+		/// radius plus two cells.
+		/// </summary>
+		/// <param name="nearest">
+		/// Receives the point moved onto the polygon.
+		/// </param>
+		/// <returns>
+		/// Returns kNoNavPoly if no polygon is near enough.
+		/// </returns>
+		NavPolyRef findPolygon(const Vec3& point, Vec3& nearest) const;
+
+		/// <summary>
+		/// Find the shortest path between two points.
+		/// </summary>
+		/// <returns>
+		/// Returns false if either point is off the mesh or they are not connected.
+		/// </returns>
+		bool findPath(const Vec3& start, const Vec3& end, NavPath& path) const;
+
+		const NavTile& getTile(size_t index) const { return tiles[index]; }
+		size_t getTileCount() const { return tiles.size(); }
+		const NavPolygon& getPolygon(NavPolyRef ref) const { return tiles[ref >> 32].polygons[ref & 0xFFFFFFFF]; }
+		const NavMeshOptions& getOptions() const { return options; }
+		const NavMeshStats& getStats() const { return stats; }
+		bool empty() const { return tiles.empty(); }
+
+		/// <summary>
+		/// Display the build statistics.
+		/// </summary>
+		void displayStats() const;
+
+	private:
+		NavMeshOptions options;
+		std::vector<NavTile> tiles;
+		size_t tiles_x = 0, tiles_y = 0;
+		float origin_x = 0.0f, origin_y = 0.0f, origin_z = 0.0f;
+		// Hull bounds the tiles were built with, to find the tiles a changed hull used to touch.
+		std::vector<Aabb> hull_bounds;
+		NavMeshStats stats;
+
+		void markTiles(const Aabb& box, std::vector<bool>& marked) const;
+		bool rebuild(const PhysicsFile& physics, const std::vector<bool>& marked);
+		void buildTiles(const PhysicsFile& physics, const std::vector<Aabb>& bounds, const std::vector<size_t>& indices);
+		void linkTiles(const std::vector<size_t>& indices);
+		void updateCounts();
+		Aabb getTileBounds(size_t tileX, size_t tileY, float border) const;
+	};
+} // namespace cs2
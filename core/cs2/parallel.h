@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace cs2
+{
+	/// <summary>
+	/// Resolve a requested thread count. Zero means one thread per hardware thread.
+	/// </summary>
+	inline unsigned resolveThreadCount(unsigned threads)
+	{
+		if (threads == 0)
+			threads = std::thread::hardware_concurrency();
+		return threads == 0 ? 1 : threads;
+	}
+
+	/// <summary>
+	/// Run fn(index, worker) for every index in [0, count). Workers pull the next
+	/// index from a shared counter, so a slow item never holds back the others.
+	/// The calling thread takes part as worker 0.
+	/// </summary>
+	/// <param name="count">
+	/// The number of items to process.
+	/// </param>
+	/// <param name="threads">
+	/// The number of workers, zero for one per hardware thread.
+	/// </param>
+	/// <param name="fn">
+	/// The function to call for every item.
+	/// </param>
+	template <typename Fn>
+	void parallelFor(size_t count, unsigned threads, Fn&& fn)
+	{
+		threads = resolveThreadCount(threads);
+		if (threads > count)
+			threads = static_cast<unsigned>(count);
+
+		if (threads <= 1)
+		{
+			for (size_t i = 0; i < count; i++)
+				fn(i, 0u);
+			return;
+		}
+
+		std::atomic<size_t> next = 0;
+		auto worker = [&](unsigned id) {
+			for (;;)
+			{
+				size_t i = next.fetch_add(1, std::memory_order_relaxed);
+				if (i >= count)
+					break;
+				fn(i, id);
+			}
+		};
+
+		std::vector<std::thread> pool;
+		pool.reserve(threads - 1);
+		for (unsigned id = 1; id < threads; id++)
+			pool.emplace_back(worker, id);
+
+		worker(0);
+
+		for (auto& thread : pool)
+			thread.join();
+	}
+} // namespace cs2
@@ -1,49 +1,662 @@
 #include "parser.h"
+#include "hull_cache.h"
+#include "hash.h"
 
-bool cs2::PhysicsFile::load(const std::string& filename, const std::string& workingDir)
+namespace
 {
-	std::ifstream file(filename);
-	if (!file.is_open())
+	// Collects the filename and surface_prop of every object in the manifest that has a _class.
+	class ManifestReader : public cs2::Kv3Handler {
+	public:
+		explicit ManifestReader(std::vector<cs2::HullFile>& hulls) : hulls(hulls) {}
+
+		void key(std::string_view name) override { pending_key = name; }
+
+		void value(std::string_view text, std::string_view) override
+		{
+			if (!scopes.empty() && !pending_key.empty())
+			{
+				Scope& scope = scopes.back();
+				if (pending_key == "_class")
+					scope.has_class = true;
+				else if (pending_key == "filename")
+				{
+					scope.filename = text;
+					scope.has_filename = true;
+				}
+				else if (pending_key == "surface_prop")
+					scope.surface_prop = text;
+			}
+
+			pending_key = {};
+		}
+
+		void beginObject(std::string_view) override
+		{
+			scopes.push_back(Scope());
+			pending_key = {};
+		}
+
+		void endObject() override
+		{
+			Scope scope = scopes.back();
+			scopes.pop_back();
+
+			if (scope.has_class && scope.has_filename)
+				hulls.emplace_back(std::string(scope.filename), std::string(scope.surface_prop));
+		}
+
+		void beginArray(std::string_view) override { pending_key = {}; }
+
+	private:
+		struct Scope {
+			bool has_class = false;
+			bool has_filename = false;
+			std::string_view filename;
+			std::string_view surface_prop;
+		};
+
+		std::vector<cs2::HullFile>& hulls;
+		std::vector<Scope> scopes;
+		std::string_view pending_key;
+	};
+
+	// Positions and indices of a hull file, counted before it is parsed.
+	struct HullCounts {
+		size_t vertices = 0;
+		size_t indices = 0;
+	};
+
+	// Items of the first array declared as key and type, found without parsing the
+	// file. The same name can appear as a plain string first, e.g. in a vertexFormat
+	// string_array, so the type has to follow the key.
+	size_t countArray(std::string_view input, std::string_view key, std::string_view type)
+	{
+		for (size_t at = input.find(key); at != std::string_view::npos; at = input.find(key, at + key.size()))
+		{
+			size_t next = input.find_first_not_of(" \t\r\n", at + key.size());
+			if (next == std::string_view::npos || input.compare(next, type.size(), type) != 0)
+				continue;
+
+			size_t open = input.find('[', next + type.size());
+			if (open == std::string_view::npos)
+				return 0;
+
+			size_t close = input.find(']', open);
+			return cs2::countArrayItems(input.substr(open + 1, close == std::string_view::npos ? close : close - open - 1));
+		}
+		return 0;
+	}
+
+	HullCounts countHullItems(std::string_view input)
+	{
+		HullCounts counts;
+		counts.vertices = countArray(input, "\"position$0\"", "\"vector3_array\"");
+		counts.indices = countArray(input, "\"position$0Indices\"", "\"int_array\"");
+		return counts;
+	}
+
+	// Collects the first "position$0" vector3_array and "position$0Indices" int_array of a
+	// hull file straight into the output buffers. Indices go in a triangle at a time, and
+	// triangles naming a vertex past vertex_count are dropped, as HullFile::setIndexed does.
+	template <typename Index>
+	class HullReader : public cs2::Kv3Handler {
+	public:
+		HullReader(std::pmr::vector<cs2::Vec3>& vertices, std::pmr::vector<Index>& indices, size_t vertex_count) :
+			vertices(vertices), indices(indices), vertex_count(vertex_count) {}
+
+		bool malformed = false;
+
+		void key(std::string_view name) override { pending_key = name; }
+
+		void value(std::string_view text, std::string_view) override
+		{
+			pending_key = {};
+
+			if (target == Target::Vertices)
+			{
+				cs2::NumberScanner scanner(text);
+				cs2::Vec3 vec = cs2::Vec3();
+				if (scanner.next(vec.x) && scanner.next(vec.y) && scanner.next(vec.z) && scanner.done())
+					vertices.push_back(vec);
+				else
+					malformed = true;
+			}
+			else if (target == Target::Indices)
+			{
+				cs2::NumberScanner scanner(text);
+				int index = 0;
+				if (!scanner.next(index) || !scanner.done())
+				{
+					malformed = true;
+					return;
+				}
+
+				triangle[corner++] = index;
+				if (corner < 3)
+					return;
+
+				corner = 0;
+				if (isValid(triangle[0]) && isValid(triangle[1]) && isValid(triangle[2]))
+					for (int corner_index : triangle)
+						indices.push_back(static_cast<Index>(corner_index));
+			}
+		}
+
+		void beginObject(std::string_view) override { pending_key = {}; }
+
+		void beginArray(std::string_view type) override
+		{
+			if (!have_vertices && pending_key == "position$0" && type == "vector3_array")
+				target = Target::Vertices;
+			else if (!have_indices && pending_key == "position$0Indices" && type == "int_array")
+				target = Target::Indices;
+
+			pending_key = {};
+		}
+
+		void endArray() override
+		{
+			if (target == Target::Vertices)
+				have_vertices = true;
+			else if (target == Target::Indices)
+				have_indices = true;
+
+			target = Target::None;
+		}
+
+	private:
+		enum class Target { None, Vertices, Indices };
+
+		std::pmr::vector<cs2::Vec3>& vertices;
+		std::pmr::vector<Index>& indices;
+		size_t vertex_count;
+
+		Target target = Target::None;
+		bool have_vertices = false;
+		bool have_indices = false;
+		std::string_view pending_key;
+		int triangle[3] = {};
+		int corner = 0;
+
+		bool isValid(int index) const { return index >= 0 && static_cast<size_t>(index) < vertex_count; }
+	};
+
+	// Drop the triangles naming a vertex past vertex_count, in place.
+	template <typename Index>
+	void dropInvalidTriangles(std::pmr::vector<Index>& indices, size_t vertex_count)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			if (indices[i] >= vertex_count || indices[i + 1] >= vertex_count || indices[i + 2] >= vertex_count)
+				continue;
+			for (size_t k = 0; k < 3; k++)
+				indices[kept++] = indices[i + k];
+		}
+		indices.resize(kept);
+	}
+
+	// Parse a hull file into the output buffers, sized from its counts up front.
+	template <typename Index>
+	bool readHullFile(std::string_view input, const HullCounts& counts, std::pmr::vector<cs2::Vec3>& vertices, std::pmr::vector<Index>& indices, std::string& parse_error)
+	{
+		vertices.reserve(vertices.size() + counts.vertices);
+		indices.reserve(indices.size() + counts.indices);
+
+		HullReader<Index> reader(vertices, indices, counts.vertices);
+		bool valid = cs2::parseKv3(input, reader, &parse_error) && !reader.malformed;
+
+		// A malformed position leaves fewer vertices than were counted.
+		if (vertices.size() < counts.vertices)
+			dropInvalidTriangles(indices, vertices.size());
+
+		return valid;
+	}
+
+	// Buffers reused by one worker from hull to hull, for the representations
+	// that are built from the parsed positions and indices rather than being them.
+	struct HullScratch {
+		std::pmr::vector<cs2::Vec3> vertices;
+		std::pmr::vector<uint32_t> indices;
+	};
+
+	// Parse a hull file into hull, whose buffers live in the arena. Indexed hulls are
+	// read straight into them; expanded and quantized hulls are built from the scratch buffers.
+	bool parseHullFile(std::string_view input, const HullCounts& counts, const cs2::LoadOptions& options, cs2::HullFile& hull, HullScratch& scratch, std::string& parse_error)
+	{
+		if (options.indexed && !options.quantized)
+		{
+			// Same index width as setIndexed picks.
+			if (counts.vertices <= 0x10000)
+				return readHullFile(input, counts, hull.vertices, hull.indices16, parse_error);
+			return readHullFile(input, counts, hull.vertices, hull.indices32, parse_error);
+		}
+
+		scratch.vertices.clear();
+		scratch.indices.clear();
+		bool valid = readHullFile(input, counts, scratch.vertices, scratch.indices, parse_error);
+
+		if (options.quantized)
+		{
+			hull.quantized = cs2::QuantizedMesh::encode(scratch.vertices, scratch.indices);
+		}
+		else
+		{
+			hull.triangles.reserve(scratch.indices.size() / 3);
+			for (size_t i = 0; i + 2 < scratch.indices.size(); i += 3)
+				hull.triangles.emplace_back(scratch.vertices[scratch.indices[i]], scratch.vertices[scratch.indices[i + 1]], scratch.vertices[scratch.indices[i + 2]]);
+		}
+
+		return valid;
+	}
+
+	// Upper bound of the arena bytes an expanded or indexed hull takes once parsed, from its counts.
+	size_t getArenaBytes(const cs2::HullFile& hull, const HullCounts& counts, const cs2::LoadOptions& options)
+	{
+		size_t bytes = 0;
+		auto add = [&](size_t size, size_t alignment) {
+			if (size > 0)
+				bytes += size + alignment - 1;
+		};
+
+		add(hull.name.size() + 1, alignof(char));
+		add(hull.surface_prop.size() + 1, alignof(char));
+
+		if (options.indexed)
+		{
+			add(counts.vertices * sizeof(cs2::Vec3), alignof(cs2::Vec3));
+			add(counts.indices * (counts.vertices <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t)), alignof(uint32_t));
+		}
+		else
+		{
+			add(counts.indices / 3 * sizeof(cs2::Triangle), alignof(cs2::Triangle));
+		}
+
+		return bytes;
+	}
+
+	// A hull file mapped and counted ahead of parsing.
+	struct HullSource {
+		cs2::MappedFile file;
+		std::string file_name;
+		std::string path;
+		HullCounts counts;
+	};
+
+	bool parseHull(cs2::HullFile& hull, const HullSource& source, const cs2::LoadOptions& options, cs2::HullCache* cache, HullScratch& scratch, cs2::LoadStats& hullStats, std::string& error)
+	{
+		// A file whose size and mtime match the index is trusted to still have the
+		// indexed hash and is not hashed again. Other files are hashed, so touched
+		// but identical files still hit by content.
+		cs2::HullCacheEntry entry;
+		if (cache)
+		{
+			std::error_code ec;
+			entry.size = source.file.size();
+			entry.mtime = std::filesystem::last_write_time(source.path, ec).time_since_epoch().count();
+			bool known_hash = !ec && cache->findHash(source.path, entry.size, entry.mtime, entry.hash);
+			if (!known_hash)
+				entry.hash = cs2::hashBytes(source.file.view());
+
+			if (cache->load(entry.hash, options, hull, hullStats))
+			{
+				hullStats.cache_hits++;
+				if (!known_hash)
+					cache->update(source.path, entry);
+				return true;
+			}
+		}
+
+		std::string parse_error;
+		bool valid = parseHullFile(source.file.view(), source.counts, options, hull, scratch, parse_error);
+		if (!valid)
+			error = "Malformed geometry in file: " + source.file_name + (parse_error.empty() ? "" : " (" + parse_error + ")");
+
+		if (cache)
+		{
+			hullStats.cache_misses++;
+			if (valid && cache->store(entry.hash, options, hull))
+				cache->update(source.path, entry);
+		}
+
+		return valid;
+	}
+
+	bool isCompiledResource(const std::string& filename)
+	{
+		return filename.size() > 2 && filename.compare(filename.size() - 2, 2, "_c") == 0;
+	}
+
+	// Fixed-size little-endian records of a blob, or the items of an array.
+	size_t recordCount(const cs2::Kv3Value* value, size_t record_size)
+	{
+		if (!value)
+			return 0;
+		if (value->type == cs2::Kv3Type::Blob)
+			return value->blob.size() / record_size;
+		if (value->type == cs2::Kv3Type::Array)
+			return value->items.size();
+		return 0;
+	}
+
+	template <typename T>
+	T readLittleEndian(const uint8_t* p)
+	{
+		T value;
+		std::memcpy(&value, p, sizeof(T));
+		if constexpr (std::endian::native == std::endian::big)
+		{
+			auto bytes = reinterpret_cast<uint8_t*>(&value);
+			std::reverse(bytes, bytes + sizeof(T));
+		}
+		return value;
+	}
+
+	// Vector arrays are blobs of packed float triples, or arrays of 3-element arrays.
+	bool readVectors(const cs2::Kv3Value* value, std::vector<cs2::Vec3>& output)
+	{
+		static_assert(sizeof(cs2::Vec3) == 12, "Vec3 must match the packed resource layout");
+
+		output.clear();
+		if (!value)
+			return false;
+
+		if (value->type == cs2::Kv3Type::Blob)
+		{
+			output.resize(value->blob.size() / 12);
+			if constexpr (std::endian::native == std::endian::little)
+			{
+				std::memcpy(output.data(), value->blob.data(), output.size() * 12);
+			}
+			else
+			{
+				for (size_t i = 0; i < output.size(); i++)
+				{
+					const uint8_t* p = value->blob.data() + i * 12;
+					output[i] = cs2::Vec3(readLittleEndian<float>(p), readLittleEndian<float>(p + 4), readLittleEndian<float>(p + 8));
+				}
+			}
+			return true;
+		}
+
+		if (value->type != cs2::Kv3Type::Array)
+			return false;
+
+		output.reserve(value->items.size());
+		for (auto& item : value->items)
+		{
+			if (item.type != cs2::Kv3Type::Array || item.items.size() < 3)
+				return false;
+			output.emplace_back(static_cast<float>(item.items[0].asDouble()), static_cast<float>(item.items[1].asDouble()), static_cast<float>(item.items[2].asDouble()));
+		}
+		return true;
+	}
+
+	// RnTriangle_t: a blob of packed int triples, or an array of objects holding m_nIndex.
+	bool readTriangles(const cs2::Kv3Value* value, std::vector<int>& output)
+	{
+		output.clear();
+		if (!value)
+			return false;
+
+		if (value->type == cs2::Kv3Type::Blob)
+		{
+			output.resize(value->blob.size() / 12 * 3);
+			for (size_t i = 0; i < output.size(); i++)
+				output[i] = readLittleEndian<int32_t>(value->blob.data() + i * 4);
+			return true;
+		}
+
+		if (value->type != cs2::Kv3Type::Array)
+			return false;
+
+		output.reserve(value->items.size() * 3);
+		for (auto& item : value->items)
+		{
+			const cs2::Kv3Value* index = item.type == cs2::Kv3Type::Object ? item.find("m_nIndex") : &item;
+			if (!index || index->type != cs2::Kv3Type::Array || index->items.size() < 3)
+				return false;
+			for (size_t k = 0; k < 3; k++)
+				output.push_back(static_cast<int>(index->items[k].asInt()));
+		}
+		return true;
+	}
+
+	// Field of a record: a byte at a fixed offset of a blob record, or a named object member.
+	int recordField(const cs2::Kv3Value* value, size_t index, size_t record_size, size_t offset, std::string_view name)
+	{
+		if (value->type == cs2::Kv3Type::Blob)
+			return value->blob[index * record_size + offset];
+
+		const cs2::Kv3Value* field = value->items[index].find(name);
+		return field ? static_cast<int>(field->asInt()) : -1;
+	}
+
+	// Fan-triangulate the faces of an RnHull_t half-edge mesh.
+	bool readHull(const cs2::Kv3Value& hull, std::vector<cs2::Vec3>& vertices, std::vector<int>& indices)
+	{
+		const cs2::Kv3Value* positions = hull.find("m_VertexPositions");
+		if (!positions || recordCount(positions, 12) == 0)
+			positions = hull.find("m_Vertices");
+		if (!readVectors(positions, vertices))
+			return false;
+
+		// RnHalfEdge_t: next, twin, origin, face. RnFace_t: edge.
+		const cs2::Kv3Value* edges = hull.find("m_Edges");
+		const cs2::Kv3Value* faces = hull.find("m_Faces");
+		size_t edge_count = recordCount(edges, 4);
+		size_t face_count = recordCount(faces, 1);
+
+		indices.clear();
+		for (size_t f = 0; f < face_count; f++)
+		{
+			int first = recordField(faces, f, 1, 0, "m_nEdge");
+			if (first < 0 || static_cast<size_t>(first) >= edge_count)
+				return false;
+
+			int origin = recordField(edges, first, 4, 2, "m_nOrigin");
+			int edge = recordField(edges, first, 4, 0, "m_nNext");
+			int previous = -1;
+
+			// A face never has more edges than the hull, which also stops broken cycles.
+			for (size_t steps = 0; edge != first && steps < edge_count; steps++)
+			{
+				if (edge < 0 || static_cast<size_t>(edge) >= edge_count)
+					return false;
+
+				int current = recordField(edges, edge, 4, 2, "m_nOrigin");
+				if (previous >= 0)
+				{
+					indices.push_back(origin);
+					indices.push_back(previous);
+					indices.push_back(current);
+				}
+
+				previous = current;
+				edge = recordField(edges, edge, 4, 0, "m_nNext");
+			}
+		}
+		return true;
+	}
+
+	bool isValidTriangle(const std::vector<int>& indices, size_t i, size_t vertex_count)
+	{
+		return static_cast<size_t>(indices[i]) < vertex_count &&
+			static_cast<size_t>(indices[i + 1]) < vertex_count &&
+			static_cast<size_t>(indices[i + 2]) < vertex_count;
+	}
+
+	void expandTriangles(const std::vector<cs2::Vec3>& vertices, const std::vector<int>& indices, std::pmr::vector<cs2::Triangle>& triangles)
+	{
+		triangles.reserve(indices.size() / 3);
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			if (!isValidTriangle(indices, i, vertices.size()))
+				continue;
+
+			triangles.emplace_back(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]]);
+		}
+	}
+
+	void storeGeometry(cs2::HullFile& hull, std::vector<cs2::Vec3>& vertices, const std::vector<int>& indices, const cs2::LoadOptions& options)
+	{
+		if (options.quantized)
+		{
+			hull.setIndexed(std::move(vertices), indices);
+			hull.quantize();
+		}
+		else if (options.indexed)
+			hull.setIndexed(std::move(vertices), indices);
+		else
+			expandTriangles(vertices, indices, hull.triangles);
+	}
+
+	// Surface props of the stock game, used to turn the hashes stored in compiled files back into names.
+	constexpr std::string_view kSurfacePropNames[] = {
+		"default", "default_silent", "no_decal", "player", "player_control_clip", "npc_clip",
+		"concrete", "concrete_block", "brick", "rock", "gravel", "dirt", "mud", "sand", "grass", "snow", "ice",
+		"tile", "ceiling_tile", "plaster", "porcelain", "pottery", "glass", "glassbottle", "computer",
+		"metal", "solidmetal", "metal_box", "metal_barrel", "metalgrate", "metalpanel", "metalvent", "metalvehicle",
+		"metal_sand_barrel", "chainlink", "ladder", "wood", "wood_box", "wood_crate", "wood_plank", "wood_panel",
+		"wood_solid", "wood_furniture", "cardboard", "paper", "cloth", "carpet", "rubber", "rubbertire",
+		"plastic", "plastic_barrel", "plastic_box", "foliage", "water", "slosh", "flesh", "upholstery",
+	};
+
+	// Name of a surface prop hash: the stock name if it is one, the hash as "0x%08X" otherwise.
+	std::string surfacePropName(uint32_t hash)
+	{
+		for (std::string_view name : kSurfacePropNames)
+		{
+			if (cs2::hashToken(name) == hash)
+				return std::string(name);
+		}
+
+		char text[16];
+		std::snprintf(text, sizeof(text), "0x%08X", hash);
+		return text;
+	}
+}
+
+bool cs2::PhysicsFile::load(const std::string& filename, const std::string& workingDir, const LoadOptions& options)
+{
+	if (isCompiledResource(filename))
+		return loadCompiled(filename, options);
+
+	auto start_time = std::chrono::steady_clock::now();
+
+	MappedFile file;
+	if (!file.open(filename))
 	{
 		std::cerr << "Failed to open file: " << filename << std::endl;
 		return false;
 	}
 
 	this->filename = removePath(filename);
+	this->stats = LoadStats();
+	this->stats.bytes_mapped += file.size();
 
-	std::vector<char> buffer(std::istreambuf_iterator<char>(file), {});
-	buffer.push_back('\0');
-	file.close();
+	this->hulls.clear();
+	this->arena.reset();
 
-    std::string_view data(buffer.data(), buffer.size());
+	ManifestReader reader(hulls);
+	std::string error;
+	if (!parseKv3(file.view(), reader, &error))
+	{
+		std::cerr << "Failed to parse file: " << filename << " (" << error << ")" << std::endl;
+		return false;
+	}
 
-    while (data.find("_class") != std::string::npos)
-    {
-		HullFile Hull = HullFile();
+	if (hulls.empty())
+	{
+		std::cerr << "No hulls found in file: " << filename << std::endl;
+		return false;
+	}
 
-		// Filename
-        size_t start = data.find("filename = \"") + 12;
-        size_t end = data.find("\"", start);
-        Hull.name = std::string(data.substr(start, end - start));
+	this->mapname = std::string(hulls[0].name);
+	this->mapname.erase(0, 5);
+	this->mapname.erase(this->mapname.find("/"), this->mapname.size());
 
-		// Surface Prop
-        start = data.find("surface_prop = \"", end) + 16;
-        end = data.find("\"", start);
-        Hull.surface_prop = std::string(data.substr(start, end - start));
+	HullCache cache;
+	bool use_cache = false;
+	if (!options.cache_directory.empty())
+	{
+		use_cache = cache.open(options.cache_directory, error);
+		if (!use_cache)
+			std::cerr << error << std::endl;
+	}
 
-        hulls.push_back(Hull);
+	// Every hull writes only to its own slot, so the result matches a serial run.
+	std::vector<LoadStats> hull_stats(hulls.size());
+	std::vector<std::string> errors(hulls.size());
+
+	// Map and count every hull file first, so the arena is sized before anything is
+	// parsed and each hull is read straight into it. Quantized hulls are encoded before
+	// their size is known, so they are parsed on the heap and compacted afterwards.
+	std::vector<HullSource> sources(hulls.size());
+	std::vector<size_t> arena_bytes(hulls.size());
+
+	parallelFor(hulls.size(), options.threads, [&](size_t i, unsigned) {
+		HullSource& source = sources[i];
+		source.file_name = removePath(hulls[i].name);
+		source.path = workingDir + "/" + source.file_name;
+		if (!source.file.open(source.path))
+		{
+			errors[i] = "Failed to open file: " + source.file_name;
+			return;
+		}
 
-        data = data.substr(end);
-    }
+		hull_stats[i].bytes_mapped += source.file.size();
+		source.counts = countHullItems(source.file.view());
+		if (!options.quantized)
+			arena_bytes[i] = getArenaBytes(hulls[i], source.counts, options);
+	});
 
-	this->mapname = hulls[0].name;
-	this->mapname.erase(0, 5);
-	this->mapname.erase(this->mapname.find("/"), this->mapname.size());
+	if (!options.quantized)
+	{
+		size_t bytes = 0;
+		for (size_t hull_bytes : arena_bytes)
+			bytes += hull_bytes;
+
+		arena = std::make_unique<Arena>();
+		arena->reserve(bytes);
+
+		std::vector<HullFile> placed;
+		placed.reserve(hulls.size());
+		for (auto& hull : hulls)
+			placed.emplace_back(hull, HullFile::allocator_type(arena.get()));
+		hulls = std::move(placed);
+	}
+
+	std::vector<HullScratch> scratch(resolveThreadCount(options.threads));
 
-	for (auto& Hull : hulls) {
-		parseHull(Hull, workingDir);
+	parallelFor(hulls.size(), options.threads, [&](size_t i, unsigned worker) {
+		if (!sources[i].file.isOpen())
+			return;
+		parseHull(hulls[i], sources[i], options, use_cache ? &cache : nullptr, scratch[worker], hull_stats[i], errors[i]);
+		sources[i].file.close();
+	});
+
+	for (size_t i = 0; i < hulls.size(); i++)
+	{
+		stats.bytes_mapped += hull_stats[i].bytes_mapped;
+		stats.bytes_copied += hull_stats[i].bytes_copied;
+		stats.cache_hits += hull_stats[i].cache_hits;
+		stats.cache_misses += hull_stats[i].cache_misses;
+
+		if (!errors[i].empty())
+			std::cerr << errors[i] << std::endl;
 	}
 
+	if (use_cache && !cache.writeIndex(error))
+		std::cerr << error << std::endl;
+
+	if (options.quantized)
+		compact();
+	else
+		internSurfaceProps();
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
 	return true;
 }
 
@@ -58,10 +671,9 @@ void cs2::PhysicsFile::writeTriangles(const std::string& filename)
 
 	for (auto& Hull : hulls)
 	{
-		for (auto& tri : Hull.triangles)
-		{
+		Hull.forEachTriangle([&](const cs2::Triangle& tri) {
 			file.write(reinterpret_cast<const char*>(&tri), sizeof(cs2::Triangle));
-		}
+		});
 	}
 
 	file.close();
@@ -71,21 +683,45 @@ void cs2::PhysicsFile::displayStats()
 {
 	std::cout << "Filename: " << filename << std::endl;
 	std::cout << "Mapname: " << mapname << std::endl;
-
-	std::unordered_map<std::string, int> surface_props;
+	std::cout << "Bytes Mapped: " << stats.bytes_mapped << std::endl;
+	std::cout << "Bytes Copied: " << stats.bytes_copied << std::endl;
+	std::cout << "Load Time: " << stats.seconds * 1000.0 << " ms" << std::endl;
+	if (stats.seconds > 0.0)
+		std::cout << "Throughput: " << stats.bytes_mapped / stats.seconds / (1024.0 * 1024.0) << " MB/s" << std::endl;
+	if (stats.cache_hits + stats.cache_misses > 0)
+		std::cout << "Parse Cache: " << stats.cache_hits << " hits, " << stats.cache_misses << " misses" << std::endl;
+
+	std::unordered_map<std::string, int> surface_prop_counts;
 	int total_triangles = 0;
+	size_t geometry_bytes = 0;
+	size_t quantized_hulls = 0;
+	float quantization_error = 0.0f;
 
 	for (auto& Hull : hulls)
 	{
-		total_triangles += static_cast<int>(Hull.triangles.size());
-		surface_props[Hull.surface_prop]++;
+		total_triangles += static_cast<int>(Hull.getTriangleCount());
+		geometry_bytes += Hull.getGeometryBytes();
+		surface_prop_counts[std::string(Hull.surface_prop)]++;
+
+		if (Hull.isQuantized())
+		{
+			quantized_hulls++;
+			quantization_error = std::max(quantization_error, Hull.quantized.error);
+		}
 	}
 
 	std::cout << "Total Hulls: " << hulls.size() << std::endl;
 	std::cout << "Total Triangles: " << total_triangles << std::endl;
+	std::cout << "Geometry Memory: " << geometry_bytes / 1024 << " KB" << std::endl;
+
+	ArenaStats arena_stats = getArenaStats();
+	std::cout << "Arena: " << arena_stats.used / 1024 << " KB used, " << arena_stats.getSlack() / 1024 << " KB slack in "
+		<< arena_stats.chunks << (arena_stats.chunks == 1 ? " chunk" : " chunks") << std::endl;
+	if (quantized_hulls > 0)
+		std::cout << "Quantized Hulls: " << quantized_hulls << " (max error " << quantization_error << ")" << std::endl;
 
 	std::cout << "Surface Props:" << std::endl;
-	for (auto& [prop, count] : surface_props)
+	for (auto& [prop, count] : surface_prop_counts)
 	{
 		std::cout << prop << ": " << count << std::endl;
 	}
@@ -93,85 +729,214 @@ void cs2::PhysicsFile::displayStats()
 	std::cout << std::endl;
 }
 
-void cs2::PhysicsFile::parseHull(HullFile& hull, const std::string& workingDir)
+bool cs2::PhysicsFile::loadCompiled(const std::string& filename, const LoadOptions& options)
 {
-	std::string file_name = removePath(hull.name);
+	auto start_time = std::chrono::steady_clock::now();
 
-	std::ifstream file(workingDir + "/" + file_name);
-	if (!file.is_open())
+	this->filename = removePath(filename);
+	this->stats = LoadStats();
+
+	Resource resource;
+	std::string error;
+	if (!resource.open(filename, error))
 	{
-		std::cerr << "Failed to open file: " << file_name << std::endl;
-		return;
+		std::cerr << error << std::endl;
+		return false;
 	}
 
-	std::vector<char> buffer(std::istreambuf_iterator<char>(file), {});
-	buffer.push_back('\0');
-	file.close();
+	stats.bytes_mapped += resource.getSize();
+
+	// Models embed their physics in a PHYS block, .vphys_c files keep it in DATA.
+	std::span<const uint8_t> block = resource.getBlock("PHYS");
+	if (!Kv3Document::isKv3(block))
+		block = resource.getBlock("DATA");
+
+	Kv3Document document;
+	if (!document.read(block, error))
+	{
+		std::cerr << "Failed to read physics data: " << filename << " (" << error << ")" << std::endl;
+		return false;
+	}
 
-	std::string_view data(buffer.data(), buffer.size());
+	const Kv3Value& root = document.getRoot();
 
-	size_t start = data.find("\"position$0\" \"vector3_array\"") + 31;
-	size_t end = data.find("]", start);
-	std::string_view vertices = data.substr(start, end - start);
-	std::string vertices_str = std::string(vertices);
-	vertices_str.erase(std::remove(vertices_str.begin(), vertices_str.end(), '\"'), vertices_str.end());
+	// Compiled files only keep the hashes of surface property names.
+	std::vector<std::string> surface_prop_names;
+	if (const Kv3Value* hashes = root.find("m_surfacePropertyHashes"); hashes && hashes->type == Kv3Type::Array)
+	{
+		for (auto& hash : hashes->items)
+			surface_prop_names.push_back(surfacePropName(static_cast<uint32_t>(hash.asInt())));
+	}
 
-	start = data.find("\"position$0Indices\" \"int_array\"") + 34;
-	end = data.find("]", start);
-	std::string_view indices = data.substr(start, end - start);
-	std::string indices_str = std::string(indices);
-	indices_str.erase(std::remove(indices_str.begin(), indices_str.end(), '\"'), indices_str.end());
+	struct Shape {
+		const Kv3Value* desc;
+		bool is_mesh;
+	};
+	std::vector<Shape> shapes;
 
-	std::vector<Vec3> vertex_list;
-	std::vector<int> indices_list;
+	if (const Kv3Value* parts = root.find("m_parts"); parts && parts->type == Kv3Type::Array)
+	{
+		for (auto& part : parts->items)
+		{
+			const Kv3Value* shape = part.find("m_rnShape");
+			if (!shape)
+				continue;
 
-	vertex_list = parseVertices(vertices_str);
-	indices_list = parseIndices(indices_str);
+			if (const Kv3Value* meshes = shape->find("m_meshes"); meshes && meshes->type == Kv3Type::Array)
+				for (auto& mesh : meshes->items)
+					shapes.push_back({ &mesh, true });
 
-	for (size_t i = 0; i + 2 < indices_list.size(); i += 3) {
-		if (indices_list[i] >= vertex_list.size() ||
-			indices_list[i + 1] >= vertex_list.size() ||
-			indices_list[i + 2] >= vertex_list.size()) {
-			continue;
+			if (const Kv3Value* convex = shape->find("m_hulls"); convex && convex->type == Kv3Type::Array)
+				for (auto& hull : convex->items)
+					shapes.push_back({ &hull, false });
 		}
+	}
 
-		Triangle tri = Triangle();
-		tri.a = vertex_list[indices_list[i]];
-		tri.b = vertex_list[indices_list[i + 1]];
-		tri.c = vertex_list[indices_list[i + 2]];
-
-		hull.triangles.push_back(tri);
+	if (shapes.empty())
+	{
+		std::cerr << "No meshes or hulls found in file: " << filename << std::endl;
+		return false;
 	}
+
+	hulls.clear();
+	arena.reset();
+	hulls.resize(shapes.size());
+	std::vector<std::string> errors(shapes.size());
+
+	parallelFor(shapes.size(), options.threads, [&](size_t i, unsigned) {
+		const Kv3Value& desc = *shapes[i].desc;
+		HullFile& hull = hulls[i];
+
+		const Kv3Value* friendly_name = desc.find("m_UserFriendlyName");
+		if (friendly_name && friendly_name->type == Kv3Type::String && !friendly_name->string.empty())
+			hull.name = std::string(friendly_name->string);
+		else
+			hull.name = (shapes[i].is_mesh ? "mesh_" : "hull_") + std::to_string(i);
+
+		const Kv3Value* surface = desc.find("m_nSurfacePropertyIndex");
+		if (surface && static_cast<size_t>(surface->asInt()) < surface_prop_names.size())
+			hull.surface_prop = surface_prop_names[static_cast<size_t>(surface->asInt())];
+
+		std::vector<Vec3> vertex_list;
+		std::vector<int> indices_list;
+		bool valid;
+
+		if (shapes[i].is_mesh)
+		{
+			const Kv3Value* mesh = desc.find("m_Mesh");
+			valid = mesh && readVectors(mesh->find("m_Vertices"), vertex_list) && readTriangles(mesh->find("m_Triangles"), indices_list);
+		}
+		else
+		{
+			const Kv3Value* hull_data = desc.find("m_Hull");
+			valid = hull_data && readHull(*hull_data, vertex_list, indices_list);
+		}
+
+		if (!valid)
+			errors[i] = "Malformed geometry in shape: " + std::string(hull.name);
+
+		storeGeometry(hull, vertex_list, indices_list, options);
+	});
+
+	for (auto& message : errors)
+		if (!message.empty())
+			std::cerr << message << std::endl;
+
+	// .../maps/<mapname>/world_physics.vphys_c
+	std::filesystem::path path(filename);
+	this->mapname = path.parent_path().filename().string();
+	if (this->mapname.empty())
+		this->mapname = path.stem().string();
+
+	compact();
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+	return true;
 }
 
-std::vector<cs2::Vec3> cs2::PhysicsFile::parseVertices(const std::string& input)
+void cs2::HullFile::setIndexed(std::span<const Vec3> vertexList, const std::vector<int>& indexList)
 {
-	std::vector<cs2::Vec3> vectors;
-	std::stringstream ss(input);
-	std::string item;
+	triangles.clear();
+	triangles.shrink_to_fit();
+	indices16.clear();
+	indices32.clear();
 
-	while (std::getline(ss, item, ',')) {
-		std::stringstream vectorStream(item);
-		cs2::Vec3 vec = cs2::Vec3();
-		vectorStream >> vec.x >> vec.y >> vec.z;
-		vectors.push_back(vec);
-	}
+	vertices.assign(vertexList.begin(), vertexList.end());
+
+	size_t valid = 0;
+	for (size_t i = 0; i + 2 < indexList.size(); i += 3)
+		valid += isValidTriangle(indexList, i, vertices.size());
 
-	return vectors;
+	auto fill = [&](auto& output) {
+		output.reserve(valid * 3);
+		for (size_t i = 0; i + 2 < indexList.size(); i += 3)
+		{
+			if (!isValidTriangle(indexList, i, vertices.size()))
+				continue;
+			for (size_t k = 0; k < 3; k++)
+				output.push_back(static_cast<typename std::decay_t<decltype(output)>::value_type>(indexList[i + k]));
+		}
+	};
+
+	if (vertices.size() <= 0x10000)
+		fill(indices16);
+	else
+		fill(indices32);
 }
 
-std::vector<int> cs2::PhysicsFile::parseIndices(const std::string& input)
+size_t cs2::HullFile::getArenaBytes() const
 {
-	std::vector<int> indices;
-	std::stringstream ss(input);
-	std::string item;
+	// Every buffer may need padding up to its alignment; strings may fit their inline buffer and take nothing.
+	size_t bytes = 0;
+	auto add = [&](size_t size, size_t alignment) {
+		if (size > 0)
+			bytes += size + alignment - 1;
+	};
+
+	add(name.size() + 1, alignof(char));
+	add(surface_prop.size() + 1, alignof(char));
+	add(triangles.size() * sizeof(Triangle), alignof(Triangle));
+	add(vertices.size() * sizeof(Vec3), alignof(Vec3));
+	add(indices16.size() * sizeof(uint16_t), alignof(uint16_t));
+	add(indices32.size() * sizeof(uint32_t), alignof(uint32_t));
+	add(quantized.positions.size() * sizeof(uint16_t), alignof(uint16_t));
+	add(quantized.indices.size(), alignof(uint8_t));
+
+	return bytes;
+}
 
-	while (std::getline(ss, item, ',')) {
-		std::stringstream indexStream(item);
-		int index;
-		indexStream >> index;
-		indices.push_back(index);
-	}
+void cs2::PhysicsFile::compact()
+{
+	size_t bytes = 0;
+	for (auto& hull : hulls)
+		bytes += hull.getArenaBytes();
+
+	auto fresh = std::make_unique<Arena>();
+	fresh->reserve(bytes);
 
-	return indices;
+	std::vector<HullFile> compacted;
+	compacted.reserve(hulls.size());
+	for (auto& hull : hulls)
+		compacted.emplace_back(hull, HullFile::allocator_type(fresh.get()));
+
+	// The old hulls go first, then the arena they may point into.
+	hulls = std::move(compacted);
+	arena = std::move(fresh);
+
+	internSurfaceProps();
+}
+
+void cs2::PhysicsFile::internSurfaceProps()
+{
+	std::unordered_map<std::string_view, uint32_t> lookup;
+	surface_props.clear();
+	hull_surface_props.resize(hulls.size());
+	for (size_t i = 0; i < hulls.size(); i++)
+	{
+		auto [it, inserted] = lookup.try_emplace(hulls[i].surface_prop, static_cast<uint32_t>(surface_props.size()));
+		if (inserted)
+			surface_props.emplace_back(hulls[i].surface_prop);
+		hull_surface_props[i] = it->second;
+	}
 }
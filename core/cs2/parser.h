@@ -11,6 +11,26 @@
 #include <filesystem>
 #include <algorithm>
 #include <unordered_map>
+#include <unordered_set>
+#include <limits>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <bit>
+#include <iterator>
+#include <span>
+#include <memory>
+#include <memory_resource>
+
+#include "mapped_file.h"
+#include "scanner.h"
+#include "parallel.h"
+#include "kv3.h"
+#include "kv3_binary.h"
+#include "resource.h"
+#include "arena.h"
 
 namespace cs2
 {
@@ -30,16 +50,392 @@ namespace cs2
 		Triangle(Vec3 a, Vec3 b, Vec3 c) : a(a), b(b), c(c) {}
 	};
 
+	class Aabb {
+	public:
+		Vec3 min = Vec3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+		Vec3 max = Vec3(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+
+		Aabb() = default;
+		Aabb(Vec3 min, Vec3 max) : min(min), max(max) {}
+
+		bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+		void extend(const Vec3& p)
+		{
+			min = Vec3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+			max = Vec3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+		}
+
+		void extend(const Aabb& box)
+		{
+			if (box.isEmpty())
+				return;
+			extend(box.min);
+			extend(box.max);
+		}
+
+		bool overlaps(const Aabb& box) const
+		{
+			return min.x <= box.max.x && max.x >= box.min.x &&
+				min.y <= box.max.y && max.y >= box.min.y &&
+				min.z <= box.max.z && max.z >= box.min.z;
+		}
+	};
+
+	/// <summary>
+	/// Read-only sequence of the triangles of a hull. Indexed hulls are expanded
+	/// one triangle at a time while iterating, nothing is materialized.
+	/// </summary>
+	class TriangleView {
+	public:
+		class Iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = Triangle;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = Triangle;
+
+			Iterator(const TriangleView* view, size_t index) : view(view), index(index) {}
+
+			Triangle operator*() const { return (*view)[index]; }
+			Iterator& operator++() { index++; return *this; }
+			Iterator operator++(int) { Iterator it = *this; index++; return it; }
+			bool operator==(const Iterator& other) const { return index == other.index; }
+			bool operator!=(const Iterator& other) const { return index != other.index; }
+
+		private:
+			const TriangleView* view;
+			size_t index;
+		};
+
+		TriangleView() = default;
+		TriangleView(const Triangle* soup, size_t count) : soup(soup), count(count) {}
+		TriangleView(const Vec3* vertices, const uint16_t* indices, size_t count) : vertices(vertices), indices16(indices), count(count) {}
+		TriangleView(const Vec3* vertices, const uint32_t* indices, size_t count) : vertices(vertices), indices32(indices), count(count) {}
+
+		Triangle operator[](size_t i) const
+		{
+			if (soup)
+				return soup[i];
+			if (indices16)
+				return Triangle(vertices[indices16[i * 3]], vertices[indices16[i * 3 + 1]], vertices[indices16[i * 3 + 2]]);
+			return Triangle(vertices[indices32[i * 3]], vertices[indices32[i * 3 + 1]], vertices[indices32[i * 3 + 2]]);
+		}
+
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+
+		Iterator begin() const { return Iterator(this, 0); }
+		Iterator end() const { return Iterator(this, count); }
+
+	private:
+		const Triangle* soup = nullptr;
+		const Vec3* vertices = nullptr;
+		const uint16_t* indices16 = nullptr;
+		const uint32_t* indices32 = nullptr;
+		size_t count = 0;
+	};
+
+	/// <summary>
+	/// Read-only quantized mesh: 16-bit positions relative to the bounds of
+	/// the hull, and indices stored as zigzag varint deltas of the previous
+	/// index. Views point into a QuantizedMesh or a mapped geometry cache.
+	/// </summary>
+	class QuantizedView {
+	public:
+		Aabb bounds;
+		// x, y, z per vertex; position = bounds.min + q * getStep().
+		std::span<const uint16_t> positions;
+		std::span<const uint8_t> indices;
+		uint32_t index_count = 0;
+		// Largest per-axis distance between a decoded and an original position.
+		float error = 0.0f;
+
+		size_t getVertexCount() const { return positions.size() / 3; }
+		size_t getTriangleCount() const { return index_count / 3; }
+		bool empty() const { return index_count == 0; }
+
+		/// <summary>
+		/// Get the distance between two adjacent quantized positions along each axis.
+		/// </summary>
+		static Vec3 getStep(const Aabb& bounds)
+		{
+			return Vec3((bounds.max.x - bounds.min.x) / 65535.0f, (bounds.max.y - bounds.min.y) / 65535.0f, (bounds.max.z - bounds.min.z) / 65535.0f);
+		}
+
+		Vec3 getStep() const { return getStep(bounds); }
+
+		/// <summary>
+		/// Dequantize every vertex into output, which must hold getVertexCount() entries.
+		/// </summary>
+		void decodeVertices(Vec3* output) const;
+
+		/// <summary>
+		/// Decode every index into output, which must hold index_count entries.
+		/// </summary>
+		/// <returns>
+		/// Returns false if the stream is truncated or references a vertex out of range.
+		/// </returns>
+		bool decodeIndices(uint32_t* output) const;
+
+		/// <summary>
+		/// Decode the mesh into plain vertex and index buffers.
+		/// </summary>
+		bool decode(std::vector<Vec3>& vertexList, std::vector<uint32_t>& indexList) const
+		{
+			vertexList.resize(getVertexCount());
+			indexList.resize(index_count);
+			decodeVertices(vertexList.data());
+			return decodeIndices(indexList.data());
+		}
+
+		/// <summary>
+		/// Decode the mesh and call fn with every triangle.
+		/// </summary>
+		template<typename Fn>
+		void forEachTriangle(Fn&& fn) const
+		{
+			std::vector<Vec3> vertex_list;
+			std::vector<uint32_t> index_list;
+			if (!decode(vertex_list, index_list))
+				return;
+			for (size_t i = 0; i + 2 < index_list.size(); i += 3)
+				fn(Triangle(vertex_list[index_list[i]], vertex_list[index_list[i + 1]], vertex_list[index_list[i + 2]]));
+		}
+	};
+
+	/// <summary>
+	/// Owning storage for a quantized mesh, about a quarter of the size of
+	/// the expanded triangles.
+	/// </summary>
+	class QuantizedMesh {
+	public:
+		using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+		Aabb bounds;
+		std::pmr::vector<uint16_t> positions;
+		std::pmr::vector<uint8_t> indices;
+		uint32_t index_count = 0;
+		float error = 0.0f;
+
+		QuantizedMesh() = default;
+		explicit QuantizedMesh(const allocator_type& alloc) : positions(alloc), indices(alloc) {}
+		QuantizedMesh(const QuantizedMesh& other, const allocator_type& alloc) :
+			bounds(other.bounds), positions(other.positions, alloc), indices(other.indices, alloc),
+			index_count(other.index_count), error(other.error) {}
+		QuantizedMesh(const QuantizedMesh&) = default;
+		QuantizedMesh(QuantizedMesh&&) = default;
+		QuantizedMesh& operator=(const QuantizedMesh&) = default;
+		QuantizedMesh& operator=(QuantizedMesh&&) = default;
+
+		bool empty() const { return index_count == 0; }
+
+		/// <summary>
+		/// Quantize an indexed mesh. Every index must be less than vertices.size().
+		/// </summary>
+		static QuantizedMesh encode(std::span<const Vec3> vertices, std::span<const uint32_t> indices);
+
+		QuantizedView view() const
+		{
+			QuantizedView result;
+			result.bounds = bounds;
+			result.positions = positions;
+			result.indices = indices;
+			result.index_count = index_count;
+			result.error = error;
+			return result;
+		}
+
+		size_t getBytes() const { return positions.capacity() * sizeof(uint16_t) + indices.capacity(); }
+	};
+
+	/// <summary>
+	/// A hull and its geometry. Strings and buffers come from a polymorphic
+	/// allocator; hulls owned by a PhysicsFile live in its arena.
+	/// </summary>
 	class HullFile {
 	public:
-		std::string name;
-		std::string surface_prop;
-		std::vector<Triangle> triangles;
+		using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+		std::pmr::string name;
+		std::pmr::string surface_prop;
+
+		// Expanded triangles, filled unless the hull was loaded as an indexed mesh.
+		std::pmr::vector<Triangle> triangles;
+
+		// Indexed mesh: the vertex array of the hull file plus one of the index
+		// buffers, 16-bit when every index fits.
+		std::pmr::vector<Vec3> vertices;
+		std::pmr::vector<uint16_t> indices16;
+		std::pmr::vector<uint32_t> indices32;
+
+		// Quantized mesh, filled instead of all of the above after quantize().
+		QuantizedMesh quantized;
 
 		HullFile() = default;
-		HullFile(const std::string& name, const std::string& surface_prop) : name(name), surface_prop(surface_prop) {}
+		HullFile(std::string_view name, std::string_view surface_prop) : name(name), surface_prop(surface_prop) {}
+		explicit HullFile(const allocator_type& alloc) :
+			name(alloc), surface_prop(alloc), triangles(alloc), vertices(alloc), indices16(alloc), indices32(alloc), quantized(alloc) {}
+
+		/// <summary>
+		/// Copy a hull into another allocator. Buffers are sized to their contents.
+		/// </summary>
+		HullFile(const HullFile& other, const allocator_type& alloc) :
+			name(other.name, alloc), surface_prop(other.surface_prop, alloc), triangles(other.triangles, alloc),
+			vertices(other.vertices, alloc), indices16(other.indices16, alloc), indices32(other.indices32, alloc),
+			quantized(other.quantized, alloc) {}
+
+		HullFile(const HullFile&) = default;
+		HullFile(HullFile&&) = default;
+		HullFile& operator=(const HullFile&) = default;
+		HullFile& operator=(HullFile&&) = default;
+
+		bool isIndexed() const { return !vertices.empty(); }
+		bool isQuantized() const { return !quantized.empty(); }
+
+		/// <summary>
+		/// Get the triangles of the hull if they are stored expanded or indexed.
+		/// Quantized hulls have to be decoded, see forEachTriangle.
+		/// </summary>
+		/// <returns>
+		/// Returns a view that stays valid while the hull is not modified, empty
+		/// for quantized hulls.
+		/// </returns>
+		TriangleView getTriangles() const
+		{
+			if (!indices16.empty())
+				return TriangleView(vertices.data(), indices16.data(), indices16.size() / 3);
+			if (!indices32.empty())
+				return TriangleView(vertices.data(), indices32.data(), indices32.size() / 3);
+			return TriangleView(triangles.data(), triangles.size());
+		}
+
+		/// <summary>
+		/// Call fn with every triangle of the hull, whichever way they are stored.
+		/// Quantized hulls are decoded into temporary buffers first.
+		/// </summary>
+		template<typename Fn>
+		void forEachTriangle(Fn&& fn) const
+		{
+			if (isQuantized())
+			{
+				quantized.view().forEachTriangle(fn);
+				return;
+			}
+			for (auto tri : getTriangles())
+				fn(tri);
+		}
+
+		size_t getTriangleCount() const
+		{
+			if (isQuantized())
+				return quantized.index_count / 3;
+			return isIndexed() ? (indices16.size() + indices32.size()) / 3 : triangles.size();
+		}
+
+		/// <summary>
+		/// Get the bounds of the hull's triangles.
+		/// </summary>
+		Aabb getBounds() const
+		{
+			if (isQuantized())
+				return quantized.bounds;
+
+			Aabb bounds;
+			if (isIndexed())
+			{
+				for (auto& vertex : vertices)
+					bounds.extend(vertex);
+				return bounds;
+			}
+			for (auto& tri : triangles)
+			{
+				bounds.extend(tri.a);
+				bounds.extend(tri.b);
+				bounds.extend(tri.c);
+			}
+			return bounds;
+		}
+
+		/// <summary>
+		/// Replace the geometry with an indexed mesh. Triangles referencing
+		/// vertices out of range are dropped.
+		/// </summary>
+		void setIndexed(std::span<const Vec3> vertexList, const std::vector<int>& indexList);
+
+		/// <summary>
+		/// Replace the geometry with a quantized mesh. Expanded hulls have their
+		/// identical vertices shared first.
+		/// </summary>
+		void quantize();
+
+		/// <summary>
+		/// Replace a quantized mesh with the indexed mesh it decodes to.
+		/// </summary>
+		void dequantize();
+
+		/// <summary>
+		/// Get the bytes held by the geometry of the hull.
+		/// </summary>
+		size_t getGeometryBytes() const
+		{
+			return triangles.capacity() * sizeof(Triangle) + vertices.capacity() * sizeof(Vec3) +
+				indices16.capacity() * sizeof(uint16_t) + indices32.capacity() * sizeof(uint32_t) + quantized.getBytes();
+		}
+
+		/// <summary>
+		/// Get an upper bound of the bytes a copy of the hull takes from an arena.
+		/// </summary>
+		size_t getArenaBytes() const;
 	};
 	
+	class LoadStats {
+	public:
+		// Bytes served straight from memory-mapped files.
+		uint64_t bytes_mapped = 0;
+		// Bytes copied out of the mapped files into intermediate buffers.
+		uint64_t bytes_copied = 0;
+		// Wall time of the load, manifest and hulls included.
+		double seconds = 0.0;
+		// Hulls served from and missing in the parse cache (LoadOptions::cache_directory).
+		size_t cache_hits = 0;
+		size_t cache_misses = 0;
+	};
+
+	class LoadOptions {
+	public:
+		// Number of threads parsing hull files, zero for one per hardware thread.
+		unsigned threads = 1;
+		// Keep hulls as vertex + index buffers instead of expanding them to triangles.
+		bool indexed = false;
+		// Keep hulls as quantized meshes (see QuantizedMesh), overrides indexed.
+		bool quantized = false;
+		// Directory of the persistent parse cache (see HullCache), empty to always parse.
+		std::string cache_directory;
+	};
+
+	class WeldOptions {
+	public:
+		// Vertices closer than this are merged, and triangles thinner than this are dropped.
+		float tolerance = 0.01f;
+		// Number of threads cleaning up hulls, zero for one per hardware thread.
+		unsigned threads = 1;
+	};
+
+	class WeldStats {
+	public:
+		// Stored vertices before and after welding; soup hulls count three per triangle.
+		size_t vertices_before = 0;
+		size_t vertices_after = 0;
+		// Distinct welded positions per hull, summed. Matches vertices_after for indexed
+		// hulls and shows the merging done to soup hulls, which still store every corner.
+		size_t welded_vertices = 0;
+		size_t degenerate_triangles = 0;
+		size_t duplicate_triangles = 0;
+		double seconds = 0.0;
+	};
+
 	class PhysicsFile {
 	public:
 		/// <summary>
@@ -49,12 +445,17 @@ namespace cs2
 		/// The filename of the physics file.
 		/// </param>
 		/// <param name="workingDir">
-		/// The working directory of the physics file.
+		/// The working directory of the physics file. Compiled resources
+		/// (.vmdl_c, .vphys_c) are self-contained and ignore it.
+		/// </param>
+		/// <param name="options">
+		/// Options controlling how the hull files are parsed. The result does
+		/// not depend on the thread count.
 		/// </param>
 		/// <returns>
 		/// Returns true if the file was loaded successfully, false otherwise.
 		/// </returns>
-		bool load(const std::string& filename, const std::string& workingDir);
+		bool load(const std::string& filename, const std::string& workingDir, const LoadOptions& options = LoadOptions());
 
 		/// <summary>
 		/// Write the triangles of the physics file to a given filename.
@@ -64,6 +465,40 @@ namespace cs2
 		/// </param>
 		void writeTriangles(const std::string& filename);
 
+		/// <summary>
+		/// Write the hulls to a geometry cache file (see cache.h), which
+		/// GeometryCache maps back without parsing.
+		/// </summary>
+		/// <param name="filename">
+		/// The filename to write the cache to.
+		/// </param>
+		/// <returns>
+		/// Returns true if the cache was written successfully, false otherwise.
+		/// </returns>
+		bool writeCache(const std::string& filename) const;
+
+		/// <summary>
+		/// Weld vertices across all hulls and drop degenerate and duplicate
+		/// triangles. A triangle repeated in several hulls is kept in the first.
+		/// Hulls keep their representation (indexed, expanded or quantized).
+		/// </summary>
+		/// <param name="options">
+		/// The weld tolerance and thread count.
+		/// </param>
+		/// <returns>
+		/// Returns how many vertices and triangles were removed.
+		/// </returns>
+		WeldStats weld(const WeldOptions& options = WeldOptions());
+
+		/// <summary>
+		/// Move every hull into a fresh arena sized to fit them exactly, then
+		/// drop the old one, and intern the surface props. load() reads hull
+		/// files straight into an arena sized from their counts, and compacts
+		/// quantized hulls and compiled resources once they are built; call it
+		/// after edits such as weld() or quantize() to reclaim their leftovers.
+		/// </summary>
+		void compact();
+
 		/// <summary>
 		/// Display the statistics of the physics file.
 		/// </summary>
@@ -93,22 +528,56 @@ namespace cs2
 		/// </returns>
 		const std::string& getMapname() const { return mapname; }
 
+		/// <summary>
+		/// Get the I/O statistics of the last load.
+		/// </summary>
+		/// <returns>
+		/// Returns the bytes mapped and copied while loading.
+		/// </returns>
+		const LoadStats& getLoadStats() const { return stats; }
+
+		/// <summary>
+		/// Get how much of the arena holding the hulls is in use.
+		/// </summary>
+		/// <returns>
+		/// Returns the bytes reserved, used and left as slack.
+		/// </returns>
+		ArenaStats getArenaStats() const { return arena ? arena->getStats() : ArenaStats(); }
+
+		/// <summary>
+		/// Get the distinct surface props of the hulls, in order of first use.
+		/// Compiled resources only store name hashes (see hashToken); stock names
+		/// are resolved and any other prop is named by its hash, e.g. "0x1A2B3C4D".
+		/// </summary>
+		const std::vector<std::string>& getSurfaceProps() const { return surface_props; }
+
+		/// <summary>
+		/// Get the index into getSurfaceProps() of a hull's surface prop.
+		/// </summary>
+		uint32_t getSurfacePropId(size_t hull) const { return hull_surface_props[hull]; }
+
 	private:
 		std::string filename;
 		std::string mapname;
 
+		// Declared before the hulls so it outlives them.
+		std::unique_ptr<Arena> arena;
 		std::vector<HullFile> hulls;
 
-		void parseHull(HullFile& hull, const std::string& workingDir);
+		// Interned surface props, refreshed by load() and compact().
+		std::vector<std::string> surface_props;
+		std::vector<uint32_t> hull_surface_props;
+
+		LoadStats stats;
 
-		std::vector<Vec3> parseVertices(const std::string& input);
-		std::vector<int> parseIndices(const std::string& input);
+		bool loadCompiled(const std::string& filename, const LoadOptions& options);
+		void internSurfaceProps();
 
-		inline std::string removePath(const std::string& path) {
+		inline std::string removePath(std::string_view path) {
 			auto pos = path.find_last_of("/\\");
 			if (pos == std::string::npos)
-				return path;
-			return path.substr(pos + 1);
+				return std::string(path);
+			return std::string(path.substr(pos + 1));
 		}
 	};
 } // namespace cs2
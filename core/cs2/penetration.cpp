@@ -0,0 +1,77 @@
+#include "penetration.h"
+
+#include <algorithm>
+
+cs2::PenetrationTracer::PenetrationTracer(const PhysicsFile& physics, const Raycaster& raycaster) :
+	raycaster(raycaster), surface_props(physics.getSurfaceProps().size())
+{
+}
+
+bool cs2::PenetrationTracer::trace(const Vec3& start, const Vec3& end, Penetration& result) const
+{
+	result.intervals.clear();
+	result.thickness.assign(surface_props, 0.0f);
+	result.total = 0.0f;
+	result.unpaired = 0;
+
+	std::vector<RayHit>& hits = result.hits;
+	if (raycaster.segmentAll(start, end, hits) == 0)
+		return false;
+
+	// Follow each hull on its own; stable so equal distances keep the triangle order.
+	std::stable_sort(hits.begin(), hits.end(), [](const RayHit& a, const RayHit& b) { return a.hull < b.hull; });
+
+	size_t i = 0;
+	while (i < hits.size())
+	{
+		const uint32_t hull = hits[i].hull;
+		int depth = 0;
+		bool unpaired = false;
+		PenetrationInterval interval;
+		interval.hull = hull;
+		interval.surface_prop = hits[i].surface_prop;
+
+		while (i < hits.size() && hits[i].hull == hull)
+		{
+			// Hits at the same spot are one crossing unless they cancel out (a graze).
+			const float distance = hits[i].distance;
+			int facing = 0;
+			for (; i < hits.size() && hits[i].hull == hull && hits[i].distance - distance < kCoincident; i++)
+				facing += hits[i].front_face ? 1 : -1;
+			if (facing == 0)
+				continue;
+
+			if (facing > 0)
+			{
+				if (depth++ == 0)
+					interval.enter = distance;
+			}
+			else if (depth == 0)
+			{
+				// Leaving without having entered: the start is inside, or this is the back of an open surface.
+				unpaired = true;
+			}
+			else if (--depth == 0)
+			{
+				interval.exit = distance;
+				result.intervals.push_back(interval);
+			}
+		}
+
+		if (unpaired || depth > 0)
+			result.unpaired++;
+	}
+
+	std::sort(result.intervals.begin(), result.intervals.end(), [](const PenetrationInterval& a, const PenetrationInterval& b) {
+		return a.enter < b.enter || (a.enter == b.enter && a.hull < b.hull);
+	});
+
+	for (const PenetrationInterval& interval : result.intervals)
+	{
+		float thickness = interval.getThickness();
+		if (interval.surface_prop < result.thickness.size())
+			result.thickness[interval.surface_prop] += thickness;
+		result.total += thickness;
+	}
+	return !result.intervals.empty();
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "raycast.h"
+
+namespace cs2
+{
+	class PenetrationInterval {
+	public:
+		// Distances from the segment start where it enters and leaves the hull.
+		float enter = 0.0f;
+		float exit = 0.0f;
+		uint32_t hull = 0;
+		// Index into PhysicsFile::getSurfaceProps.
+		uint32_t surface_prop = 0;
+
+		float getThickness() const { return exit - enter; }
+	};
+
+	class Penetration {
+	public:
+		// Every stretch of the segment inside a hull, ordered by where it enters.
+		std::vector<PenetrationInterval> intervals;
+		// Total distance travelled inside hulls, per surface prop id.
+		std::vector<float> thickness;
+		// Sum of thickness; hulls that overlap each count their own stretch.
+		float total = 0.0f;
+		// Hulls with a crossing that could not be paired with an entry or an exit.
+		size_t unpaired = 0;
+		// Every crossing of the last trace, grouped by hull. Kept with the result
+		// so that tracing into the same result does not allocate again.
+		std::vector<RayHit> hits;
+	};
+
+	/// <summary>
+	/// Measures how much material a segment passes through, e.g. to estimate
+	/// wall-bang damage. The hits of an all-hits query are turned into entry
+	/// and exit intervals per hull by their facing: triangles are wound with
+	/// their front facing out, so a front face hit enters the hull and a back
+	/// face hit leaves it. A depth count per hull keeps mesh shapes right: shells
+	/// that overlap give one interval over both, and the air between separate
+	/// surfaces of one mesh is never counted. Crossings that do not pair up are
+	/// not counted: an endpoint lies inside the hull, the hull is an open
+	/// surface seen from one side, or the segment slipped through a crack
+	/// between two triangles, and these cannot be told apart.
+	///
+	/// A segment passing exactly through an edge hits both triangles sharing
+	/// it; crossings of one hull at the same distance with the same facing are
+	/// merged into one, and a segment grazing a hull (one front and one back
+	/// face at the same distance) does not enter it.
+	/// </summary>
+	class PenetrationTracer {
+	public:
+		// Crossings of one hull closer together than this are treated as the same crossing.
+		static constexpr float kCoincident = 1e-3f;
+
+		/// <param name="physics">
+		/// The physics file the BVH was built from, for the number of surface props.
+		/// </param>
+		/// <param name="raycaster">
+		/// The raycaster to query, which must outlive the tracer.
+		/// </param>
+		PenetrationTracer(const PhysicsFile& physics, const Raycaster& raycaster);
+
+		/// <summary>
+		/// Find the material between two points.
+		/// </summary>
+		/// <param name="start">
+		/// The start of the segment, which should lie outside every hull.
+		/// </param>
+		/// <param name="end">
+		/// The end of the segment, which should also lie outside every hull.
+		/// </param>
+		/// <param name="result">
+		/// Receives the intervals and the thickness per surface prop. Reusing the
+		/// same result across calls avoids reallocating, including the hit buffer;
+		/// threads sharing the tracer each need their own result.
+		/// </param>
+		/// <returns>
+		/// Returns true if the segment passes through any material, false otherwise.
+		/// </returns>
+		bool trace(const Vec3& start, const Vec3& end, Penetration& result) const;
+
+	private:
+		const Raycaster& raycaster;
+		size_t surface_props;
+	};
+} // namespace cs2
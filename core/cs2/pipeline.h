@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace cs2
+{
+	/// <summary>
+	/// Fixed-capacity queue between two pipeline stages. push blocks while the
+	/// queue is full, which caps how much work (and memory) sits between stages.
+	/// </summary>
+	template <typename T>
+	class BoundedQueue {
+	public:
+		explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(capacity, 1)) {}
+
+		/// <summary>
+		/// Add an item, waiting for room.
+		/// </summary>
+		/// <returns>
+		/// Returns false if the queue was closed, the item is dropped.
+		/// </returns>
+		bool push(T item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+			if (closed)
+				return false;
+
+			items.push_back(std::move(item));
+			not_empty.notify_one();
+			return true;
+		}
+
+		/// <summary>
+		/// Take the oldest item, waiting for one.
+		/// </summary>
+		/// <returns>
+		/// Returns false once the queue is closed and drained.
+		/// </returns>
+		bool pop(T& item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			not_empty.wait(lock, [&] { return closed || !items.empty(); });
+			if (items.empty())
+				return false;
+
+			item = std::move(items.front());
+			items.pop_front();
+			not_full.notify_one();
+			return true;
+		}
+
+		/// <summary>
+		/// Stop accepting items. Consumers drain what is left, then pop returns false.
+		/// </summary>
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+			not_empty.notify_all();
+			not_full.notify_all();
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable not_empty;
+		std::condition_variable not_full;
+		std::deque<T> items;
+		size_t capacity;
+		bool closed = false;
+	};
+
+	/// <summary>
+	/// Pool of thread tokens shared by concurrent stages, so the stages together
+	/// never run more threads than the budget however their work overlaps.
+	/// </summary>
+	class ThreadBudget {
+	public:
+		explicit ThreadBudget(unsigned total) : available(std::max(total, 1u)) {}
+
+		/// <summary>
+		/// Take up to wanted tokens, waiting until at least one is free.
+		/// </summary>
+		/// <returns>
+		/// Returns the number of tokens taken, to be passed to release.
+		/// </returns>
+		unsigned acquire(unsigned wanted)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			released.wait(lock, [&] { return available > 0; });
+
+			unsigned taken = std::clamp(wanted, 1u, available);
+			available -= taken;
+			return taken;
+		}
+
+		void release(unsigned count)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			available += count;
+			released.notify_all();
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable released;
+		unsigned available;
+	};
+} // namespace cs2
@@ -0,0 +1,235 @@
+#include "parser.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CS2_QUANTIZE_SSE2 1
+#endif
+
+namespace
+{
+	struct VertexKey {
+		uint32_t x, y, z;
+
+		bool operator==(const VertexKey& other) const { return x == other.x && y == other.y && z == other.z; }
+	};
+
+	struct VertexKeyHash {
+		size_t operator()(const VertexKey& key) const
+		{
+			uint64_t h = key.x * 0x9E3779B97F4A7C15ull;
+			h ^= (h >> 29) ^ key.y * 0xBF58476D1CE4E5B9ull;
+			h ^= (h >> 31) ^ key.z * 0x94D049BB133111EBull;
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+	};
+
+	uint16_t quantizeAxis(float value, float min, float inverse_step)
+	{
+		float q = std::round((value - min) * inverse_step);
+		return static_cast<uint16_t>(std::clamp(q, 0.0f, 65535.0f));
+	}
+
+	// Must match the arithmetic of the SIMD path exactly, error bounds depend on it.
+	float dequantizeAxis(uint16_t q, float min, float step)
+	{
+		return static_cast<float>(q) * step + min;
+	}
+}
+
+cs2::QuantizedMesh cs2::QuantizedMesh::encode(std::span<const Vec3> vertices, std::span<const uint32_t> indices)
+{
+	QuantizedMesh mesh;
+	if (indices.empty())
+		return mesh;
+
+	for (auto& vertex : vertices)
+		mesh.bounds.extend(vertex);
+
+	Vec3 min = mesh.bounds.min;
+	Vec3 step = QuantizedView::getStep(mesh.bounds);
+	Vec3 inverse(step.x > 0.0f ? 1.0f / step.x : 0.0f, step.y > 0.0f ? 1.0f / step.y : 0.0f, step.z > 0.0f ? 1.0f / step.z : 0.0f);
+
+	mesh.positions.resize(vertices.size() * 3);
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vec3& v = vertices[i];
+		uint16_t* q = &mesh.positions[i * 3];
+		q[0] = quantizeAxis(v.x, min.x, inverse.x);
+		q[1] = quantizeAxis(v.y, min.y, inverse.y);
+		q[2] = quantizeAxis(v.z, min.z, inverse.z);
+
+		mesh.error = std::max({ mesh.error,
+			std::abs(dequantizeAxis(q[0], min.x, step.x) - v.x),
+			std::abs(dequantizeAxis(q[1], min.y, step.y) - v.y),
+			std::abs(dequantizeAxis(q[2], min.z, step.z) - v.z) });
+	}
+
+	// Neighbouring indices are usually close, so their zigzag deltas fit in one byte.
+	mesh.indices.reserve(indices.size() + indices.size() / 4);
+	int64_t previous = 0;
+	for (auto index : indices)
+	{
+		int64_t delta = static_cast<int64_t>(index) - previous;
+		uint64_t value = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+		while (value >= 0x80)
+		{
+			mesh.indices.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		mesh.indices.push_back(static_cast<uint8_t>(value));
+		previous = index;
+	}
+
+	mesh.indices.shrink_to_fit();
+	mesh.index_count = static_cast<uint32_t>(indices.size());
+
+	return mesh;
+}
+
+void cs2::QuantizedView::decodeVertices(Vec3* output) const
+{
+	const size_t count = getVertexCount();
+	const uint16_t* input = positions.data();
+	float* out = reinterpret_cast<float*>(output);
+
+	const Vec3 min = bounds.min;
+	const Vec3 step = getStep();
+	size_t i = 0;
+
+#ifdef CS2_QUANTIZE_SSE2
+	// Four vertices are twelve values; the x, y, z pattern repeats every three registers.
+	const __m128 step0 = _mm_setr_ps(step.x, step.y, step.z, step.x);
+	const __m128 step1 = _mm_setr_ps(step.y, step.z, step.x, step.y);
+	const __m128 step2 = _mm_setr_ps(step.z, step.x, step.y, step.z);
+	const __m128 min0 = _mm_setr_ps(min.x, min.y, min.z, min.x);
+	const __m128 min1 = _mm_setr_ps(min.y, min.z, min.x, min.y);
+	const __m128 min2 = _mm_setr_ps(min.z, min.x, min.y, min.z);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * 3));
+		__m128i high = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(input + i * 3 + 8));
+
+		__m128 f0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+		__m128 f1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+		__m128 f2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+
+		_mm_storeu_ps(out + i * 3, _mm_add_ps(_mm_mul_ps(f0, step0), min0));
+		_mm_storeu_ps(out + i * 3 + 4, _mm_add_ps(_mm_mul_ps(f1, step1), min1));
+		_mm_storeu_ps(out + i * 3 + 8, _mm_add_ps(_mm_mul_ps(f2, step2), min2));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		output[i] = Vec3(
+			dequantizeAxis(input[i * 3], min.x, step.x),
+			dequantizeAxis(input[i * 3 + 1], min.y, step.y),
+			dequantizeAxis(input[i * 3 + 2], min.z, step.z));
+	}
+}
+
+bool cs2::QuantizedView::decodeIndices(uint32_t* output) const
+{
+	const uint8_t* input = indices.data();
+	const size_t size = indices.size();
+	const int64_t vertex_count = static_cast<int64_t>(getVertexCount());
+
+	size_t pos = 0;
+	int64_t previous = 0;
+
+	for (uint32_t i = 0; i < index_count; i++)
+	{
+		uint64_t value = 0;
+		for (unsigned shift = 0;; shift += 7)
+		{
+			if (pos >= size || shift > 35)
+				return false;
+
+			uint8_t byte = input[pos++];
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				break;
+		}
+
+		previous += static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+		if (previous < 0 || previous >= vertex_count)
+			return false;
+
+		output[i] = static_cast<uint32_t>(previous);
+	}
+
+	return true;
+}
+
+void cs2::HullFile::quantize()
+{
+	if (isQuantized())
+		return;
+
+	std::vector<Vec3> vertex_list;
+	std::vector<uint32_t> index_list;
+
+	if (isIndexed())
+	{
+		index_list.assign(indices16.begin(), indices16.end());
+		index_list.insert(index_list.end(), indices32.begin(), indices32.end());
+		quantized = QuantizedMesh::encode(vertices, index_list);
+	}
+	else
+	{
+		// Expanded triangles repeat their corners; share identical positions.
+		std::unordered_map<VertexKey, uint32_t, VertexKeyHash> lookup;
+		lookup.reserve(triangles.size() * 3 / 2);
+		index_list.reserve(triangles.size() * 3);
+
+		auto add = [&](const Vec3& v) {
+			VertexKey key = { std::bit_cast<uint32_t>(v.x), std::bit_cast<uint32_t>(v.y), std::bit_cast<uint32_t>(v.z) };
+			auto [it, inserted] = lookup.try_emplace(key, static_cast<uint32_t>(vertex_list.size()));
+			if (inserted)
+				vertex_list.push_back(v);
+			index_list.push_back(it->second);
+		};
+
+		for (auto& tri : triangles)
+		{
+			add(tri.a);
+			add(tri.b);
+			add(tri.c);
+		}
+
+		quantized = QuantizedMesh::encode(vertex_list, index_list);
+	}
+
+	triangles.clear();
+	triangles.shrink_to_fit();
+	vertices.clear();
+	vertices.shrink_to_fit();
+	indices16.clear();
+	indices16.shrink_to_fit();
+	indices32.clear();
+	indices32.shrink_to_fit();
+}
+
+void cs2::HullFile::dequantize()
+{
+	if (!isQuantized())
+		return;
+
+	std::vector<Vec3> vertex_list;
+	std::vector<uint32_t> index_list;
+	bool valid = quantized.view().decode(vertex_list, index_list);
+	quantized = QuantizedMesh();
+
+	if (!valid)
+		return;
+
+	// Decoding already rejected indices out of range, so they are stored as they are,
+	// in 16 bits when every vertex is reachable that way, as setIndexed does.
+	vertices.assign(vertex_list.begin(), vertex_list.end());
+	if (vertices.size() <= 0x10000)
+		indices16.assign(index_list.begin(), index_list.end());
+	else
+		indices32.assign(index_list.begin(), index_list.end());
+}
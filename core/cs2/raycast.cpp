@@ -0,0 +1,803 @@
+#include "raycast.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+#include "parallel.h"
+
+namespace
+{
+	// Direction components closer to zero than this are nudged away from it, so
+	// the reciprocal stays finite and slab tests never compute 0 * inf.
+	constexpr float kMinDirection = 1e-20f;
+
+	struct Ray {
+		float origin[3];
+		float direction[3];
+		float inverse[3];
+		bool negative[3];
+		float max_distance;
+	};
+
+	bool makeRay(const cs2::Vec3& origin, const cs2::Vec3& direction, float maxDistance, Ray& ray)
+	{
+		float length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+		if (!(length > 0.0f) || !(maxDistance > 0.0f))
+			return false;
+
+		const float origin_values[3] = { origin.x, origin.y, origin.z };
+		const float direction_values[3] = { direction.x, direction.y, direction.z };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float d = direction_values[axis] / length;
+			ray.origin[axis] = origin_values[axis];
+			ray.direction[axis] = d;
+			if (std::fabs(d) < kMinDirection)
+				d = std::copysign(kMinDirection, d);
+			ray.inverse[axis] = 1.0f / d;
+			ray.negative[axis] = ray.inverse[axis] < 0.0f;
+		}
+		ray.max_distance = maxDistance;
+		return true;
+	}
+
+	// Node kernels store the entry distance of each child in near and return a
+	// mask of the children the ray enters before maxDistance. Picking the near
+	// and far planes by the ray's sign also rejects the inverted bounds of
+	// empty children.
+	int testNodeScalar(const cs2::BvhNode& node, const Ray& ray, float maxDistance, float near[4])
+	{
+		const float* near_x = ray.negative[0] ? node.max_x : node.min_x;
+		const float* near_y = ray.negative[1] ? node.max_y : node.min_y;
+		const float* near_z = ray.negative[2] ? node.max_z : node.min_z;
+		const float* far_x = ray.negative[0] ? node.min_x : node.max_x;
+		const float* far_y = ray.negative[1] ? node.min_y : node.max_y;
+		const float* far_z = ray.negative[2] ? node.min_z : node.max_z;
+
+		int mask = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			float tn = std::max(std::max((near_x[i] - ray.origin[0]) * ray.inverse[0], (near_y[i] - ray.origin[1]) * ray.inverse[1]),
+				std::max((near_z[i] - ray.origin[2]) * ray.inverse[2], 0.0f));
+			float tf = std::min(std::min((far_x[i] - ray.origin[0]) * ray.inverse[0], (far_y[i] - ray.origin[1]) * ray.inverse[1]),
+				std::min((far_z[i] - ray.origin[2]) * ray.inverse[2], maxDistance));
+			near[i] = tn;
+			if (tn <= tf)
+				mask |= 1 << i;
+		}
+		return mask;
+	}
+
+	// Block kernels store the hit distance of each lane in t and return a mask
+	// of the lanes hit in (0, maxDistance). Padding lanes have zero area and
+	// are rejected by the determinant.
+	int testBlockScalar(const cs2::TriangleBlock& block, const Ray& ray, float maxDistance, float t[8])
+	{
+		const float dx = ray.direction[0], dy = ray.direction[1], dz = ray.direction[2];
+		int mask = 0;
+
+		for (int i = 0; i < 8; i++)
+		{
+			float e1x = block.bx[i] - block.ax[i], e1y = block.by[i] - block.ay[i], e1z = block.bz[i] - block.az[i];
+			float e2x = block.cx[i] - block.ax[i], e2y = block.cy[i] - block.ay[i], e2z = block.cz[i] - block.az[i];
+
+			float px = dy * e2z - dz * e2y, py = dz * e2x - dx * e2z, pz = dx * e2y - dy * e2x;
+			float det = e1x * px + e1y * py + e1z * pz;
+			float inv = 1.0f / det;
+
+			float sx = ray.origin[0] - block.ax[i], sy = ray.origin[1] - block.ay[i], sz = ray.origin[2] - block.az[i];
+			float u = (sx * px + sy * py + sz * pz) * inv;
+
+			float qx = sy * e1z - sz * e1y, qy = sz * e1x - sx * e1z, qz = sx * e1y - sy * e1x;
+			float v = (dx * qx + dy * qy + dz * qz) * inv;
+			float distance = (e2x * qx + e2y * qy + e2z * qz) * inv;
+
+			t[i] = distance;
+			if (det != 0.0f && u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance > 0.0f && distance < maxDistance)
+				mask |= 1 << i;
+		}
+
+		return mask;
+	}
+
+#ifdef CS2_SIMD_X86
+	CS2_TARGET_SSE4 int testNodeSse4(const cs2::BvhNode& node, const Ray& ray, float maxDistance, float near[4])
+	{
+		const __m128 ox = _mm_set1_ps(ray.origin[0]), oy = _mm_set1_ps(ray.origin[1]), oz = _mm_set1_ps(ray.origin[2]);
+		const __m128 ix = _mm_set1_ps(ray.inverse[0]), iy = _mm_set1_ps(ray.inverse[1]), iz = _mm_set1_ps(ray.inverse[2]);
+
+		__m128 near_x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negative[0] ? node.max_x : node.min_x), ox), ix);
+		__m128 near_y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negative[1] ? node.max_y : node.min_y), oy), iy);
+		__m128 near_z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negative[2] ? node.max_z : node.min_z), oz), iz);
+		__m128 far_x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negative[0] ? node.min_x : node.max_x), ox), ix);
+		__m128 far_y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negative[1] ? node.min_y : node.max_y), oy), iy);
+		__m128 far_z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(ray.negative[2] ? node.min_z : node.max_z), oz), iz);
+
+		__m128 tn = _mm_max_ps(_mm_max_ps(near_x, near_y), _mm_max_ps(near_z, _mm_setzero_ps()));
+		__m128 tf = _mm_min_ps(_mm_min_ps(far_x, far_y), _mm_min_ps(far_z, _mm_set1_ps(maxDistance)));
+
+		_mm_storeu_ps(near, tn);
+		return _mm_movemask_ps(_mm_cmple_ps(tn, tf));
+	}
+
+	CS2_TARGET_SSE4 int testBlockSse4(const cs2::TriangleBlock& block, const Ray& ray, float maxDistance, float t[8])
+	{
+		const __m128 dx = _mm_set1_ps(ray.direction[0]), dy = _mm_set1_ps(ray.direction[1]), dz = _mm_set1_ps(ray.direction[2]);
+		const __m128 ox = _mm_set1_ps(ray.origin[0]), oy = _mm_set1_ps(ray.origin[1]), oz = _mm_set1_ps(ray.origin[2]);
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), max_distance = _mm_set1_ps(maxDistance);
+		int mask = 0;
+
+		for (int half = 0; half < 8; half += 4)
+		{
+			__m128 ax = _mm_load_ps(block.ax + half), ay = _mm_load_ps(block.ay + half), az = _mm_load_ps(block.az + half);
+			__m128 e1x = _mm_sub_ps(_mm_load_ps(block.bx + half), ax);
+			__m128 e1y = _mm_sub_ps(_mm_load_ps(block.by + half), ay);
+			__m128 e1z = _mm_sub_ps(_mm_load_ps(block.bz + half), az);
+			__m128 e2x = _mm_sub_ps(_mm_load_ps(block.cx + half), ax);
+			__m128 e2y = _mm_sub_ps(_mm_load_ps(block.cy + half), ay);
+			__m128 e2z = _mm_sub_ps(_mm_load_ps(block.cz + half), az);
+
+			__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+			__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+			__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+			__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+			__m128 inv = _mm_div_ps(one, det);
+
+			__m128 sx = _mm_sub_ps(ox, ax), sy = _mm_sub_ps(oy, ay), sz = _mm_sub_ps(oz, az);
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv);
+
+			__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+			__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+			__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+			__m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+
+			__m128 hit = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_cmpge_ps(u, zero));
+			hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+			hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			hit = _mm_and_ps(hit, _mm_cmpgt_ps(distance, zero));
+			hit = _mm_and_ps(hit, _mm_cmplt_ps(distance, max_distance));
+
+			_mm_storeu_ps(t + half, distance);
+			mask |= _mm_movemask_ps(hit) << half;
+		}
+
+		return mask;
+	}
+
+	CS2_TARGET_AVX2 int testBlockAvx2(const cs2::TriangleBlock& block, const Ray& ray, float maxDistance, float t[8])
+	{
+		const __m256 dx = _mm256_set1_ps(ray.direction[0]), dy = _mm256_set1_ps(ray.direction[1]), dz = _mm256_set1_ps(ray.direction[2]);
+		const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+
+		__m256 ax = _mm256_load_ps(block.ax), ay = _mm256_load_ps(block.ay), az = _mm256_load_ps(block.az);
+		__m256 e1x = _mm256_sub_ps(_mm256_load_ps(block.bx), ax);
+		__m256 e1y = _mm256_sub_ps(_mm256_load_ps(block.by), ay);
+		__m256 e1z = _mm256_sub_ps(_mm256_load_ps(block.bz), az);
+		__m256 e2x = _mm256_sub_ps(_mm256_load_ps(block.cx), ax);
+		__m256 e2y = _mm256_sub_ps(_mm256_load_ps(block.cy), ay);
+		__m256 e2z = _mm256_sub_ps(_mm256_load_ps(block.cz), az);
+
+		__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+		__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+		__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+		__m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+		__m256 inv = _mm256_div_ps(one, det);
+
+		__m256 sx = _mm256_sub_ps(_mm256_set1_ps(ray.origin[0]), ax);
+		__m256 sy = _mm256_sub_ps(_mm256_set1_ps(ray.origin[1]), ay);
+		__m256 sz = _mm256_sub_ps(_mm256_set1_ps(ray.origin[2]), az);
+		__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inv);
+
+		__m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+		__m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+		__m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+		__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inv);
+		__m256 distance = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inv);
+
+		__m256 hit = _mm256_and_ps(_mm256_cmp_ps(det, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+		hit = _mm256_and_ps(hit, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+		hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+		hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, zero, _CMP_GT_OQ));
+		hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, _mm256_set1_ps(maxDistance), _CMP_LT_OQ));
+
+		_mm256_storeu_ps(t, distance);
+		return _mm256_movemask_ps(hit);
+	}
+#endif
+
+	struct ScalarKernel {
+		static int testNode(const cs2::BvhNode& node, const Ray& ray, float maxDistance, float near[4]) { return testNodeScalar(node, ray, maxDistance, near); }
+		static int testBlock(const cs2::TriangleBlock& block, const Ray& ray, float maxDistance, float t[8]) { return testBlockScalar(block, ray, maxDistance, t); }
+	};
+
+#ifdef CS2_SIMD_X86
+	struct Sse4Kernel {
+		static int testNode(const cs2::BvhNode& node, const Ray& ray, float maxDistance, float near[4]) { return testNodeSse4(node, ray, maxDistance, near); }
+		static int testBlock(const cs2::TriangleBlock& block, const Ray& ray, float maxDistance, float t[8]) { return testBlockSse4(block, ray, maxDistance, t); }
+	};
+
+	struct Avx2Kernel {
+		static int testNode(const cs2::BvhNode& node, const Ray& ray, float maxDistance, float near[4]) { return testNodeSse4(node, ray, maxDistance, near); }
+		static int testBlock(const cs2::TriangleBlock& block, const Ray& ray, float maxDistance, float t[8]) { return testBlockAvx2(block, ray, maxDistance, t); }
+	};
+#endif
+
+	void fillHit(const cs2::Bvh& bvh, const Ray& ray, size_t lane, float distance, cs2::RayHit& hit)
+	{
+		const cs2::TriangleSoup& soup = bvh.getSoup();
+		cs2::Triangle tri = soup.get(lane);
+		float e1x = tri.b.x - tri.a.x, e1y = tri.b.y - tri.a.y, e1z = tri.b.z - tri.a.z;
+		float e2x = tri.c.x - tri.a.x, e2y = tri.c.y - tri.a.y, e2z = tri.c.z - tri.a.z;
+		float nx = e1y * e2z - e1z * e2y, ny = e1z * e2x - e1x * e2z, nz = e1x * e2y - e1y * e2x;
+
+		hit.distance = distance;
+		hit.triangle = bvh.getSourceIndex(lane);
+		hit.hull = soup.getHull(lane);
+		hit.surface_prop = soup.getSurfaceProp(lane);
+		hit.front_face = ray.direction[0] * nx + ray.direction[1] * ny + ray.direction[2] * nz < 0.0f;
+	}
+
+	// Walk the BVH front to back. Nearest-hit queries shrink the ray to the best
+	// hit so far and skip subtrees entered beyond it; any-hit queries stop at the
+	// first hit and report the block it was found in. Ties go to the lowest
+	// lane, so every kernel picks the same triangle.
+	template<typename Kernel, bool AnyHit>
+	bool traverse(const cs2::Bvh& bvh, const Ray& ray, cs2::RayHit* hit, uint32_t* hitBlock)
+	{
+		struct Entry {
+			uint32_t node;
+			float distance;
+		};
+
+		const std::vector<cs2::BvhNode>& nodes = bvh.getNodes();
+		const std::vector<cs2::TriangleBlock>& blocks = bvh.getSoup().getBlocks();
+		if (nodes.empty())
+			return false;
+
+		Entry stack[cs2::Bvh::kStackSize];
+		size_t depth = 0;
+		stack[depth++] = Entry{ 0, 0.0f };
+
+		float best = ray.max_distance;
+		size_t best_lane = cs2::TriangleSoup::kPadding;
+
+		while (depth > 0)
+		{
+			Entry entry = stack[--depth];
+			if (entry.distance > best)
+				continue;
+
+			if (cs2::Bvh::isLeaf(entry.node))
+			{
+				uint32_t first = cs2::Bvh::getLeafFirstBlock(entry.node);
+				uint32_t last = first + cs2::Bvh::getLeafBlockCount(entry.node);
+				for (uint32_t b = first; b < last; b++)
+				{
+					alignas(32) float t[8];
+					int mask = Kernel::testBlock(blocks[b], ray, best, t);
+					if (AnyHit && mask)
+					{
+						if (hitBlock)
+							*hitBlock = b;
+						return true;
+					}
+
+					while (mask)
+					{
+						int lane = std::countr_zero(static_cast<unsigned>(mask));
+						mask &= mask - 1;
+						if (t[lane] < best)
+						{
+							best = t[lane];
+							best_lane = static_cast<size_t>(b) * cs2::TriangleSoup::kLanes + lane;
+						}
+					}
+				}
+				continue;
+			}
+
+			const cs2::BvhNode& node = nodes[entry.node];
+			alignas(16) float near[4];
+			int mask = Kernel::testNode(node, ray, best, near);
+			if (!mask)
+				continue;
+
+			// Push the entered children farthest first so the nearest is popped next.
+			Entry children[4];
+			size_t count = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				if (!(mask & (1 << i)))
+					continue;
+
+				Entry child{ node.children[i], near[i] };
+				size_t j = count++;
+				for (; j > 0 && children[j - 1].distance < child.distance; j--)
+					children[j] = children[j - 1];
+				children[j] = child;
+			}
+
+			for (size_t i = 0; i < count; i++)
+				stack[depth++] = children[i];
+		}
+
+		if (AnyHit || best_lane == cs2::TriangleSoup::kPadding)
+			return false;
+
+		fillHit(bvh, ray, best_lane, best, *hit);
+		return true;
+	}
+
+	// Collect every triangle the ray hits before its max distance, in no
+	// particular order. Nothing can be pruned, so children are pushed as found.
+	template<typename Kernel>
+	void traverseAll(const cs2::Bvh& bvh, const Ray& ray, std::vector<cs2::RayHit>& hits)
+	{
+		const std::vector<cs2::BvhNode>& nodes = bvh.getNodes();
+		const std::vector<cs2::TriangleBlock>& blocks = bvh.getSoup().getBlocks();
+		if (nodes.empty())
+			return;
+
+		uint32_t stack[cs2::Bvh::kStackSize];
+		size_t depth = 0;
+		stack[depth++] = 0;
+
+		while (depth > 0)
+		{
+			uint32_t index = stack[--depth];
+			if (cs2::Bvh::isLeaf(index))
+			{
+				uint32_t first = cs2::Bvh::getLeafFirstBlock(index);
+				uint32_t last = first + cs2::Bvh::getLeafBlockCount(index);
+				for (uint32_t b = first; b < last; b++)
+				{
+					alignas(32) float t[8];
+					int mask = Kernel::testBlock(blocks[b], ray, ray.max_distance, t);
+					while (mask)
+					{
+						int lane = std::countr_zero(static_cast<unsigned>(mask));
+						mask &= mask - 1;
+						fillHit(bvh, ray, static_cast<size_t>(b) * cs2::TriangleSoup::kLanes + lane, t[lane], hits.emplace_back());
+					}
+				}
+				continue;
+			}
+
+			const cs2::BvhNode& node = nodes[index];
+			alignas(16) float near[4];
+			int mask = Kernel::testNode(node, ray, ray.max_distance, near);
+			for (int i = 0; i < 4; i++)
+			{
+				if (mask & (1 << i))
+					stack[depth++] = node.children[i];
+			}
+		}
+	}
+
+#ifdef CS2_SIMD_X86
+	// Up to eight segments sharing a direction octant, traced together so each
+	// node is fetched and tested once for all of them. Unused lanes have a
+	// negative length and never enter a node.
+	struct RayPacket {
+		alignas(32) float origin[3][8];
+		alignas(32) float inverse[3][8];
+		alignas(32) float max_distance[8];
+		bool negative[3];
+		const Ray* rays[8];
+		int count;
+	};
+
+	void initPacket(RayPacket& packet)
+	{
+		for (int lane = 0; lane < 8; lane++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				packet.origin[axis][lane] = 0.0f;
+				packet.inverse[axis][lane] = 1.0f;
+			}
+			packet.max_distance[lane] = -1.0f;
+		}
+		packet.count = 0;
+	}
+
+	void addToPacket(RayPacket& packet, const Ray& ray)
+	{
+		int lane = packet.count++;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			packet.origin[axis][lane] = ray.origin[axis];
+			packet.inverse[axis][lane] = ray.inverse[axis];
+			packet.negative[axis] = ray.negative[axis];
+		}
+		packet.max_distance[lane] = ray.max_distance;
+		packet.rays[lane] = &ray;
+	}
+
+	// Same slab test as testNodeSse4, with the rays in the lanes instead of the children.
+	CS2_TARGET_AVX2 void testNodePacketAvx2(const cs2::BvhNode& node, const RayPacket& packet, int masks[4])
+	{
+		const __m256 ox = _mm256_load_ps(packet.origin[0]), oy = _mm256_load_ps(packet.origin[1]), oz = _mm256_load_ps(packet.origin[2]);
+		const __m256 ix = _mm256_load_ps(packet.inverse[0]), iy = _mm256_load_ps(packet.inverse[1]), iz = _mm256_load_ps(packet.inverse[2]);
+		const __m256 max_distance = _mm256_load_ps(packet.max_distance);
+		const __m256 zero = _mm256_setzero_ps();
+
+		for (int i = 0; i < 4; i++)
+		{
+			__m256 near_x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(packet.negative[0] ? node.max_x[i] : node.min_x[i]), ox), ix);
+			__m256 near_y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(packet.negative[1] ? node.max_y[i] : node.min_y[i]), oy), iy);
+			__m256 near_z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(packet.negative[2] ? node.max_z[i] : node.min_z[i]), oz), iz);
+			__m256 far_x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(packet.negative[0] ? node.min_x[i] : node.max_x[i]), ox), ix);
+			__m256 far_y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(packet.negative[1] ? node.min_y[i] : node.max_y[i]), oy), iy);
+			__m256 far_z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(packet.negative[2] ? node.min_z[i] : node.max_z[i]), oz), iz);
+
+			__m256 tn = _mm256_max_ps(_mm256_max_ps(near_x, near_y), _mm256_max_ps(near_z, zero));
+			__m256 tf = _mm256_min_ps(_mm256_min_ps(far_x, far_y), _mm256_min_ps(far_z, max_distance));
+			masks[i] = _mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ));
+		}
+	}
+
+	// Any-hit traversal of a packet. Every ray only descends into nodes its own
+	// slab test accepts, so the result matches tracing the rays one by one.
+	int traversePacketAvx2(const cs2::Bvh& bvh, const RayPacket& packet)
+	{
+		struct Entry {
+			uint32_t node;
+			int rays;
+		};
+
+		const std::vector<cs2::BvhNode>& nodes = bvh.getNodes();
+		const std::vector<cs2::TriangleBlock>& blocks = bvh.getSoup().getBlocks();
+		if (nodes.empty())
+			return 0;
+
+		Entry stack[cs2::Bvh::kStackSize];
+		size_t depth = 0;
+		stack[depth++] = Entry{ 0, (1 << packet.count) - 1 };
+		int occluded = 0;
+
+		while (depth > 0)
+		{
+			Entry entry = stack[--depth];
+			int rays = entry.rays & ~occluded;
+			if (!rays)
+				continue;
+
+			if (cs2::Bvh::isLeaf(entry.node))
+			{
+				uint32_t first = cs2::Bvh::getLeafFirstBlock(entry.node);
+				uint32_t last = first + cs2::Bvh::getLeafBlockCount(entry.node);
+				for (uint32_t b = first; b < last && rays; b++)
+				{
+					for (int pending = rays; pending; pending &= pending - 1)
+					{
+						int lane = std::countr_zero(static_cast<unsigned>(pending));
+						alignas(32) float t[8];
+						if (testBlockAvx2(blocks[b], *packet.rays[lane], packet.rays[lane]->max_distance, t))
+							rays &= ~(1 << lane);
+					}
+				}
+				occluded |= entry.rays & ~occluded & ~rays;
+				continue;
+			}
+
+			const cs2::BvhNode& node = nodes[entry.node];
+			int masks[4];
+			testNodePacketAvx2(node, packet, masks);
+			for (int i = 0; i < 4; i++)
+			{
+				int child_rays = masks[i] & rays;
+				if (child_rays)
+					stack[depth++] = Entry{ node.children[i], child_rays };
+			}
+		}
+
+		return occluded;
+	}
+#endif
+
+	// Interleave the low ten bits of x, y and z.
+	uint32_t morton3(uint32_t x, uint32_t y, uint32_t z)
+	{
+		auto spread = [](uint32_t v) {
+			v &= 0x3FF;
+			v = (v | (v << 16)) & 0x030000FF;
+			v = (v | (v << 8)) & 0x0300F00F;
+			v = (v | (v << 4)) & 0x030C30C3;
+			v = (v | (v << 2)) & 0x09249249;
+			return v;
+		};
+		return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+	}
+
+	template<bool AnyHit>
+	bool dispatch(cs2::SimdLevel level, const cs2::Bvh& bvh, const Ray& ray, cs2::RayHit* hit, uint32_t* hitBlock = nullptr)
+	{
+#ifdef CS2_SIMD_X86
+		if (level == cs2::SimdLevel::AVX2)
+			return traverse<Avx2Kernel, AnyHit>(bvh, ray, hit, hitBlock);
+		if (level == cs2::SimdLevel::SSE4)
+			return traverse<Sse4Kernel, AnyHit>(bvh, ray, hit, hitBlock);
+#endif
+		return traverse<ScalarKernel, AnyHit>(bvh, ray, hit, hitBlock);
+	}
+
+	void dispatchAll(cs2::SimdLevel level, const cs2::Bvh& bvh, const Ray& ray, std::vector<cs2::RayHit>& hits)
+	{
+#ifdef CS2_SIMD_X86
+		if (level == cs2::SimdLevel::AVX2)
+			return traverseAll<Avx2Kernel>(bvh, ray, hits);
+		if (level == cs2::SimdLevel::SSE4)
+			return traverseAll<Sse4Kernel>(bvh, ray, hits);
+#endif
+		traverseAll<ScalarKernel>(bvh, ray, hits);
+	}
+
+	int dispatchBlock(cs2::SimdLevel level, const cs2::TriangleBlock& block, const Ray& ray)
+	{
+		alignas(32) float t[8];
+#ifdef CS2_SIMD_X86
+		if (level == cs2::SimdLevel::AVX2)
+			return testBlockAvx2(block, ray, ray.max_distance, t);
+		if (level == cs2::SimdLevel::SSE4)
+			return testBlockSse4(block, ray, ray.max_distance, t);
+#endif
+		return testBlockScalar(block, ray, ray.max_distance, t);
+	}
+
+	bool makeSegment(const cs2::Vec3& start, const cs2::Vec3& end, Ray& ray)
+	{
+		cs2::Vec3 delta(end.x - start.x, end.y - start.y, end.z - start.z);
+		return makeRay(start, delta, std::sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z), ray);
+	}
+}
+
+cs2::Raycaster::Raycaster(const Bvh& bvh, SimdLevel level) : bvh(bvh), level(getSupportedSimdLevel(level))
+{
+}
+
+bool cs2::Raycaster::raycast(const Vec3& origin, const Vec3& direction, float maxDistance, RayHit& hit) const
+{
+	Ray ray;
+	if (!makeRay(origin, direction, maxDistance, ray))
+		return false;
+	return dispatch<false>(level, bvh, ray, &hit);
+}
+
+bool cs2::Raycaster::raycastAny(const Vec3& origin, const Vec3& direction, float maxDistance) const
+{
+	Ray ray;
+	if (!makeRay(origin, direction, maxDistance, ray))
+		return false;
+	return dispatch<true>(level, bvh, ray, nullptr);
+}
+
+bool cs2::Raycaster::segment(const Vec3& start, const Vec3& end, RayHit& hit) const
+{
+	Vec3 delta(end.x - start.x, end.y - start.y, end.z - start.z);
+	return raycast(start, delta, std::sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z), hit);
+}
+
+bool cs2::Raycaster::segmentAny(const Vec3& start, const Vec3& end) const
+{
+	Vec3 delta(end.x - start.x, end.y - start.y, end.z - start.z);
+	return raycastAny(start, delta, std::sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z));
+}
+
+bool cs2::Raycaster::segmentAny(const Vec3& start, const Vec3& end, uint32_t& block) const
+{
+	Ray ray;
+	if (!makeSegment(start, end, ray))
+		return false;
+	return dispatch<true>(level, bvh, ray, nullptr, &block);
+}
+
+bool cs2::Raycaster::segmentAnyInBlock(const Vec3& start, const Vec3& end, uint32_t block) const
+{
+	Ray ray;
+	if (block >= bvh.getSoup().getBlockCount() || !makeSegment(start, end, ray))
+		return false;
+	return dispatchBlock(level, bvh.getSoup().getBlocks()[block], ray) != 0;
+}
+
+size_t cs2::Raycaster::segmentAll(const Vec3& start, const Vec3& end, std::vector<RayHit>& hits) const
+{
+	hits.clear();
+	Ray ray;
+	if (!makeSegment(start, end, ray))
+		return 0;
+
+	dispatchAll(level, bvh, ray, hits);
+	std::sort(hits.begin(), hits.end(), [](const RayHit& a, const RayHit& b) {
+		return a.distance < b.distance || (a.distance == b.distance && a.triangle < b.triangle);
+	});
+	return hits.size();
+}
+
+cs2::LineOfSightStats cs2::Raycaster::testLineOfSight(std::span<const Segment> segments, std::vector<uint64_t>& visible, const LineOfSightOptions& options) const
+{
+	using Clock = std::chrono::steady_clock;
+	auto start_time = Clock::now();
+
+	LineOfSightStats stats;
+	stats.queries = segments.size();
+	stats.threads = resolveThreadCount(options.threads);
+
+	const size_t count = segments.size();
+	const size_t chunks = (count + 4095) / 4096;
+	auto forEachQuery = [&](auto&& fn) {
+		parallelFor(chunks, options.threads, [&](size_t chunk, unsigned) {
+			for (size_t i = chunk * 4096; i < std::min(count, (chunk + 1) * 4096); i++)
+				fn(i);
+		});
+	};
+
+	// Order by direction octant first, since a packet needs one, then along a
+	// Morton curve of the start and the end so neighbours share a path through
+	// the tree. The key sits above the query index, and the radix sort only
+	// looks at the key.
+	std::vector<uint64_t> order(count);
+	if (options.sort && count > 1)
+	{
+		auto sort_start = Clock::now();
+		const Aabb& bounds = bvh.getBounds();
+		const float scale_x = 32.0f / std::max(bounds.max.x - bounds.min.x, 1.0f);
+		const float scale_y = 32.0f / std::max(bounds.max.y - bounds.min.y, 1.0f);
+		const float scale_z = 32.0f / std::max(bounds.max.z - bounds.min.z, 1.0f);
+		auto cell = [&](const Vec3& p) {
+			auto axis = [](float value, float low, float scale) { return static_cast<uint32_t>(std::clamp((value - low) * scale, 0.0f, 31.0f)); };
+			return morton3(axis(p.x, bounds.min.x, scale_x), axis(p.y, bounds.min.y, scale_y), axis(p.z, bounds.min.z, scale_z));
+		};
+
+		forEachQuery([&](size_t i) {
+			const Segment& segment = segments[i];
+			uint64_t octant = (segment.end.x < segment.start.x) | ((segment.end.y < segment.start.y) << 1) | ((segment.end.z < segment.start.z) << 2);
+			uint64_t key = (octant << 29) | (static_cast<uint64_t>(cell(segment.start)) << 14) | (cell(segment.end) >> 1);
+			order[i] = (key << 32) | i;
+		});
+
+		std::vector<uint64_t> scratch(count);
+		for (int shift = 32; shift < 64; shift += 11)
+		{
+			size_t offsets[2048] = {};
+			for (uint64_t value : order)
+				offsets[(value >> shift) & 2047]++;
+			size_t sum = 0;
+			for (size_t& offset : offsets)
+			{
+				size_t bucket = offset;
+				offset = sum;
+				sum += bucket;
+			}
+			for (uint64_t value : order)
+				scratch[offsets[(value >> shift) & 2047]++] = value;
+			order.swap(scratch);
+		}
+
+		stats.sort_seconds = std::chrono::duration<double>(Clock::now() - sort_start).count();
+	}
+	else
+	{
+		std::iota(order.begin(), order.end(), 0);
+	}
+
+	// Rays are laid out in traversal order so the workers stream through them.
+	std::vector<Ray> rays(count);
+	std::vector<uint8_t> valid(count);
+	forEachQuery([&](size_t k) {
+		const Segment& segment = segments[static_cast<uint32_t>(order[k])];
+		Vec3 delta(segment.end.x - segment.start.x, segment.end.y - segment.start.y, segment.end.z - segment.start.z);
+		valid[k] = makeRay(segment.start, delta, std::sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z), rays[k]);
+	});
+
+	// Workers take runs of the ordered queries. Within a run, consecutive
+	// segments of one octant whose starts and ends stay close become packets.
+	constexpr size_t kRunSize = 1024;
+	const bool packets = options.packets && level == SimdLevel::AVX2;
+	std::vector<uint8_t> occluded(count);
+	std::vector<size_t> run_packets((count + kRunSize - 1) / kRunSize);
+	std::vector<size_t> run_packet_queries(run_packets.size());
+
+	parallelFor(run_packets.size(), options.threads, [&](size_t run, unsigned) {
+		size_t end = std::min(count, (run + 1) * kRunSize);
+		size_t i = run * kRunSize;
+
+		while (i < end)
+		{
+			if (!valid[i])
+			{
+				i++;
+				continue;
+			}
+
+#ifdef CS2_SIMD_X86
+			if (packets)
+			{
+				const Ray& first = rays[i];
+				size_t packet_end = i + 1;
+				Aabb starts, ends;
+				starts.extend(segments[static_cast<uint32_t>(order[i])].start);
+				ends.extend(segments[static_cast<uint32_t>(order[i])].end);
+
+				while (packet_end < end && packet_end - i < 8)
+				{
+					const Ray& next = rays[packet_end];
+					if (!valid[packet_end] || next.negative[0] != first.negative[0] || next.negative[1] != first.negative[1] || next.negative[2] != first.negative[2])
+						break;
+
+					const Segment& segment = segments[static_cast<uint32_t>(order[packet_end])];
+					Aabb next_starts = starts, next_ends = ends;
+					next_starts.extend(segment.start);
+					next_ends.extend(segment.end);
+					auto extent = [](const Aabb& box) { return std::max(std::max(box.max.x - box.min.x, box.max.y - box.min.y), box.max.z - box.min.z); };
+					if (extent(next_starts) > options.packet_spread || extent(next_ends) > options.packet_spread)
+						break;
+
+					starts = next_starts;
+					ends = next_ends;
+					packet_end++;
+				}
+
+				// Below four rays a packet does not pay for its wider node tests.
+				if (packet_end - i >= 4)
+				{
+					RayPacket packet;
+					initPacket(packet);
+					for (size_t k = i; k < packet_end; k++)
+						addToPacket(packet, rays[k]);
+
+					int mask = traversePacketAvx2(bvh, packet);
+					for (size_t k = i; k < packet_end; k++)
+						occluded[k] = (mask >> (k - i)) & 1;
+
+					run_packets[run]++;
+					run_packet_queries[run] += packet_end - i;
+					i = packet_end;
+					continue;
+				}
+			}
+#endif
+
+			occluded[i] = dispatch<true>(level, bvh, rays[i], nullptr);
+			i++;
+		}
+	});
+
+	// Scatter back to the caller's order, one word of the bitmap per query at a time.
+	visible.assign((count + 63) / 64, 0);
+	if (options.sort)
+	{
+		for (size_t k = 0; k < count; k++)
+		{
+			uint32_t query = static_cast<uint32_t>(order[k]);
+			visible[query / 64] |= static_cast<uint64_t>(!occluded[k]) << (query % 64);
+		}
+	}
+	else
+	{
+		parallelFor((visible.size() + 1023) / 1024, options.threads, [&](size_t chunk, unsigned) {
+			for (size_t word = chunk * 1024; word < std::min(visible.size(), (chunk + 1) * 1024); word++)
+			{
+				uint64_t bits = 0;
+				for (size_t i = word * 64; i < std::min(count, (word + 1) * 64); i++)
+					bits |= static_cast<uint64_t>(!occluded[i]) << (i % 64);
+				visible[word] = bits;
+			}
+		});
+	}
+
+	for (size_t run = 0; run < run_packets.size(); run++)
+	{
+		stats.packets += run_packets[run];
+		stats.packet_queries += run_packet_queries[run];
+	}
+	for (uint64_t word : visible)
+		stats.visible += std::popcount(word);
+
+	stats.seconds = std::chrono::duration<double>(Clock::now() - start_time).count();
+	return stats;
+}
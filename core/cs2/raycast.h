@@ -0,0 +1,164 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "bvh.h"
+#include "simd.h"
+
+namespace cs2
+{
+	class RayHit {
+	public:
+		static constexpr uint32_t kNoHit = 0xFFFFFFFF;
+
+		// Distance from the origin along the normalized direction.
+		float distance = std::numeric_limits<float>::max();
+		// Index of the triangle in hull order (see Bvh::getSourceIndex).
+		uint32_t triangle = kNoHit;
+		uint32_t hull = kNoHit;
+		// Index into PhysicsFile::getSurfaceProps.
+		uint32_t surface_prop = kNoHit;
+		// The ray hit the side the triangle's winding faces, i.e. it points against (b - a) x (c - a).
+		bool front_face = false;
+
+		bool isHit() const { return triangle != kNoHit; }
+	};
+
+	class Segment {
+	public:
+		Vec3 start, end;
+
+		Segment() = default;
+		Segment(Vec3 start, Vec3 end) : start(start), end(end) {}
+	};
+
+	class LineOfSightOptions {
+	public:
+		// Number of threads, zero for one per hardware thread.
+		unsigned threads = 0;
+		// Reorder the queries along a Morton curve of their endpoints so neighbouring
+		// queries touch the same nodes; results keep the caller's order.
+		bool sort = true;
+		// Trace runs of similar segments as packets of eight (AVX2 only).
+		bool packets = true;
+		// Largest extent of the starts and of the ends of a packet.
+		float packet_spread = 512.0f;
+	};
+
+	class LineOfSightStats {
+	public:
+		size_t queries = 0;
+		size_t visible = 0;
+		size_t packets = 0;
+		// Queries traced as part of a packet, the rest were traced one by one.
+		size_t packet_queries = 0;
+		unsigned threads = 0;
+		double sort_seconds = 0.0;
+		double seconds = 0.0;
+
+		double getQueriesPerSecond() const { return seconds > 0.0 ? queries / seconds : 0.0; }
+	};
+
+	/// <summary>
+	/// Ray and segment queries against the triangles of a BVH. Triangles are
+	/// tested a whole TriangleBlock at a time with Möller-Trumbore, using the
+	/// widest kernel the CPU supports: AVX2 tests eight lanes at once, SSE4
+	/// four, and the scalar kernel one. All kernels evaluate the same
+	/// arithmetic in the same order, so they return identical hits.
+	/// Triangles are two-sided; hits exactly at the origin are ignored.
+	/// </summary>
+	class Raycaster {
+	public:
+		/// <param name="bvh">
+		/// The BVH to trace against, which must outlive the raycaster.
+		/// </param>
+		/// <param name="level">
+		/// The kernel to use, lowered to what the CPU supports.
+		/// </param>
+		explicit Raycaster(const Bvh& bvh, SimdLevel level = getSimdLevel());
+
+		const Bvh& getBvh() const { return bvh; }
+		SimdLevel getLevel() const { return level; }
+
+		/// <summary>
+		/// Find the nearest triangle along a ray.
+		/// </summary>
+		/// <param name="origin">
+		/// The origin of the ray.
+		/// </param>
+		/// <param name="direction">
+		/// The direction of the ray, normalized internally.
+		/// </param>
+		/// <param name="maxDistance">
+		/// Hits at or beyond this distance are ignored.
+		/// </param>
+		/// <param name="hit">
+		/// Receives the nearest hit, left untouched on a miss.
+		/// </param>
+		/// <returns>
+		/// Returns true if the ray hit a triangle, false otherwise.
+		/// </returns>
+		bool raycast(const Vec3& origin, const Vec3& direction, float maxDistance, RayHit& hit) const;
+
+		/// <summary>
+		/// Check whether a ray hits any triangle, stopping at the first one found.
+		/// </summary>
+		bool raycastAny(const Vec3& origin, const Vec3& direction, float maxDistance) const;
+
+		/// <summary>
+		/// Find the nearest triangle between two points. The distance of the hit is measured from start.
+		/// </summary>
+		bool segment(const Vec3& start, const Vec3& end, RayHit& hit) const;
+
+		/// <summary>
+		/// Check whether any triangle lies between two points, i.e. whether they cannot see each other.
+		/// </summary>
+		bool segmentAny(const Vec3& start, const Vec3& end) const;
+
+		/// <summary>
+		/// Like segmentAny, and on a hit also report the BVH soup block holding the blocking triangle.
+		/// </summary>
+		bool segmentAny(const Vec3& start, const Vec3& end, uint32_t& block) const;
+
+		/// <summary>
+		/// Check whether a triangle of one BVH soup block lies between two points.
+		/// This is a cheap first test against a blocker remembered from an earlier query.
+		/// </summary>
+		bool segmentAnyInBlock(const Vec3& start, const Vec3& end, uint32_t block) const;
+
+		/// <summary>
+		/// Find every triangle between two points, e.g. all the surfaces a bullet passes through.
+		/// </summary>
+		/// <param name="hits">
+		/// Receives the hits ordered by distance from start, ties by triangle index.
+		/// </param>
+		/// <returns>
+		/// Returns the number of hits.
+		/// </returns>
+		size_t segmentAll(const Vec3& start, const Vec3& end, std::vector<RayHit>& hits) const;
+
+		/// <summary>
+		/// Check line of sight for a batch of segments, e.g. every pair of players in a tick.
+		/// </summary>
+		/// <param name="segments">
+		/// The segments to check.
+		/// </param>
+		/// <param name="visible">
+		/// Receives one bit per segment, set if nothing lies between its endpoints
+		/// (see isVisible).
+		/// </param>
+		/// <param name="options">
+		/// Threading, ordering and packet options.
+		/// </param>
+		LineOfSightStats testLineOfSight(std::span<const Segment> segments, std::vector<uint64_t>& visible,
+			const LineOfSightOptions& options = LineOfSightOptions()) const;
+
+		static bool isVisible(const std::vector<uint64_t>& visible, size_t index) { return (visible[index / 64] >> (index % 64)) & 1; }
+
+	private:
+		const Bvh& bvh;
+		SimdLevel level;
+	};
+} // namespace cs2
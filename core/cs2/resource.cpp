@@ -0,0 +1,88 @@
+#include "resource.h"
+
+#include <cstring>
+
+namespace
+{
+	constexpr uint16_t kHeaderVersion = 12;
+
+	uint32_t readU32(const char* p)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, 4);
+		return value;
+	}
+
+	uint16_t readU16(const char* p)
+	{
+		uint16_t value;
+		std::memcpy(&value, p, 2);
+		return value;
+	}
+}
+
+bool cs2::Resource::open(const std::string& filename, std::string& error)
+{
+	blocks.clear();
+
+	if (!file.open(filename))
+	{
+		error = "Failed to open file: " + filename;
+		return false;
+	}
+
+	const char* data = file.data();
+	size_t size = file.size();
+
+	// u32 file size, u16 header version, u16 version, u32 block offset, u32 block count
+	if (size < 16 || readU16(data + 4) != kHeaderVersion)
+	{
+		error = "Not a compiled resource: " + filename;
+		return false;
+	}
+
+	version = readU16(data + 6);
+
+	// Offsets are relative to the field holding them.
+	uint64_t table = 8 + static_cast<uint64_t>(readU32(data + 8));
+	uint32_t count = readU32(data + 12);
+
+	if (table + static_cast<uint64_t>(count) * 12 > size)
+	{
+		error = "Corrupt block table in: " + filename;
+		return false;
+	}
+
+	blocks.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const char* entry = data + table + i * 12;
+		ResourceBlock& block = blocks[i];
+
+		std::memcpy(block.type, entry, 4);
+		uint64_t offset = static_cast<uint64_t>(table + i * 12 + 4) + readU32(entry + 4);
+		block.size = readU32(entry + 8);
+
+		if (offset + block.size > size)
+		{
+			error = "Block " + std::string(block.type, 4) + " out of range in: " + filename;
+			blocks.clear();
+			return false;
+		}
+
+		block.offset = static_cast<uint32_t>(offset);
+	}
+
+	return true;
+}
+
+std::span<const uint8_t> cs2::Resource::getBlock(std::string_view type) const
+{
+	for (auto& block : blocks)
+	{
+		if (block.is(type))
+			return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(file.data()) + block.offset, block.size);
+	}
+
+	return {};
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace cs2
+{
+	class ResourceBlock {
+	public:
+		char type[4] = {};
+		uint32_t offset = 0;
+		uint32_t size = 0;
+
+		bool is(std::string_view name) const { return name.size() == 4 && std::string_view(type, 4) == name; }
+	};
+
+	/// <summary>
+	/// A compiled Source 2 resource (e.g. .vmdl_c, .vphys_c) mapped into memory.
+	/// Only the container is parsed; block contents are handed out as raw bytes.
+	/// </summary>
+	class Resource {
+	public:
+		/// <summary>
+		/// Map a compiled resource and read its block table.
+		/// </summary>
+		/// <param name="filename">
+		/// The filename of the compiled resource.
+		/// </param>
+		/// <param name="error">
+		/// Receives a description of the failure, if any.
+		/// </param>
+		/// <returns>
+		/// Returns true if the resource was opened successfully, false otherwise.
+		/// </returns>
+		bool open(const std::string& filename, std::string& error);
+
+		/// <summary>
+		/// Get the contents of the first block of a given type, e.g. "DATA" or "PHYS".
+		/// </summary>
+		/// <returns>
+		/// Returns an empty span if there is no such block.
+		/// </returns>
+		std::span<const uint8_t> getBlock(std::string_view type) const;
+
+		const std::vector<ResourceBlock>& getBlocks() const { return blocks; }
+		uint16_t getVersion() const { return version; }
+		size_t getSize() const { return file.size(); }
+
+	private:
+		MappedFile file;
+		uint16_t version = 0;
+		std::vector<ResourceBlock> blocks;
+	};
+} // namespace cs2
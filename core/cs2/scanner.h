@@ -0,0 +1,108 @@
+#pragma once
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CS2_SCANNER_SSE2 1
+#endif
+
+namespace cs2
+{
+	/// <summary>
+	/// Single pass scanner over the text of a numeric array such as
+	/// "1 2 3", "4 5 6" or "0", "1", "2". Quotes, commas and whitespace
+	/// are skipped in place, so the input never has to be copied.
+	/// </summary>
+	class NumberScanner {
+	public:
+		explicit NumberScanner(std::string_view input) : cursor(input.data()), last(input.data() + input.size()) {}
+
+		/// <summary>
+		/// Parse the next number.
+		/// </summary>
+		/// <param name="value">
+		/// Receives the parsed number.
+		/// </param>
+		/// <returns>
+		/// Returns false at the end of the input or on malformed text.
+		/// </returns>
+		template <typename T>
+		bool next(T& value)
+		{
+			skipSeparators();
+			if (cursor == last)
+				return false;
+
+			if (*cursor == '+')
+				++cursor;
+
+			auto [ptr, ec] = std::from_chars(cursor, last, value);
+			if (ec != std::errc())
+				return false;
+
+			cursor = ptr;
+			return true;
+		}
+
+		bool done()
+		{
+			skipSeparators();
+			return cursor == last;
+		}
+
+	private:
+		const char* cursor;
+		const char* last;
+
+		static bool isSeparator(char c)
+		{
+			return c == ' ' || c == ',' || c == '"' || c == '\n' || c == '\r' || c == '\t';
+		}
+
+		void skipSeparators()
+		{
+			while (cursor != last && isSeparator(*cursor))
+				++cursor;
+		}
+	};
+
+	/// <summary>
+	/// Count the occurrences of a delimiter, 16 bytes at a time where SSE2 is available.
+	/// Used to size array outputs before parsing them.
+	/// </summary>
+	inline size_t countDelimiters(std::string_view input, char delimiter)
+	{
+		const char* p = input.data();
+		const char* end = p + input.size();
+		size_t count = 0;
+
+#ifdef CS2_SCANNER_SSE2
+		const __m128i needle = _mm_set1_epi8(delimiter);
+		for (; p + 16 <= end; p += 16)
+		{
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+			count += static_cast<size_t>(std::popcount(mask));
+		}
+#endif
+
+		for (; p != end; ++p)
+			count += (*p == delimiter);
+
+		return count;
+	}
+
+	/// <summary>
+	/// Count the comma separated items of an array body.
+	/// </summary>
+	inline size_t countArrayItems(std::string_view input)
+	{
+		if (input.find_first_not_of(" \t\r\n\"") == std::string_view::npos)
+			return 0;
+		return countDelimiters(input, ',') + 1;
+	}
+} // namespace cs2
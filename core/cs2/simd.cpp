@@ -0,0 +1,87 @@
+#include "simd.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(CS2_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	cs2::SimdLevel detectSimdLevel()
+	{
+#if defined(CS2_SIMD_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int max_leaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse4 = (info[2] & (1 << 19)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+
+		// AVX registers are only usable if the OS saves them on context switches.
+		bool ymm = osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+		bool avx2 = false;
+		if (ymm && max_leaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+
+		if (avx2)
+			return cs2::SimdLevel::AVX2;
+		if (sse4)
+			return cs2::SimdLevel::SSE4;
+		return cs2::SimdLevel::Scalar;
+#elif defined(CS2_SIMD_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return cs2::SimdLevel::AVX2;
+		if (__builtin_cpu_supports("sse4.1"))
+			return cs2::SimdLevel::SSE4;
+		return cs2::SimdLevel::Scalar;
+#else
+		return cs2::SimdLevel::Scalar;
+#endif
+	}
+
+	cs2::SimdLevel getCpuSimdLevel()
+	{
+		static const cs2::SimdLevel level = detectSimdLevel();
+		return level;
+	}
+}
+
+cs2::SimdLevel cs2::getSupportedSimdLevel(SimdLevel requested)
+{
+	SimdLevel supported = getCpuSimdLevel();
+	return static_cast<int>(requested) < static_cast<int>(supported) ? requested : supported;
+}
+
+cs2::SimdLevel cs2::getSimdLevel()
+{
+	static const SimdLevel level = [] {
+		const char* name = std::getenv("CS2_SIMD");
+		if (name && std::strcmp(name, "scalar") == 0)
+			return getSupportedSimdLevel(SimdLevel::Scalar);
+		if (name && std::strcmp(name, "sse4") == 0)
+			return getSupportedSimdLevel(SimdLevel::SSE4);
+		return getCpuSimdLevel();
+	}();
+	return level;
+}
+
+const char* cs2::getSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::AVX2:
+		return "avx2";
+	case SimdLevel::SSE4:
+		return "sse4";
+	default:
+		return "scalar";
+	}
+}
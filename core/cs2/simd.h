@@ -0,0 +1,40 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CS2_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// Functions using instructions above the compiler's baseline are tagged with
+// these and only called after getSimdLevel() says the CPU supports them.
+// MSVC allows any intrinsic anywhere, so it needs no tag.
+#if defined(CS2_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CS2_TARGET_SSE4 __attribute__((target("sse4.1")))
+#define CS2_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CS2_TARGET_SSE4
+#define CS2_TARGET_AVX2
+#endif
+
+namespace cs2
+{
+	enum class SimdLevel {
+		Scalar,
+		SSE4,
+		AVX2,
+	};
+
+	/// <summary>
+	/// Get the widest instruction set the CPU and OS support, detected once.
+	/// The CS2_SIMD environment variable (scalar, sse4, avx2) lowers it,
+	/// which is useful to compare kernels.
+	/// </summary>
+	SimdLevel getSimdLevel();
+
+	/// <summary>
+	/// Clamp a requested level to what the CPU supports.
+	/// </summary>
+	SimdLevel getSupportedSimdLevel(SimdLevel requested);
+
+	const char* getSimdLevelName(SimdLevel level);
+} // namespace cs2
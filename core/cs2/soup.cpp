@@ -0,0 +1,56 @@
+#include "soup.h"
+
+cs2::TriangleSoup::TriangleSoup(const PhysicsFile& physics, unsigned threads)
+{
+	const std::vector<HullFile>& hull_list = physics.getHulls();
+
+	std::vector<size_t> offsets(hull_list.size() + 1, 0);
+	for (size_t h = 0; h < hull_list.size(); h++)
+		offsets[h + 1] = offsets[h] + hull_list[h].getTriangleCount();
+
+	resize(offsets.back());
+
+	// Hulls fill disjoint ranges; neighbours may share a block but never a lane.
+	parallelFor(hull_list.size(), threads, [&](size_t h, unsigned) {
+		size_t index = offsets[h];
+		uint32_t surface = physics.getSurfacePropId(h);
+		hull_list[h].forEachTriangle([&](const Triangle& tri) {
+			set(index++, tri, static_cast<uint32_t>(h), surface);
+		});
+	});
+}
+
+cs2::TriangleSoup::TriangleSoup(std::span<const Triangle> triangles)
+{
+	resize(triangles.size());
+	for (size_t i = 0; i < triangles.size(); i++)
+		set(i, triangles[i], 0, 0);
+}
+
+void cs2::TriangleSoup::resize(size_t newCount)
+{
+	size_t block_count = (newCount + kLanes - 1) / kLanes;
+
+	blocks.resize(block_count, TriangleBlock());
+	hulls.resize(block_count * kLanes, kPadding);
+	surface_props.resize(block_count * kLanes, 0);
+
+	// Lanes past the end are cleared so shrinking leaves proper padding behind.
+	for (size_t i = newCount; i < block_count * kLanes; i++)
+	{
+		blocks[i / kLanes].set(i % kLanes, Triangle(Vec3(0, 0, 0), Vec3(0, 0, 0), Vec3(0, 0, 0)));
+		hulls[i] = kPadding;
+		surface_props[i] = 0;
+	}
+
+	count = newCount;
+}
+
+std::vector<cs2::Triangle> cs2::TriangleSoup::toTriangles() const
+{
+	std::vector<Triangle> triangles;
+	triangles.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		triangles.push_back(get(i));
+	return triangles;
+}
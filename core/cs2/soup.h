@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "parser.h"
+
+namespace cs2
+{
+	/// <summary>
+	/// Eight triangles with every vertex component in its own 32-byte aligned
+	/// lane array, so an AVX2 kernel loads one component of all eight with a
+	/// single aligned load.
+	/// </summary>
+	struct alignas(32) TriangleBlock {
+		static constexpr size_t kLanes = 8;
+
+		float ax[kLanes], ay[kLanes], az[kLanes];
+		float bx[kLanes], by[kLanes], bz[kLanes];
+		float cx[kLanes], cy[kLanes], cz[kLanes];
+
+		Triangle get(size_t lane) const
+		{
+			return Triangle(Vec3(ax[lane], ay[lane], az[lane]), Vec3(bx[lane], by[lane], bz[lane]), Vec3(cx[lane], cy[lane], cz[lane]));
+		}
+
+		void set(size_t lane, const Triangle& tri)
+		{
+			ax[lane] = tri.a.x; ay[lane] = tri.a.y; az[lane] = tri.a.z;
+			bx[lane] = tri.b.x; by[lane] = tri.b.y; bz[lane] = tri.b.z;
+			cx[lane] = tri.c.x; cy[lane] = tri.c.y; cz[lane] = tri.c.z;
+		}
+	};
+
+	static_assert(sizeof(TriangleBlock) == 9 * 32, "TriangleBlock must be nine packed lane arrays");
+
+	/// <summary>
+	/// Triangles of a map in blocks of eight (AoSoA), the input format of the
+	/// bulk geometric kernels. Every triangle carries the index of its hull
+	/// and the id of its surface prop (see PhysicsFile::getSurfaceProps). The
+	/// last block is padded with zero-area triangles whose hull is kPadding.
+	/// </summary>
+	class TriangleSoup {
+	public:
+		static constexpr size_t kLanes = TriangleBlock::kLanes;
+		static constexpr uint32_t kPadding = 0xFFFFFFFF;
+
+		TriangleSoup() = default;
+
+		/// <summary>
+		/// Gather the triangles of every hull, in hull order. Quantized hulls are decoded.
+		/// </summary>
+		/// <param name="physics">
+		/// The loaded physics file.
+		/// </param>
+		/// <param name="threads">
+		/// Number of threads copying hulls, zero for one per hardware thread.
+		/// </param>
+		explicit TriangleSoup(const PhysicsFile& physics, unsigned threads = 1);
+
+		/// <summary>
+		/// Copy a plain triangle list, all in hull 0 with surface prop 0.
+		/// </summary>
+		explicit TriangleSoup(std::span<const Triangle> triangles);
+
+		/// <summary>
+		/// Resize to count triangles. New triangles are zero-area padding until set.
+		/// </summary>
+		void resize(size_t count);
+
+		void set(size_t index, const Triangle& tri, uint32_t hull, uint32_t surfaceProp)
+		{
+			blocks[index / kLanes].set(index % kLanes, tri);
+			hulls[index] = hull;
+			surface_props[index] = surfaceProp;
+		}
+
+		Triangle get(size_t index) const { return blocks[index / kLanes].get(index % kLanes); }
+		uint32_t getHull(size_t index) const { return hulls[index]; }
+		uint32_t getSurfaceProp(size_t index) const { return surface_props[index]; }
+
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+
+		const std::vector<TriangleBlock>& getBlocks() const { return blocks; }
+		size_t getBlockCount() const { return blocks.size(); }
+
+		/// <summary>
+		/// Copy the triangles back out as a plain list.
+		/// </summary>
+		std::vector<Triangle> toTriangles() const;
+
+		size_t getBytes() const
+		{
+			return blocks.capacity() * sizeof(TriangleBlock) + (hulls.capacity() + surface_props.capacity()) * sizeof(uint32_t);
+		}
+
+	private:
+		std::vector<TriangleBlock> blocks;
+		// Per triangle, padded to whole blocks.
+		std::vector<uint32_t> hulls;
+		std::vector<uint32_t> surface_props;
+		size_t count = 0;
+	};
+} // namespace cs2
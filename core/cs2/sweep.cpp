@@ -0,0 +1,386 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "geometry.h"
+
+namespace
+{
+	using cs2::Vec3;
+	using namespace cs2::detail;
+
+	// Same clamp as the raycaster, so slab tests never compute 0 * inf.
+	constexpr float kMinDirection = 1e-20f;
+	constexpr int kMaxAdvancements = 32;
+
+	// Closest points of segments p1q1 and p2q2, returns their squared distance (Ericson 5.1.9).
+	float closestSegmentSegment(const Vec3& p1, const Vec3& q1, const Vec3& p2, const Vec3& q2, Vec3& c1, Vec3& c2)
+	{
+		Vec3 d1 = sub(q1, p1), d2 = sub(q2, p2), r = sub(p1, p2);
+		float a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+		float s, t;
+
+		if (a <= 1e-12f && e <= 1e-12f)
+		{
+			s = t = 0.0f;
+		}
+		else if (a <= 1e-12f)
+		{
+			s = 0.0f;
+			t = std::clamp(f / e, 0.0f, 1.0f);
+		}
+		else
+		{
+			float c = dot(d1, r);
+			if (e <= 1e-12f)
+			{
+				t = 0.0f;
+				s = std::clamp(-c / a, 0.0f, 1.0f);
+			}
+			else
+			{
+				float b = dot(d1, d2);
+				float denom = a * e - b * b;
+				s = denom != 0.0f ? std::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+				t = (b * s + f) / e;
+				if (t < 0.0f)
+				{
+					t = 0.0f;
+					s = std::clamp(-c / a, 0.0f, 1.0f);
+				}
+				else if (t > 1.0f)
+				{
+					t = 1.0f;
+					s = std::clamp((b - c) / a, 0.0f, 1.0f);
+				}
+			}
+		}
+
+		c1 = add(p1, scale(d1, s));
+		c2 = add(p2, scale(d2, t));
+		Vec3 d = sub(c1, c2);
+		return dot(d, d);
+	}
+
+	// Closest points of segment pq and triangle abc, returns their squared distance.
+	float closestSegmentTriangle(const Vec3& p, const Vec3& q, const cs2::Triangle& tri, Vec3& onSegment, Vec3& onTriangle)
+	{
+		// A segment through the triangle touches it where it crosses the plane.
+		Vec3 n = cross(sub(tri.b, tri.a), sub(tri.c, tri.a));
+		float dp = dot(sub(p, tri.a), n), dq = dot(sub(q, tri.a), n);
+		if (dp != dq && ((dp <= 0.0f && dq >= 0.0f) || (dp >= 0.0f && dq <= 0.0f)))
+		{
+			Vec3 x = add(p, scale(sub(q, p), dp / (dp - dq)));
+			if (dot(cross(sub(tri.b, tri.a), sub(x, tri.a)), n) >= 0.0f &&
+				dot(cross(sub(tri.c, tri.b), sub(x, tri.b)), n) >= 0.0f &&
+				dot(cross(sub(tri.a, tri.c), sub(x, tri.c)), n) >= 0.0f)
+			{
+				onSegment = onTriangle = x;
+				return 0.0f;
+			}
+		}
+
+		// Otherwise the closest points involve an endpoint of the segment or an edge of the triangle.
+		onSegment = p;
+		onTriangle = closestPointTriangle(p, tri.a, tri.b, tri.c);
+		float best = dot(sub(onSegment, onTriangle), sub(onSegment, onTriangle));
+
+		Vec3 on_triangle = closestPointTriangle(q, tri.a, tri.b, tri.c);
+		float distance = dot(sub(q, on_triangle), sub(q, on_triangle));
+		if (distance < best)
+		{
+			best = distance;
+			onSegment = q;
+			onTriangle = on_triangle;
+		}
+
+		const Vec3* corners[4] = { &tri.a, &tri.b, &tri.c, &tri.a };
+		for (int edge = 0; edge < 3; edge++)
+		{
+			Vec3 on_segment;
+			distance = closestSegmentSegment(p, q, *corners[edge], *corners[edge + 1], on_segment, on_triangle);
+			if (distance < best)
+			{
+				best = distance;
+				onSegment = on_segment;
+				onTriangle = on_triangle;
+			}
+		}
+
+		return best;
+	}
+
+	// Exact box sweep: the box overlaps the triangle exactly when their
+	// projections overlap on all 13 candidate axes, so the time of impact is
+	// the latest time any axis starts overlapping, provided none has stopped.
+	bool sweepBoxTriangle(const cs2::Triangle& tri, const Vec3& start, const Vec3& delta, const Vec3& halfExtents,
+		float maxFraction, float& fraction, Vec3& normal, bool& startSolid)
+	{
+		const Vec3 a = sub(tri.a, start), b = sub(tri.b, start), c = sub(tri.c, start);
+		const Vec3 edges[3] = { sub(b, a), sub(c, b), sub(a, c) };
+
+		// exit is not clamped to maxFraction: once a contact at 0 is found, a
+		// triangle the box starts inside must still leave exit above 0.
+		float enter = -std::numeric_limits<float>::max();
+		float exit = std::numeric_limits<float>::max();
+		Vec3 enter_axis(0.0f, 0.0f, 0.0f);
+
+		// Touching counts as separated, so shapes can slide along and leave surfaces they rest on.
+		auto overlaps = [&](const Vec3& axis) {
+			float pa = dot(a, axis), pb = dot(b, axis), pc = dot(c, axis);
+			float r = halfExtents.x * std::fabs(axis.x) + halfExtents.y * std::fabs(axis.y) + halfExtents.z * std::fabs(axis.z);
+			float low = std::min(std::min(pa, pb), pc) - r;
+			float high = std::max(std::max(pa, pb), pc) + r;
+			float speed = dot(delta, axis);
+
+			if (speed == 0.0f)
+				return low < 0.0f && 0.0f < high;
+
+			float t0 = (speed > 0.0f ? low : high) / speed;
+			float t1 = (speed > 0.0f ? high : low) / speed;
+			if (t0 > enter)
+			{
+				enter = t0;
+				enter_axis = speed > 0.0f ? scale(axis, -1.0f) : axis;
+			}
+			exit = std::min(exit, t1);
+			return enter < exit && enter < maxFraction;
+		};
+
+		for (const Vec3& axis : { Vec3(1.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f), Vec3(0.0f, 0.0f, 1.0f) })
+			if (!overlaps(axis))
+				return false;
+
+		Vec3 plane = cross(edges[0], edges[1]);
+		if (dot(plane, plane) > 0.0f && !overlaps(plane))
+			return false;
+
+		for (const Vec3& edge : edges)
+		{
+			float length = dot(edge, edge);
+			for (const Vec3& axis : { Vec3(0.0f, -edge.z, edge.y), Vec3(edge.z, 0.0f, -edge.x), Vec3(-edge.y, edge.x, 0.0f) })
+			{
+				// Edges parallel to a box axis add nothing beyond the box faces.
+				if (dot(axis, axis) <= 1e-8f * length)
+					continue;
+				if (!overlaps(axis))
+					return false;
+			}
+		}
+
+		if (exit <= 0.0f)
+			return false;
+
+		startSolid = enter < 0.0f;
+		fraction = startSolid ? 0.0f : enter;
+		normal = startSolid ? Vec3(0.0f, 0.0f, 0.0f) : normalize(enter_axis);
+		return true;
+	}
+
+	// Conservative advancement. The distance between two convex shapes is a
+	// convex function of a translation, so stepping by gap / closing speed
+	// never passes the contact; a shape that stops closing never will.
+	bool sweepCapsuleTriangle(const cs2::Triangle& tri, const Vec3& start, const Vec3& delta, float radius, float halfHeight,
+		float maxFraction, float& fraction, Vec3& normal, bool& startSolid)
+	{
+		const Vec3 axis(0.0f, 0.0f, halfHeight);
+		float t = 0.0f;
+		Vec3 towards(0.0f, 0.0f, 0.0f);
+
+		for (int step = 0; step < kMaxAdvancements; step++)
+		{
+			Vec3 center = add(start, scale(delta, t));
+			Vec3 on_segment, on_triangle;
+			float distance = std::sqrt(closestSegmentTriangle(sub(center, axis), add(center, axis), tri, on_segment, on_triangle));
+			float gap = distance - radius;
+
+			if (t == 0.0f && gap < 0.0f)
+			{
+				startSolid = true;
+				fraction = 0.0f;
+				normal = Vec3(0.0f, 0.0f, 0.0f);
+				return true;
+			}
+
+			if (distance > 0.0f)
+				towards = scale(sub(on_triangle, on_segment), 1.0f / distance);
+
+			float closing = dot(delta, towards);
+			if (closing <= 0.0f)
+				return false;
+
+			if (gap <= cs2::Sweeper::kSkin)
+			{
+				startSolid = false;
+				fraction = t;
+				normal = scale(towards, -1.0f);
+				return true;
+			}
+
+			t += (gap - cs2::Sweeper::kSkin * 0.5f) / closing;
+			if (t >= maxFraction)
+				return false;
+		}
+
+		// Out of steps short of the skin, which a capsule grazing the triangle
+		// at a shallow angle can run into: it never got close enough to count as a hit.
+		return false;
+	}
+
+	// Walk the leaves whose bounds, grown by extents, the center enters before
+	// the nearest hit so far. best is read on every step, so hits found in one
+	// leaf prune the rest of the walk.
+	template<typename Fn>
+	void traverseSwept(const cs2::Bvh& bvh, const Vec3& start, const Vec3& delta, const Vec3& extents, const float& best, Fn&& fn)
+	{
+		struct Entry {
+			uint32_t node;
+			float distance;
+		};
+
+		const std::vector<cs2::BvhNode>& nodes = bvh.getNodes();
+		if (nodes.empty())
+			return;
+
+		const float origin[3] = { start.x, start.y, start.z };
+		const float grow[3] = { extents.x, extents.y, extents.z };
+		const float direction[3] = { delta.x, delta.y, delta.z };
+		float inverse[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float d = std::fabs(direction[axis]) < kMinDirection ? std::copysign(kMinDirection, direction[axis]) : direction[axis];
+			inverse[axis] = 1.0f / d;
+		}
+
+		Entry stack[cs2::Bvh::kStackSize];
+		size_t depth = 0;
+		stack[depth++] = Entry{ 0, 0.0f };
+
+		while (depth > 0)
+		{
+			Entry entry = stack[--depth];
+			if (entry.distance > best)
+				continue;
+
+			if (cs2::Bvh::isLeaf(entry.node))
+			{
+				fn(cs2::Bvh::getLeafFirstBlock(entry.node), cs2::Bvh::getLeafBlockCount(entry.node));
+				continue;
+			}
+
+			const cs2::BvhNode& node = nodes[entry.node];
+			const float* mins[3] = { node.min_x, node.min_y, node.min_z };
+			const float* maxs[3] = { node.max_x, node.max_y, node.max_z };
+
+			Entry children[4];
+			size_t count = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				if (node.children[i] == cs2::BvhNode::kEmptyChild)
+					continue;
+
+				float tn = 0.0f, tf = best;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					float t0 = (mins[axis][i] - grow[axis] - origin[axis]) * inverse[axis];
+					float t1 = (maxs[axis][i] + grow[axis] - origin[axis]) * inverse[axis];
+					if (inverse[axis] < 0.0f)
+						std::swap(t0, t1);
+					tn = std::max(tn, t0);
+					tf = std::min(tf, t1);
+				}
+				if (tn > tf)
+					continue;
+
+				// Keep the children sorted farthest first so the nearest is popped next.
+				Entry child{ node.children[i], tn };
+				size_t j = count++;
+				for (; j > 0 && children[j - 1].distance < child.distance; j--)
+					children[j] = children[j - 1];
+				children[j] = child;
+			}
+
+			for (size_t i = 0; i < count; i++)
+				stack[depth++] = children[i];
+		}
+	}
+
+	template<typename Test>
+	bool sweep(const cs2::Bvh& bvh, const Vec3& start, const Vec3& end, const Vec3& extents, Test&& test, cs2::SweepHit& hit)
+	{
+		const Vec3 delta = sub(end, start);
+		const cs2::TriangleSoup& soup = bvh.getSoup();
+
+		float best = 1.0f;
+		size_t best_lane = cs2::TriangleSoup::kPadding;
+		Vec3 best_normal(0.0f, 0.0f, 0.0f);
+		bool best_solid = false;
+
+		traverseSwept(bvh, start, delta, extents, best, [&](uint32_t firstBlock, uint32_t blockCount) {
+			// Bounds of the shape over the part of the move still in play.
+			Vec3 stop = add(start, scale(delta, best));
+			cs2::Aabb swept(sub(Vec3(std::min(start.x, stop.x), std::min(start.y, stop.y), std::min(start.z, stop.z)), extents),
+				add(Vec3(std::max(start.x, stop.x), std::max(start.y, stop.y), std::max(start.z, stop.z)), extents));
+
+			size_t first = static_cast<size_t>(firstBlock) * cs2::TriangleSoup::kLanes;
+			size_t last = first + static_cast<size_t>(blockCount) * cs2::TriangleSoup::kLanes;
+			for (size_t lane = first; lane < last; lane++)
+			{
+				if (bvh.getSourceIndex(lane) == cs2::TriangleSoup::kPadding)
+					continue;
+
+				cs2::Triangle tri = soup.get(lane);
+				cs2::Aabb tri_bounds;
+				tri_bounds.extend(tri.a);
+				tri_bounds.extend(tri.b);
+				tri_bounds.extend(tri.c);
+				if (!tri_bounds.overlaps(swept))
+					continue;
+
+				float fraction;
+				Vec3 normal;
+				bool start_solid = false;
+				if (!test(tri, delta, best, fraction, normal, start_solid))
+					continue;
+
+				// Prefer reporting that the shape starts stuck over a contact at zero.
+				if (fraction < best || (start_solid && !best_solid))
+				{
+					best = fraction;
+					best_lane = lane;
+					best_normal = normal;
+					best_solid = start_solid;
+				}
+			}
+		});
+
+		if (best_lane == cs2::TriangleSoup::kPadding)
+			return false;
+
+		hit.fraction = best;
+		hit.normal = best_normal;
+		hit.start_solid = best_solid;
+		hit.triangle = bvh.getSourceIndex(best_lane);
+		hit.hull = soup.getHull(best_lane);
+		hit.surface_prop = soup.getSurfaceProp(best_lane);
+		return true;
+	}
+}
+
+bool cs2::Sweeper::sweepBox(const Vec3& start, const Vec3& end, const Vec3& halfExtents, SweepHit& hit) const
+{
+	return sweep(bvh, start, end, halfExtents, [&](const Triangle& tri, const Vec3& delta, float maxFraction, float& fraction, Vec3& normal, bool& startSolid) {
+		return sweepBoxTriangle(tri, start, delta, halfExtents, maxFraction, fraction, normal, startSolid);
+	}, hit);
+}
+
+bool cs2::Sweeper::sweepCapsule(const Vec3& start, const Vec3& end, float radius, float halfHeight, SweepHit& hit) const
+{
+	Vec3 extents(radius, radius, radius + halfHeight);
+	return sweep(bvh, start, end, extents, [&](const Triangle& tri, const Vec3& delta, float maxFraction, float& fraction, Vec3& normal, bool& startSolid) {
+		return sweepCapsuleTriangle(tri, start, delta, radius, halfHeight, maxFraction, fraction, normal, startSolid);
+	}, hit);
+}
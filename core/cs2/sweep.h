@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+
+#include "bvh.h"
+
+namespace cs2
+{
+	class SweepHit {
+	public:
+		static constexpr uint32_t kNoHit = 0xFFFFFFFF;
+
+		// Fraction of the move completed before the shape touches geometry, 1 if nothing was hit.
+		float fraction = 1.0f;
+		// Unit normal of the contact, pointing from the geometry towards the shape.
+		Vec3 normal = Vec3(0.0f, 0.0f, 0.0f);
+		// Index of the triangle in hull order (see Bvh::getSourceIndex).
+		uint32_t triangle = kNoHit;
+		uint32_t hull = kNoHit;
+		// Index into PhysicsFile::getSurfaceProps.
+		uint32_t surface_prop = kNoHit;
+		// The shape already overlapped geometry at the start; fraction is 0 and normal is zero.
+		bool start_solid = false;
+
+		bool isHit() const { return triangle != kNoHit; }
+	};
+
+	/// <summary>
+	/// Swept-volume traces against the triangles of a BVH, for player movement
+	/// and spawn validation. The BVH is walked front to back with node bounds
+	/// grown by the shape's extents, and subtrees beyond the nearest hit so far
+	/// are skipped.
+	///
+	/// Boxes are swept exactly with the separating axis test over the 13 axes of
+	/// a box and a triangle. Capsules use conservative advancement, which stops
+	/// them within kSkin of the surface. Touching geometry while moving along or
+	/// away from it is not a hit.
+	/// </summary>
+	class Sweeper {
+	public:
+		// Capsules stop between kSkin / 2 and kSkin from the surface they hit.
+		static constexpr float kSkin = 1.0f / 32.0f;
+
+		/// <param name="bvh">
+		/// The BVH to sweep against, which must outlive the sweeper.
+		/// </param>
+		explicit Sweeper(const Bvh& bvh) : bvh(bvh) {}
+
+		/// <summary>
+		/// Sweep an axis-aligned box from start to end.
+		/// </summary>
+		/// <param name="start">
+		/// The center of the box at the start of the move.
+		/// </param>
+		/// <param name="end">
+		/// The center of the box at the end of the move.
+		/// </param>
+		/// <param name="halfExtents">
+		/// Half the size of the box on each axis, e.g. (16, 16, 36) for a standing player.
+		/// </param>
+		/// <param name="hit">
+		/// Receives the first contact, left untouched on a miss.
+		/// </param>
+		/// <returns>
+		/// Returns true if the box hit a triangle before reaching end, false otherwise.
+		/// </returns>
+		bool sweepBox(const Vec3& start, const Vec3& end, const Vec3& halfExtents, SweepHit& hit) const;
+
+		/// <summary>
+		/// Sweep an upright capsule from start to end. The capsule is the set of
+		/// points within radius of the vertical segment from center - halfHeight
+		/// to center + halfHeight.
+		/// </summary>
+		bool sweepCapsule(const Vec3& start, const Vec3& end, float radius, float halfHeight, SweepHit& hit) const;
+
+	private:
+		const Bvh& bvh;
+	};
+} // namespace cs2
@@ -0,0 +1,81 @@
+#include "visibility.h"
+
+#include <chrono>
+
+namespace
+{
+	float distanceSquared(const cs2::Vec3& a, const cs2::Vec3& b)
+	{
+		float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+		return dx * dx + dy * dy + dz * dz;
+	}
+}
+
+cs2::VisibilityTracker::VisibilityTracker(const Raycaster& raycaster, size_t players, const VisibilityOptions& options) :
+	raycaster(raycaster), players(players), options(options)
+{
+	reset();
+}
+
+void cs2::VisibilityTracker::reset()
+{
+	matrix.resize(players);
+	for (size_t a = 0; a < players; a++)
+		matrix.set(a, a, true);
+
+	pairs.assign(players * (players - (players > 0)) / 2, PairState());
+}
+
+bool cs2::VisibilityTracker::update(std::span<const Vec3> positions)
+{
+	if (positions.size() != players)
+	{
+		std::cerr << "Expected " << players << " player positions, got " << positions.size() << std::endl;
+		return false;
+	}
+
+	auto start_time = std::chrono::steady_clock::now();
+	const float tolerance_squared = options.tolerance * options.tolerance;
+	size_t pair = 0;
+
+	for (size_t a = 0; a < players; a++)
+	{
+		for (size_t b = a + 1; b < players; b++, pair++)
+		{
+			PairState& state = pairs[pair];
+			const Vec3& start = positions[a];
+			const Vec3& end = positions[b];
+
+			if (state.traced && options.tolerance > 0.0f &&
+				distanceSquared(start, state.start) < tolerance_squared && distanceSquared(end, state.end) < tolerance_squared)
+			{
+				stats.skipped++;
+				continue;
+			}
+
+			bool blocked;
+			if (options.reuse_blockers && state.blocker != PairState::kNoBlocker && raycaster.segmentAnyInBlock(start, end, state.blocker))
+			{
+				blocked = true;
+				stats.blocker_hits++;
+			}
+			else
+			{
+				uint32_t block = PairState::kNoBlocker;
+				blocked = raycaster.segmentAny(start, end, block);
+				state.blocker = blocked ? block : PairState::kNoBlocker;
+				stats.traced++;
+			}
+
+			state.start = start;
+			state.end = end;
+			state.traced = true;
+			matrix.set(a, b, !blocked);
+		}
+	}
+
+	stats.ticks++;
+	stats.pairs += pair;
+	stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	return true;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "raycast.h"
+
+namespace cs2
+{
+	/// <summary>
+	/// Which players can see each other, one bit per ordered pair. The matrix
+	/// is symmetric and every player sees itself.
+	/// </summary>
+	class VisibilityMatrix {
+	public:
+		void resize(size_t players)
+		{
+			size = players;
+			bits.assign((players * players + 63) / 64, 0);
+		}
+
+		size_t getPlayerCount() const { return size; }
+
+		bool canSee(size_t a, size_t b) const
+		{
+			size_t bit = a * size + b;
+			return (bits[bit / 64] >> (bit % 64)) & 1;
+		}
+
+		void set(size_t a, size_t b, bool visible)
+		{
+			for (size_t bit : { a * size + b, b * size + a })
+			{
+				if (visible)
+					bits[bit / 64] |= uint64_t(1) << (bit % 64);
+				else
+					bits[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+			}
+		}
+
+	private:
+		size_t size = 0;
+		std::vector<uint64_t> bits;
+	};
+
+	class VisibilityOptions {
+	public:
+		// A pair is not traced again while both players stay within this distance
+		// of where they were when it was last traced. Zero traces every pair every tick.
+		float tolerance = 1.0f;
+		// Test the block that blocked a pair last time before tracing it again.
+		bool reuse_blockers = true;
+	};
+
+	class VisibilityStats {
+	public:
+		size_t ticks = 0;
+		size_t pairs = 0;
+		// Pairs whose players stayed within the tolerance and kept their result.
+		size_t skipped = 0;
+		// Pairs found blocked by the block that blocked them before.
+		size_t blocker_hits = 0;
+		// Pairs traced through the BVH.
+		size_t traced = 0;
+		double seconds = 0.0;
+	};
+
+	/// <summary>
+	/// Tracks which players can see each other over the ticks of a replay.
+	/// Positions barely move between ticks, so each pair remembers where it was
+	/// last traced and what blocked it: pairs that have not moved keep their
+	/// result, and a blocked pair first retests the block that blocked it,
+	/// which usually still does. Only the remaining pairs go through the BVH.
+	/// </summary>
+	class VisibilityTracker {
+	public:
+		/// <param name="raycaster">
+		/// The raycaster to trace with, which must outlive the tracker.
+		/// </param>
+		/// <param name="players">
+		/// The number of players in every tick.
+		/// </param>
+		VisibilityTracker(const Raycaster& raycaster, size_t players, const VisibilityOptions& options = VisibilityOptions());
+
+		/// <summary>
+		/// Compute the visibility matrix of the next tick.
+		/// </summary>
+		/// <param name="positions">
+		/// The eye position of every player.
+		/// </param>
+		/// <returns>
+		/// Returns false if the number of positions does not match the number of players.
+		/// </returns>
+		bool update(std::span<const Vec3> positions);
+
+		/// <summary>
+		/// Forget all cached results, e.g. at a round restart when everyone teleports.
+		/// </summary>
+		void reset();
+
+		const VisibilityMatrix& getMatrix() const { return matrix; }
+		const VisibilityStats& getStats() const { return stats; }
+
+	private:
+		class PairState {
+		public:
+			static constexpr uint32_t kNoBlocker = 0xFFFFFFFF;
+
+			Vec3 start;
+			Vec3 end;
+			uint32_t blocker = kNoBlocker;
+			bool traced = false;
+		};
+
+		const Raycaster& raycaster;
+		size_t players;
+		VisibilityOptions options;
+		VisibilityMatrix matrix;
+		// One per unordered pair (a, b) with a < b, in row order.
+		std::vector<PairState> pairs;
+		VisibilityStats stats;
+	};
+} // namespace cs2
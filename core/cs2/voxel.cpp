@@ -0,0 +1,673 @@
+#include "voxel.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+#include "parallel.h"
+
+namespace
+{
+	constexpr size_t kChunkSize = cs2::VoxelGrid::kChunkSize;
+	constexpr size_t kBrickSize = cs2::VoxelGrid::kBrickSize;
+	constexpr size_t kChunkBricks = cs2::VoxelGrid::kChunkBricks;
+	constexpr size_t kNodeEntries = kChunkBricks * kChunkBricks * kChunkBricks;
+
+	// Voxels are grown by this fraction of their size when marking the ones a
+	// triangle touches, so rounding never drops one.
+	constexpr float kSlack = 1e-3f;
+	// Crossings of one hull closer than this fraction of a voxel are the same crossing.
+	constexpr float kCoincident = 1e-3f;
+	// Largest grid, in chunks; keeps node and brick indices below kSolid.
+	constexpr size_t kMaxChunks = size_t(1) << 22;
+
+	struct Vertex {
+		float x, y, z;
+	};
+
+	struct Crossing {
+		// Vertical line through voxel centers, y * kChunkSize + x within the column.
+		uint32_t line;
+		uint32_t hull;
+		float z;
+		// Sign of the triangle normal's z, +1 or -1.
+		int32_t facing;
+	};
+
+	// One column of chunks, voxelized densely and then compressed on its own.
+	class ColumnBuilder {
+	public:
+		// Nodes and bricks are numbered within the column until they are merged.
+		std::vector<uint32_t> root;
+		std::vector<uint32_t> nodes;
+		std::vector<cs2::VoxelBrick> bricks;
+		size_t boundary_voxels = 0;
+		size_t solid_voxels = 0;
+
+		// Voxel rows of the column, bit x of row z * kChunkSize + y.
+		std::vector<uint64_t> boundary;
+		std::vector<uint64_t> inside;
+		std::vector<Crossing> crossings;
+		std::vector<Crossing> sorted;
+		std::vector<uint32_t> line_starts;
+		std::vector<std::pair<float, float>> intervals;
+
+		void build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& hulls, const uint32_t* triangles, size_t count,
+			size_t columnX, size_t columnY, size_t chunksZ)
+		{
+			const size_t size_z = chunksZ * kChunkSize;
+			boundary.assign(size_z * kChunkSize, 0);
+			inside.assign(size_z * kChunkSize, 0);
+			crossings.clear();
+
+			const float offset_x = static_cast<float>(columnX * kChunkSize);
+			const float offset_y = static_cast<float>(columnY * kChunkSize);
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t t = triangles[i];
+				Vertex v[3];
+				for (int k = 0; k < 3; k++)
+					v[k] = Vertex{ vertices[t * 3 + k].x - offset_x, vertices[t * 3 + k].y - offset_y, vertices[t * 3 + k].z };
+
+				markBoundary(v, size_z);
+				addCrossings(v, hulls[t]);
+			}
+
+			fillInside(size_z);
+
+			for (size_t row = 0; row < boundary.size(); row++)
+			{
+				inside[row] &= ~boundary[row];
+				boundary_voxels += std::popcount(boundary[row]);
+				solid_voxels += std::popcount(inside[row]);
+			}
+
+			compress(chunksZ);
+
+			// The dense rows are reused by the next column on this worker.
+			crossings.clear();
+		}
+
+	private:
+		// Mark the voxels a triangle touches, one row of x at a time: the part of
+		// the triangle inside the row's y and z slab is convex, so every voxel
+		// between its smallest and largest x is touched.
+		void markBoundary(const Vertex v[3], size_t sizeZ)
+		{
+			float lo[3], hi[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				lo[axis] = std::min(std::min((&v[0].x)[axis], (&v[1].x)[axis]), (&v[2].x)[axis]);
+				hi[axis] = std::max(std::max((&v[0].x)[axis], (&v[1].x)[axis]), (&v[2].x)[axis]);
+			}
+
+			const int64_t limit[3] = { static_cast<int64_t>(kChunkSize) - 1, static_cast<int64_t>(kChunkSize) - 1, static_cast<int64_t>(sizeZ) - 1 };
+			int64_t first[3], last[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				first[axis] = std::max<int64_t>(static_cast<int64_t>(std::floor(lo[axis] - kSlack)), 0);
+				last[axis] = std::min<int64_t>(static_cast<int64_t>(std::floor(hi[axis] + kSlack)), limit[axis]);
+				if (first[axis] > last[axis])
+					return;
+			}
+
+			for (int64_t z = first[2]; z <= last[2]; z++)
+			{
+				for (int64_t y = first[1]; y <= last[1]; y++)
+				{
+					float x0, x1;
+					if (!clipToRow(v, static_cast<float>(y), static_cast<float>(z), x0, x1))
+						continue;
+
+					int64_t row_first = std::max<int64_t>(static_cast<int64_t>(std::floor(x0 - kSlack)), first[0]);
+					int64_t row_last = std::min<int64_t>(static_cast<int64_t>(std::floor(x1 + kSlack)), last[0]);
+					if (row_first <= row_last)
+						boundary[z * kChunkSize + y] |= (~uint64_t(0) >> (63 - (row_last - row_first))) << row_first;
+				}
+			}
+		}
+
+		// Clip a triangle to the slab y..y+1, z..z+1 (grown by kSlack) and return its extent in x.
+		static bool clipToRow(const Vertex v[3], float y, float z, float& x0, float& x1)
+		{
+			Vertex buffer[2][7];
+			Vertex* polygon = buffer[0];
+			Vertex* clipped = buffer[1];
+			size_t count = 3;
+			std::copy(v, v + 3, polygon);
+
+			const float planes[4][2] = { { y - kSlack, 1.0f }, { y + 1.0f + kSlack, -1.0f }, { z - kSlack, 1.0f }, { z + 1.0f + kSlack, -1.0f } };
+			for (int p = 0; p < 4; p++)
+			{
+				const bool along_y = p < 2;
+				const float plane = planes[p][0], direction = planes[p][1];
+				auto distance = [&](const Vertex& vertex) { return ((along_y ? vertex.y : vertex.z) - plane) * direction; };
+
+				size_t out = 0;
+				for (size_t i = 0; i < count; i++)
+				{
+					const Vertex& a = polygon[i];
+					const Vertex& b = polygon[(i + 1) % count];
+					float da = distance(a), db = distance(b);
+					if (da >= 0.0f)
+						clipped[out++] = a;
+					if ((da >= 0.0f) != (db >= 0.0f))
+					{
+						float t = da / (da - db);
+						clipped[out++] = Vertex{ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+					}
+				}
+
+				count = out;
+				if (count == 0)
+					return false;
+				std::swap(polygon, clipped);
+			}
+
+			x0 = x1 = polygon[0].x;
+			for (size_t i = 1; i < count; i++)
+			{
+				x0 = std::min(x0, polygon[i].x);
+				x1 = std::max(x1, polygon[i].x);
+			}
+			return true;
+		}
+
+		// Record where the vertical lines through the voxel centers cross the
+		// triangle. Edges are inclusive, so a line through a shared edge crosses
+		// both triangles; fillInside merges the two.
+		void addCrossings(const Vertex v[3], uint32_t hull)
+		{
+			float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+			if (area == 0.0f)
+				return;
+
+			const float min_x = std::min(std::min(v[0].x, v[1].x), v[2].x), max_x = std::max(std::max(v[0].x, v[1].x), v[2].x);
+			const float min_y = std::min(std::min(v[0].y, v[1].y), v[2].y), max_y = std::max(std::max(v[0].y, v[1].y), v[2].y);
+			const int64_t first_x = std::max<int64_t>(static_cast<int64_t>(std::ceil(min_x - 0.5f)), 0);
+			const int64_t last_x = std::min<int64_t>(static_cast<int64_t>(std::floor(max_x - 0.5f)), kChunkSize - 1);
+			const int64_t first_y = std::max<int64_t>(static_cast<int64_t>(std::ceil(min_y - 0.5f)), 0);
+			const int64_t last_y = std::min<int64_t>(static_cast<int64_t>(std::floor(max_y - 0.5f)), kChunkSize - 1);
+
+			auto edge = [](const Vertex& a, const Vertex& b, float px, float py) {
+				return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+			};
+
+			const float sign = area > 0.0f ? 1.0f : -1.0f;
+			for (int64_t y = first_y; y <= last_y; y++)
+			{
+				for (int64_t x = first_x; x <= last_x; x++)
+				{
+					const float px = x + 0.5f, py = y + 0.5f;
+					float w0 = edge(v[1], v[2], px, py) * sign;
+					float w1 = edge(v[2], v[0], px, py) * sign;
+					float w2 = edge(v[0], v[1], px, py) * sign;
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+						continue;
+
+					float z = (w0 * v[0].z + w1 * v[1].z + w2 * v[2].z) / (w0 + w1 + w2);
+					crossings.push_back(Crossing{ static_cast<uint32_t>(y * kChunkSize + x), hull, z, area > 0.0f ? 1 : -1 });
+				}
+			}
+		}
+
+		// Follow the crossings of each hull up each line by their facing, like
+		// PenetrationTracer, and mark the voxels whose centers lie between an
+		// entry and the exit that brings the hull's depth back to zero. Exits
+		// with nothing entered and entries never left, as open surfaces give, fill nothing.
+		// The intervals of a line are merged and only their ends are marked, as
+		// bits that toggle the state; one pass up each column of rows resolves them.
+		void fillInside(size_t sizeZ)
+		{
+			// Counting sort by line, then each line's few crossings by hull and height.
+			constexpr size_t kLines = kChunkSize * kChunkSize;
+			std::vector<uint32_t>& starts = line_starts;
+			starts.assign(kLines + 1, 0);
+			for (const Crossing& crossing : crossings)
+				starts[crossing.line + 1]++;
+			for (size_t line = 0; line < kLines; line++)
+				starts[line + 1] += starts[line];
+
+			sorted.resize(crossings.size());
+			std::vector<uint32_t> cursor(starts.begin(), starts.end() - 1);
+			for (const Crossing& crossing : crossings)
+				sorted[cursor[crossing.line]++] = crossing;
+
+			for (size_t line = 0; line < kLines; line++)
+			{
+				Crossing* first = sorted.data() + starts[line];
+				Crossing* last = sorted.data() + starts[line + 1];
+				if (first == last)
+					continue;
+
+				std::sort(first, last, [](const Crossing& a, const Crossing& b) { return a.hull < b.hull || (a.hull == b.hull && a.z < b.z); });
+
+				intervals.clear();
+				for (Crossing* c = first; c != last;)
+				{
+					const uint32_t hull = c->hull;
+					int depth = 0;
+					float enter = 0.0f;
+					while (c != last && c->hull == hull)
+					{
+						const float z = c->z;
+						int facing = 0;
+						for (; c != last && c->hull == hull && c->z - z < kCoincident; c++)
+							facing += c->facing;
+						if (facing == 0)
+							continue;
+
+						// Going up, a face whose normal points down enters the hull and one pointing up leaves it.
+						if (facing < 0)
+						{
+							if (depth++ == 0)
+								enter = z;
+						}
+						else if (depth > 0 && --depth == 0)
+						{
+							intervals.emplace_back(enter, z);
+						}
+					}
+				}
+
+				// Merge overlapping hulls, then toggle at the first voxel center inside and the first one past.
+				std::sort(intervals.begin(), intervals.end());
+				const uint64_t bit = uint64_t(1) << (line % kChunkSize);
+				const size_t y = line / kChunkSize;
+				for (size_t i = 0; i < intervals.size();)
+				{
+					float enter = intervals[i].first, exit = intervals[i].second;
+					for (i++; i < intervals.size() && intervals[i].first <= exit; i++)
+						exit = std::max(exit, intervals[i].second);
+
+					int64_t from = std::max<int64_t>(static_cast<int64_t>(std::ceil(enter - 0.5f)), 0);
+					int64_t to = std::min<int64_t>(static_cast<int64_t>(std::floor(exit - 0.5f)) + 1, static_cast<int64_t>(sizeZ));
+					if (from >= to)
+						continue;
+					inside[from * kChunkSize + y] ^= bit;
+					if (to < static_cast<int64_t>(sizeZ))
+						inside[to * kChunkSize + y] ^= bit;
+				}
+			}
+
+			for (size_t y = 0; y < kChunkSize; y++)
+			{
+				uint64_t state = 0;
+				for (size_t z = 0; z < sizeZ; z++)
+				{
+					state ^= inside[z * kChunkSize + y];
+					inside[z * kChunkSize + y] = state;
+				}
+			}
+		}
+
+		void compress(size_t chunksZ)
+		{
+			root.assign(chunksZ, cs2::VoxelGrid::kEmpty);
+			uint32_t entries[kNodeEntries];
+
+			for (size_t cz = 0; cz < chunksZ; cz++)
+			{
+				// Most chunks are all empty or all solid; check the rows before splitting them into bricks.
+				const size_t rows = kChunkSize * kChunkSize;
+				const uint64_t* chunk_boundary = boundary.data() + cz * rows;
+				const uint64_t* chunk_inside = inside.data() + cz * rows;
+				if (std::all_of(chunk_boundary, chunk_boundary + rows, [](uint64_t row) { return row == 0; }))
+				{
+					if (std::all_of(chunk_inside, chunk_inside + rows, [](uint64_t row) { return row == 0; }))
+						continue;
+					if (std::all_of(chunk_inside, chunk_inside + rows, [](uint64_t row) { return row == ~uint64_t(0); }))
+					{
+						root[cz] = cs2::VoxelGrid::kSolid;
+						continue;
+					}
+				}
+
+				for (size_t b = 0; b < kNodeEntries; b++)
+				{
+					const size_t bx = b % kChunkBricks, by = (b / kChunkBricks) % kChunkBricks, bz = b / (kChunkBricks * kChunkBricks);
+					cs2::VoxelBrick brick;
+					bool any_boundary = false, any_solid = false, all_solid = true;
+					for (size_t lz = 0; lz < kBrickSize; lz++)
+					{
+						const size_t z = cz * kChunkSize + bz * kBrickSize + lz;
+						uint64_t boundary_word = 0, solid_word = 0;
+						for (size_t ly = 0; ly < kBrickSize; ly++)
+						{
+							const size_t row = z * kChunkSize + by * kBrickSize + ly;
+							boundary_word |= ((boundary[row] >> (bx * kBrickSize)) & 0xFF) << (ly * kBrickSize);
+							solid_word |= ((inside[row] >> (bx * kBrickSize)) & 0xFF) << (ly * kBrickSize);
+						}
+						brick.boundary[lz] = boundary_word;
+						brick.solid[lz] = solid_word;
+						any_boundary |= boundary_word != 0;
+						any_solid |= solid_word != 0;
+						all_solid &= solid_word == ~uint64_t(0);
+					}
+
+					if (!any_boundary && !any_solid)
+					{
+						entries[b] = cs2::VoxelGrid::kEmpty;
+					}
+					else if (all_solid)
+					{
+						entries[b] = cs2::VoxelGrid::kSolid;
+					}
+					else
+					{
+						entries[b] = static_cast<uint32_t>(bricks.size());
+						bricks.push_back(brick);
+					}
+				}
+
+				bool uniform = std::all_of(entries + 1, entries + kNodeEntries, [&](uint32_t entry) { return entry == entries[0]; });
+				if (uniform && entries[0] >= cs2::VoxelGrid::kSolid)
+				{
+					root[cz] = entries[0];
+				}
+				else
+				{
+					root[cz] = static_cast<uint32_t>(nodes.size() / kNodeEntries);
+					nodes.insert(nodes.end(), entries, entries + kNodeEntries);
+				}
+			}
+		}
+	};
+}
+
+bool cs2::VoxelGrid::build(const PhysicsFile& physics, const VoxelOptions& options)
+{
+	return build(TriangleSoup(physics, options.threads), options);
+}
+
+bool cs2::VoxelGrid::build(const TriangleSoup& source, const VoxelOptions& options)
+{
+	auto start_time = std::chrono::steady_clock::now();
+
+	root.clear();
+	nodes.clear();
+	bricks.clear();
+	chunks_x = chunks_y = chunks_z = 0;
+	bounds = Aabb();
+	stats = VoxelStats();
+
+	if (!(options.voxel_size > 0.0f))
+	{
+		std::cerr << "Voxel size must be positive, got " << options.voxel_size << std::endl;
+		return false;
+	}
+	voxel_size = options.voxel_size;
+	inverse_size = 1.0f / voxel_size;
+
+	std::vector<uint32_t> refs;
+	refs.reserve(source.size());
+	for (size_t i = 0; i < source.size(); i++)
+	{
+		if (source.getHull(i) == TriangleSoup::kPadding)
+			continue;
+
+		refs.push_back(static_cast<uint32_t>(i));
+		Triangle tri = source.get(i);
+		bounds.extend(tri.a);
+		bounds.extend(tri.b);
+		bounds.extend(tri.c);
+	}
+
+	stats.triangles = refs.size();
+	if (refs.empty())
+		return true;
+
+	// One voxel of margin, so voxels touched by triangles on the bounds are inside the grid.
+	origin = Vec3(std::floor(bounds.min.x * inverse_size) * voxel_size - voxel_size,
+		std::floor(bounds.min.y * inverse_size) * voxel_size - voxel_size,
+		std::floor(bounds.min.z * inverse_size) * voxel_size - voxel_size);
+	auto chunksFor = [&](float extent) {
+		return static_cast<size_t>(std::floor(extent * inverse_size) + 2.0f + kChunkSize - 1) / kChunkSize;
+	};
+	chunks_x = chunksFor(bounds.max.x - origin.x);
+	chunks_y = chunksFor(bounds.max.y - origin.y);
+	chunks_z = chunksFor(bounds.max.z - origin.z);
+
+	if (chunks_x * chunks_y * chunks_z > kMaxChunks)
+	{
+		std::cerr << "Voxel grid of " << chunks_x * kChunkSize << "x" << chunks_y * kChunkSize << "x" << chunks_z * kChunkSize
+			<< " is too large, use a larger voxel size" << std::endl;
+		chunks_x = chunks_y = chunks_z = 0;
+		return false;
+	}
+
+	// Triangles in voxel units, and the columns of chunks their bounds touch.
+	std::vector<Vertex> vertices(refs.size() * 3);
+	std::vector<uint32_t> hulls(refs.size());
+	std::vector<uint32_t> column_range(refs.size() * 4);
+	unsigned threads = resolveThreadCount(options.threads);
+	parallelFor(refs.size(), threads, [&](size_t i, unsigned) {
+		Triangle tri = source.get(refs[i]);
+		float min_x = std::numeric_limits<float>::max(), max_x = -min_x, min_y = min_x, max_y = -min_x;
+		for (int k = 0; k < 3; k++)
+		{
+			const Vec3& p = k == 0 ? tri.a : k == 1 ? tri.b : tri.c;
+			Vertex& v = vertices[i * 3 + k];
+			v = Vertex{ (p.x - origin.x) * inverse_size, (p.y - origin.y) * inverse_size, (p.z - origin.z) * inverse_size };
+			min_x = std::min(min_x, v.x); max_x = std::max(max_x, v.x);
+			min_y = std::min(min_y, v.y); max_y = std::max(max_y, v.y);
+		}
+		hulls[i] = source.getHull(refs[i]);
+
+		auto column = [](float value, size_t count) {
+			return static_cast<uint32_t>(std::clamp<int64_t>(static_cast<int64_t>(std::floor(value)) / static_cast<int64_t>(kChunkSize), 0, count - 1));
+		};
+		column_range[i * 4 + 0] = column(min_x - kSlack, chunks_x);
+		column_range[i * 4 + 1] = column(max_x + kSlack, chunks_x);
+		column_range[i * 4 + 2] = column(min_y - kSlack, chunks_y);
+		column_range[i * 4 + 3] = column(max_y + kSlack, chunks_y);
+	});
+
+	// Bin the triangles by column.
+	const size_t columns = chunks_x * chunks_y;
+	std::vector<size_t> offsets(columns + 1, 0);
+	for (size_t i = 0; i < refs.size(); i++)
+		for (uint32_t y = column_range[i * 4 + 2]; y <= column_range[i * 4 + 3]; y++)
+			for (uint32_t x = column_range[i * 4 + 0]; x <= column_range[i * 4 + 1]; x++)
+				offsets[y * chunks_x + x + 1]++;
+	for (size_t c = 0; c < columns; c++)
+		offsets[c + 1] += offsets[c];
+
+	std::vector<uint32_t> binned(offsets[columns]);
+	std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < refs.size(); i++)
+		for (uint32_t y = column_range[i * 4 + 2]; y <= column_range[i * 4 + 3]; y++)
+			for (uint32_t x = column_range[i * 4 + 0]; x <= column_range[i * 4 + 1]; x++)
+				binned[cursor[y * chunks_x + x]++] = static_cast<uint32_t>(i);
+
+	// Voxelize the columns in parallel. Each worker keeps its dense rows
+	// between columns; the compressed results are merged in column order.
+	std::vector<ColumnBuilder> workers(threads);
+	std::vector<ColumnBuilder> results(columns);
+	parallelFor(columns, threads, [&](size_t c, unsigned worker) {
+		ColumnBuilder& builder = workers[worker];
+		builder.build(vertices, hulls, binned.data() + offsets[c], offsets[c + 1] - offsets[c], c % chunks_x, c / chunks_x, chunks_z);
+
+		ColumnBuilder& result = results[c];
+		result.root = std::move(builder.root);
+		result.nodes = std::move(builder.nodes);
+		result.bricks = std::move(builder.bricks);
+		result.boundary_voxels = builder.boundary_voxels;
+		result.solid_voxels = builder.solid_voxels;
+		builder.root.clear();
+		builder.nodes.clear();
+		builder.bricks.clear();
+		builder.boundary_voxels = builder.solid_voxels = 0;
+	});
+	workers.clear();
+
+	size_t node_count = 0, brick_count = 0;
+	for (auto& result : results)
+	{
+		node_count += result.nodes.size() / kNodeEntries;
+		brick_count += result.bricks.size();
+	}
+	if (brick_count >= kSolid || node_count * kNodeEntries >= kSolid)
+	{
+		std::cerr << "Voxel grid has too many bricks, use a larger voxel size" << std::endl;
+		chunks_x = chunks_y = chunks_z = 0;
+		return false;
+	}
+
+	root.assign(chunks_x * chunks_y * chunks_z, kEmpty);
+	nodes.reserve(node_count * kNodeEntries);
+	bricks.reserve(brick_count);
+	for (size_t c = 0; c < columns; c++)
+	{
+		ColumnBuilder& result = results[c];
+		const uint32_t node_offset = static_cast<uint32_t>(nodes.size() / kNodeEntries);
+		const uint32_t brick_offset = static_cast<uint32_t>(bricks.size());
+
+		for (size_t cz = 0; cz < chunks_z; cz++)
+		{
+			uint32_t entry = result.root[cz];
+			root[cz * columns + c] = entry >= kSolid ? entry : entry + node_offset;
+		}
+		for (uint32_t entry : result.nodes)
+			nodes.push_back(entry >= kSolid ? entry : entry + brick_offset);
+		bricks.insert(bricks.end(), result.bricks.begin(), result.bricks.end());
+
+		stats.boundary_voxels += result.boundary_voxels;
+		stats.solid_voxels += result.solid_voxels;
+		result = ColumnBuilder();
+	}
+
+	stats.size_x = chunks_x * kChunkSize;
+	stats.size_y = chunks_y * kChunkSize;
+	stats.size_z = chunks_z * kChunkSize;
+	stats.chunks = root.size();
+	stats.nodes = node_count;
+	stats.bricks = brick_count;
+	stats.bytes = root.capacity() * sizeof(uint32_t) + nodes.capacity() * sizeof(uint32_t) + bricks.capacity() * sizeof(VoxelBrick);
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	return true;
+}
+
+bool cs2::VoxelGrid::toVoxel(const Vec3& point, int64_t voxel[3]) const
+{
+	const float local[3] = { (point.x - origin.x) * inverse_size, (point.y - origin.y) * inverse_size, (point.z - origin.z) * inverse_size };
+	const size_t size[3] = { chunks_x * kChunkSize, chunks_y * kChunkSize, chunks_z * kChunkSize };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// Also rejects NaN.
+		if (!(local[axis] >= 0.0f && local[axis] < static_cast<float>(size[axis])))
+			return false;
+		voxel[axis] = std::min(static_cast<int64_t>(local[axis]), static_cast<int64_t>(size[axis]) - 1);
+	}
+	return true;
+}
+
+cs2::VoxelState cs2::VoxelGrid::getState(const Vec3& point) const
+{
+	int64_t v[3];
+	if (root.empty() || !toVoxel(point, v))
+		return VoxelState::Empty;
+
+	uint32_t entry = root[((v[2] / kChunkSize) * chunks_y + v[1] / kChunkSize) * chunks_x + v[0] / kChunkSize];
+	if (entry >= kSolid)
+		return entry == kSolid ? VoxelState::Solid : VoxelState::Empty;
+
+	size_t slot = (v[0] / kBrickSize) % kChunkBricks + ((v[1] / kBrickSize) % kChunkBricks) * kChunkBricks +
+		((v[2] / kBrickSize) % kChunkBricks) * kChunkBricks * kChunkBricks;
+	entry = nodes[entry * kNodeEntries + slot];
+	if (entry >= kSolid)
+		return entry == kSolid ? VoxelState::Solid : VoxelState::Empty;
+
+	const VoxelBrick& brick = bricks[entry];
+	const uint64_t bit = uint64_t(1) << (v[0] % kBrickSize + (v[1] % kBrickSize) * kBrickSize);
+	const size_t z = v[2] % kBrickSize;
+	if (brick.boundary[z] & bit)
+		return VoxelState::Boundary;
+	return (brick.solid[z] & bit) ? VoxelState::Solid : VoxelState::Empty;
+}
+
+bool cs2::VoxelGrid::isClear(const Aabb& box) const
+{
+	if (root.empty() || box.isEmpty())
+		return true;
+
+	// Voxel range of the box, clamped to the grid; geometry never lies outside it.
+	const float lo[3] = { (box.min.x - origin.x) * inverse_size, (box.min.y - origin.y) * inverse_size, (box.min.z - origin.z) * inverse_size };
+	const float hi[3] = { (box.max.x - origin.x) * inverse_size, (box.max.y - origin.y) * inverse_size, (box.max.z - origin.z) * inverse_size };
+	const size_t size[3] = { chunks_x * kChunkSize, chunks_y * kChunkSize, chunks_z * kChunkSize };
+	int64_t first[3], last[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (!(hi[axis] >= 0.0f) || !(lo[axis] < static_cast<float>(size[axis])))
+			return true;
+		first[axis] = std::max<int64_t>(static_cast<int64_t>(std::floor(lo[axis])), 0);
+		last[axis] = std::min<int64_t>(static_cast<int64_t>(std::floor(hi[axis])), static_cast<int64_t>(size[axis]) - 1);
+	}
+
+	for (int64_t cz = first[2] / kChunkSize; cz <= last[2] / static_cast<int64_t>(kChunkSize); cz++)
+	for (int64_t cy = first[1] / kChunkSize; cy <= last[1] / static_cast<int64_t>(kChunkSize); cy++)
+	for (int64_t cx = first[0] / kChunkSize; cx <= last[0] / static_cast<int64_t>(kChunkSize); cx++)
+	{
+		uint32_t chunk = root[(cz * chunks_y + cy) * chunks_x + cx];
+		if (chunk == kEmpty)
+			continue;
+		if (chunk == kSolid)
+			return false;
+
+		// Brick range of the box within this chunk.
+		int64_t brick_first[3], brick_last[3];
+		const int64_t chunk_origin[3] = { cx * static_cast<int64_t>(kChunkSize), cy * static_cast<int64_t>(kChunkSize), cz * static_cast<int64_t>(kChunkSize) };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			brick_first[axis] = (std::max(first[axis], chunk_origin[axis]) - chunk_origin[axis]) / kBrickSize;
+			brick_last[axis] = (std::min(last[axis], chunk_origin[axis] + static_cast<int64_t>(kChunkSize) - 1) - chunk_origin[axis]) / kBrickSize;
+		}
+
+		for (int64_t bz = brick_first[2]; bz <= brick_last[2]; bz++)
+		for (int64_t by = brick_first[1]; by <= brick_last[1]; by++)
+		for (int64_t bx = brick_first[0]; bx <= brick_last[0]; bx++)
+		{
+			uint32_t entry = nodes[chunk * kNodeEntries + bx + by * kChunkBricks + bz * kChunkBricks * kChunkBricks];
+			if (entry == kEmpty)
+				continue;
+			if (entry == kSolid)
+				return false;
+
+			// Voxel range within the brick, as a mask over one z layer and a z range.
+			const int64_t brick_origin[3] = { chunk_origin[0] + bx * static_cast<int64_t>(kBrickSize),
+				chunk_origin[1] + by * static_cast<int64_t>(kBrickSize), chunk_origin[2] + bz * static_cast<int64_t>(kBrickSize) };
+			int64_t voxel_first[3], voxel_last[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				voxel_first[axis] = std::max(first[axis], brick_origin[axis]) - brick_origin[axis];
+				voxel_last[axis] = std::min(last[axis], brick_origin[axis] + static_cast<int64_t>(kBrickSize) - 1) - brick_origin[axis];
+			}
+
+			const uint64_t row = ((uint64_t(1) << (voxel_last[0] - voxel_first[0] + 1)) - 1) << voxel_first[0];
+			uint64_t mask = 0;
+			for (int64_t y = voxel_first[1]; y <= voxel_last[1]; y++)
+				mask |= row << (y * kBrickSize);
+
+			const VoxelBrick& brick = bricks[entry];
+			for (int64_t z = voxel_first[2]; z <= voxel_last[2]; z++)
+			{
+				if ((brick.boundary[z] | brick.solid[z]) & mask)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+void cs2::VoxelGrid::displayStats() const
+{
+	size_t voxels = stats.size_x * stats.size_y * stats.size_z;
+	std::cout << "Voxel Size: " << voxel_size << std::endl;
+	std::cout << "Voxel Grid: " << stats.size_x << "x" << stats.size_y << "x" << stats.size_z << " (" << stats.chunks << " chunks)" << std::endl;
+	std::cout << "Voxel Occupancy: " << stats.boundary_voxels << " boundary, " << stats.solid_voxels << " solid of " << voxels << std::endl;
+	std::cout << "Voxel Nodes: " << stats.nodes << ", Bricks: " << stats.bricks << std::endl;
+	std::cout << "Voxel Memory: " << stats.bytes / 1024 << " KB" << std::endl;
+	std::cout << "Voxel Build Time: " << stats.seconds * 1000.0 << " ms" << std::endl;
+	std::cout << std::endl;
+}
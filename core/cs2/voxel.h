@@ -0,0 +1,140 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "parser.h"
+#include "soup.h"
+
+namespace cs2
+{
+	enum class VoxelState : uint8_t {
+		// No triangle touches the voxel and its center is outside every hull.
+		Empty,
+		// A triangle touches the voxel, so it is partly solid.
+		Boundary,
+		// The voxel lies entirely inside a hull.
+		Solid,
+	};
+
+	/// <summary>
+	/// Eight by eight by eight voxels, one bit each in two masks. Bit
+	/// x + 8 * y of word z is voxel (x, y, z).
+	/// </summary>
+	struct alignas(64) VoxelBrick {
+		static constexpr size_t kSize = 8;
+
+		uint64_t boundary[kSize];
+		uint64_t solid[kSize];
+	};
+
+	static_assert(sizeof(VoxelBrick) == 128, "VoxelBrick must span exactly two cache lines");
+
+	class VoxelOptions {
+	public:
+		// Number of threads voxelizing columns, zero for one per hardware thread.
+		unsigned threads = 1;
+		// Edge length of a voxel in map units.
+		float voxel_size = 8.0f;
+	};
+
+	class VoxelStats {
+	public:
+		size_t triangles = 0;
+		// Size of the grid in voxels, padded to whole chunks.
+		size_t size_x = 0, size_y = 0, size_z = 0;
+		size_t boundary_voxels = 0;
+		size_t solid_voxels = 0;
+		size_t chunks = 0;
+		// Chunks and bricks that are not all empty or all solid, and so are stored.
+		size_t nodes = 0;
+		size_t bricks = 0;
+		size_t bytes = 0;
+		double seconds = 0.0;
+	};
+
+	/// <summary>
+	/// Sparse occupancy grid over the hulls of a map, for point-in-solid and
+	/// clearance checks that do not need exact triangle tests. The grid is a
+	/// three level hierarchy: a dense root of chunks of 64^3 voxels, nodes of
+	/// 8^3 bricks for chunks that are not uniform, and bricks of 8^3 voxels
+	/// for bricks that are not uniform. A point query reads at most one entry
+	/// of each level.
+	///
+	/// Voxels touched by a triangle are Boundary, found by clipping the
+	/// triangle to each row of voxels it spans. The others are Solid if their center is inside a
+	/// hull, found by following the crossings of each hull by their facing
+	/// along vertical lines through the voxel centers (see PenetrationTracer), so
+	/// the air between the surfaces of an open or multi-shell mesh stays empty. Empty voxels and
+	/// boxes reported clear are therefore guaranteed free of geometry.
+	/// </summary>
+	class VoxelGrid {
+	public:
+		static constexpr size_t kBrickSize = VoxelBrick::kSize;
+		// Bricks along each side of a chunk.
+		static constexpr size_t kChunkBricks = 8;
+		static constexpr size_t kChunkSize = kBrickSize * kChunkBricks;
+
+		// Root and node entries that do not index a node or brick.
+		static constexpr uint32_t kEmpty = 0xFFFFFFFF;
+		static constexpr uint32_t kSolid = 0xFFFFFFFE;
+
+		/// <summary>
+		/// Voxelize every hull of a physics file.
+		/// </summary>
+		/// <returns>
+		/// Returns false if the voxel size is not positive or the grid would be too large.
+		/// </returns>
+		bool build(const PhysicsFile& physics, const VoxelOptions& options = VoxelOptions());
+
+		/// <summary>
+		/// Voxelize a soup in which every hull is closed, e.g. TriangleSoup(physics).
+		/// Padding lanes are skipped.
+		/// </summary>
+		bool build(const TriangleSoup& source, const VoxelOptions& options = VoxelOptions());
+
+		/// <summary>
+		/// Get the state of the voxel holding a point. Points outside the grid are Empty.
+		/// </summary>
+		VoxelState getState(const Vec3& point) const;
+
+		/// <summary>
+		/// Check whether a point is certainly inside solid geometry. Points in
+		/// Boundary voxels need an exact test to decide.
+		/// </summary>
+		bool isSolid(const Vec3& point) const { return getState(point) == VoxelState::Solid; }
+
+		/// <summary>
+		/// Check whether every voxel overlapping a box is Empty, so the box is
+		/// clear of geometry. A box overlapping a Boundary voxel is reported
+		/// blocked even if it only comes within a voxel of a surface.
+		/// </summary>
+		bool isClear(const Aabb& box) const;
+
+		const VoxelStats& getStats() const { return stats; }
+		const Aabb& getBounds() const { return bounds; }
+		float getVoxelSize() const { return voxel_size; }
+		bool empty() const { return root.empty(); }
+
+		/// <summary>
+		/// Display the build statistics.
+		/// </summary>
+		void displayStats() const;
+
+	private:
+		// Chunk entries in x, y, z order: kEmpty, kSolid or the first node entry / 512.
+		std::vector<uint32_t> root;
+		// 512 brick entries per node: kEmpty, kSolid or a brick index.
+		std::vector<uint32_t> nodes;
+		std::vector<VoxelBrick> bricks;
+		// Grid extent in whole chunks; voxel (0, 0, 0) starts at origin.
+		size_t chunks_x = 0, chunks_y = 0, chunks_z = 0;
+		Vec3 origin = Vec3(0.0f, 0.0f, 0.0f);
+		float voxel_size = 0.0f;
+		float inverse_size = 0.0f;
+		Aabb bounds;
+		VoxelStats stats;
+
+		bool toVoxel(const Vec3& point, int64_t voxel[3]) const;
+	};
+} // namespace cs2
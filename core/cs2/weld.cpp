@@ -0,0 +1,399 @@
+#include "parser.h"
+
+namespace
+{
+	struct CellKey {
+		int32_t x, y, z;
+
+		bool operator==(const CellKey& other) const { return x == other.x && y == other.y && z == other.z; }
+	};
+
+	struct CellKeyHash {
+		size_t operator()(const CellKey& key) const
+		{
+			uint64_t h = static_cast<uint32_t>(key.x) * 0x9E3779B97F4A7C15ull;
+			h ^= static_cast<uint32_t>(key.y) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+			h ^= static_cast<uint32_t>(key.z) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+			h ^= h >> 33;
+			h *= 0xFF51AFD7ED558CCDull;
+			h ^= h >> 33;
+			return static_cast<size_t>(h);
+		}
+	};
+
+	// A triangle as sorted global vertex ids, so both windings compare equal.
+	struct TriangleKey {
+		uint32_t a, b, c;
+
+		TriangleKey(uint32_t i0, uint32_t i1, uint32_t i2)
+		{
+			if (i0 > i1) std::swap(i0, i1);
+			if (i1 > i2) std::swap(i1, i2);
+			if (i0 > i1) std::swap(i0, i1);
+			a = i0; b = i1; c = i2;
+		}
+
+		bool operator==(const TriangleKey& other) const { return a == other.a && b == other.b && c == other.c; }
+	};
+
+	struct TriangleKeyHash {
+		size_t operator()(const TriangleKey& key) const
+		{
+			uint64_t h = (static_cast<uint64_t>(key.a) << 32 | key.b) * 0x9E3779B97F4A7C15ull;
+			h ^= key.c * 0xC2B2AE3D27D4EB4Full;
+			h ^= h >> 33;
+			return static_cast<size_t>(h);
+		}
+	};
+
+	// Welds positions to the first position seen within tolerance. Only the
+	// cells overlapped by the tolerance sphere are searched, which is a single
+	// cell for most positions since cells are several tolerances wide.
+	class VertexWelder {
+	public:
+		explicit VertexWelder(float tolerance) : tolerance(tolerance), tolerance_sq(tolerance * tolerance), cell(std::max(tolerance * 4.0f, 1e-3f)) {}
+
+		uint32_t insert(const cs2::Vec3& p)
+		{
+			CellKey base = keyOf(p);
+			CellKey lo = keyOf(cs2::Vec3(p.x - tolerance, p.y - tolerance, p.z - tolerance));
+			CellKey hi = keyOf(cs2::Vec3(p.x + tolerance, p.y + tolerance, p.z + tolerance));
+
+			for (int32_t z = lo.z; z <= hi.z; z++)
+				for (int32_t y = lo.y; y <= hi.y; y++)
+					for (int32_t x = lo.x; x <= hi.x; x++)
+					{
+						for (uint32_t id = cells.find(CellKey{ x, y, z }); id != kNone; id = next[id])
+						{
+							const cs2::Vec3& q = positions[id];
+							float ex = p.x - q.x, ey = p.y - q.y, ez = p.z - q.z;
+							if (ex * ex + ey * ey + ez * ez <= tolerance_sq)
+								return id;
+						}
+					}
+
+			uint32_t id = static_cast<uint32_t>(positions.size());
+			positions.push_back(p);
+
+			uint32_t& head = cells.findOrInsert(base);
+			next.push_back(head);
+			head = id;
+
+			return id;
+		}
+
+		const std::vector<cs2::Vec3>& getPositions() const { return positions; }
+
+	private:
+		static constexpr uint32_t kNone = 0xFFFFFFFF;
+
+		float tolerance;
+		float tolerance_sq;
+		float cell;
+
+		// Open addressing map from cell to the newest position in it.
+		class CellTable {
+		public:
+			uint32_t find(const CellKey& key) const
+			{
+				if (slots.empty())
+					return kNone;
+
+				for (size_t i = CellKeyHash()(key) & mask;; i = (i + 1) & mask)
+				{
+					if (slots[i].head == kNone)
+						return kNone;
+					if (slots[i].key == key)
+						return slots[i].head;
+				}
+			}
+
+			uint32_t& findOrInsert(const CellKey& key)
+			{
+				if ((count + 1) * 2 > slots.size())
+					grow();
+
+				size_t i = CellKeyHash()(key) & mask;
+				for (; slots[i].head != kNone; i = (i + 1) & mask)
+				{
+					if (slots[i].key == key)
+						return slots[i].head;
+				}
+
+				// The caller links the new position in, so an empty chain is fine here.
+				count++;
+				slots[i].key = key;
+				return slots[i].head;
+			}
+
+		private:
+			struct Slot {
+				CellKey key = {};
+				uint32_t head = kNone;
+			};
+
+			std::vector<Slot> slots;
+			size_t mask = 0;
+			size_t count = 0;
+
+			void grow()
+			{
+				std::vector<Slot> old = std::move(slots);
+				slots.assign(old.empty() ? 1024 : old.size() * 2, Slot());
+				mask = slots.size() - 1;
+
+				for (auto& slot : old)
+				{
+					if (slot.head == kNone)
+						continue;
+					size_t i = CellKeyHash()(slot.key) & mask;
+					while (slots[i].head != kNone)
+						i = (i + 1) & mask;
+					slots[i] = slot;
+				}
+			}
+		};
+
+		CellTable cells;
+		std::vector<cs2::Vec3> positions;
+		std::vector<uint32_t> next;
+
+		CellKey keyOf(const cs2::Vec3& p) const
+		{
+			return CellKey{
+				static_cast<int32_t>(std::floor(p.x / cell)),
+				static_cast<int32_t>(std::floor(p.y / cell)),
+				static_cast<int32_t>(std::floor(p.z / cell)),
+			};
+		}
+	};
+
+	// True when the triangle's height over its longest edge is within tolerance.
+	bool isDegenerate(const cs2::Vec3& a, const cs2::Vec3& b, const cs2::Vec3& c, float tolerance)
+	{
+		float ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+		float vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+		float wx = c.x - b.x, wy = c.y - b.y, wz = c.z - b.z;
+
+		float nx = uy * vz - uz * vy;
+		float ny = uz * vx - ux * vz;
+		float nz = ux * vy - uy * vx;
+		float area2_sq = nx * nx + ny * ny + nz * nz;
+
+		float longest_sq = std::max({ ux * ux + uy * uy + uz * uz, vx * vx + vy * vy + vz * vz, wx * wx + wy * wy + wz * wz });
+
+		// |n| = 2 * area = longest * height
+		return area2_sq <= tolerance * tolerance * longest_sq;
+	}
+}
+
+cs2::WeldStats cs2::PhysicsFile::weld(const WeldOptions& options)
+{
+	auto start_time = std::chrono::steady_clock::now();
+
+	WeldStats result;
+
+	// Quantized hulls are welded as indexed meshes and quantized again afterwards.
+	std::vector<uint8_t> requantize(hulls.size(), 0);
+	parallelFor(hulls.size(), options.threads, [&](size_t h, unsigned) {
+		if (!hulls[h].isQuantized())
+			return;
+		requantize[h] = 1;
+		hulls[h].dequantize();
+	});
+
+	// Flatten every hull to global vertex ids. Positions are welded in hull
+	// order on one thread, which keeps the representatives deterministic.
+	VertexWelder welder(options.tolerance);
+	std::vector<std::vector<uint32_t>> hull_ids(hulls.size());
+
+	for (size_t h = 0; h < hulls.size(); h++)
+	{
+		const HullFile& hull = hulls[h];
+		std::vector<uint32_t>& ids = hull_ids[h];
+
+		if (hull.isIndexed())
+		{
+			std::vector<uint32_t> remap(hull.vertices.size());
+			for (size_t v = 0; v < hull.vertices.size(); v++)
+				remap[v] = welder.insert(hull.vertices[v]);
+
+			result.vertices_before += hull.vertices.size();
+
+			ids.reserve(hull.getTriangleCount() * 3);
+			for (auto index : hull.indices16)
+				ids.push_back(remap[index]);
+			for (auto index : hull.indices32)
+				ids.push_back(remap[index]);
+		}
+		else
+		{
+			result.vertices_before += hull.triangles.size() * 3;
+
+			ids.reserve(hull.triangles.size() * 3);
+			for (auto& tri : hull.triangles)
+			{
+				ids.push_back(welder.insert(tri.a));
+				ids.push_back(welder.insert(tri.b));
+				ids.push_back(welder.insert(tri.c));
+			}
+		}
+	}
+
+	const std::vector<Vec3>& positions = welder.getPositions();
+
+	// Only triangles made entirely of vertices used by several hulls can repeat across hulls.
+	constexpr uint32_t kNoHull = 0xFFFFFFFF;
+	std::vector<uint32_t> owner(positions.size(), kNoHull);
+	std::vector<uint8_t> shared(positions.size(), 0);
+
+	for (size_t h = 0; h < hulls.size(); h++)
+	{
+		for (auto id : hull_ids[h])
+		{
+			if (owner[id] == kNoHull)
+				owner[id] = static_cast<uint32_t>(h);
+			else if (owner[id] != h)
+				shared[id] = 1;
+		}
+	}
+
+	// Drop degenerate and repeated triangles within each hull.
+	std::vector<size_t> degenerate(hulls.size());
+	std::vector<size_t> duplicate(hulls.size());
+
+	parallelFor(hulls.size(), options.threads, [&](size_t h, unsigned) {
+		std::vector<uint32_t>& ids = hull_ids[h];
+		size_t count = ids.size() / 3;
+
+		// Sorting the keys finds repeats without a hash set; the stable order keeps the first one.
+		std::vector<std::pair<TriangleKey, uint32_t>> keys;
+		keys.reserve(count);
+		std::vector<uint8_t> keep(count, 1);
+
+		for (size_t t = 0; t < count; t++)
+		{
+			uint32_t a = ids[t * 3], b = ids[t * 3 + 1], c = ids[t * 3 + 2];
+
+			if (a == b || b == c || a == c || isDegenerate(positions[a], positions[b], positions[c], options.tolerance))
+			{
+				keep[t] = 0;
+				degenerate[h]++;
+				continue;
+			}
+
+			keys.emplace_back(TriangleKey(a, b, c), static_cast<uint32_t>(t));
+		}
+
+		std::sort(keys.begin(), keys.end(), [](const auto& l, const auto& r) {
+			if (l.first.a != r.first.a) return l.first.a < r.first.a;
+			if (l.first.b != r.first.b) return l.first.b < r.first.b;
+			if (l.first.c != r.first.c) return l.first.c < r.first.c;
+			return l.second < r.second;
+		});
+
+		for (size_t k = 1; k < keys.size(); k++)
+		{
+			if (keys[k].first == keys[k - 1].first)
+			{
+				keep[keys[k].second] = 0;
+				duplicate[h]++;
+			}
+		}
+
+		size_t kept = 0;
+		for (size_t t = 0; t < count; t++)
+		{
+			if (!keep[t])
+				continue;
+			ids[kept++] = ids[t * 3];
+			ids[kept++] = ids[t * 3 + 1];
+			ids[kept++] = ids[t * 3 + 2];
+		}
+
+		ids.resize(kept);
+	});
+
+	// Triangles repeated across hulls are kept in the first hull only.
+	std::unordered_set<TriangleKey, TriangleKeyHash> seen;
+	for (size_t h = 0; h < hulls.size(); h++)
+	{
+		std::vector<uint32_t>& ids = hull_ids[h];
+
+		size_t kept = 0;
+		for (size_t i = 0; i + 2 < ids.size(); i += 3)
+		{
+			bool candidate = shared[ids[i]] && shared[ids[i + 1]] && shared[ids[i + 2]];
+			if (candidate && !seen.insert(TriangleKey(ids[i], ids[i + 1], ids[i + 2])).second)
+			{
+				duplicate[h]++;
+				continue;
+			}
+
+			ids[kept++] = ids[i];
+			ids[kept++] = ids[i + 1];
+			ids[kept++] = ids[i + 2];
+		}
+
+		ids.resize(kept);
+	}
+
+	// Rebuild each hull in its original representation from the welded positions.
+	std::vector<size_t> vertices_after(hulls.size());
+	std::vector<size_t> welded_vertices(hulls.size());
+
+	parallelFor(hulls.size(), options.threads, [&](size_t h, unsigned) {
+		HullFile& hull = hulls[h];
+		const std::vector<uint32_t>& ids = hull_ids[h];
+
+		// Global id -> local index, sized to the hull rather than to the whole map.
+		std::unordered_map<uint32_t, int> local;
+		local.reserve(ids.size());
+
+		std::vector<Vec3> vertex_list;
+		std::vector<int> index_list;
+		index_list.reserve(ids.size());
+
+		for (auto id : ids)
+		{
+			auto [it, inserted] = local.try_emplace(id, static_cast<int>(vertex_list.size()));
+			if (inserted)
+				vertex_list.push_back(positions[id]);
+			index_list.push_back(it->second);
+		}
+
+		welded_vertices[h] = vertex_list.size();
+
+		if (hull.isIndexed())
+		{
+			vertices_after[h] = vertex_list.size();
+			hull.setIndexed(std::move(vertex_list), index_list);
+		}
+		else
+		{
+			std::vector<Triangle> triangle_list;
+			triangle_list.reserve(ids.size() / 3);
+
+			for (size_t i = 0; i + 2 < ids.size(); i += 3)
+				triangle_list.emplace_back(positions[ids[i]], positions[ids[i + 1]], positions[ids[i + 2]]);
+
+			vertices_after[h] = triangle_list.size() * 3;
+			hull.triangles.assign(triangle_list.begin(), triangle_list.end());
+		}
+
+		if (requantize[h])
+			hull.quantize();
+	});
+
+	for (size_t h = 0; h < hulls.size(); h++)
+	{
+		result.vertices_after += vertices_after[h];
+		result.welded_vertices += welded_vertices[h];
+		result.degenerate_triangles += degenerate[h];
+		result.duplicate_triangles += duplicate[h];
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+	return result;
+}
@@ -1,15 +1,1444 @@
-#include "cs2/parser.h"
+#include "cs2/cache.h"
+#include "cs2/distance_field.h"
+#include "cs2/pipeline.h"
+#include "cs2/grenade.h"
+#include "cs2/heightfield.h"
+#include "cs2/navmesh.h"
+#include "cs2/sweep.h"
+#include "cs2/visibility.h"
+#include "cs2/voxel.h"
 
-int main()
+#include <cctype>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <thread>
+
+namespace
 {
-	cs2::PhysicsFile physics;
-	physics.load(
-		"C:\\Users\\vasie\\Desktop\\map\\world_physics.vmdl",
-		"C:\\Users\\vasie\\Desktop\\map"
-	);
-	
-	physics.displayStats();
-	physics.writeTriangles(physics.getMapname() + ".tri");
-	
+	class BatchOptions {
+	public:
+		std::vector<std::string> inputs;
+		std::string output_dir = ".";
+		unsigned threads = 0;
+		// Maps allowed to wait between two stages; bounds how many are resident at once.
+		size_t queue_depth = 1;
+		bool weld = false;
+		bool write_triangles = false;
+		// Also write a <map>.cs2h floor and ceiling heightfield next to the cache.
+		bool write_heightfield = false;
+		// Time NumberScanner against the stringstream parsing it replaced, and check they agree.
+		bool bench_scanner = false;
+		// Report hull parse throughput in MB/s on one and on all threads instead of exporting.
+		bool bench_parse = false;
+		// Run the line of sight benchmark with this many queries instead of exporting.
+		size_t bench_los = 0;
+		// Run the grenade benchmark with this many throws instead of exporting.
+		size_t bench_grenades = 0;
+		// Run the box and capsule sweep benchmark with this many sweeps instead of exporting.
+		size_t bench_sweeps = 0;
+		// Report voxel grid build time and memory at several voxel sizes instead of exporting.
+		bool bench_voxels = false;
+		// Report distance field bake time, memory and sampling rate per format instead of exporting.
+		bool bench_sdf = false;
+		// Report navigation mesh stage times, path query rate and tile rebuild time instead of exporting.
+		bool bench_navmesh = false;
+		// Report tiles and bytes mapped by region and frustum loads of the cache instead of exporting.
+		bool bench_tiles = false;
+		cs2::LoadOptions load;
+	};
+
+	class MapJob {
+	public:
+		std::string manifest;
+		std::string working_dir;
+		std::unique_ptr<cs2::PhysicsFile> physics;
+		std::unique_ptr<cs2::Heightfield> heightfield;
+
+		bool ok = true;
+		std::string name;
+		size_t hulls = 0;
+		size_t triangles = 0;
+		uint64_t bytes_read = 0;
+		double read_seconds = 0.0;
+		double parse_seconds = 0.0;
+		double post_seconds = 0.0;
+		double write_seconds = 0.0;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	double secondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	bool isCompiled(const std::filesystem::path& path)
+	{
+		std::string extension = path.extension().string();
+		return extension.size() > 2 && extension.compare(extension.size() - 2, 2, "_c") == 0;
+	}
+
+	// A map directory holds world_physics.vmdl (decompiled) or world_physics.vphys_c.
+	std::string findManifest(const std::filesystem::path& directory)
+	{
+		for (const char* name : { "world_physics.vmdl", "world_physics.vphys_c", "world_physics.vmdl_c" })
+		{
+			std::error_code ec;
+			if (std::filesystem::is_regular_file(directory / name, ec))
+				return (directory / name).string();
+		}
+		return std::string();
+	}
+
+	// Inputs are manifests, map directories, directories of map directories,
+	// or text files listing any of these one per line.
+	void collectMaps(const std::string& input, std::vector<std::string>& manifests, bool nested = false)
+	{
+		std::filesystem::path path(input);
+		std::error_code ec;
+
+		if (std::filesystem::is_directory(path, ec))
+		{
+			std::string manifest = findManifest(path);
+			if (!manifest.empty())
+			{
+				manifests.push_back(manifest);
+				return;
+			}
+
+			std::vector<std::string> children;
+			for (auto& entry : std::filesystem::directory_iterator(path, ec))
+			{
+				if (entry.is_directory(ec))
+				{
+					manifest = findManifest(entry.path());
+					if (!manifest.empty())
+						children.push_back(manifest);
+				}
+			}
+
+			if (children.empty())
+				std::cerr << "No maps found in directory: " << input << std::endl;
+
+			std::sort(children.begin(), children.end());
+			manifests.insert(manifests.end(), children.begin(), children.end());
+			return;
+		}
+
+		std::string extension = path.extension().string();
+		if (nested || extension == ".vmdl" || isCompiled(path))
+		{
+			manifests.push_back(input);
+			return;
+		}
+
+		std::ifstream list(input);
+		if (!list.is_open())
+		{
+			std::cerr << "Failed to open file: " << input << std::endl;
+			return;
+		}
+
+		std::string line;
+		while (std::getline(list, line))
+		{
+			while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back())))
+				line.pop_back();
+			if (line.empty() || line[0] == '#')
+				continue;
+			collectMaps(line, manifests, true);
+		}
+	}
+
+	// Pull a map's files into the page cache so parsing never waits on the disk.
+	uint64_t prefetchMap(const MapJob& job)
+	{
+		std::vector<std::string> files;
+		if (isCompiled(job.manifest))
+		{
+			files.push_back(job.manifest);
+		}
+		else
+		{
+			std::error_code ec;
+			for (auto& entry : std::filesystem::directory_iterator(job.working_dir, ec))
+				if (entry.is_regular_file(ec))
+					files.push_back(entry.path().string());
+		}
+
+		uint64_t bytes = 0;
+		for (auto& file_name : files)
+		{
+			cs2::MappedFile file;
+			if (!file.open(file_name))
+				continue;
+
+			volatile char sink = 0;
+			for (size_t offset = 0; offset < file.size(); offset += 4096)
+				sink = sink + file.data()[offset];
+
+			bytes += file.size();
+		}
+
+		return bytes;
+	}
+
+	constexpr size_t kDemoPlayers = 10;
+
+	// Eye positions of ten players walking between random spots on the floors
+	// at speed units/s, sampled at 64 ticks/s like a demo, kDemoPlayers per tick.
+	// The first standing players never leave their spot.
+	std::vector<cs2::Vec3> makeDemoTicks(const cs2::PhysicsFile& physics, size_t ticks, float speed = 250.0f, size_t standing = 0)
+	{
+		std::vector<cs2::Triangle> floors;
+		for (auto& hull : physics.getHulls())
+		{
+			hull.forEachTriangle([&](const cs2::Triangle& tri) {
+				cs2::Vec3 e1(tri.b.x - tri.a.x, tri.b.y - tri.a.y, tri.b.z - tri.a.z);
+				cs2::Vec3 e2(tri.c.x - tri.a.x, tri.c.y - tri.a.y, tri.c.z - tri.a.z);
+				cs2::Vec3 n(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+				float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+				if (length > 0.0f && std::fabs(n.z) > 0.5f * length)
+					floors.push_back(tri);
+			});
+		}
+
+		std::vector<cs2::Vec3> demo;
+		if (floors.empty())
+			return demo;
+
+		std::mt19937 rng(12345);
+		std::uniform_int_distribution<size_t> pick(0, floors.size() - 1);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		auto randomSpot = [&]() {
+			const cs2::Triangle& tri = floors[pick(rng)];
+			float u = unit(rng), v = unit(rng);
+			if (u + v > 1.0f)
+			{
+				u = 1.0f - u;
+				v = 1.0f - v;
+			}
+			return cs2::Vec3(tri.a.x + u * (tri.b.x - tri.a.x) + v * (tri.c.x - tri.a.x),
+				tri.a.y + u * (tri.b.y - tri.a.y) + v * (tri.c.y - tri.a.y),
+				tri.a.z + u * (tri.b.z - tri.a.z) + v * (tri.c.z - tri.a.z) + 64.0f);
+		};
+
+		constexpr size_t kPlayers = kDemoPlayers;
+		const float step = speed / 64.0f;
+		std::vector<cs2::Vec3> positions(kPlayers), targets(kPlayers);
+		for (size_t p = 0; p < kPlayers; p++)
+		{
+			positions[p] = randomSpot();
+			targets[p] = randomSpot();
+		}
+
+		demo.reserve(ticks * kPlayers);
+		for (size_t tick = 0; tick < ticks; tick++)
+		{
+			demo.insert(demo.end(), positions.begin(), positions.end());
+
+			for (size_t p = standing; p < kPlayers; p++)
+			{
+				cs2::Vec3 delta(targets[p].x - positions[p].x, targets[p].y - positions[p].y, targets[p].z - positions[p].z);
+				float distance = std::sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z);
+				if (distance <= step)
+				{
+					positions[p] = targets[p];
+					targets[p] = randomSpot();
+					continue;
+				}
+				float scale = step / distance;
+				positions[p] = cs2::Vec3(positions[p].x + delta.x * scale, positions[p].y + delta.y * scale, positions[p].z + delta.z * scale);
+			}
+		}
+
+		return demo;
+	}
+
+	bool loadForBenchmark(const std::string& manifest, const BatchOptions& options, cs2::PhysicsFile& physics)
+	{
+		std::string working_dir = std::filesystem::path(manifest).parent_path().string();
+		cs2::LoadOptions load = options.load;
+		load.threads = cs2::resolveThreadCount(options.threads);
+		return physics.load(manifest, working_dir, load);
+	}
+
+	bool loadForBenchmark(const std::string& manifest, const BatchOptions& options, cs2::PhysicsFile& physics, cs2::Bvh& bvh)
+	{
+		if (!loadForBenchmark(manifest, options, physics))
+			return false;
+
+		cs2::BvhOptions bvh_options;
+		bvh_options.threads = cs2::resolveThreadCount(options.threads);
+		return bvh.build(physics, bvh_options);
+	}
+
+	// The array parsing replaced by NumberScanner: strip the quotes from a copy,
+	// then one stringstream for the array and another per item.
+	std::vector<cs2::Vec3> parseVerticesScalar(std::string_view input)
+	{
+		std::string unquoted(input);
+		unquoted.erase(std::remove(unquoted.begin(), unquoted.end(), '"'), unquoted.end());
+
+		std::vector<cs2::Vec3> vectors;
+		std::stringstream ss(unquoted);
+		std::string item;
+		while (std::getline(ss, item, ','))
+		{
+			std::stringstream vectorStream(item);
+			cs2::Vec3 vec = cs2::Vec3();
+			vectorStream >> vec.x >> vec.y >> vec.z;
+			vectors.push_back(vec);
+		}
+		return vectors;
+	}
+
+	std::vector<int> parseIndicesScalar(std::string_view input)
+	{
+		std::string unquoted(input);
+		unquoted.erase(std::remove(unquoted.begin(), unquoted.end(), '"'), unquoted.end());
+
+		std::vector<int> indices;
+		std::stringstream ss(unquoted);
+		std::string item;
+		while (std::getline(ss, item, ','))
+		{
+			std::stringstream indexStream(item);
+			int index;
+			indexStream >> index;
+			indices.push_back(index);
+		}
+		return indices;
+	}
+
+	bool benchmarkScanner(const std::string& manifest, const BatchOptions& options)
+	{
+		std::string working_dir = std::filesystem::path(manifest).parent_path().string();
+
+		cs2::LoadOptions load = options.load;
+		load.threads = cs2::resolveThreadCount(options.threads);
+		load.indexed = true;
+		load.quantized = false;
+		cs2::PhysicsFile physics;
+		if (!physics.load(manifest, working_dir, load))
+			return false;
+
+		// The map's vertices and indices written as one vector3_array and one
+		// int_array body, in the quoted, comma separated form of the hull files.
+		std::string vertex_text, index_text;
+		char buffer[64];
+		auto append = [&](std::string& text, auto value) {
+			auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+			text.append(buffer, end);
+		};
+		for (auto& hull : physics.getHulls())
+		{
+			for (const cs2::Vec3& v : hull.vertices)
+			{
+				vertex_text += vertex_text.empty() ? "\n\"" : ",\n\"";
+				append(vertex_text, v.x);
+				vertex_text += ' ';
+				append(vertex_text, v.y);
+				vertex_text += ' ';
+				append(vertex_text, v.z);
+				vertex_text += '"';
+			}
+			auto appendIndices = [&](const auto& indices) {
+				for (auto index : indices)
+				{
+					index_text += index_text.empty() ? "\n\"" : ",\n\"";
+					append(index_text, static_cast<int>(index));
+					index_text += '"';
+				}
+			};
+			appendIndices(hull.indices16);
+			appendIndices(hull.indices32);
+		}
+
+		if (vertex_text.empty())
+		{
+			std::cerr << "No indexed geometry: " << manifest << std::endl;
+			return false;
+		}
+
+		auto start = Clock::now();
+		std::vector<cs2::Vec3> scalar_vertices = parseVerticesScalar(vertex_text);
+		std::vector<int> scalar_indices = parseIndicesScalar(index_text);
+		double scalar_seconds = secondsSince(start);
+
+		// The same text as a one hull map, loaded the way every hull file is: counted,
+		// then read by the kv3 parser straight into the arena. Best of three loads.
+		std::error_code ec;
+		std::filesystem::path directory = std::filesystem::temp_directory_path(ec) / ("cs2-bench-scanner-" + std::to_string(std::hash<std::string>()(manifest)));
+		std::filesystem::create_directories(directory, ec);
+		std::string hull_path = (directory / "hull_0.dmx").string();
+		std::string manifest_path = (directory / "world_physics.vmdl").string();
+		{
+			std::ofstream hull_file(hull_path, std::ios::binary);
+			hull_file << "<!-- dmx encoding keyvalues2 4 format model 22 -->\n\"DmElement\"\n{\n"
+				<< "\"position$0\" \"vector3_array\"\n[" << vertex_text << "\n]\n"
+				<< "\"position$0Indices\" \"int_array\"\n[" << index_text << "\n]\n}\n";
+			std::ofstream manifest_file(manifest_path, std::ios::binary);
+			manifest_file << "{\n\trootNode =\n\t{\n\t\t_class = \"RootNode\"\n\t\tchildren =\n\t\t[\n"
+				<< "\t\t\t{\n\t\t\t\t_class = \"PhysicsMeshFile\"\n\t\t\t\tfilename = \"maps/bench_scanner/world_physics/hull_0.dmx\"\n\t\t\t},\n\t\t],\n\t},\n}\n";
+		}
+
+		cs2::LoadOptions single;
+		single.indexed = true;
+		std::unique_ptr<cs2::PhysicsFile> reloaded;
+		double scanner_seconds = 0.0;
+		bool loaded = true;
+		for (int run = 0; run < 3 && loaded; run++)
+		{
+			reloaded = std::make_unique<cs2::PhysicsFile>();
+			loaded = reloaded->load(manifest_path, directory.string(), single);
+			if (loaded && (run == 0 || reloaded->getLoadStats().seconds < scanner_seconds))
+				scanner_seconds = reloaded->getLoadStats().seconds;
+		}
+		std::filesystem::remove_all(directory, ec);
+
+		if (!loaded || reloaded->getHulls().size() != 1)
+		{
+			std::cerr << "Failed to reload scanner text: " << manifest << std::endl;
+			return false;
+		}
+
+		const cs2::HullFile& hull = reloaded->getHulls().front();
+		std::vector<int> indices(hull.indices16.begin(), hull.indices16.end());
+		indices.insert(indices.end(), hull.indices32.begin(), hull.indices32.end());
+
+		bool match = hull.vertices.size() == scalar_vertices.size() && indices == scalar_indices &&
+			std::memcmp(hull.vertices.data(), scalar_vertices.data(), hull.vertices.size() * sizeof(cs2::Vec3)) == 0;
+
+		// The SSE2 comma count against a byte at a time.
+		bool counts_match =
+			cs2::countDelimiters(vertex_text, ',') == static_cast<size_t>(std::count(vertex_text.begin(), vertex_text.end(), ',')) &&
+			cs2::countDelimiters(index_text, ',') == static_cast<size_t>(std::count(index_text.begin(), index_text.end(), ','));
+
+		double megabytes = (vertex_text.size() + index_text.size()) / (1024.0 * 1024.0);
+		std::cout << manifest << " (" << hull.vertices.size() << " vertices, " << indices.size() << " indices)" << std::endl;
+		std::cout << std::fixed << std::setprecision(1)
+			<< "stringstream: " << scalar_seconds * 1000.0 << " ms, " << megabytes / std::max(scalar_seconds, 1e-9) << " MB/s" << std::endl
+			<< "HullReader: " << scanner_seconds * 1000.0 << " ms, " << megabytes / std::max(scanner_seconds, 1e-9) << " MB/s ("
+			<< scalar_seconds / std::max(scanner_seconds, 1e-9) << "x)" << std::endl
+			<< "Results: " << (match ? "identical" : "DIFFERENT") << ", comma counts " << (counts_match ? "identical" : "DIFFERENT") << std::endl;
+		std::cout << std::endl;
+		return match && counts_match;
+	}
+
+	bool benchmarkParse(const std::string& manifest, const BatchOptions& options)
+	{
+		std::string working_dir = std::filesystem::path(manifest).parent_path().string();
+		unsigned threads = cs2::resolveThreadCount(options.threads);
+
+		// The parse cache would skip the work being measured.
+		cs2::LoadOptions load = options.load;
+		load.cache_directory.clear();
+
+		std::cout << manifest << std::endl;
+		std::cout << std::left << std::setw(10) << "Threads" << std::right << std::setw(8) << "Hulls" << std::setw(12) << "Triangles"
+			<< std::setw(12) << "Input MB" << std::setw(10) << "Load ms" << std::setw(10) << "MB/s" << std::endl;
+
+		// Best of three loads, the first of which also warms the page cache.
+		for (unsigned count : { 1u, threads })
+		{
+			load.threads = count;
+			double best = 0.0;
+			uint64_t bytes = 0;
+			size_t hulls = 0, triangles = 0;
+			for (int run = 0; run < 3; run++)
+			{
+				cs2::PhysicsFile physics;
+				if (!physics.load(manifest, working_dir, load))
+					return false;
+
+				const cs2::LoadStats& stats = physics.getLoadStats();
+				if (run == 0 || stats.seconds < best)
+					best = stats.seconds;
+				bytes = stats.bytes_mapped;
+				hulls = physics.getHulls().size();
+				triangles = 0;
+				for (auto& hull : physics.getHulls())
+					triangles += hull.getTriangleCount();
+			}
+
+			double megabytes = bytes / (1024.0 * 1024.0);
+			std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(10) << count << std::right
+				<< std::setw(8) << hulls << std::setw(12) << triangles << std::setw(12) << megabytes
+				<< std::setw(10) << best * 1000.0 << std::setw(10) << (best > 0.0 ? megabytes / best : 0.0) << std::endl;
+
+			if (threads == 1)
+				break;
+		}
+		std::cout << std::endl;
+		return true;
+	}
+
+	bool benchmarkLineOfSight(const std::string& manifest, const BatchOptions& options)
+	{
+		unsigned threads = cs2::resolveThreadCount(options.threads);
+		cs2::PhysicsFile physics;
+		cs2::Bvh bvh;
+		if (!loadForBenchmark(manifest, options, physics, bvh))
+			return false;
+
+		// Every pair of players in every tick, in tick order.
+		constexpr size_t kPairs = kDemoPlayers * (kDemoPlayers - 1) / 2;
+		std::vector<cs2::Vec3> demo = makeDemoTicks(physics, (options.bench_los + kPairs - 1) / kPairs);
+		std::vector<cs2::Segment> queries;
+		for (size_t tick = 0; tick < demo.size() / kDemoPlayers; tick++)
+			for (size_t a = 0; a < kDemoPlayers; a++)
+				for (size_t b = a + 1; b < kDemoPlayers; b++)
+					queries.emplace_back(demo[tick * kDemoPlayers + a], demo[tick * kDemoPlayers + b]);
+		queries.resize(std::min(queries.size(), options.bench_los));
+
+		if (queries.empty())
+		{
+			std::cerr << "No floors to place players on: " << manifest << std::endl;
+			return false;
+		}
+
+		std::cout << manifest << std::endl;
+		bvh.displayStats();
+
+		class Config {
+		public:
+			const char* name;
+			cs2::SimdLevel level;
+			unsigned threads;
+			bool sort;
+			bool packets;
+		};
+
+		const Config configs[] = {
+			{ "scalar", cs2::SimdLevel::Scalar, 1, false, false },
+			{ "sse4", cs2::SimdLevel::SSE4, 1, false, false },
+			{ "avx2", cs2::SimdLevel::AVX2, 1, false, false },
+			{ "avx2 sorted", cs2::SimdLevel::AVX2, 1, true, false },
+			{ "avx2 sorted packets", cs2::SimdLevel::AVX2, 1, true, true },
+			{ "avx2 sorted packets", cs2::SimdLevel::AVX2, threads, true, true },
+		};
+
+		std::cout << std::left << std::setw(22) << "Kernel" << std::right << std::setw(8) << "Threads"
+			<< std::setw(14) << "Queries/s" << std::setw(14) << "Per core" << std::setw(10) << "Sort ms"
+			<< std::setw(10) << "Packets" << std::setw(10) << "Visible" << std::endl;
+
+		std::vector<uint64_t> reference;
+		bool consistent = true;
+		std::cout << std::fixed << std::setprecision(0);
+		for (auto& config : configs)
+		{
+			cs2::Raycaster raycaster(bvh, config.level);
+			if (raycaster.getLevel() != config.level)
+				continue;
+
+			cs2::LineOfSightOptions los;
+			los.threads = config.threads;
+			los.sort = config.sort;
+			los.packets = config.packets;
+
+			std::vector<uint64_t> visible;
+			cs2::LineOfSightStats stats = raycaster.testLineOfSight(queries, visible, los);
+			if (reference.empty())
+				reference = visible;
+			consistent = consistent && visible == reference;
+
+			std::cout << std::left << std::setw(22) << config.name << std::right << std::setw(8) << stats.threads
+				<< std::setw(14) << stats.getQueriesPerSecond() << std::setw(14) << stats.getQueriesPerSecond() / stats.threads
+				<< std::setw(10) << std::setprecision(1) << stats.sort_seconds * 1000.0 << std::setprecision(0)
+				<< std::setw(9) << (stats.queries ? 100.0 * stats.packet_queries / stats.queries : 0.0) << "%"
+				<< std::setw(9) << (stats.queries ? 100.0 * stats.visible / stats.queries : 0.0) << "%" << std::endl;
+		}
+		std::cout << std::endl;
+
+		// Tick by tick: the 45 pairs traced independently, then through a
+		// VisibilityTracker, exact and with the default movement tolerance.
+		// At 250 units/s players move about 3.9 units a tick and the tolerance
+		// never applies, so the same ticks are replayed with four players
+		// standing still and the rest walking at 32 units/s, half a unit a tick.
+		cs2::Raycaster raycaster(bvh);
+		const size_t ticks = demo.size() / kDemoPlayers;
+		constexpr size_t kStanding = 4;
+
+		class Replay {
+		public:
+			const char* name;
+			std::vector<cs2::Vec3> demo;
+			size_t standing;
+		};
+
+		Replay replays[] = {
+			{ "walking", std::move(demo), 0 },
+			{ "slow", makeDemoTicks(physics, ticks, 32.0f, kStanding), kStanding },
+		};
+
+		for (auto& replay : replays)
+		{
+			const std::vector<cs2::Vec3>& positions = replay.demo;
+			std::vector<uint8_t> independent(ticks * kPairs);
+
+			auto tick_start = Clock::now();
+			for (size_t tick = 0, pair = 0; tick < ticks; tick++)
+				for (size_t a = 0; a < kDemoPlayers; a++)
+					for (size_t b = a + 1; b < kDemoPlayers; b++, pair++)
+						independent[pair] = !raycaster.segmentAny(positions[tick * kDemoPlayers + a], positions[tick * kDemoPlayers + b]);
+			double independent_seconds = secondsSince(tick_start);
+
+			std::cout << std::left << std::setw(22) << (std::string("Per tick, ") + replay.name) << std::right << std::setw(14) << "Ticks/s"
+				<< std::setw(10) << "Traced" << std::setw(10) << "Blocker" << std::setw(10) << "Skipped" << std::setw(10) << "Wrong" << std::endl;
+			std::cout << std::left << std::setw(22) << "independent pairs" << std::right << std::setw(14) << ticks / independent_seconds
+				<< std::setw(9) << 100 << "%" << std::setw(9) << 0 << "%" << std::setw(9) << 0 << "%" << std::setw(10) << 0 << std::endl;
+
+			for (float tolerance : { 0.0f, cs2::VisibilityOptions().tolerance })
+			{
+				cs2::VisibilityOptions visibility;
+				visibility.tolerance = tolerance;
+				cs2::VisibilityTracker tracker(raycaster, kDemoPlayers, visibility);
+
+				// Pairs of two standing players are skipped after their first trace
+				// and must keep exactly the answer the exact tracker gives.
+				size_t wrong = 0, standing_wrong = 0;
+				for (size_t tick = 0, pair = 0; tick < ticks; tick++)
+				{
+					tracker.update(std::span<const cs2::Vec3>(positions).subspan(tick * kDemoPlayers, kDemoPlayers));
+					for (size_t a = 0; a < kDemoPlayers; a++)
+						for (size_t b = a + 1; b < kDemoPlayers; b++, pair++)
+						{
+							bool differs = tracker.getMatrix().canSee(a, b) != static_cast<bool>(independent[pair]);
+							wrong += differs;
+							standing_wrong += differs && b < replay.standing;
+						}
+				}
+
+				const cs2::VisibilityStats& stats = tracker.getStats();
+				double pairs = static_cast<double>(std::max<size_t>(stats.pairs, 1));
+				std::cout << std::left << std::setw(22) << (tolerance > 0.0f ? "tracker (tolerance)" : "tracker (exact)") << std::right
+					<< std::setw(14) << stats.ticks / stats.seconds << std::setw(9) << 100.0 * stats.traced / pairs << "%"
+					<< std::setw(9) << 100.0 * stats.blocker_hits / pairs << "%" << std::setw(9) << 100.0 * stats.skipped / pairs << "%"
+					<< std::setw(10) << wrong << std::endl;
+
+				// Reusing a blocker never changes the answer, only skipping by tolerance may,
+				// and never for players who did not move at all.
+				consistent = consistent && (tolerance > 0.0f || wrong == 0) && standing_wrong == 0;
+				if (tolerance > 0.0f && replay.standing > 1 && stats.skipped == 0)
+				{
+					std::cerr << "Tolerance never skipped a pair of standing players: " << manifest << std::endl;
+					consistent = false;
+				}
+			}
+			std::cout << std::endl;
+		}
+
+		if (!consistent)
+			std::cerr << "Kernels disagree on line of sight: " << manifest << std::endl;
+		return consistent;
+	}
+
+	// Every player of a demo tick throws an even spread of yaw and pitch angles.
+	bool benchmarkGrenades(const std::string& manifest, const BatchOptions& options)
+	{
+		cs2::PhysicsFile physics;
+		cs2::Bvh bvh;
+		if (!loadForBenchmark(manifest, options, physics, bvh))
+			return false;
+
+		std::vector<cs2::Vec3> players = makeDemoTicks(physics, 1);
+		if (players.empty())
+		{
+			std::cerr << "No floors to place players on: " << manifest << std::endl;
+			return false;
+		}
+
+		constexpr float kThrowSpeed = 675.0f;
+		constexpr float kPi = 3.14159265f;
+		const size_t per_player = (options.bench_grenades + players.size() - 1) / players.size();
+		const size_t pitches = std::max<size_t>(1, static_cast<size_t>(std::sqrt(per_player / 4.0)));
+		const size_t yaws = (per_player + pitches - 1) / pitches;
+
+		std::vector<cs2::GrenadeThrow> throws;
+		for (auto& player : players)
+		{
+			for (size_t i = 0; i < per_player && throws.size() < options.bench_grenades; i++)
+			{
+				float yaw = 2.0f * kPi * (i % yaws) / yaws;
+				float pitch = (-30.0f + 90.0f * (i / yaws) / pitches) * kPi / 180.0f;
+				cs2::Vec3 velocity(std::cos(yaw) * std::cos(pitch) * kThrowSpeed, std::sin(yaw) * std::cos(pitch) * kThrowSpeed, std::sin(pitch) * kThrowSpeed);
+				throws.emplace_back(player, velocity);
+			}
+		}
+
+		std::cout << manifest << std::endl;
+
+		cs2::GrenadeOptions grenade_options;
+		grenade_options.restitution = { { "concrete", 0.45f }, { "metal", 0.6f }, { "wood", 0.4f }, { "dirt", 0.3f }, { "glass", 0.2f } };
+
+		std::cout << std::left << std::setw(10) << "Threads" << std::right << std::setw(16) << "Throws/s" << std::setw(14) << "Per core"
+			<< std::setw(12) << "Ticks" << std::setw(10) << "Bounces" << std::setw(10) << "At rest" << std::endl;
+
+		std::vector<cs2::GrenadeResult> reference;
+		bool consistent = true;
+		for (unsigned threads : { 1u, cs2::resolveThreadCount(options.threads) })
+		{
+			grenade_options.threads = threads;
+			cs2::GrenadeSimulator simulator(physics, bvh, grenade_options);
+
+			std::vector<cs2::GrenadeResult> results;
+			cs2::GrenadeStats stats = simulator.simulate(throws, results);
+			if (reference.empty())
+				reference = std::move(results);
+			else
+				for (size_t i = 0; i < results.size(); i++)
+					consistent = consistent && std::memcmp(&results[i].position, &reference[i].position, sizeof(cs2::Vec3)) == 0;
+
+			double count = static_cast<double>(std::max<size_t>(stats.trajectories, 1));
+			std::cout << std::fixed << std::setprecision(0) << std::left << std::setw(10) << stats.threads << std::right
+				<< std::setw(16) << stats.getTrajectoriesPerSecond() << std::setw(14) << stats.getTrajectoriesPerSecond() / stats.threads
+				<< std::setprecision(1) << std::setw(12) << stats.ticks / count << std::setw(10) << stats.bounces / count
+				<< std::setw(9) << 100.0 * stats.at_rest / count << "%" << std::endl;
+		}
+		std::cout << std::endl;
+
+		if (!consistent)
+			std::cerr << "Grenade results depend on the thread count: " << manifest << std::endl;
+		return consistent;
+	}
+
+	// Player boxes and capsules moved from demo positions in random directions,
+	// timed, then a sample replayed as a discrete scan of zero length sweeps,
+	// which only report whether the shape overlaps geometry where it stands.
+	bool benchmarkSweeps(const std::string& manifest, const BatchOptions& options)
+	{
+		cs2::PhysicsFile physics;
+		cs2::Bvh bvh;
+		if (!loadForBenchmark(manifest, options, physics, bvh))
+			return false;
+
+		std::vector<cs2::Vec3> players = makeDemoTicks(physics, (options.bench_sweeps + kDemoPlayers - 1) / kDemoPlayers);
+		if (players.empty())
+		{
+			std::cerr << "No floors to place players on: " << manifest << std::endl;
+			return false;
+		}
+
+		// Moves of up to 256 units, mostly level like walking, some up or down like jumps and falls.
+		constexpr float kPi = 3.14159265f;
+		constexpr float kEyeHeight = 28.0f;
+		std::mt19937 rng(54321);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<std::pair<cs2::Vec3, cs2::Vec3>> moves;
+		moves.reserve(std::min(players.size(), options.bench_sweeps));
+		for (size_t i = 0; i < players.size() && moves.size() < options.bench_sweeps; i++)
+		{
+			float yaw = 2.0f * kPi * unit(rng);
+			float pitch = (unit(rng) - 0.5f) * kPi / 3.0f;
+			float length = 256.0f * unit(rng);
+			cs2::Vec3 start(players[i].x, players[i].y, players[i].z - kEyeHeight);
+			moves.emplace_back(start, cs2::Vec3(start.x + std::cos(yaw) * std::cos(pitch) * length,
+				start.y + std::sin(yaw) * std::cos(pitch) * length, start.z + std::sin(pitch) * length));
+		}
+
+		class Shape {
+		public:
+			const char* name;
+			std::function<bool(const cs2::Vec3&, const cs2::Vec3&, cs2::SweepHit&)> sweep;
+		};
+
+		cs2::Sweeper sweeper(bvh);
+		const cs2::Vec3 half_extents(16.0f, 16.0f, 36.0f);
+		const Shape shapes[] = {
+			{ "box", [&](const cs2::Vec3& start, const cs2::Vec3& end, cs2::SweepHit& hit) { return sweeper.sweepBox(start, end, half_extents, hit); } },
+			{ "capsule", [&](const cs2::Vec3& start, const cs2::Vec3& end, cs2::SweepHit& hit) { return sweeper.sweepCapsule(start, end, 16.0f, 20.0f, hit); } },
+		};
+
+		std::cout << manifest << " (" << moves.size() << " sweeps)" << std::endl;
+		std::cout << std::left << std::setw(10) << "Shape" << std::right << std::setw(14) << "Sweeps/s" << std::setw(10) << "us"
+			<< std::setw(10) << "Hit" << std::setw(12) << "Stuck" << std::setw(10) << "Checked" << std::setw(10) << "Wrong" << std::endl;
+
+		// The scan steps a unit or less at a time; contacts within kTolerance of a
+		// step are left to rounding.
+		constexpr size_t kCheckedSweeps = 1000;
+		constexpr size_t kScanSteps = 400;
+		constexpr float kTolerance = 0.01f;
+
+		bool consistent = true;
+		for (auto& shape : shapes)
+		{
+			std::vector<cs2::SweepHit> hits(moves.size());
+			auto start = Clock::now();
+			for (size_t i = 0; i < moves.size(); i++)
+				shape.sweep(moves[i].first, moves[i].second, hits[i]);
+			double seconds = secondsSince(start);
+
+			size_t hit = 0, stuck = 0;
+			for (auto& result : hits)
+			{
+				hit += result.isHit();
+				stuck += result.start_solid;
+			}
+
+			// A sweep is wrong if the scan finds the shape overlapping before the
+			// reported contact, or if the shape overlaps just short of it.
+			auto overlaps = [&](const cs2::Vec3& position) {
+				cs2::SweepHit probe;
+				return shape.sweep(position, position, probe) && probe.start_solid;
+			};
+			auto along = [](const std::pair<cs2::Vec3, cs2::Vec3>& move, float t) {
+				return cs2::Vec3(move.first.x + (move.second.x - move.first.x) * t, move.first.y + (move.second.y - move.first.y) * t,
+					move.first.z + (move.second.z - move.first.z) * t);
+			};
+
+			size_t checked = 0, wrong = 0;
+			for (size_t i = 0; i < moves.size() && checked < kCheckedSweeps; i++)
+			{
+				if (hits[i].start_solid)
+					continue;
+				checked++;
+
+				const auto& move = moves[i];
+				cs2::Vec3 delta(move.second.x - move.first.x, move.second.y - move.first.y, move.second.z - move.first.z);
+				float length = std::sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z);
+				float margin = length > 0.0f ? kTolerance / length : 0.0f;
+
+				bool disagrees = hits[i].isHit() && overlaps(along(move, std::max(0.0f, hits[i].fraction - margin)));
+				for (size_t step = 1; step <= kScanSteps && !disagrees; step++)
+				{
+					float t = static_cast<float>(step) / kScanSteps;
+					if (t >= hits[i].fraction - margin)
+						break;
+					disagrees = overlaps(along(move, t));
+				}
+				wrong += disagrees;
+			}
+
+			double count = static_cast<double>(std::max<size_t>(moves.size(), 1));
+			std::cout << std::fixed << std::setprecision(0) << std::left << std::setw(10) << shape.name << std::right
+				<< std::setw(14) << moves.size() / std::max(seconds, 1e-9) << std::setprecision(2) << std::setw(10) << seconds * 1e6 / count
+				<< std::setprecision(1) << std::setw(9) << 100.0 * hit / count << "%" << std::setw(11) << 100.0 * stuck / count << "%"
+				<< std::setw(10) << checked << std::setw(10) << wrong << std::endl;
+
+			consistent = consistent && wrong == 0;
+		}
+		std::cout << std::endl;
+
+		if (!consistent)
+			std::cerr << "Sweeps disagree with discrete overlap tests: " << manifest << std::endl;
+		return consistent;
+	}
+
+	bool benchmarkVoxels(const std::string& manifest, const BatchOptions& options)
+	{
+		unsigned threads = cs2::resolveThreadCount(options.threads);
+		cs2::PhysicsFile physics;
+		if (!loadForBenchmark(manifest, options, physics))
+			return false;
+
+		cs2::TriangleSoup soup(physics, threads);
+		std::cout << manifest << " (" << soup.size() << " triangles)" << std::endl;
+		std::cout << std::left << std::setw(8) << "Size" << std::setw(18) << "Grid" << std::right << std::setw(10) << "Build ms"
+			<< std::setw(12) << "Memory KB" << std::setw(8) << "Nodes" << std::setw(10) << "Bricks"
+			<< std::setw(11) << "Boundary" << std::setw(9) << "Solid" << std::setw(12) << "Points/s" << std::setw(11) << "Occupied" << std::endl;
+
+		bool ok = true;
+		for (float size : { 32.0f, 16.0f, 8.0f, 4.0f })
+		{
+			cs2::VoxelOptions voxel_options;
+			voxel_options.threads = threads;
+			voxel_options.voxel_size = size;
+
+			cs2::VoxelGrid grid;
+			if (!grid.build(soup, voxel_options))
+			{
+				ok = false;
+				continue;
+			}
+
+			// Random points over the map's bounds.
+			const cs2::Aabb& bounds = grid.getBounds();
+			std::mt19937 rng(1);
+			std::uniform_real_distribution<float> x(bounds.min.x, bounds.max.x), y(bounds.min.y, bounds.max.y), z(bounds.min.z, bounds.max.z);
+			std::vector<cs2::Vec3> points(1 << 20);
+			for (auto& point : points)
+				point = cs2::Vec3(x(rng), y(rng), z(rng));
+
+			auto start = Clock::now();
+			size_t occupied = 0;
+			for (auto& point : points)
+				occupied += grid.getState(point) != cs2::VoxelState::Empty;
+			double query_seconds = secondsSince(start);
+
+			const cs2::VoxelStats& stats = grid.getStats();
+			double voxels = static_cast<double>(std::max<size_t>(stats.size_x * stats.size_y * stats.size_z, 1));
+			std::string dimensions = std::to_string(stats.size_x) + "x" + std::to_string(stats.size_y) + "x" + std::to_string(stats.size_z);
+			std::cout << std::fixed << std::setprecision(0) << std::left << std::setw(8) << size << std::setw(18) << dimensions << std::right
+				<< std::setprecision(1) << std::setw(10) << stats.seconds * 1000.0 << std::setw(12) << stats.bytes / 1024
+				<< std::setw(8) << stats.nodes << std::setw(10) << stats.bricks
+				<< std::setw(10) << 100.0 * stats.boundary_voxels / voxels << "%" << std::setw(8) << 100.0 * stats.solid_voxels / voxels << "%"
+				<< std::setprecision(0) << std::setw(12) << (query_seconds > 0.0 ? points.size() / query_seconds : 0.0)
+				<< std::setprecision(1) << std::setw(10) << 100.0 * occupied / points.size() << "%" << std::endl;
+		}
+		std::cout << std::endl;
+		return ok;
+	}
+
+	bool benchmarkDistanceField(const std::string& manifest, const BatchOptions& options)
+	{
+		unsigned threads = cs2::resolveThreadCount(options.threads);
+		cs2::PhysicsFile physics;
+		cs2::Bvh bvh;
+		if (!loadForBenchmark(manifest, options, physics, bvh))
+			return false;
+
+		std::cout << manifest << " (" << bvh.getStats().triangles << " triangles)" << std::endl;
+		std::cout << std::left << std::setw(10) << "Format" << std::setw(16) << "Grid" << std::right << std::setw(10) << "Bake ms"
+			<< std::setw(10) << "Flood ms" << std::setw(12) << "Memory KB" << std::setw(9) << "Inside"
+			<< std::setw(14) << "Scalar/s" << std::setw(14) << "Batch/s" << std::setw(11) << "Max error" << std::setw(12) << "Round trip" << std::endl;
+
+		// Random points over the map's bounds, the same for every format.
+		const cs2::Aabb& bounds = bvh.getBounds();
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> x(bounds.min.x, bounds.max.x), y(bounds.min.y, bounds.max.y), z(bounds.min.z, bounds.max.z);
+		std::vector<cs2::Vec3> points(1 << 20);
+		for (auto& point : points)
+			point = cs2::Vec3(x(rng), y(rng), z(rng));
+
+		// Each field is also written and mapped back, which must sample exactly the same.
+		std::error_code ec;
+		std::string path = (std::filesystem::temp_directory_path(ec) / ("cs2-bench-sdf-" + std::to_string(std::hash<std::string>()(manifest)) + ".cs2d")).string();
+
+		bool ok = true;
+		std::vector<float> reference, distances(points.size()), mapped_distances(points.size());
+		for (cs2::DistanceFormat format : { cs2::DistanceFormat::Float32, cs2::DistanceFormat::Snorm16, cs2::DistanceFormat::Snorm8 })
+		{
+			cs2::DistanceFieldOptions field_options;
+			field_options.threads = threads;
+			field_options.format = format;
+
+			cs2::DistanceField field;
+			if (!field.bake(physics, bvh, field_options))
+			{
+				ok = false;
+				continue;
+			}
+
+			auto start = Clock::now();
+			field.sample(points, distances, cs2::SimdLevel::Scalar);
+			double scalar_seconds = secondsSince(start);
+
+			start = Clock::now();
+			field.sample(points, distances);
+			double batch_seconds = secondsSince(start);
+
+			// Quantization error against the float field.
+			double max_error = 0.0;
+			if (reference.empty())
+				reference = distances;
+			for (size_t i = 0; i < points.size(); i++)
+				max_error = std::max(max_error, static_cast<double>(std::abs(distances[i] - reference[i])));
+
+			// The header fields, then every point through both samplers.
+			std::string error;
+			cs2::DistanceField mapped;
+			bool round_trip = field.write(path) && mapped.open(path, error);
+			if (!error.empty())
+				std::cerr << error << std::endl;
+			round_trip = round_trip && mapped.getFormat() == field.getFormat() && mapped.getCellSize() == field.getCellSize() &&
+				mapped.getMaxDistance() == field.getMaxDistance() && std::memcmp(&mapped.getOrigin(), &field.getOrigin(), sizeof(cs2::Vec3)) == 0 &&
+				mapped.getSize(0) == field.getSize(0) && mapped.getSize(1) == field.getSize(1) && mapped.getSize(2) == field.getSize(2);
+			for (cs2::SimdLevel level : { cs2::SimdLevel::Scalar, cs2::getSimdLevel() })
+			{
+				if (!round_trip)
+					break;
+				field.sample(points, distances, level);
+				mapped.sample(points, mapped_distances, level);
+				round_trip = std::memcmp(distances.data(), mapped_distances.data(), distances.size() * sizeof(float)) == 0;
+			}
+			ok = ok && round_trip;
+
+			const char* name = format == cs2::DistanceFormat::Float32 ? "float32" : format == cs2::DistanceFormat::Snorm16 ? "snorm16" : "snorm8";
+			const cs2::DistanceFieldStats& stats = field.getStats();
+			std::string dimensions = std::to_string(field.getSize(0)) + "x" + std::to_string(field.getSize(1)) + "x" + std::to_string(field.getSize(2));
+			std::cout << std::fixed << std::left << std::setw(10) << name << std::setw(16) << dimensions << std::right
+				<< std::setprecision(1) << std::setw(10) << stats.seconds * 1000.0 << std::setw(10) << stats.flood_seconds * 1000.0
+				<< std::setw(12) << stats.bytes / 1024 << std::setw(8) << 100.0 * stats.inside / std::max<size_t>(stats.samples, 1) << "%"
+				<< std::setprecision(0) << std::setw(14) << (scalar_seconds > 0.0 ? points.size() / scalar_seconds : 0.0)
+				<< std::setw(14) << (batch_seconds > 0.0 ? points.size() / batch_seconds : 0.0)
+				<< std::setprecision(3) << std::setw(11) << max_error << std::setw(12) << (round_trip ? "identical" : "DIFFERENT") << std::endl;
+		}
+		std::filesystem::remove(path, ec);
+		std::cout << std::endl;
+
+		if (!ok)
+			std::cerr << "Distance fields did not bake or map back identically: " << manifest << std::endl;
+		return ok;
+	}
+
+	bool benchmarkNavMesh(const std::string& manifest, const BatchOptions& options)
+	{
+		unsigned threads = cs2::resolveThreadCount(options.threads);
+		cs2::PhysicsFile physics;
+		if (!loadForBenchmark(manifest, options, physics))
+			return false;
+
+		cs2::NavMeshOptions mesh_options;
+		mesh_options.threads = threads;
+		cs2::NavMesh mesh;
+		if (!mesh.build(physics, mesh_options))
+			return false;
+
+		std::cout << manifest << std::endl;
+		mesh.displayStats();
+
+		// Paths between the centres of random polygons; islands like rooftops leave some unconnected.
+		std::vector<cs2::Vec3> centers;
+		for (size_t t = 0; t < mesh.getTileCount(); t++)
+		{
+			const cs2::NavTile& tile = mesh.getTile(t);
+			for (const cs2::NavPolygon& polygon : tile.polygons)
+			{
+				cs2::Vec3 center(0.0f, 0.0f, 0.0f);
+				for (size_t i = 0; i < polygon.vertex_count; i++)
+				{
+					const cs2::Vec3& v = tile.vertices[polygon.vertices[i]];
+					center = cs2::Vec3(center.x + v.x / polygon.vertex_count, center.y + v.y / polygon.vertex_count, center.z + v.z / polygon.vertex_count);
+				}
+				centers.push_back(center);
+			}
+		}
+		if (centers.empty())
+		{
+			std::cerr << "No walkable polygons: " << manifest << std::endl;
+			return false;
+		}
+
+		constexpr size_t kPaths = 10000;
+		std::mt19937 rng(1);
+		std::uniform_int_distribution<size_t> pick(0, centers.size() - 1);
+		size_t found = 0, corners = 0;
+		double length = 0.0;
+		cs2::NavPath path;
+		auto start = Clock::now();
+		for (size_t i = 0; i < kPaths; i++)
+		{
+			if (!mesh.findPath(centers[pick(rng)], centers[pick(rng)], path))
+				continue;
+			found++;
+			corners += path.points.size() - 2;
+			length += path.length;
+		}
+		double path_seconds = secondsSince(start);
+
+		std::cout << std::fixed << std::setprecision(0) << "Paths: " << (path_seconds > 0.0 ? kPaths / path_seconds : 0.0) << "/s, "
+			<< std::setprecision(1) << 100.0 * found / kPaths << "% connected, " << static_cast<double>(corners) / std::max<size_t>(found, 1)
+			<< " corners and " << length / std::max<size_t>(found, 1) << " units on average" << std::endl;
+
+		// Rebuild what one hull touches, as when a door or prop moves.
+		const uint32_t hull = static_cast<uint32_t>(physics.getHulls().size() / 2);
+		if (!mesh.rebuildHulls(physics, std::span<const uint32_t>(&hull, 1)))
+			return false;
+		std::cout << "Rebuild of hull " << hull << ": " << mesh.getStats().tiles_built << " tiles in "
+			<< mesh.getStats().seconds * 1000.0 << " ms" << std::endl;
+		std::cout << std::endl;
+		return true;
+	}
+
+	bool benchmarkTiles(const std::string& manifest, const BatchOptions& options)
+	{
+		cs2::PhysicsFile physics;
+		if (!loadForBenchmark(manifest, options, physics))
+			return false;
+
+		std::error_code ec;
+		std::string path = (std::filesystem::temp_directory_path(ec) / ("cs2-bench-tiles-" + std::to_string(std::hash<std::string>()(manifest)) + ".cs2c")).string();
+		if (!physics.writeCache(path))
+			return false;
+
+		std::string error;
+		cs2::GeometryCache full;
+		if (!full.open(path, error))
+		{
+			std::cerr << error << std::endl;
+			std::filesystem::remove(path, ec);
+			return false;
+		}
+
+		cs2::Aabb bounds;
+		for (size_t i = 0; i < full.getTileCount(); i++)
+			bounds.extend(full.getTileBounds(i));
+		cs2::Vec3 center(0.5f * (bounds.min.x + bounds.max.x), 0.5f * (bounds.min.y + bounds.max.y), 0.5f * (bounds.min.z + bounds.max.z));
+
+		std::cout << manifest << " (" << full.getTileCount() << " tiles, " << full.getFileSize() / 1024 << " KB)" << std::endl;
+		std::cout << std::left << std::setw(16) << "Region" << std::right << std::setw(8) << "Tiles" << std::setw(8) << "Hulls"
+			<< std::setw(12) << "Triangles" << std::setw(12) << "Mapped KB" << std::setw(9) << "File" << std::setw(10) << "Open ms" << std::endl;
+
+		auto report = [&](const std::string& name, auto&& open) {
+			auto start = Clock::now();
+			cs2::GeometryCache cache;
+			if (!open(cache))
+			{
+				std::cerr << error << std::endl;
+				return false;
+			}
+			double seconds = secondsSince(start);
+
+			size_t hulls = 0, triangles = 0;
+			for (size_t i = 0; i < cache.getHullCount(); i++)
+			{
+				if (!cache.isHullLoaded(i))
+					continue;
+				hulls++;
+				triangles += cache.getHull(i).getTriangleCount();
+			}
+
+			std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(16) << name << std::right
+				<< std::setw(8) << cache.getLoadedTileCount() << std::setw(8) << hulls << std::setw(12) << triangles
+				<< std::setw(12) << cache.getMappedBytes() / 1024
+				<< std::setw(8) << 100.0 * cache.getMappedBytes() / std::max<uint64_t>(cache.getFileSize(), 1) << "%"
+				<< std::setprecision(2) << std::setw(10) << seconds * 1000.0 << std::endl;
+			return true;
+		};
+
+		bool ok = report("whole file", [&](cs2::GeometryCache& cache) { return cache.open(path, error); });
+
+		// Squares around the centre of the map, from half its width down to a tenth.
+		for (float fraction : { 0.5f, 0.25f, 0.1f })
+		{
+			float half_x = 0.5f * fraction * (bounds.max.x - bounds.min.x);
+			float half_y = 0.5f * fraction * (bounds.max.y - bounds.min.y);
+			cs2::Aabb region(cs2::Vec3(center.x - half_x, center.y - half_y, bounds.min.z), cs2::Vec3(center.x + half_x, center.y + half_y, bounds.max.z));
+			std::string name = "box " + std::to_string(static_cast<int>(fraction * 100.0f)) + "%";
+			ok = report(name, [&](cs2::GeometryCache& cache) { return cache.openRegion(path, region, error); }) && ok;
+		}
+
+		// What a player in the middle of the map sees looking along x, out to 2048 units.
+		cs2::Frustum frustum(center, cs2::Vec3(1.0f, 0.0f, 0.0f), cs2::Vec3(0.0f, 0.0f, 1.0f), 90.0f, 16.0f / 9.0f, 4.0f, 2048.0f);
+		ok = report("view frustum", [&](cs2::GeometryCache& cache) { return cache.openRegion(path, frustum, error); }) && ok;
+
+		std::filesystem::remove(path, ec);
+		std::cout << std::endl;
+		return ok;
+	}
+
+	void printUsage()
+	{
+		std::cerr <<
+			"Usage: cs2-batch [options] <map dir | maps dir | manifest | list file>...\n"
+			"\n"
+			"Options:\n"
+			"  --out <dir>        Directory for the <map>.cs2c files (default: .)\n"
+			"  --threads <n>      Thread budget shared by all stages (default: all cores)\n"
+			"  --queue <n>        Maps allowed to wait between stages (default: 1)\n"
+			"  --cache <dir>      Persistent parse cache directory\n"
+			"  --indexed          Keep hulls as indexed meshes\n"
+			"  --quantized        Keep hulls as quantized meshes\n"
+			"  --weld             Weld vertices and drop degenerate and duplicate triangles\n"
+			"  --tri              Also write <map>.tri triangle dumps\n"
+			"  --heightfield      Also write <map>.cs2h floor and ceiling heightfields\n"
+			"  --bench-scanner    Time hull file parsing against the stringstream parsing it replaced per map instead of exporting\n"
+			"  --bench-parse      Report parse throughput in MB/s on one and all threads per map instead of exporting\n"
+			"  --bench-los <n>    Benchmark <n> line of sight queries per map instead of exporting\n"
+			"  --bench-grenades <n>  Benchmark <n> grenade throws per map instead of exporting\n"
+			"  --bench-sweeps <n>  Benchmark <n> box and capsule sweeps per map and check them against discrete overlap tests\n"
+			"  --bench-voxels     Report voxel grid build time and memory per map instead of exporting\n"
+			"  --bench-sdf        Report distance field bake time, memory and sampling rate per map instead of exporting\n"
+			"  --bench-navmesh    Report navigation mesh build stages, path query rate and tile rebuild time per map instead of exporting\n"
+			"  --bench-tiles      Report tiles, bytes mapped and load time of region and frustum cache loads per map instead of exporting\n";
+	}
+
+	bool parseArguments(int argc, char** argv, BatchOptions& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+
+			if (arg == "--out" || arg == "--threads" || arg == "--queue" || arg == "--cache" || arg == "--bench-los" || arg == "--bench-grenades" || arg == "--bench-sweeps")
+			{
+				const char* text = value();
+				if (!text)
+				{
+					std::cerr << "Missing value for " << arg << std::endl;
+					return false;
+				}
+
+				if (arg == "--out")
+					options.output_dir = text;
+				else if (arg == "--threads")
+					options.threads = static_cast<unsigned>(std::strtoul(text, nullptr, 10));
+				else if (arg == "--queue")
+					options.queue_depth = std::strtoul(text, nullptr, 10);
+				else if (arg == "--bench-los")
+					options.bench_los = std::strtoull(text, nullptr, 10);
+				else if (arg == "--bench-grenades")
+					options.bench_grenades = std::strtoull(text, nullptr, 10);
+				else if (arg == "--bench-sweeps")
+					options.bench_sweeps = std::strtoull(text, nullptr, 10);
+				else
+					options.load.cache_directory = text;
+			}
+			else if (arg == "--indexed")
+				options.load.indexed = true;
+			else if (arg == "--quantized")
+				options.load.quantized = true;
+			else if (arg == "--weld")
+				options.weld = true;
+			else if (arg == "--tri")
+				options.write_triangles = true;
+			else if (arg == "--heightfield")
+				options.write_heightfield = true;
+			else if (arg == "--bench-scanner")
+				options.bench_scanner = true;
+			else if (arg == "--bench-parse")
+				options.bench_parse = true;
+			else if (arg == "--bench-voxels")
+				options.bench_voxels = true;
+			else if (arg == "--bench-sdf")
+				options.bench_sdf = true;
+			else if (arg == "--bench-navmesh")
+				options.bench_navmesh = true;
+			else if (arg == "--bench-tiles")
+				options.bench_tiles = true;
+			else if (arg == "--help" || arg == "-h")
+				return false;
+			else if (!arg.empty() && arg[0] == '-')
+			{
+				std::cerr << "Unknown option: " << arg << std::endl;
+				return false;
+			}
+			else
+				options.inputs.push_back(arg);
+		}
+
+		return !options.inputs.empty();
+	}
+
+	void printReport(const std::vector<std::unique_ptr<MapJob>>& jobs, double wall_seconds, unsigned threads)
+	{
+		std::cout << std::left << std::setw(24) << "Map" << std::right
+			<< std::setw(8) << "Hulls" << std::setw(12) << "Triangles"
+			<< std::setw(10) << "Read ms" << std::setw(10) << "Parse ms"
+			<< std::setw(10) << "Post ms" << std::setw(10) << "Write ms" << std::endl;
+
+		double read = 0.0, parse = 0.0, post = 0.0, write = 0.0;
+		uint64_t bytes = 0;
+		size_t failed = 0, triangles = 0;
+
+		std::cout << std::fixed << std::setprecision(1);
+		for (auto& job : jobs)
+		{
+			std::cout << std::left << std::setw(24) << (job->ok ? job->name : job->name + " (failed)") << std::right
+				<< std::setw(8) << job->hulls << std::setw(12) << job->triangles
+				<< std::setw(10) << job->read_seconds * 1000.0 << std::setw(10) << job->parse_seconds * 1000.0
+				<< std::setw(10) << job->post_seconds * 1000.0 << std::setw(10) << job->write_seconds * 1000.0 << std::endl;
+
+			read += job->read_seconds;
+			parse += job->parse_seconds;
+			post += job->post_seconds;
+			write += job->write_seconds;
+			bytes += job->bytes_read;
+			triangles += job->triangles;
+			failed += !job->ok;
+		}
+
+		double busy = read + parse + post + write;
+		std::cout << std::endl;
+		std::cout << "Maps: " << jobs.size() - failed << " ok, " << failed << " failed" << std::endl;
+		std::cout << "Threads: " << threads << std::endl;
+		std::cout << "Triangles: " << triangles << std::endl;
+		std::cout << "Stage Time: read " << read * 1000.0 << " ms, parse " << parse * 1000.0 << " ms, post "
+			<< post * 1000.0 << " ms, write " << write * 1000.0 << " ms" << std::endl;
+		std::cout << "Wall Time: " << wall_seconds * 1000.0 << " ms";
+		if (wall_seconds > 0.0)
+			std::cout << " (stage overlap " << busy / wall_seconds << "x, "
+				<< bytes / wall_seconds / (1024.0 * 1024.0) << " MB/s)";
+		std::cout << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BatchOptions options;
+	if (!parseArguments(argc, argv, options))
+	{
+		printUsage();
+		return 1;
+	}
+
+	std::vector<std::string> manifests;
+	for (auto& input : options.inputs)
+		collectMaps(input, manifests);
+
+	if (manifests.empty())
+	{
+		std::cerr << "No maps to process." << std::endl;
+		return 1;
+	}
+
+	if (options.bench_scanner || options.bench_parse || options.bench_los > 0 || options.bench_grenades > 0 || options.bench_sweeps > 0 || options.bench_voxels || options.bench_sdf || options.bench_navmesh || options.bench_tiles)
+	{
+		bool ok = true;
+		for (auto& manifest : manifests)
+		{
+			if (options.bench_scanner)
+				ok = benchmarkScanner(manifest, options) && ok;
+			if (options.bench_parse)
+				ok = benchmarkParse(manifest, options) && ok;
+			if (options.bench_los > 0)
+				ok = benchmarkLineOfSight(manifest, options) && ok;
+			if (options.bench_grenades > 0)
+				ok = benchmarkGrenades(manifest, options) && ok;
+			if (options.bench_sweeps > 0)
+				ok = benchmarkSweeps(manifest, options) && ok;
+			if (options.bench_voxels)
+				ok = benchmarkVoxels(manifest, options) && ok;
+			if (options.bench_sdf)
+				ok = benchmarkDistanceField(manifest, options) && ok;
+			if (options.bench_navmesh)
+				ok = benchmarkNavMesh(manifest, options) && ok;
+			if (options.bench_tiles)
+				ok = benchmarkTiles(manifest, options) && ok;
+		}
+		return ok ? 0 : 2;
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(options.output_dir, ec);
+
+	std::vector<std::unique_ptr<MapJob>> jobs;
+	for (auto& manifest : manifests)
+	{
+		auto job = std::make_unique<MapJob>();
+		job->manifest = manifest;
+		job->working_dir = std::filesystem::path(manifest).parent_path().string();
+
+		// Outputs are named after the map directory, which is unique per input
+		// even when manifests disagree about their map name.
+		job->name = std::filesystem::path(job->working_dir).filename().string();
+		if (job->name.empty())
+			job->name = std::filesystem::path(manifest).stem().string();
+		jobs.push_back(std::move(job));
+	}
+
+	// read -> parse -> post-process -> write, one thread per stage. Stages borrow
+	// extra threads from the shared budget for the parallel parts of their work,
+	// and the queues between them cap how many maps are in memory.
+	const unsigned budget_size = cs2::resolveThreadCount(options.threads);
+	cs2::ThreadBudget budget(budget_size);
+	cs2::BoundedQueue<MapJob*> parse_queue(options.queue_depth);
+	cs2::BoundedQueue<MapJob*> post_queue(options.queue_depth);
+	cs2::BoundedQueue<MapJob*> write_queue(options.queue_depth);
+
+	auto start_time = Clock::now();
+
+	std::thread reader([&] {
+		for (auto& job : jobs)
+		{
+			unsigned tokens = budget.acquire(1);
+			auto stage_start = Clock::now();
+			job->bytes_read = prefetchMap(*job);
+			job->read_seconds = secondsSince(stage_start);
+			budget.release(tokens);
+
+			parse_queue.push(job.get());
+		}
+		parse_queue.close();
+	});
+
+	std::thread parser([&] {
+		MapJob* job;
+		while (parse_queue.pop(job))
+		{
+			unsigned tokens = budget.acquire(budget_size);
+			auto stage_start = Clock::now();
+
+			cs2::LoadOptions load = options.load;
+			load.threads = tokens;
+			job->physics = std::make_unique<cs2::PhysicsFile>();
+			job->ok = job->physics->load(job->manifest, job->working_dir, load);
+
+			job->parse_seconds = secondsSince(stage_start);
+			budget.release(tokens);
+
+			post_queue.push(job);
+		}
+		post_queue.close();
+	});
+
+	std::thread post_processor([&] {
+		MapJob* job;
+		while (post_queue.pop(job))
+		{
+			if (job->ok)
+			{
+				unsigned tokens = budget.acquire(budget_size);
+				auto stage_start = Clock::now();
+
+				if (options.weld)
+				{
+					cs2::WeldOptions weld;
+					weld.threads = tokens;
+					job->physics->weld(weld);
+					job->physics->compact();
+				}
+
+				for (auto& hull : job->physics->getHulls())
+					job->triangles += hull.getTriangleCount();
+				job->hulls = job->physics->getHulls().size();
+
+				if (options.write_heightfield)
+				{
+					cs2::HeightfieldOptions heightfield;
+					heightfield.threads = tokens;
+					job->heightfield = std::make_unique<cs2::Heightfield>();
+					job->ok = job->heightfield->build(*job->physics, heightfield);
+				}
+
+				job->post_seconds = secondsSince(stage_start);
+				budget.release(tokens);
+			}
+
+			write_queue.push(job);
+		}
+		write_queue.close();
+	});
+
+	std::thread writer([&] {
+		MapJob* job;
+		while (write_queue.pop(job))
+		{
+			if (job->ok)
+			{
+				unsigned tokens = budget.acquire(1);
+				auto stage_start = Clock::now();
+
+				std::string base = (std::filesystem::path(options.output_dir) / job->name).string();
+				job->ok = job->physics->writeCache(base + ".cs2c");
+				if (options.write_triangles)
+					job->physics->writeTriangles(base + ".tri");
+				if (job->ok && job->heightfield)
+					job->ok = job->heightfield->write(base + ".cs2h");
+
+				job->write_seconds = secondsSince(stage_start);
+				budget.release(tokens);
+			}
+
+			// Done with the map, free its geometry before the next one arrives.
+			job->physics.reset();
+			job->heightfield.reset();
+		}
+	});
+
+	reader.join();
+	parser.join();
+	post_processor.join();
+	writer.join();
+
+	printReport(jobs, secondsSince(start_time), budget_size);
+
+	for (auto& job : jobs)
+		if (!job->ok)
+			return 2;
+
 	return 0;
-}
\ No newline at end of file
+}
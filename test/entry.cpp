@@ -1,24 +1,39 @@
-#include "../core/cs2/parser.h"
+#include "../core/cs2/cache.h"
 #include "renderer.h"
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
 	std::vector<cs2::Triangle> triangles;
-	
-	std::ifstream in("de_mirage.tri", std::ios::binary);
-	if (!in)
-	{
-		MessageBoxA(NULL, "Failed to open file: de_mirage.tri\nMake sure the file exists in the executable directory.", "Error", MB_OK | MB_ICONERROR);
-		return 1;
-	}
 
-	cs2::Triangle triangle = {};
-	while (in.read(reinterpret_cast<char*>(&triangle), sizeof(cs2::Triangle)))
+	cs2::GeometryCache cache;
+	std::string error;
+	if (cache.open("de_mirage.cs2c", error))
 	{
-		triangles.push_back(triangle);
+		triangles.reserve(cache.getTriangleCount());
+		for (size_t i = 0; i < cache.getHullCount(); i++)
+		{
+			cache.getHull(i).forEachTriangle([&](const cs2::Triangle& triangle) {
+				triangles.push_back(triangle);
+			});
+		}
 	}
+	else
+	{
+		std::ifstream in("de_mirage.tri", std::ios::binary);
+		if (!in)
+		{
+			MessageBoxA(NULL, "Failed to open file: de_mirage.cs2c or de_mirage.tri\nMake sure the file exists in the executable directory.", "Error", MB_OK | MB_ICONERROR);
+			return 1;
+		}
+
+		cs2::Triangle triangle = {};
+		while (in.read(reinterpret_cast<char*>(&triangle), sizeof(cs2::Triangle)))
+		{
+			triangles.push_back(triangle);
+		}
 
-	in.close();
+		in.close();
+	}
 
 	Renderer::Application app;
 	if (!app.Initialize(hInstance, nCmdShow))
@@ -0,0 +1,28 @@
+# Decodes one compiled fixture with cs2-batch and checks the result.
+#   cmake -DBATCH=<cs2-batch> -DFIXTURE=<file> -DNAME=<map> -DEXPECTED=<expected.tri> -DOUT=<dir> [-DNAMES=<a,b>] -P check_fixture.cmake
+
+file(REMOVE_RECURSE "${OUT}")
+execute_process(COMMAND "${BATCH}" --tri --out "${OUT}" "${FIXTURE}" RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "cs2-batch failed on ${FIXTURE}")
+endif()
+
+execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files "${OUT}/${NAME}.tri" "${EXPECTED}" RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "Triangles of ${FIXTURE} differ from ${EXPECTED}")
+endif()
+
+# Hull names and surface props: stock props resolve to their names, others keep the hash.
+if(DEFINED NAMES)
+	string(REPLACE "," ";" NAMES "${NAMES}")
+else()
+	set(NAMES floor concrete metal 0xDEADBEEF)
+endif()
+file(STRINGS "${OUT}/${NAME}.cs2c" strings)
+string(JOIN "" strings ${strings})
+foreach(name ${NAMES})
+	string(FIND "${strings}" "${name}" found)
+	if(found EQUAL -1)
+		message(FATAL_ERROR "${NAME}.cs2c does not name ${name}")
+	endif()
+endforeach()
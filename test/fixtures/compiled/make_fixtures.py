@@ -0,0 +1,358 @@
+"""Writes the compiled resource fixtures decoded by the CTest checks.
+
+Every fixture holds the same physics data, one mesh stored as blobs, one
+stored as arrays and one convex hull, in a different binary KV3 encoding.
+expected.tri is the triangle dump cs2-batch --tri must write for each.
+The v4 and zstd fixtures use encodings the decoder rejects.
+
+Run from this directory: python3 make_fixtures.py
+"""
+
+import os
+import struct
+
+MAGIC_LEGACY = 0x03564B56
+MAGIC_VERSIONED = 0x4B563300
+BLOB_TRAILER = 0xFFEEDD00
+
+ENCODING_UNCOMPRESSED = bytes([0x00, 0x05, 0x86, 0x1B, 0xD8, 0xF7, 0xC1, 0x40, 0xAD, 0x82, 0x75, 0xA4, 0x82, 0x67, 0xE7, 0x14])
+ENCODING_BLOCK = bytes([0x46, 0x1A, 0x79, 0x95, 0xBC, 0x95, 0x6C, 0x4F, 0xA7, 0x0B, 0x05, 0xBC, 0xA1, 0xB7, 0xDF, 0xD2])
+ENCODING_LZ4 = bytes([0x8A, 0x34, 0x47, 0x68, 0xA1, 0x63, 0x5C, 0x4F, 0xA1, 0x97, 0x53, 0x80, 0x6F, 0xD9, 0xB1, 0x19])
+
+
+def hash_token(name):
+    """MurmurHash2 of the lowercased name, as Source 2 hashes surface props."""
+    data = name.lower().encode()
+    m = 0x5BD1E995
+    h = (0x31415926 ^ len(data)) & 0xFFFFFFFF
+    i = 0
+    while i + 4 <= len(data):
+        k = struct.unpack_from('<I', data, i)[0]
+        k = (k * m) & 0xFFFFFFFF
+        k ^= k >> 24
+        k = (k * m) & 0xFFFFFFFF
+        h = ((h * m) & 0xFFFFFFFF) ^ k
+        i += 4
+    tail = data[i:]
+    if len(tail) == 3:
+        h ^= tail[2] << 16
+    if len(tail) >= 2:
+        h ^= tail[1] << 8
+    if len(tail) >= 1:
+        h ^= tail[0]
+        h = (h * m) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * m) & 0xFFFFFFFF
+    h ^= h >> 15
+    return h
+
+
+def lz4_compress(data):
+    """Greedy LZ4 block compressor, enough to exercise literals and matches."""
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    limit = len(data) - 12
+
+    def length_bytes(n):
+        while n >= 255:
+            out.append(255)
+            n -= 255
+        out.append(n)
+
+    while i < limit:
+        key = data[i:i + 4]
+        candidate = table.get(key)
+        table[key] = i
+        if candidate is None or i - candidate > 0xFFFF:
+            i += 1
+            continue
+
+        match = 4
+        while i + match < len(data) - 5 and data[candidate + match] == data[i + match]:
+            match += 1
+
+        literals = i - anchor
+        out.append((min(literals, 15) << 4) | min(match - 4, 15))
+        if literals >= 15:
+            length_bytes(literals - 15)
+        out += data[anchor:i]
+        out += struct.pack('<H', i - candidate)
+        if match - 4 >= 15:
+            length_bytes(match - 4 - 15)
+
+        i += match
+        anchor = i
+
+    literals = len(data) - anchor
+    out.append(min(literals, 15) << 4)
+    if literals >= 15:
+        length_bytes(literals - 15)
+    out += data[anchor:]
+    return bytes(out)
+
+
+def block_compress(data):
+    """Valve's LZ77 block compression: 16-entry masks of literals and back references."""
+    out = bytearray([len(data) & 0xFF, (len(data) >> 8) & 0xFF, (len(data) >> 16) & 0xFF, 0])
+    i = 0
+    while i < len(data):
+        mask = 0
+        body = bytearray()
+        for bit in range(16):
+            if i >= len(data):
+                break
+            best_length, best_offset = 0, 0
+            for offset in range(1, min(i, 4096) + 1):
+                length = 0
+                while length < 18 and i + length < len(data) and data[i - offset + length] == data[i + length]:
+                    length += 1
+                if length > best_length:
+                    best_length, best_offset = length, offset
+            if best_length >= 3:
+                mask |= 1 << bit
+                body += struct.pack('<H', ((best_offset - 1) << 4) | (best_length - 3))
+                i += best_length
+            else:
+                body.append(data[i])
+                i += 1
+        out += struct.pack('<H', mask) + body
+    return bytes(out)
+
+
+class Encoder:
+    """Splits a value tree into the KV3 streams. The legacy encoding keeps one stream."""
+
+    def __init__(self, version):
+        self.version = version
+        self.strings = []
+        self.types = bytearray()
+        self.bytes = bytearray()
+        self.ints = bytearray()
+        self.eights = bytearray()
+        self.blobs = []
+
+    def string_id(self, text):
+        if text not in self.strings:
+            self.strings.append(text)
+        return self.strings.index(text)
+
+    def stream(self, name):
+        return self.types if self.version == 0 else getattr(self, name)
+
+    def put_type(self, wire):
+        self.stream('types').append(wire)
+
+    def put_int(self, fmt, value):
+        self.stream('ints').extend(struct.pack(fmt, value))
+
+    def value(self, v):
+        kind = v[0]
+        if kind == 'object':
+            self.put_type(9)
+            self.put_int('<i', len(v[1]))
+            for key, item in v[1]:
+                self.put_int('<i', self.string_id(key))
+                self.value(item)
+        elif kind == 'array':
+            self.put_type(8)
+            self.put_int('<i', len(v[1]))
+            for item in v[1]:
+                self.value(item)
+        elif kind == 'int':
+            self.put_type(11)
+            self.put_int('<i', v[1])
+        elif kind == 'uint':
+            self.put_type(12)
+            self.put_int('<I', v[1])
+        elif kind == 'float':
+            self.put_type(19)
+            self.put_int('<f', v[1])
+        elif kind == 'string':
+            self.put_type(6)
+            self.put_int('<i', self.string_id(v[1]))
+        elif kind == 'blob':
+            self.put_type(7)
+            if self.version == 0:
+                self.put_int('<I', len(v[1]))
+                self.types.extend(v[1])
+            elif self.version == 1:
+                self.put_int('<I', len(v[1]))
+                self.bytes.extend(v[1])
+            else:
+                self.blobs.append(v[1])
+
+    def string_table(self):
+        return b''.join(s.encode() + b'\0' for s in self.strings)
+
+
+def legacy(root, encoding):
+    encoder = Encoder(0)
+    encoder.value(root)
+    body = struct.pack('<I', len(encoder.strings)) + encoder.string_table() + bytes(encoder.types)
+
+    header = struct.pack('<I', MAGIC_LEGACY) + encoding + bytes(16)
+    if encoding == ENCODING_BLOCK:
+        return header + block_compress(body)
+    if encoding == ENCODING_LZ4:
+        return header + struct.pack('<I', len(body)) + lz4_compress(body)
+    return header + body
+
+
+def versioned(root, version, compression, magic_version=None):
+    encoder = Encoder(version)
+    encoder.value(root)
+
+    buffer = bytearray(encoder.bytes)
+
+    def align(n):
+        while len(buffer) % n:
+            buffer.append(0)
+
+    if version >= 3:
+        align(2)
+    align(4)
+    buffer += struct.pack('<I', len(encoder.strings)) + encoder.ints
+    align(8)
+    buffer += encoder.eights
+    strings = encoder.string_table()
+    buffer += strings + encoder.types
+
+    blob_data = b''.join(encoder.blobs)
+    frames = []
+    if version >= 2:
+        buffer += b''.join(struct.pack('<I', len(b)) for b in encoder.blobs)
+        buffer += struct.pack('<I', BLOB_TRAILER)
+        if compression == 1 and blob_data:
+            for start in range(0, len(blob_data), 16384):
+                frame = lz4_compress(blob_data[start:start + 16384])
+                frames.append(frame)
+                buffer += struct.pack('<H', len(frame))
+    else:
+        buffer += struct.pack('<I', BLOB_TRAILER)
+
+    payload = lz4_compress(bytes(buffer)) if compression == 1 else bytes(buffer)
+
+    header = struct.pack('<I', MAGIC_VERSIONED | (magic_version or version)) + bytes(16) + struct.pack('<I', compression)
+    if version >= 2:
+        header += struct.pack('<HH', 0, 16384 if compression == 1 else 0)
+    header += struct.pack('<III', len(encoder.bytes), 1 + len(encoder.ints) // 4, len(encoder.eights) // 8)
+
+    if version == 1:
+        return header + struct.pack('<I', len(buffer)) + payload
+
+    header += struct.pack('<IHH', len(strings) + len(encoder.types), 0, 0)
+    header += struct.pack('<IIII', len(buffer), len(payload), len(encoder.blobs), len(blob_data))
+    if version >= 3:
+        header += struct.pack('<II', 0, 0)
+    return header + payload + (b''.join(frames) if compression == 1 else blob_data)
+
+
+def resource(blocks):
+    """Resource container: header, block table, 16-byte aligned blocks."""
+    table = 16
+    out = bytearray(struct.pack('<IHHII', 0, 12, 0, table - 8, len(blocks)))
+    data_offset = table + 12 * len(blocks)
+    entries = bytearray()
+    payload = bytearray()
+    for i, (kind, data) in enumerate(blocks):
+        field = table + i * 12 + 4
+        entries += kind.encode() + struct.pack('<II', data_offset + len(payload) - field, len(data))
+        payload += data
+        while len(payload) % 16:
+            payload.append(0)
+    out += entries + payload
+    struct.pack_into('<I', out, 0, len(out))
+    return bytes(out)
+
+
+# A floor and ceiling pair of quads, stored once as blobs and once as arrays,
+# and a tetrahedron hull.
+VERTICES = [(0, 0, 0), (100, 0, 0), (0, 100, 0), (100, 100, 0), (0, 0, 50), (100, 0, 50), (0, 100, 50), (100, 100, 50)]
+TRIANGLES = [(0, 1, 3), (0, 3, 2), (4, 6, 7), (4, 7, 5)]
+HULL_VERTICES = [(0, 0, 100), (10, 0, 100), (0, 10, 100), (0, 0, 110)]
+HULL_FACES = [(0, 2, 1), (0, 1, 3), (0, 3, 2), (1, 2, 3)]
+SURFACE_PROPS = [hash_token('concrete'), hash_token('metal'), 0xDEADBEEF]
+
+
+def vectors_blob(vectors):
+    return b''.join(struct.pack('<fff', *v) for v in vectors)
+
+
+def physics_root():
+    # RnHalfEdge_t records: next, twin, origin, face. RnFace_t records: first edge.
+    edges = bytearray()
+    faces = bytearray()
+    for f, face in enumerate(HULL_FACES):
+        first = len(edges) // 4
+        faces.append(first)
+        for k in range(3):
+            edges += bytes([first + (k + 1) % 3, 0, face[k], f])
+
+    mesh_blobs = ('object', [
+        ('m_UserFriendlyName', ('string', 'floor')),
+        ('m_nSurfacePropertyIndex', ('int', 1)),
+        ('m_Mesh', ('object', [
+            ('m_Vertices', ('blob', vectors_blob(VERTICES))),
+            ('m_Triangles', ('blob', b''.join(struct.pack('<iii', *t) for t in TRIANGLES))),
+        ])),
+    ])
+    mesh_arrays = ('object', [
+        ('m_nSurfacePropertyIndex', ('int', 0)),
+        ('m_Mesh', ('object', [
+            ('m_Vertices', ('array', [('array', [('float', x) for x in v]) for v in VERTICES])),
+            ('m_Triangles', ('array', [('object', [('m_nIndex', ('array', [('int', x) for x in t]))]) for t in TRIANGLES])),
+        ])),
+    ])
+    hull = ('object', [
+        ('m_nSurfacePropertyIndex', ('int', 2)),
+        ('m_Hull', ('object', [
+            ('m_VertexPositions', ('blob', vectors_blob(HULL_VERTICES))),
+            ('m_Faces', ('blob', bytes(faces))),
+            ('m_Edges', ('blob', bytes(edges))),
+        ])),
+    ])
+    shape = ('object', [('m_hulls', ('array', [hull])), ('m_meshes', ('array', [mesh_blobs, mesh_arrays]))])
+
+    return ('object', [
+        ('m_parts', ('array', [('object', [('m_rnShape', shape)])])),
+        ('m_surfacePropertyHashes', ('array', [('uint', h) for h in SURFACE_PROPS])),
+    ])
+
+
+def expected_triangles():
+    # Meshes come before hulls; hull faces are fan-triangulated from their first edge.
+    triangles = [[VERTICES[i] for i in t] for t in TRIANGLES] * 2
+    triangles += [[HULL_VERTICES[i] for i in face] for face in HULL_FACES]
+    return b''.join(vectors_blob(t) for t in triangles)
+
+
+def write(path, data):
+    if os.path.dirname(path):
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, 'wb') as file:
+        file.write(data)
+
+
+def main():
+    root = physics_root()
+
+    write('legacy/world_physics.vphys_c', resource([('DATA', legacy(root, ENCODING_UNCOMPRESSED))]))
+    write('legacy_block/world_physics.vphys_c', resource([('DATA', legacy(root, ENCODING_BLOCK))]))
+    write('legacy_lz4/world_physics.vphys_c', resource([('DATA', legacy(root, ENCODING_LZ4))]))
+    write('v1/world_physics.vphys_c', resource([('DATA', versioned(root, 1, 0))]))
+    write('v1_lz4/world_physics.vphys_c', resource([('DATA', versioned(root, 1, 1))]))
+    write('v2/world_physics.vphys_c', resource([('DATA', versioned(root, 2, 0))]))
+    write('v2_lz4/world_physics.vphys_c', resource([('DATA', versioned(root, 2, 1))]))
+    # Models keep their physics in a PHYS block next to the model DATA.
+    write('v3_lz4/model.vmdl_c', resource([('DATA', bytes(16)), ('PHYS', versioned(root, 3, 1))]))
+
+    write('v4/world_physics.vphys_c', resource([('DATA', versioned(root, 3, 0, magic_version=4))]))
+    write('zstd/world_physics.vphys_c', resource([('DATA', versioned(root, 2, 2))]))
+
+    write('expected.tri', expected_triangles())
+
+
+if __name__ == '__main__':
+    main()